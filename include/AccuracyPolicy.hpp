@@ -0,0 +1,44 @@
+#ifndef __ACCURACY_POLICY_H__
+#define __ACCURACY_POLICY_H__
+
+#pragma once
+#include <cstdint>
+
+/**
+ *  Accuracy policies of the frame loop. Every policy is compiled into its own specialization of
+ *  GameBoy::runFrame, which is picked once when the emulator starts.
+ */
+
+// Cycle accurate: M-cycle stepped CPU, FIFO PPU, timer ticked every T-cycle
+struct AccuratePolicy
+{
+    // Run a whole instruction when the CPU gets its turn and let the rest of the machine catch up
+    static constexpr bool instructionLevelCpu = false;
+    // Draw every line at once instead of going through the pixel FIFOs
+    static constexpr bool scanlinePpu = false;
+    // Advance the timer only before the CPU runs, instead of every T-cycle
+    static constexpr bool lazyTimer = false;
+    // Smallest batch of T-cycles the APU is run for; audioBatchCycles is used if it is bigger
+    static constexpr uint8_t minAudioBatchCycles = 1;
+    // Count every CPU cycle in GameBoy::profiler
+    static constexpr bool profiler = false;
+};
+
+// Frame accurate: instruction level CPU, scanline PPU, lazy timer and APU
+struct FastPolicy
+{
+    static constexpr bool instructionLevelCpu = true;
+    static constexpr bool scanlinePpu = true;
+    static constexpr bool lazyTimer = true;
+    // Stays below the number of cycles between two audio samples
+    static constexpr uint8_t minAudioBatchCycles = 64;
+    static constexpr bool profiler = false;
+};
+
+// Any of the policies above with the profiler hooked into the CPU
+template <class Policy> struct ProfilingPolicy : Policy
+{
+    static constexpr bool profiler = true;
+};
+
+#endif // __ACCURACY_POLICY_H__
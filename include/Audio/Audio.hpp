@@ -15,7 +15,11 @@
 #define AUDIO_CYCLES_UNTIL_SAMPLE_COLLECTION 95
 #define AUDIO_WAIT_CYCLES 8192
 
+class AudioThread;
+class HashStream;
 class Memory;
+class Recorder;
+class StateSerializer;
 
 class Audio
 {
@@ -40,12 +44,36 @@ class Audio
 
     bool initialInit = false;
 
+    // When false, the channels are still cycled but no samples are collected or queued. Used for
+    // frames that are emulated speculatively and then discarded
+    bool mixSamples = true;
+
+    // Gets a copy of every chunk of samples queued to SDL, if it is recording
+    Recorder *recorder = nullptr;
+    // Hashes every chunk of samples, in headless runs
+    HashStream *hashStream = nullptr;
+    // False in headless runs, which mix the samples without an audio device
+    bool queueToSdl = true;
+
+    // While it is set, the channels are only cycled as far as the CPU can see and the samples
+    // are made by the audio thread
+    AudioThread *audioThread = nullptr;
+
     Audio();
     ~Audio();
 
     void initSDL();
+    // Playback time of the samples queued to SDL that weren't played yet
+    uint32_t getQueuedMicroseconds();
 
     void cycle(uint8_t numCycles);
+    // Without synthesize only the length counters and the sweep run, which are what turn the
+    // channels off in NR52
+    template <bool synthesize> void cycleChannels(uint8_t numCycles);
+    // Collects the samples of numCycles cycles and queues every full buffer
+    void mix(uint8_t numCycles);
+
+    void serialize(StateSerializer &state);
 
     // Channel 1 Sweep - NR10 - 0xFF10
     uint8_t getChannel1Sweep();
@@ -0,0 +1,121 @@
+#ifndef __AUDIO_THREAD_H__
+#define __AUDIO_THREAD_H__
+
+#pragma once
+#include "Audio.hpp"
+#include "Memory.hpp"
+#include "PPU.hpp"
+#include "ReplayLog.hpp"
+#include <cstdint>
+
+// Entries of the log; must be a power of 2
+#define AUDIO_LOG_SIZE (1 << 14)
+// Batches of cycles logged in one entry before the thread is given them
+#define AUDIO_LOG_FLUSH_BATCHES 1024
+
+enum AudioLogType {
+    // Write of the CPU to FF10-FF3F; address is the register
+    AUDIO_LOG_WRITE,
+    // address calls of Audio::cycle(value), with the samples mixed or not
+    AUDIO_LOG_CYCLES,
+    AUDIO_LOG_CYCLES_NO_MIX
+};
+
+struct AudioLogEntry
+{
+    uint16_t address;
+    uint8_t value;
+    uint8_t type;
+};
+
+/**
+ *  Makes the samples on its own thread.
+ *
+ *  While it runs, Audio::cycle only runs the length counters and the sweep of the emulator
+ *  channels, which are all that change what the CPU can read (the channel flags of NR52). Every
+ *  call is logged as a batch of cycles and every write of the CPU to the audio registers and the
+ *  wave RAM is logged between them, so the cycles logged before a write are its timestamp. The
+ *  audio thread replays the log on a shadow Audio and Memory: the writes through
+ *  Memory::writeAudioRegister and the batches through Audio::cycle, so the shadow channels go
+ *  through exactly the same states and make the same samples, which it mixes and queues to SDL,
+ *  the recorder and the hash stream.
+ *
+ *  The duty, wave, noise and envelope state only the shadow channels keep is copied back to the
+ *  emulator Audio when a state is saved.
+ */
+class AudioThread
+{
+  public:
+    // The emulator Audio the writes come from; nullptr while the thread isn't running
+    Audio *source = nullptr;
+
+    Memory memory;
+    Audio audio;
+    // Never cycled; Memory needs one to see that no OAM DMA is running
+    PPU ppu;
+
+    AudioThread();
+    ~AudioThread();
+
+    // Copies the state of source into the shadow Audio, hooks the thread into it and starts it
+    void start(Audio *source);
+    // Waits for the log to be replayed, copies the state and the samples not queued yet back into
+    // source and unhooks the thread
+    void stop();
+
+    void logWrite(uint16_t addr, uint8_t val)
+    {
+        flushCycles();
+        replayLog.push({addr, val, AUDIO_LOG_WRITE});
+    }
+
+    // Consecutive batches of the same size are logged as one entry
+    void logCycles(uint8_t numCycles, bool mixSamples)
+    {
+        uint8_t type = mixSamples ? AUDIO_LOG_CYCLES : AUDIO_LOG_CYCLES_NO_MIX;
+        if (pendingBatches != 0 && (numCycles != pendingCycles || type != pendingType))
+            flushCycles();
+
+        pendingCycles = numCycles;
+        pendingType = type;
+        if (++pendingBatches == AUDIO_LOG_FLUSH_BATCHES)
+            flushCycles();
+    }
+
+    // Gives the thread the batches logged since the last entry
+    void flushCycles()
+    {
+        if (pendingBatches == 0)
+            return;
+
+        replayLog.push({pendingBatches, pendingCycles, pendingType});
+        pendingBatches = 0;
+        replayLog.wake();
+    }
+
+    // Waits until the whole log has been replayed
+    void drain()
+    {
+        flushCycles();
+        replayLog.drain();
+    }
+    // With the log drained: copy the state of source into the shadow Audio (after a state was
+    // loaded) or the state only the shadow Audio keeps into source (before a state is saved)
+    void syncFromSource();
+    void syncToSource();
+
+  private:
+    uint16_t pendingBatches = 0;
+    uint8_t pendingCycles = 0;
+    uint8_t pendingType = AUDIO_LOG_CYCLES;
+
+    void replay(const AudioLogEntry &entry);
+
+    ReplayLog<AudioLogEntry, AUDIO_LOG_SIZE, AudioThread, &AudioThread::replay> replayLog{
+        this, "Audio", "Wait for audio thread", "Audio"};
+
+    // The state Audio::serialize saves
+    static void copyState(Audio &dest, const Audio &source);
+};
+
+#endif // __AUDIO_THREAD_H__
@@ -5,6 +5,7 @@
 #include <cstdint>
 
 class Audio;
+class StateSerializer;
 
 class Channel1
 {
@@ -48,6 +49,8 @@ class Channel1
     uint16_t calcNewSweepFreq(bool &overflow);
 
     void updateSoundLengthCycles(uint8_t soundLength);
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __CHANNEL_1_H__
@@ -5,6 +5,7 @@
 #include <cstdint>
 
 class Audio;
+class StateSerializer;
 
 class Channel2
 {
@@ -35,6 +36,8 @@ class Channel2
     uint8_t getVolume();
 
     void updateSoundLengthCycles(uint8_t soundLength);
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __CHANNEL_2_H__
@@ -5,6 +5,7 @@
 #include <cstdint>
 
 class Audio;
+class StateSerializer;
 
 class Channel3
 {
@@ -29,6 +30,8 @@ class Channel3
     uint8_t getVolume();
 
     void updateSoundLengthCycles(uint8_t soundLength);
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __CHANNEL_3_H__
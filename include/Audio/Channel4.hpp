@@ -5,6 +5,7 @@
 #include <cstdint>
 
 class Audio;
+class StateSerializer;
 
 class Channel4
 {
@@ -38,6 +39,8 @@ class Channel4
     uint8_t getVolume();
 
     void updateSoundLengthCycles(uint8_t soundLength);
+
+    void serialize(StateSerializer &state);
     uint64_t calcStepCycles(uint8_t shiftClockFrequency, uint8_t dividingRatio);
 };
 
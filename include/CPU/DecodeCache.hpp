@@ -0,0 +1,62 @@
+#ifndef __DECODE_CACHE_H__
+#define __DECODE_CACHE_H__
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define DECODE_CACHE_BANK_SIZE 0x4000
+
+class ROM;
+
+struct DecodedInstruction
+{
+    // 0 if the entry has not been decoded yet
+    uint8_t length;
+    uint8_t opcode;
+    // Bytes following the opcode; only the first length - 1 are valid
+    uint8_t operands[2];
+};
+
+/**
+ *  Cache of decoded instructions for code running from the cartridge ROM (0x0000-0x7FFF).
+ *  Entries are keyed by (ROM bank, address inside the bank), so the instructions of a basic block
+ *  sit next to each other and are decoded only the first time they are executed. Fetching a
+ *  cached instruction does not go through Memory::readmem and the MBC read functions.
+ *
+ *  Each of the two 16KB regions keeps a pointer to the table of the bank currently mapped there.
+ *  The pointers are recomputed when ROM::mappingGeneration changes (bank switch, bootrom disable,
+ *  state load); the entries themselves stay valid since ROM can't be written.
+ *
+ *  Tables are allocated the first time code from their bank is executed.
+ */
+class DecodeCache
+{
+  public:
+    std::vector<std::unique_ptr<DecodedInstruction[]>> banks;
+
+    // Table, ROM data and number of the bank mapped in each region; nullptr / -1 if the region
+    // can't be cached
+    DecodedInstruction *regionTables[2];
+    const uint8_t *regionData[2];
+    int32_t regionBanks[2];
+
+    // Values of the ROM at the time the regions were mapped
+    const uint8_t *mappedRomData;
+    uint32_t mappedGeneration;
+
+    DecodeCache();
+
+    void clear();
+
+    // Returns the decoded instruction at addr, or nullptr if it must be read through the memory bus
+    DecodedInstruction *lookup(ROM *rom, uint16_t addr);
+
+    static uint8_t getInstructionLength(uint8_t opcode);
+
+  private:
+    void mapRegions(ROM *rom);
+};
+
+#endif // __DECODE_CACHE_H__
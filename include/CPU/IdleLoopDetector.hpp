@@ -0,0 +1,92 @@
+#ifndef __IDLE_LOOP_DETECTOR_H__
+#define __IDLE_LOOP_DETECTOR_H__
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Longest loop (in bytes, from the branch target to the branch) that is analyzed
+#define IDLE_LOOP_MAX_SIZE 32
+#define IDLE_LOOP_MAX_READS 4
+// Longest iteration (in M-cycles) that can be skipped
+#define IDLE_LOOP_MAX_PERIOD 255
+
+enum IdleLoopRead { IDLE_READ_FIXED, IDLE_READ_HL, IDLE_READ_BC, IDLE_READ_DE, IDLE_READ_FF00_C };
+
+class SM83;
+class StateSerializer;
+
+struct IdleLoop
+{
+    // false if the loop has side effects or carries state from one iteration to the next
+    bool idle;
+    uint16_t start, end;
+
+    // Memory the loop reads; the address of a register based read is computed when skipping starts
+    uint8_t numReads;
+    IdleLoopRead readKinds[IDLE_LOOP_MAX_READS];
+    uint16_t readAddresses[IDLE_LOOP_MAX_READS];
+
+    uint64_t skippedCycles;
+    uint32_t timesSkipped;
+};
+
+/**
+ *  Detects loops that only wait for a value to change, like `ld a,(ff44); cp n; jr nz` or polling
+ *  STAT / IF, and skips running them.
+ *
+ *  When the interpreter takes a short backward branch in ROM, the loop between the target and the
+ *  branch is analyzed once. A loop is idle if it does not write memory, does not leave the loop
+ *  except through conditional branches, and every register it reads is either written earlier in
+ *  the same iteration or not written by the loop at all. Such a loop does the exact same thing on
+ *  every iteration as long as the memory it reads does not change.
+ *
+ *  Once two iterations in a row start with the same memory values, the CPU stops executing the
+ *  loop. Every iteration length the values are read again and the CPU resumes at the start of the
+ *  loop when one of them changed. It resumes immediately when an interrupt is about to be serviced.
+ */
+class IdleLoopDetector
+{
+  public:
+    bool enabled;
+
+    // Analysis results, keyed by (ROM bank, start, end)
+    std::unordered_map<uint64_t, IdleLoop> loops;
+
+    // Loop that is being skipped
+    bool active;
+    uint64_t currentKey;
+    uint8_t period;
+    uint8_t cyclesUntilCheck;
+    uint8_t numReads;
+    uint16_t readAddresses[IDLE_LOOP_MAX_READS];
+    uint8_t readValues[IDLE_LOOP_MAX_READS];
+    uint64_t currentSkippedCycles;
+
+    // Loop seen on the last backward branch, waiting for a second iteration with the same values
+    uint64_t candidateKey;
+    uint64_t candidateCycle;
+    uint8_t candidateValues[IDLE_LOOP_MAX_READS];
+
+    /* STATISTICS */
+
+    uint64_t totalCycles;
+    uint64_t skippedCycles;
+
+    IdleLoopDetector();
+
+    // Called for every CPU M-cycle; returns true if the cycle was skipped
+    bool cycle(SM83 &cpu);
+    // Called after a taken branch from branchPc back to PC
+    void onBackwardBranch(SM83 &cpu, uint16_t branchPc);
+    void stop();
+
+    void printStats(std::string gameTitle);
+    void serialize(StateSerializer &state);
+
+  private:
+    IdleLoop analyze(SM83 &cpu, uint16_t start, uint16_t end);
+};
+
+#endif // __IDLE_LOOP_DETECTOR_H__
@@ -0,0 +1,45 @@
+#ifndef __INTERRUPT_CONTROLLER_H__
+#define __INTERRUPT_CONTROLLER_H__
+
+#pragma once
+#include <cstdint>
+
+// Bits of the IE and IF registers, in priority order
+#define INTERRUPT_VBLANK 0x01
+#define INTERRUPT_LCD_STAT 0x02
+#define INTERRUPT_TIMER 0x04
+#define INTERRUPT_SERIAL 0x08
+#define INTERRUPT_JOYPAD 0x10
+#define INTERRUPT_MASK 0x1F
+
+#define INTERRUPT_VECTOR_START 0x40
+#define INTERRUPT_VECTOR_SIZE 0x08
+
+/**
+ *  Keeps IE & IF as a single cached bitmask, so checking for pending interrupts does not have to
+ *  go through the memory bus. IE and IF themselves are still stored by Memory; the mask is
+ *  recomputed whenever one of them is written (see Memory::updateInterrupts()).
+ *
+ *  The functions are defined here so they can be inlined in the CPU loop.
+ */
+class InterruptController
+{
+  public:
+    // IE & IF; nonzero if an interrupt is pending
+    uint8_t pending = 0;
+
+    void update(uint8_t ie, uint8_t flags) { pending = ie & flags & INTERRUPT_MASK; }
+
+    bool anyPending() { return pending != 0; }
+
+    // Index of the highest priority pending interrupt (0 = VBlank ... 4 = Joypad). Should only be
+    // called if anyPending() is true
+    uint8_t getHighestPriority() { return __builtin_ctz(pending); }
+
+    static uint16_t getVector(uint8_t index)
+    {
+        return INTERRUPT_VECTOR_START + index * INTERRUPT_VECTOR_SIZE;
+    }
+};
+
+#endif // __INTERRUPT_CONTROLLER_H__
@@ -0,0 +1,79 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define JIT_CODE_BUFFER_SIZE (16 * 1024 * 1024)
+#define JIT_MAX_BLOCK_INSTRUCTIONS 32
+// Upper bound of the code emitted for one block
+#define JIT_MAX_BLOCK_SIZE (JIT_MAX_BLOCK_INSTRUCTIONS * 64 + 64)
+// Number of times a block has to be reached before it is compiled
+#define JIT_DEFAULT_HOT_THRESHOLD 16
+#define JIT_NOT_COMPILABLE 0xFFFF
+
+class SM83;
+
+// Compiled block; runs the block and returns the number of M-cycles it took
+typedef uint32_t (*JitBlock)(SM83 *cpu);
+
+struct JitEntry
+{
+    JitBlock block;
+    // Times the block was reached before being compiled; JIT_NOT_COMPILABLE if it can't be
+    uint16_t hits;
+};
+
+/**
+ *  Dynamic recompiler that translates hot SM83 basic blocks running from ROM into x86-64 code.
+ *
+ *  A block is run as a whole and its cycles are handed back to the caller, which advances the rest
+ *  of the machine before the CPU continues; timing is accurate at block granularity instead of
+ *  M-cycle granularity. Blocks end at control flow instructions and around memory accesses: an
+ *  instruction that accesses memory can only be the first of a block, and a write also ends it,
+ *  so IO is always accessed with the rest of the machine caught up and a bank switch can't
+ *  change the code of the block being run.
+ *
+ *  Register loads, 16-bit increments and unconditional jumps are emitted as native code. Every
+ *  other instruction calls back into the interpreter handler, which accesses memory through the
+ *  Memory interface as usual.
+ *
+ *  Blocks are keyed by (ROM bank, address), like the DecodeCache. Code in RAM is never compiled and
+ *  always runs on the interpreter, which stays the reference implementation.
+ */
+class Jit
+{
+  public:
+    uint8_t *codeBuffer;
+    size_t codeUsed;
+
+    // Indexed by (bank << 1) | region, since a bank can be mapped at 0x0000 or 0x4000 on MBC1
+    std::vector<std::unique_ptr<JitEntry[]>> blocks;
+    const uint8_t *mappedRomData;
+
+    uint16_t hotThreshold;
+
+    uint64_t blocksCompiled;
+    uint64_t blocksRun;
+
+    Jit();
+    ~Jit();
+
+    // Allocates the executable code buffer; returns false if the JIT can't be used
+    bool init();
+    bool isAvailable();
+    void flush();
+
+    // Runs the block at PC if it is compiled. Returns the number of M-cycles it took, or 0 if the
+    // interpreter should run the next cycle instead
+    uint32_t run(SM83 &cpu);
+
+  private:
+    JitEntry *getEntry(SM83 &cpu);
+    JitBlock compile(SM83 &cpu);
+};
+
+#endif // __JIT_H__
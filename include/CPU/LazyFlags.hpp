@@ -0,0 +1,155 @@
+#ifndef __LAZY_FLAGS_H__
+#define __LAZY_FLAGS_H__
+
+#pragma once
+#include <cstdint>
+
+enum LazyFlagsOp : uint8_t { FLAGS_MATERIALIZED, FLAGS_ADD, FLAGS_SUB, FLAGS_INC, FLAGS_DEC, FLAGS_LOGIC };
+
+/**
+ *  The F register, with lazy flag evaluation.
+ *
+ *  The 8 bit ALU instructions don't compute Z, N, H and C; they only record the operation and its
+ *  operands. A flag is computed when something reads it (conditional jumps, ADC / SBC, DAA,
+ *  PUSH AF...), and only the flag that is read. Most flags are overwritten by the next ALU
+ *  instruction before anything reads them.
+ *
+ *  The object converts to and from uint8_t, so F can still be used as a plain register. The flags
+ *  that the recorded operation doesn't compute are kept in flags; for FLAGS_MATERIALIZED that is
+ *  all of them.
+ *
+ *  The functions are defined here so they can be inlined in the opcode functions.
+ */
+class LazyFlags
+{
+  public:
+    LazyFlags() : op(FLAGS_MATERIALIZED), flags(0), lowBits(0), lhs(0), rhs(0), carryIn(0) {}
+
+    LazyFlags &operator=(uint8_t val)
+    {
+        op = FLAGS_MATERIALIZED;
+        flags = val;
+        lowBits = val & 0x0F;
+        return *this;
+    }
+
+    LazyFlags &operator=(const LazyFlags &other) = default;
+
+    operator uint8_t() const { return get(); }
+
+    uint8_t get() const
+    {
+        return (getZero() << 7) | (getSubtract() << 6) | (getHalfCarry() << 5) |
+               (getCarry() << 4) | lowBits;
+    }
+
+    uint8_t getZero() const
+    {
+        switch (op) {
+        case FLAGS_ADD:
+            return (uint8_t)(lhs + rhs + carryIn) == 0;
+        case FLAGS_SUB:
+            return (uint8_t)(lhs - rhs - carryIn) == 0;
+        case FLAGS_INC:
+        case FLAGS_DEC:
+        case FLAGS_LOGIC:
+            return lhs == 0;
+        default:
+            return (flags & 0x80) >> 7;
+        }
+    }
+
+    uint8_t getSubtract() const
+    {
+        switch (op) {
+        case FLAGS_ADD:
+        case FLAGS_INC:
+            return 0;
+        case FLAGS_SUB:
+        case FLAGS_DEC:
+            return 1;
+        default:
+            return (flags & 0x40) >> 6;
+        }
+    }
+
+    uint8_t getHalfCarry() const
+    {
+        switch (op) {
+        case FLAGS_ADD:
+            return ((lhs & 0xF) + (rhs & 0xF) + carryIn) > 0xF;
+        case FLAGS_SUB:
+            return (lhs & 0xF) < (rhs & 0xF) + carryIn;
+        case FLAGS_INC:
+            return (lhs & 0xF) == 0;
+        case FLAGS_DEC:
+            return (lhs & 0xF) == 0xF;
+        default:
+            return (flags & 0x20) >> 5;
+        }
+    }
+
+    uint8_t getCarry() const
+    {
+        switch (op) {
+        case FLAGS_ADD:
+            return lhs + rhs + carryIn > 0xFF;
+        case FLAGS_SUB:
+            return lhs < rhs + carryIn;
+        default:
+            return (flags & 0x10) >> 4;
+        }
+    }
+
+    // Z N H C from a + b + carry
+    void setAdd(uint8_t a, uint8_t b, uint8_t carry = 0)
+    {
+        op = FLAGS_ADD;
+        lhs = a;
+        rhs = b;
+        carryIn = carry;
+    }
+
+    // Z N H C from a - b - carry
+    void setSub(uint8_t a, uint8_t b, uint8_t carry = 0)
+    {
+        op = FLAGS_SUB;
+        lhs = a;
+        rhs = b;
+        carryIn = carry;
+    }
+
+    // Z N H from the incremented value; C is kept
+    void setInc(uint8_t result)
+    {
+        flags = getCarry() << 4;
+        op = FLAGS_INC;
+        lhs = result;
+    }
+
+    // Z N H from the decremented value; C is kept
+    void setDec(uint8_t result)
+    {
+        flags = getCarry() << 4;
+        op = FLAGS_DEC;
+        lhs = result;
+    }
+
+    // Z from result; N H C are given in nhc
+    void setLogic(uint8_t result, uint8_t nhc)
+    {
+        flags = nhc & 0x70;
+        op = FLAGS_LOGIC;
+        lhs = result;
+    }
+
+  private:
+    LazyFlagsOp op;
+    uint8_t flags;   // flags that the recorded operation does not compute
+    uint8_t lowBits; // bits 3-0, which are only changed by assignments
+    uint8_t lhs;
+    uint8_t rhs;
+    uint8_t carryIn;
+};
+
+#endif // __LAZY_FLAGS_H__
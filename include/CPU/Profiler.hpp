@@ -0,0 +1,112 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Base opcodes are 0x00-0xFF, CB prefixed ones 0x100-0x1FF
+#define PROFILER_NUM_OPCODES 512
+#define PROFILER_MAX_STACK_DEPTH 64
+#define PROFILER_REPORT_ENTRIES 100
+// Bank stored in the key of code that is not in a known ROM bank (bootrom, unsupported MBC)
+#define PROFILER_NO_BANK 0xFFFF
+// Keys of the cycles that don't belong to an instruction
+#define PROFILER_INTERRUPT_KEY 0xFFFFFFFF
+#define PROFILER_HALT_KEY 0xFFFFFFFE
+#define PROFILER_IDLE_LOOP_KEY 0xFFFFFFFD
+
+class SM83;
+class ROM;
+
+struct ProfilerSymbol
+{
+    uint16_t bank;
+    uint16_t addr;
+    std::string name;
+};
+
+/**
+ *  Counts the M-cycles the CPU spends on every instruction, keyed by (ROM bank, PC) and by opcode.
+ *
+ *  cycle() is called by the frame loop before every CPU M-cycle. The instruction a cycle belongs to
+ *  is picked when the previous one ended, so all the cycles of an instruction go to its address,
+ *  while interrupt dispatch, HALT and skipped idle loops are counted separately.
+ *
+ *  Addresses are resolved against the RGBDS .sym file next to the ROM, if there is one. With folded
+ *  stacks enabled, a shadow call stack is kept from CALL / RST / RET and interrupts, and the cycles
+ *  are written in the folded format used by flame graph tools.
+ *
+ *  The frame loop only calls the profiler in its profiling specializations, so it costs nothing
+ *  when disabled.
+ */
+class Profiler
+{
+  public:
+    bool enabled;
+    bool foldedStacks;
+
+    ROM *rom;
+
+    // Cycles per ROM address, indexed by bank * 0x4000 + (PC & 0x3FFF)
+    std::vector<uint64_t> romCycles;
+    // Cycles of code outside of the ROM banks (bootrom, RAM), indexed by PC
+    std::vector<uint64_t> otherCycles;
+
+    uint64_t opcodeCycles[PROFILER_NUM_OPCODES];
+    uint64_t opcodeCounts[PROFILER_NUM_OPCODES];
+
+    uint64_t totalCycles;
+    uint64_t interruptCycles;
+    uint64_t haltCycles;
+    uint64_t idleLoopCycles;
+
+    std::vector<ProfilerSymbol> symbols;
+
+    // Instruction the next cycles are counted for
+    uint32_t currentKey;
+    uint16_t currentOpcode;
+    uint16_t currentSp;
+    uint64_t *currentCounter;
+    uint64_t *currentOpcodeCounter;
+    uint64_t currentCycles;
+    // Opcode counter of the cycles that are not spent on an instruction
+    uint64_t noOpcodeCycles;
+
+    // Keys of the called functions, outermost first
+    std::vector<uint32_t> callStack;
+    // Calls made while the call stack was full, which are not tracked
+    uint32_t overflowFrames;
+    std::vector<uint32_t> stackKey;
+    std::map<std::vector<uint32_t>, uint64_t> stackCycles;
+
+    Profiler();
+
+    void init(ROM *rom, bool foldedStacks);
+    // Loads an RGBDS .sym file; returns false if it can't be read
+    bool loadSymbols(std::string path);
+
+    void cycle(SM83 &cpu);
+
+    // Writes the report or the folded stacks, depending on foldedStacks
+    bool write(std::string path, std::string gameTitle);
+
+    // (bank << 16) | addr of the code at addr, with the banks numbered like in RGBDS .sym files
+    uint32_t getKey(uint16_t addr);
+    // Name of the symbol at or before the key, with the offset from it if withOffset is set.
+    // Without symbols, or without offset, the address or the function is printed instead
+    std::string resolve(uint32_t key, bool withOffset = true);
+
+  private:
+    uint64_t *getCounter(uint32_t key);
+    void startInstruction(SM83 &cpu);
+    void startOther(SM83 &cpu, uint32_t key, uint64_t *counter);
+    // Updates the call stack and the stack cycles with the instruction that just ended
+    void endCurrent(SM83 &cpu);
+    bool writeReport(std::string path, std::string gameTitle);
+    bool writeFoldedStacks(std::string path);
+};
+
+#endif // __PROFILER_H__
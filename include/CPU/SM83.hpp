@@ -4,7 +4,11 @@
 #pragma once
 #include <cstdint>
 #include <cstring>
+#include "DecodeCache.hpp"
 #include "Enums.hpp"
+#include "IdleLoopDetector.hpp"
+#include "LazyFlags.hpp"
+#include "Tracer.hpp"
 
 #define SM83_VBLANK_INT 0x40
 #define SM83_LCD_STAT_INT 0x48
@@ -14,13 +18,16 @@
 
 class Memory;
 class GameBoy;
+class StateSerializer;
+
 class SM83
 {
   public:
     Memory *memory;
     GameBoy *gameboy;
 
-    uint8_t A, F, B, C, D, E, H, L;
+    uint8_t A, B, C, D, E, H, L;
+    LazyFlags F;
     uint16_t PC, SP;
 
     // The current cycle the current instruction being executed is on
@@ -54,6 +61,22 @@ class SM83
 
     bool stop_signal;
 
+    // Set when the CPU ran into an illegal opcode; it is stuck on it from then on
+    bool illegalOpcode;
+
+    // Decoded instructions of the code running from ROM
+    DecodeCache decodeCache;
+
+    // Cached decoding of the instruction being executed; nullptr if it is read through the memory bus
+    DecodedInstruction *currentInstruction;
+
+    // Address of the instruction being executed
+    uint16_t instructionPc;
+
+    IdleLoopDetector idleLoop;
+
+    Tracer tracer;
+
     SM83();
     void initRegisters();
 
@@ -63,10 +86,15 @@ class SM83
     bool checkInterrupts(int8_t *int_cycles, uint16_t *int_addr);
     bool serviceInterrupt();
 
+    void serialize(StateSerializer &state);
+
     /* MEMORY READ AND WRITE */
 
     uint8_t readmem_u8(uint16_t addr);
     uint16_t readmem_u16(uint16_t addr);
+    uint8_t fetchOpcode();
+    uint8_t readImmediate_u8();
+    uint16_t readImmediate_u16();
     void writemem_u8(uint8_t val, uint16_t addr);
     void writemem_u16(uint16_t val, uint16_t addr);
 
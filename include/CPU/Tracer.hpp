@@ -0,0 +1,103 @@
+#ifndef __TRACER_H__
+#define __TRACER_H__
+
+#pragma once
+#include "Enums.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TRACE_FILE_MAGIC "GBTRACE1"
+#define TRACE_DEFAULT_BUFFER_SIZE_MB 16
+#define TRACE_NO_BANK 0xFFFF
+
+class SM83;
+
+// State of the CPU at the start of an instruction; written to the trace files as is
+struct TraceRecord
+{
+    uint16_t pc, sp;
+    // ROM bank the instruction was read from, TRACE_NO_BANK outside of the ROM
+    uint16_t bank;
+    uint8_t a, f, b, c, d, e, h, l;
+    // The 4 bytes at PC
+    uint8_t pcmem[4];
+    uint8_t ime;
+    uint8_t padding;
+};
+
+static_assert(sizeof(TraceRecord) == 20, "TraceRecord is written to files as is");
+
+struct TraceFileHeader
+{
+    char magic[8];
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+/**
+ *  Records the state of the CPU at the start of every instruction into a preallocated ring buffer.
+ *
+ *  In ring mode the buffer works as a flight recorder: it always holds the last instructions and is
+ *  only written to the trace file when something goes wrong (illegal opcode, crash signal) or when
+ *  a dump is requested (SIGUSR1 or F12). In stream mode a background thread writes the records to
+ *  the trace file as they are produced; the CPU waits for it if the buffer fills up, so no
+ *  instruction is lost.
+ *
+ *  Trace files are a TraceFileHeader followed by TraceRecords, oldest first. convertToDoctor turns
+ *  them into the gameboy-doctor log format, to diff them against the logs of other emulators.
+ */
+class Tracer
+{
+  public:
+    bool enabled;
+    TraceMode mode;
+    std::string path;
+
+    std::vector<TraceRecord> records;
+    // records.size() - 1; the size is a power of 2
+    uint64_t mask;
+    // Number of records written so far; the next one goes to records[head & mask]
+    std::atomic<uint64_t> head;
+    // Number of records the writer thread has written to the file, in stream mode
+    std::atomic<uint64_t> tail;
+
+    // Set by SIGUSR1; the dump is done by the emulator thread
+    std::atomic<bool> dumpRequested;
+
+    Tracer();
+    ~Tracer();
+
+    // Allocates the buffer and, in stream mode, opens the file and starts the writer thread
+    bool init(TraceMode mode, std::string path, size_t bufferSize);
+    void stop();
+
+    void record(SM83 &cpu);
+
+    // Writes the records in the ring buffer to the trace file
+    bool dump(const char *reason);
+    // Dumps the buffer if a dump was requested since the last call
+    void update();
+
+    // Dumps the ring buffer on crash signals and on SIGUSR1
+    void installSignalHandlers();
+
+    // Converts a trace file into one gameboy-doctor log line per instruction
+    static bool convertToDoctor(std::string tracePath, FILE *out);
+
+  private:
+    FILE *streamFile;
+    std::thread writerThread;
+    std::atomic<bool> writerRunning;
+    // Path as a C string, so it can be opened from a signal handler
+    char signalPath[4096];
+
+    void writerLoop();
+    void writeRange(FILE *file, uint64_t from, uint64_t to);
+    static void signalHandler(int signal);
+};
+
+#endif // __TRACER_H__
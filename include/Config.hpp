@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <string>
 #include "Color.hpp"
+#include "Enums.hpp"
 
 class Config
 {
@@ -18,7 +19,26 @@ class Config
     bool useBootrom = false;
     std::string bootromPath;
     bool printPerformanceInfo;
+    int performanceInfoInterval;
     bool useCustomDMGPalette;
+    int runAheadFrames;
+    bool useJit;
+    bool idleLoopSkipping;
+    AccuracyProfile accuracyProfile;
+    bool renderThread;
+    bool audioThread;
+    ProfilerOutput profilerOutput;
+    TraceMode traceMode;
+    bool timelineEnable;
+    bool timelinePpuModes;
+    ScaleFilter scaleFilter;
+    int scaleThreads;
+    int traceBufferSize;
+    bool rewindEnable;
+    int rewindFrameInterval;
+    int rewindBufferSize;
+    RecordFormat recordFormat;
+    bool recordDirectIo;
 
     Color bgCustomDMGPalette[4];
     Color obp0CustomDMGPalette[4];
@@ -37,7 +57,26 @@ class Config
     bool getUseBootrom();
     std::string getBootromPath();
     bool getPrintPerformanceInfo();
+    int getPerformanceInfoInterval();
     bool getUseCustomDMGPalette();
+    int getRunAheadFrames();
+    bool getUseJit();
+    bool getIdleLoopSkipping();
+    AccuracyProfile getAccuracyProfile();
+    bool getRenderThread();
+    bool getAudioThread();
+    ProfilerOutput getProfilerOutput();
+    TraceMode getTraceMode();
+    bool getTimelineEnable();
+    bool getTimelinePpuModes();
+    ScaleFilter getScaleFilter();
+    int getScaleThreads();
+    int getTraceBufferSize();
+    bool getRewindEnable();
+    int getRewindFrameInterval();
+    int getRewindBufferSize();
+    RecordFormat getRecordFormat();
+    bool getRecordDirectIo();
     Color getBgCustomDMGPalette(int index);
     Color getObp0CustomDMGPalette(int index);
     Color getObp1CustomDMGPalette(int index);
@@ -48,7 +87,26 @@ class Config
     void setUseBootrom(bool useBootrom);
     void setBootromPath(std::string bootromPath);
     void setPrintPerformanceInfo(bool printPerformanceInfo);
+    void setPerformanceInfoInterval(int performanceInfoInterval);
     void setUseCustomDMGPalette(bool useCustomDMGPalette);
+    void setRunAheadFrames(int runAheadFrames);
+    void setUseJit(bool useJit);
+    void setIdleLoopSkipping(bool idleLoopSkipping);
+    void setAccuracyProfile(AccuracyProfile accuracyProfile);
+    void setRenderThread(bool renderThread);
+    void setAudioThread(bool audioThread);
+    void setProfilerOutput(ProfilerOutput profilerOutput);
+    void setTraceMode(TraceMode traceMode);
+    void setTimelineEnable(bool timelineEnable);
+    void setTimelinePpuModes(bool timelinePpuModes);
+    void setScaleFilter(ScaleFilter scaleFilter);
+    void setScaleThreads(int scaleThreads);
+    void setTraceBufferSize(int traceBufferSize);
+    void setRewindEnable(bool rewindEnable);
+    void setRewindFrameInterval(int rewindFrameInterval);
+    void setRewindBufferSize(int rewindBufferSize);
+    void setRecordFormat(RecordFormat recordFormat);
+    void setRecordDirectIo(bool recordDirectIo);
     void setBgCustomDMGPalette(int index, Color color);
     void setObp0CustomDMGPalette(int index, Color color);
     void setObp1CustomDMGPalette(int index, Color color);
@@ -2,5 +2,10 @@
 #define __ENUMS_H__
 
 enum EmulatorMode { DMG, CGB };
+enum AccuracyProfile { ACCURATE, FAST };
+enum ProfilerOutput { PROFILER_OFF, PROFILER_REPORT, PROFILER_FOLDED };
+enum TraceMode { TRACE_OFF, TRACE_RING, TRACE_STREAM };
+enum ScaleFilter { SCALE_NONE, SCALE_2X, SCALE_3X, SCALE_XBR, SCALE_SHARP_BILINEAR };
+enum RecordFormat { RECORD_Y4M, RECORD_RGBA };
 
 #endif // __ENUMS_H__
\ No newline at end of file
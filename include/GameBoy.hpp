@@ -21,14 +21,26 @@
 #define GAMEBOY_HRAM_START 0xFF80
 
 #pragma once
+#include "AccuracyPolicy.hpp"
 #include "Audio.hpp"
+#include "AudioThread.hpp"
+#include "BatterySaver.hpp"
 #include "Enums.hpp"
+#include "FrameMetrics.hpp"
+#include "HashStream.hpp"
+#include "Jit.hpp"
 #include "Joypad.hpp"
 #include "Memory.hpp"
+#include "Movie.hpp"
 #include "PPU.hpp"
+#include "Profiler.hpp"
 #include "ROM.hpp"
+#include "Recorder.hpp"
+#include "RenderThread.hpp"
+#include "Rewind.hpp"
 #include "SM83.hpp"
 #include "Timer.hpp"
+#include "Upscaler.hpp"
 #include <SDL2/SDL.h>
 #include <chrono>
 #include <cstring>
@@ -54,9 +66,15 @@ class GameBoy
     PPU ppu;
     SM83 cpu;
     ROM rom;
+    // Declared after rom, so it is destroyed (and writes the last save) before it
+    BatterySaver batterySaver;
     Timer timer;
     Joypad joypad;
     Audio audio;
+    // Draws the lines of the fast profile when the render thread is enabled
+    RenderThread renderThread;
+    // Makes the samples when the audio thread is enabled
+    AudioThread audioThread;
 
     bool doubleSpeedMode;
     uint32_t speedSwitchSleepCycles;
@@ -67,9 +85,23 @@ class GameBoy
     uint currentCycles;
     uint numCyclesPerFrame;
 
+    // Histograms of the frame times; the summary is printed every performanceInfoInterval seconds
+    // with printPerformanceInfo, and when the emulator closes
+    FrameMetrics metrics;
+    std::chrono::high_resolution_clock::time_point metricsIntervalStart;
+    // Time of the first joypad change that wasn't presented yet
+    std::chrono::high_resolution_clock::time_point inputChangeTime;
+    bool inputChangePending = false;
+
     uint8_t cpuWaitTCycles; // cycle cpu once every 4 t cycles
+    uint32_t cpuBlockCycles; // M-cycles left of the last block run by the JIT
+
+    Jit jit;
+    bool useJit;
     uint8_t audioBatchCycles;
 
+    Profiler profiler;
+
     // float windowScale;
     int windowWidth, windowHeight;
     SDL_Window *sdlWindow;
@@ -77,26 +109,91 @@ class GameBoy
     SDL_Renderer *sdlRenderer;
     SDL_Texture *sdlTexture;
     SDL_PixelFormat *sdlPixelFormat;
-    uint8_t *sdlTexturePixels = nullptr;
+
+    // The frame as RGBA8888, before it is scaled
+    std::vector<uint32_t> framePixels;
+    // Written by the scaler workers while the next frame is emulated, then uploaded to the texture
+    std::vector<uint32_t> scaledPixels;
+    bool scaledFrameReady = false;
+    Upscaler upscaler;
 
     SDL_DisplayMode sdlDisplayMode;
     uint refreshRate;
 
     const uint8_t *keyboardState;
+    bool traceKeyPressed = false;
     // [0][0-3] -> direction buttons; [1][0-3] -> action buttons
     bool currentKeysState[2][4];
 
     Color displayBuffer[144][160];
 
+    Rewind rewind;
+    std::vector<uint8_t> stateBuffer;
+    uint rewindFrameInterval;
+    uint framesSinceSnapshot;
+
+    uint runAheadFrames;
+    std::vector<uint8_t> runAheadState;
+
+    Movie movie;
+    std::string recordMoviePath;
+    std::string playMoviePath;
+    bool recordMovieFromSave = false; // start the recording from the battery save, not power-on
+
+    // Video and audio recording; an empty path doesn't record that stream
+    Recorder recorder;
+    std::string recordVideoPath;
+    std::string recordAudioPath;
+
     void run();
+    // Loads the ROM and sets the power-on state for run, benchmark and runHeadless; returns false
+    // if the movie or the ROM can't be loaded. reproducible ignores the battery save and the time
+    // of day, unless a movie sets them
+    bool powerOn(bool reproducible);
+    // Picks the accuracy profile, the render thread and idle loop skipping from the config
+    void selectConfiguredFrameLoop();
+    // Emulates one frame; returns true if the emulator should quit. Speculative frames don't
+    // poll the input, so they all run with the input of the real frame before them
+    bool runFrame(bool speculative = false);
+    // Frame loop compiled for one hardware model and accuracy policy; runFrame calls the one
+    // picked by selectFrameLoop, with the profiling one if profiler.enabled is set
+    template <EmulatorMode mode, class Policy> bool runFrame(bool speculative);
+    bool (GameBoy::*runFrameForMode)(bool speculative);
+    // useRenderThread starts renderThread with the fast profile and stops it otherwise
+    void selectFrameLoop(AccuracyProfile profile, bool useRenderThread = false);
+    template <class Policy> bool (GameBoy::*selectFrameLoop())(bool speculative);
+    // Runs the loaded ROM without video or audio for the given number of frames with every
+    // accuracy profile, and the fast one with the render thread, and prints the throughput of
+    // each one, then the time every scale filter takes to scale the last frame
+    void benchmark(uint frames);
+    // Runs the loaded ROM for the given number of frames (0 runs until the movie ends) as fast as
+    // possible without video and audio output, adding the hash of every frame and audio block to
+    // hashes. Returns false if they diverge from its golden stream
+    bool runHeadless(uint frames, HashStream &hashes);
+    void runAhead();
     void initSDL();
     double getDeltaTime(std::chrono::high_resolution_clock::time_point &tp1,
                         std::chrono::high_resolution_clock::time_point &tp2);
     bool getInput();
+    void readKeyboard();
     void savePpuBuffer();
     void drawFrame();
+    void updateMetrics();
     void setInitialState();
 
+    // Writes / restores the whole emulator state, without the SDL and display buffers
+    void saveState(std::vector<uint8_t> &state);
+    bool loadState(std::vector<uint8_t> &state);
+    void updateRewind();
+
+    // Sets up the ROM for a movie; must be called before the ROM is loaded
+    bool prepareMovie();
+    // Records the initial state or restores the one from the movie
+    bool startMovie();
+    // Records or plays back the joypad state of the next frame; returns false at the end of a
+    // playback
+    bool updateMovieInput();
+
     void setDoubleSpeedMode(bool doubleSpeed, bool sleepDuringSwitch = true);
 };
 
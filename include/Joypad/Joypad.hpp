@@ -6,6 +6,7 @@
 
 class SM83;
 class Memory;
+class StateSerializer;
 
 class Joypad
 {
@@ -18,6 +19,8 @@ class Joypad
     bool keyState[2][4];
 
     void cycle();
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __JOYPAD_H__
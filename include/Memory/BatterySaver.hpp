@@ -0,0 +1,64 @@
+#ifndef __BATTERY_SAVER_H__
+#define __BATTERY_SAVER_H__
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Frames without writes to the RAM after which it is saved; games write their saves in bursts
+#define BATTERY_SAVE_QUIET_FRAMES 60
+// A game that never stops writing is still saved this many frames after the first unsaved write
+#define BATTERY_SAVE_MAX_DELAY_FRAMES 600
+
+class ROM;
+
+/**
+ *  Writes the battery RAM of the cartridge to its save file from a background thread.
+ *
+ *  update() is called once per frame and only does work when the game changed the RAM: after
+ *  BATTERY_SAVE_QUIET_FRAMES frames without further changes, the save data is copied on the
+ *  emulator thread and handed to the writer thread, which never touches the ROM. The file is
+ *  replaced through a temporary file, so a crash while saving leaves the previous save intact.
+ *
+ *  stop() writes the last changes, and the current time of the RTC, before the emulator exits.
+ */
+class BatterySaver
+{
+  public:
+    ROM *rom;
+    bool enabled;
+
+    // There are changes to the RAM that were not handed to the writer thread yet
+    bool unsaved;
+    uint32_t quietFrames;
+    uint32_t unsavedFrames;
+
+    // Number of saves written to the file
+    std::atomic<uint32_t> savesWritten;
+
+    BatterySaver();
+    ~BatterySaver();
+
+    // Starts the writer thread if the cartridge has a save file
+    void start(ROM *rom);
+    void update();
+    // Writes the unsaved changes and waits for the writer thread to end
+    void stop();
+
+  private:
+    std::thread writerThread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<uint8_t> pendingData;
+    bool pending;
+    bool stopRequested;
+
+    void queueSave();
+    void writerLoop();
+};
+
+#endif // __BATTERY_SAVER_H__
@@ -0,0 +1,94 @@
+#ifndef __MBC_H__
+#define __MBC_H__
+
+#pragma once
+#include <cstdint>
+#include <memory>
+
+class ROM;
+
+/**
+ *  Memory bank controller of a cartridge.
+ *
+ *  The bank registers live in the ROM; an MBC only decodes the writes to them and maps the banks
+ *  they select with ROM::mapRomBank / ROM::mapRamBank. Reads, and RAM writes, then go straight
+ *  through the ROM windows, so the MBC only runs when a register at 0x0000-0x7FFF is written.
+ *  Accesses to 0xA000-0xBFFF while no RAM bank is mapped there (MBC2 RAM, MBC3 RTC registers)
+ *  are forwarded to readRam / writeRam.
+ *
+ *  The base class is used for the MBCs that are not supported: nothing is mapped, reads return
+ *  0xFF and writes are ignored.
+ */
+class Mbc
+{
+  public:
+    explicit Mbc(ROM *rom);
+    virtual ~Mbc();
+
+    // Returns the MBC of the cartridge type read from the header
+    static std::unique_ptr<Mbc> create(ROM *rom);
+
+    virtual void writeRegister(uint8_t val, uint16_t addr);
+    virtual void mapBanks();
+
+    virtual uint8_t readRam(uint16_t addr);
+    virtual void writeRam(uint8_t val, uint16_t addr);
+
+  protected:
+    ROM *rom;
+};
+
+class NoMbc : public Mbc
+{
+  public:
+    using Mbc::Mbc;
+
+    void writeRegister(uint8_t val, uint16_t addr) override;
+    void mapBanks() override;
+};
+
+class Mbc1 : public Mbc
+{
+  public:
+    using Mbc::Mbc;
+
+    void writeRegister(uint8_t val, uint16_t addr) override;
+    void mapBanks() override;
+};
+
+class Mbc2 : public Mbc
+{
+  public:
+    using Mbc::Mbc;
+
+    void writeRegister(uint8_t val, uint16_t addr) override;
+    void mapBanks() override;
+
+    // The RAM is 512 half bytes, repeated over the whole area
+    uint8_t readRam(uint16_t addr) override;
+    void writeRam(uint8_t val, uint16_t addr) override;
+};
+
+class Mbc3 : public Mbc
+{
+  public:
+    using Mbc::Mbc;
+
+    void writeRegister(uint8_t val, uint16_t addr) override;
+    void mapBanks() override;
+
+    // RTC registers, selected with RAM banks 0x08-0x0C
+    uint8_t readRam(uint16_t addr) override;
+    void writeRam(uint8_t val, uint16_t addr) override;
+};
+
+class Mbc5 : public Mbc
+{
+  public:
+    using Mbc::Mbc;
+
+    void writeRegister(uint8_t val, uint16_t addr) override;
+    void mapBanks() override;
+};
+
+#endif // __MBC_H__
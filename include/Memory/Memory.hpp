@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <cstring>
 #include <cstdio>
+#include "InterruptController.hpp"
 #include "ROM.hpp"
 #include "Enums.hpp"
 
@@ -25,6 +26,7 @@ class GameBoy;
 class PPU;
 class Timer;
 class Audio;
+class StateSerializer;
 
 class Memory
 {
@@ -50,11 +52,15 @@ class Memory
     uint8_t cgbBgColorPalette[0x40];
     uint8_t cgbObjColorPalette[0x40];
 
+    InterruptController interrupts;
+
     Memory(EmulatorMode mode = EmulatorMode::DMG); 
     
     uint8_t readmem(uint16_t addr, bool bypass = false, bool bypassOamDma = false);
     void writemem(uint8_t val, uint16_t addr, bool bypass = false, bool bypassOamDma = false);
     void writebit(uint8_t val, uint8_t bit, uint16_t addr, bool bypass = false, bool bypassOamDma = false);
+    // The FF10-FF26 part of writemem, with the effects of the writes on the channels
+    void writeAudioRegister(uint8_t val, uint16_t addr, bool bypass);
 
     uint8_t getCurrentVramBank();
     uint8_t getCurrentWramBank();
@@ -63,6 +69,14 @@ class Memory
     void setCurrentWramBank(uint8_t val);
 
     uint8_t getLcdMode();
+
+    // Recomputes the pending interrupts mask; must be called if IE or IF are changed directly
+    void updateInterrupts();
+    // Sets / clears bits in IF without going through the memory bus
+    void requestInterrupt(uint8_t interrupt);
+    void acknowledgeInterrupt(uint8_t interrupt);
+
+    void serialize(StateSerializer &state);
 };
  
 #endif // __MEMORY_H__
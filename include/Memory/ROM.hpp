@@ -9,24 +9,34 @@
 #include <experimental/filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #define ROM_RTC_T_CYCLES_UNTIL_TICK 128
 #define ROM_RTC_TICKS_UNTIL_INCREMENT 32678
 
 namespace fs = std::experimental::filesystem;
 
+class Mbc;
+class RomImage;
+class StateSerializer;
+
 enum MBC { None, MBC1, MBC2, MMM01, MBC3, MBC5, MBC6, MBC7, HuC1, HuC3 };
 
 class ROM
 {
   public:
-    uint8_t *rom;
+    const uint8_t *rom; // romImage->data
     uint8_t *ram;
+    std::shared_ptr<RomImage> romImage;
     uint32_t romFileSize;
     fs::path romFilePath;
     fs::path saveFilePath;
-    FILE *saveFile = NULL;
+    bool useSaveFile; // if false, the battery RAM is neither loaded nor saved
+    bool batterySave; // set by loadSaveFile when the RAM is battery backed and saved to saveFilePath
+    // Set whenever the game changes the RAM or the RTC registers; cleared by whoever saves them
+    bool ramDirty;
     uint8_t bootrom[256];
     bool bootromActive;
 
@@ -34,7 +44,6 @@ class ROM
 
     bool nintendoLogoOk;
     bool headerChecksumOk;
-    bool globalchecksumOk;
 
     /* HEADER FLAGS */
 
@@ -64,6 +73,9 @@ class ROM
     uint8_t currentRAMBank; // In MBC1 it can be used to select ROM banks
     uint8_t bankMode;
 
+    // Incremented whenever the banks mapped at 0x0000-0x7FFF may have changed
+    uint32_t mappingGeneration;
+
     // NOTE: To switch banks, there will be mem writes to a ROM area
     // The writes are intercepted, no ROM will be written and the MBC controls
     // the switching
@@ -81,12 +93,21 @@ class ROM
     uint64_t rtcLatchedSeconds;
     uint16_t rtcNumCycles;
 
+    // When set, fixedTime is used instead of the wall clock, so runs are reproducible
+    bool useFixedTime;
+    time_t fixedTime;
+
     ROM();
     ~ROM();
 
     bool loadROM(std::string romPath);
     bool loadSaveFile(fs::path savePath);
+    // Writes the save file synchronously
     bool saveRam();
+    // Contents of the save file: the RTC registers and the current time (MBC3 with timer), then the RAM
+    void getSaveData(std::vector<uint8_t> &data);
+    // Writes data to a temporary file that then replaces path, so a crash never leaves a partial save
+    static bool writeSaveFile(fs::path path, const std::vector<uint8_t> &data);
     bool loadBootrom(std::string bootromPath);
     void disableBootrom();
 
@@ -95,6 +116,10 @@ class ROM
     bool checkNintendoLogo();
     bool checkHeaderChecksum();
     bool checkGlobalChecksum();
+    // checkGlobalChecksum reads every bank, so it only runs the first time any instance using
+    // the image asks for it
+    bool isGlobalChecksumOk();
+    static uint64_t sumBytes(const uint8_t *data, size_t size);
 
     /* HEADER FLAG GETTERS */
 
@@ -112,29 +137,75 @@ class ROM
 
     /* CARTRIDGE READ AND WRITE */
 
-    uint8_t readmem(uint16_t addr);
-    void writemem(uint8_t val, uint16_t addr);
+    uint8_t readmem(uint16_t addr)
+    {
+        // ROM banks
+        if (addr < 0x8000) {
+            if (bootromActive && addr < 0x100)
+                return bootrom[addr];
 
-    uint8_t readmemNoMBC(uint16_t addr);
-    void writememNoMBC(uint8_t val, uint16_t addr);
+            return romWindow[addr >> 14][addr & 0x3FFF];
+        }
 
-    uint8_t readmemMBC1(uint16_t addr);
-    void writememMBC1(uint8_t val, uint16_t addr);
+        // RAM
+        if (addr >= 0xA000 && addr < 0xC000) {
+            // There is no RAM or RAM is not enabled
+            if (!cartridgeRam || !ramEnable)
+                return 0xFF;
 
-    uint8_t readmemMBC2(uint16_t addr);
-    void writememMBC2(uint8_t val, uint16_t addr);
+            if (ramWindow != nullptr)
+                return ramWindow[(addr - 0xA000) & ramWindowMask];
 
-    uint8_t readmemMBC3(uint16_t addr);
-    void writememMBC3(uint8_t val, uint16_t addr);
+            return readUnmappedRam(addr);
+        }
 
-    uint8_t readmemMBC5(uint16_t addr);
-    void writememMBC5(uint8_t val, uint16_t addr);
+        return readInvalid(addr);
+    }
+
+    void writemem(uint8_t val, uint16_t addr);
+    // Out of line, so the inline read doesn't need the MBC classes
+    uint8_t readUnmappedRam(uint16_t addr);
+    uint8_t readInvalid(uint16_t addr);
+
+    void writeRam(uint32_t index, uint8_t val)
+    {
+        if (ram[index] != val) {
+            ram[index] = val;
+            ramDirty = true;
+        }
+    }
+
+    /* BANK WINDOWS */
+
+    // The MBC of the cartridge; it runs on writes to its registers and maps the selected banks
+    std::unique_ptr<Mbc> mbcController;
+
+    // Banks mapped at 0x0000-0x3FFF and 0x4000-0x7FFF; -1 and open bus when nothing is mapped
+    const uint8_t *romWindow[2];
+    int32_t romWindowBank[2];
+    // RAM bank mapped at 0xA000-0xBFFF; nullptr when the accesses go to the MBC instead
+    uint8_t *ramWindow;
+    uint16_t ramWindowMask;
+
+    // Recomputes the windows from the bank registers; called by writes to the MBC registers and
+    // needed after changing the registers directly
+    void mapBanks();
+    // The banks wrap around the size of the ROM file / RAM
+    void mapRomBank(uint8_t window, uint32_t bank);
+    void unmapRomBank(uint8_t window);
+    void mapRamBank(uint32_t bank);
+    void unmapRamBank();
+
+    int32_t getMappedBank(uint16_t addr);
 
     /* MBC3 RTC FUNCTIONS */
 
     // Should be called once every ROM_RTC_T_CYCLES_UNTIL_TICK t cycles
     void cycleRtc();
     void incrementRtc(uint64_t numSeconds);
+    time_t getCurrentTime();
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __ROM_H__
@@ -0,0 +1,76 @@
+#ifndef __ROM_IMAGE_CACHE_H__
+#define __ROM_IMAGE_CACHE_H__
+
+#pragma once
+#include <cstdint>
+#include <experimental/filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace fs = std::experimental::filesystem;
+
+// Cartridge header, hashed to tell ROMs apart without reading the whole file
+#define ROM_IMAGE_HEADER_START 0x100
+#define ROM_IMAGE_HEADER_END 0x150
+
+/**
+ *  Identifies the contents of a ROM file: where it is, the file it was mapped from and a hash of
+ *  its cartridge header, which also holds the global checksum of the ROM.
+ */
+struct RomImageKey
+{
+    std::string path;
+    uint64_t device, inode, size;
+    int64_t modifiedTime;
+    uint64_t headerHash;
+
+    bool operator<(const RomImageKey &other) const
+    {
+        return std::tie(path, device, inode, size, modifiedTime, headerHash) <
+               std::tie(other.path, other.device, other.inode, other.size, other.modifiedTime,
+                        other.headerHash);
+    }
+};
+
+/**
+ *  A ROM file mapped read-only in memory. The pages are only read from the file when they are
+ *  touched.
+ */
+class RomImage
+{
+  public:
+    const uint8_t *data;
+    uint32_t size;
+    RomImageKey key;
+
+    // Set by ROM::isGlobalChecksumOk the first time it is called for the image
+    std::once_flag globalChecksumChecked;
+    bool globalChecksumOk = false;
+
+    RomImage();
+    ~RomImage();
+};
+
+/**
+ *  Shares the mapped ROM files between the ROM instances of the process. Images are kept alive by
+ *  the instances using them and unmapped when the last one lets go; loading a file that changed
+ *  since it was mapped gives a new image, while the old one stays valid for its users.
+ */
+class RomImageCache
+{
+  public:
+    // Returns the image of the ROM at path, mapping it if it is not mapped yet
+    static std::shared_ptr<RomImage> get(fs::path path);
+
+    // Number of images in use
+    static size_t getNumImages();
+
+  private:
+    static inline std::mutex mutex;
+    static inline std::map<RomImageKey, std::weak_ptr<RomImage>> images;
+};
+
+#endif // __ROM_IMAGE_CACHE_H__
@@ -0,0 +1,91 @@
+#ifndef __ROM_LIBRARY_H__
+#define __ROM_LIBRARY_H__
+
+#pragma once
+#include "ROM.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <experimental/filesystem>
+#include <string>
+#include <vector>
+
+#define ROM_LIBRARY_MAGIC 0x58494C47 // "GLIX"
+#define ROM_LIBRARY_VERSION 1
+// Written in the scanned directory
+#define ROM_LIBRARY_INDEX_NAME "gameboy-emu-library.index"
+
+namespace fs = std::experimental::filesystem;
+
+class StateSerializer;
+
+enum GlobalChecksumState : uint8_t { CHECKSUM_UNKNOWN, CHECKSUM_OK, CHECKSUM_BAD };
+
+/**
+ *  Header of a ROM in the library, with the file size and modification time it was read at
+ */
+struct RomLibraryEntry
+{
+    std::string path;
+    uint64_t fileSize;
+    int64_t modifiedTime;
+
+    std::string gameTitle;
+    uint8_t gbcFlag;
+    uint8_t sgbFlag;
+    uint8_t cartridgeType;
+    MBC mbc;
+    uint32_t romSize;
+    uint32_t ramSize;
+    bool cartridgeBattery;
+    bool cartridgeTimer;
+    uint8_t romVersion;
+    uint16_t headerChecksum;
+    uint16_t globalChecksum;
+
+    bool nintendoLogoOk;
+    bool headerChecksumOk;
+    // The global checksum needs the whole ROM, so it is only checked by verifyGlobalChecksum
+    GlobalChecksumState globalChecksumState;
+
+    void serialize(StateSerializer &state);
+};
+
+/**
+ *  Lists the ROMs in a directory tree for a launcher.
+ *
+ *  scan() walks the directories with a pool of threads and only reads the 0x100-0x14F header of
+ *  each ROM, through the same functions ROM::loadROM uses. The entries are kept in an index file;
+ *  a ROM whose size and modification time match its indexed entry is not read again, so scanning
+ *  a library that didn't change only costs the directory walk.
+ */
+class RomLibrary
+{
+  public:
+    // Sorted by path
+    std::vector<RomLibraryEntry> entries;
+
+    // Headers read by the last scan; the other entries came from the index
+    std::atomic<uint32_t> headersRead;
+
+    RomLibrary();
+
+    // Loads the entries of a previous scan; returns false if there is no valid index
+    bool loadIndex(fs::path indexPath);
+    bool saveIndex(fs::path indexPath);
+
+    // Replaces the entries with the ROMs (.gb, .gbc) found in directory and its subdirectories.
+    // numThreads 0 uses one thread per core
+    void scan(fs::path directory, uint32_t numThreads = 0);
+
+    // Sums the whole ROM and compares it with the global checksum of the header
+    bool verifyGlobalChecksum(RomLibraryEntry &entry);
+
+    void print(FILE *out);
+
+    static bool isRomFile(const fs::path &path);
+    // Reads the header of the ROM at path; returns false if it is not a ROM
+    static bool readEntry(const fs::path &path, RomLibraryEntry &entry);
+};
+
+#endif // __ROM_LIBRARY_H__
@@ -3,11 +3,13 @@
 
 #pragma once
 #include "BgMapAttributes.hpp"
+#include "Enums.hpp"
 #include "FifoPixel.hpp"
 #include "Tile.hpp"
 #include <queue>
 
 class PPU;
+class StateSerializer;
 
 enum PixelFetcherStage { GET_TILE, GET_TILE_DATA_LOW, GET_TILE_DATA_HIGH, SLEEP, PUSH };
 
@@ -41,9 +43,10 @@ class BgFifo
     // Returns the pushed pixel, otherwise nullptr. The returned pixel is allocated dynamically and
     // thus should be deleted after being used
     FifoPixel *cycle();
+    template <EmulatorMode mode> FifoPixel *cycle();
 
     // Cycles the fetcher
-    void cycleFetcher();
+    template <EmulatorMode mode> void cycleFetcher();
 
     // Empties the pixelQueue
     void clearQueue();
@@ -56,6 +59,8 @@ class BgFifo
 
     // Prepares the Fifo and fetcher for a new line
     void prepareForLine(uint8_t line = 0);
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __BG_FIFO_H__
@@ -8,6 +8,7 @@
 #include "Enums.hpp"
 #include "OAMSprite.hpp"
 #include "SpriteFifo.hpp"
+#include "SpriteRow.hpp"
 #include "Tile.hpp"
 #include <cstdio>
 
@@ -27,6 +28,8 @@ class Memory;
 class SM83;
 class GameBoy;
 class Config;
+class StateSerializer;
+class RenderThread;
 
 enum LcdMode { H_BLANK = 0, V_BLANK = 1, OAM_SEARCH = 2, DRAW = 3 };
 
@@ -36,6 +39,9 @@ class PPU
     Memory *memory;
     SM83 *cpu;
     Config *config;
+    // Set while the lines of the scanline PPU are drawn by a RenderThread; the PPU then only logs
+    // when each line is searched and drawn
+    RenderThread *renderThread = nullptr;
 
     uint64_t renderedFrames = 0;
 
@@ -53,6 +59,8 @@ class PPU
 
     int8_t spritesOnCurrentLine[PPU_MAX_SPRITES_ON_LINE];
     uint8_t numSpritesOnCurrentLine;
+    // The rows of the sprites in spritesOnCurrentLine, in the same order
+    SpriteRow spriteRows[PPU_MAX_SPRITES_ON_LINE];
 
     uint8_t windowYCounter;
     uint8_t windowXCounter;
@@ -71,6 +79,11 @@ class PPU
     uint32_t vramDmaTransferredBytes;
     uint32_t vramDmaCurrentCycles;
 
+    // Start of the current mode and transfers on the timeline; not part of the state
+    uint64_t modeStartTime;
+    uint64_t oamDmaStartTime;
+    uint64_t vramDmaStartTime;
+
     uint32_t tCycles;
     uint32_t currentModeTCycles;
     uint16_t currentOamDmaTCycles;
@@ -273,17 +286,34 @@ class PPU
     Tile getSpriteTile(int index, int tileNo = 0, int vramBank = 0);
 
     // Searches the sprites that will be displayed on the current line and puts their index in
-    // spritesOnCurrentLine. Also sets numSpritesOnCurrentLine
+    // spritesOnCurrentLine. Also sets numSpritesOnCurrentLine and fetches their spriteRows
     void searchSpritesOnLine();
+    template <EmulatorMode mode> void searchSpritesOnLine();
+
+    // Fetches the row of the sprite that is on the current line into spriteRow
+    template <EmulatorMode mode> void fetchSpriteRow(uint8_t spriteIndex, SpriteRow &spriteRow);
 
     // Returns a Color object based on the FifoPixel
     Color getColorFromFifoPixel(FifoPixel *fifoPixel, bool normalizeCgbColor = true);
+    template <EmulatorMode mode>
+    Color getColorFromFifoPixel(FifoPixel *fifoPixel, bool normalizeCgbColor = true);
 
+    // The versions without a template argument pick the hardware model from emulatorMode. The
+    // frame loop calls the specialized ones directly, so each model gets its own compiled PPU
+    // without the checks for the other one. With scanline set, each line is drawn at once at the
+    // start of mode 3 instead of going through the FIFOs, and mode 3 always has its default length
     void cycle();
+    template <EmulatorMode mode, bool scanline = false> void cycle();
+
+    // Draws the current line into display from the VRAM and OAM contents at the time of the call
+    template <EmulatorMode mode> void renderScanline();
     void oamDmaCycle();
     void vramDmaCycle();
 
     Color *mixPixels(FifoPixel *bgPixel, FifoPixel *spritePixel);
+    template <EmulatorMode mode> Color *mixPixels(FifoPixel *bgPixel, FifoPixel *spritePixel);
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __PPU_H__
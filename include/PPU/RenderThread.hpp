@@ -0,0 +1,118 @@
+#ifndef __RENDER_THREAD_H__
+#define __RENDER_THREAD_H__
+
+#pragma once
+#include "Memory.hpp"
+#include "PPU.hpp"
+#include "ReplayLog.hpp"
+#include <atomic>
+#include <cstdint>
+
+// Entries of the log; must be a power of 2. Big enough for a whole VRAM copy in one frame
+#define RENDER_LOG_SIZE (1 << 16)
+
+enum RenderLogType {
+    // Writes; address is the index in the array of the shadow Memory
+    RENDER_LOG_VRAM,
+    RENDER_LOG_OAM,
+    RENDER_LOG_IO,
+    RENDER_LOG_BG_PALETTE,
+    RENDER_LOG_OBJ_PALETTE,
+    // End of the OAM search of line address; value is windowYTrigger
+    RENDER_LOG_SEARCH,
+    // Start and end of mode 3 of line address
+    RENDER_LOG_DRAW,
+    RENDER_LOG_DRAW_END,
+    // LY was increased during VBlank
+    RENDER_LOG_VBLANK_LINE,
+    // LY went back to 0 at the end of VBlank
+    RENDER_LOG_FRAME_START,
+    // Start of VBlank; the frame is complete
+    RENDER_LOG_FRAME_END
+};
+
+// Registers FF40-FF4B the lines are drawn from: LCDC, SCY, SCX, BGP, OBP0, OBP1, WY and WX
+#define RENDER_LOG_REGISTER_MASK 0x0F8D
+
+struct RenderLogEntry
+{
+    uint16_t address;
+    uint8_t value;
+    uint8_t type;
+};
+
+/**
+ *  Draws the lines of the scanline PPU on its own thread.
+ *
+ *  While it runs, the PPU of the emulator only keeps the timing (modes, LY, STAT and the
+ *  interrupts). Memory logs every write to VRAM, OAM, the CGB palettes and the registers the
+ *  lines are drawn from, and the PPU logs the end of every OAM search and the start and end of
+ *  every mode 3. The render thread applies the writes to a shadow Memory in the same order and
+ *  draws the line into the display of a shadow PPU when it gets to its mode 3, so it sees exactly
+ *  the state the line would have been drawn from, only one or more lines later.
+ *
+ *  Nothing the CPU can read comes from the shadow PPU: the window line counter and the sprites
+ *  found on the line are only copied back to the PPU of the emulator when a state is saved.
+ */
+class RenderThread
+{
+  public:
+    // The emulator PPU the writes come from; nullptr while the thread isn't running
+    PPU *source = nullptr;
+
+    Memory memory;
+    PPU ppu;
+
+    // The last completed frame, written by the render thread at RENDER_LOG_FRAME_END
+    Color frame[PPU_SCREEN_HEIGHT][PPU_SCREEN_WIDTH];
+    // Frames logged / completed by the render thread
+    uint64_t queuedFrames = 0;
+    std::atomic<uint64_t> completedFrames{0};
+
+    RenderThread();
+    ~RenderThread();
+
+    // Copies the state of source into the shadow PPU, hooks the thread into it and starts it
+    void start(PPU *source);
+    // Waits for the log to be replayed, copies the state back into source and unhooks the thread
+    void stop();
+
+    void log(RenderLogType type, uint16_t address, uint8_t value = 0)
+    {
+        replayLog.push({address, value, (uint8_t)type});
+
+        // The thread only needs to be woken up when there is a line to draw
+        if (type >= RENDER_LOG_DRAW)
+            replayLog.wake();
+    }
+
+    static bool isLoggedRegister(uint16_t addr)
+    {
+        return addr >= 0xFF40 && addr <= 0xFF4B &&
+               ((RENDER_LOG_REGISTER_MASK >> (addr - 0xFF40)) & 1);
+    }
+
+    // Logs the end of the frame; collectFrame waits for it
+    void endFrame();
+    // Waits for the frames logged so far and copies the last one to dest (PPU_SCREEN_HEIGHT *
+    // PPU_SCREEN_WIDTH colors). Returns false if no frame ended since the last call
+    bool collectFrame(Color *dest);
+
+    // Waits until the whole log has been replayed
+    void drain() { replayLog.drain(); }
+    // With the log drained: copy the state of source into the shadow PPU (after a state was
+    // loaded) or the state only the shadow PPU keeps into source (before a state is saved)
+    void syncFromSource();
+    void syncToSource();
+
+  private:
+    uint64_t collectedFrames = 0;
+
+    void replay(const RenderLogEntry &entry);
+    template <EmulatorMode mode> void replay(const RenderLogEntry &entry);
+
+    ReplayLog<RenderLogEntry, RENDER_LOG_SIZE, RenderThread, &RenderThread::replay> replayLog{
+        this, "Render", "Wait for render thread", "Video"};
+};
+
+#endif // __RENDER_THREAD_H__
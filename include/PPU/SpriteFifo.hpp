@@ -4,12 +4,14 @@
 #pragma once
 #include "FifoPixel.hpp"
 #include "BgFifo.hpp"
+#include "Enums.hpp"
 #include "OAMSprite.hpp"
 #include <queue>
 #include <set>
 #include <vector>
 
 class PPU;
+class StateSerializer;
 
 class SpriteFifo
 {
@@ -43,11 +45,15 @@ class SpriteFifo
     SpriteFifo(PPU *ppu);
 
     void checkForSprite();
+    template <EmulatorMode mode> void checkForSprite();
     FifoPixel *cycle();
+    template <EmulatorMode mode> FifoPixel *cycle();
     // do i need the reference? or just the number of elements in the bgfifo queue?
     // but why do i need it???
 
     void prepareForLine();
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __SPRITE_FIFO_H__
@@ -0,0 +1,20 @@
+#ifndef __SPRITE_ROW_H__
+#define __SPRITE_ROW_H__
+
+#pragma once
+#include "FifoPixel.hpp"
+#include "OAMSprite.hpp"
+
+/**
+ *  The row of a sprite that is drawn on the current line, fetched during OAM search.
+ *
+ *  The pixels are already flipped and carry the palette and priorities of the sprite, so
+ *  mode 3 only has to mix them with the pixels of the other sprites and the background.
+ */
+struct SpriteRow
+{
+    OAMSprite sprite;
+    FifoPixel pixels[8];
+};
+
+#endif // __SPRITE_ROW_H__
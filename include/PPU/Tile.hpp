@@ -8,20 +8,26 @@
 class Tile
 {
   public:
+    // One color index (0-3) per pixel, 8 rows of 8 pixels
     uint8_t tileData[64];
 
     Tile();
+    // Decodes the 16 bytes of a tile in VRAM: each row is a low and a high bitplane byte
     Tile(uint8_t *tileAddr);
 
     // Returns the tile row colors in the provided dest array; The array must contain 8 uint8_t
     // elements
     void getTileRow(uint8_t row, uint8_t *dest);
-    
+
     // Flips the tile horizontally
     void flipHor();
 
     // Flips the tile vertically
     void flipVert();
+
+    // Decodes one row from its bitplane bytes into 8 color indices, leftmost pixel first. With
+    // flip, the row is decoded mirrored, which is cheaper than flipping the whole tile
+    static void decodeRow(uint8_t low, uint8_t high, uint8_t *dest, bool flip = false);
 };
 
 #endif // __TILE_H__
@@ -0,0 +1,160 @@
+#ifndef __REPLAY_LOG_H__
+#define __REPLAY_LOG_H__
+
+#pragma once
+#include "Timeline.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Times the replay thread looks at an empty log again before it goes to sleep
+#define REPLAY_LOG_SPIN_COUNT 64
+
+/**
+ *  Log written by one thread and replayed in order on a thread of its own, which calls replay on
+ *  owner for every entry. size must be a power of 2.
+ *
+ *  The replay thread goes on looking at an empty log for a while before it sleeps, since the next
+ *  entries usually come soon; the logging thread wakes it up when they should be replayed. When
+ *  the log is full, the logging thread waits for the replay thread to catch up.
+ */
+template <class Entry, uint32_t size, class Owner, void (Owner::*replay)(const Entry &)>
+class ReplayLog
+{
+    static_assert((size & (size - 1)) == 0, "The size of a replay log must be a power of 2");
+
+  public:
+    // threadName names the replay thread on the timeline, waitName and waitCategory the waits
+    // for space in the log
+    ReplayLog(Owner *owner, const char *threadName, const char *waitName,
+              const char *waitCategory)
+        : owner(owner), threadName(threadName), waitName(waitName), waitCategory(waitCategory)
+    {
+        entries.resize(size);
+    }
+
+    ~ReplayLog() { stop(); }
+
+    bool isRunning() const { return thread.joinable(); }
+
+    void start()
+    {
+        stop();
+
+        head = 0;
+        tail = 0;
+
+        running = true;
+        thread = std::thread(&ReplayLog::threadLoop, this);
+    }
+
+    // Waits for the log to be replayed and stops the thread
+    void stop()
+    {
+        if (!thread.joinable())
+            return;
+
+        drain();
+
+        running = false;
+        wake();
+        thread.join();
+    }
+
+    void push(const Entry &entry)
+    {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        if (index - tail.load(std::memory_order_acquire) >= size)
+            waitForSpace(index);
+
+        entries[index & (size - 1)] = entry;
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    // Waits until the whole log has been replayed
+    void drain()
+    {
+        while (tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed)) {
+            wake();
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     *  The thread checks sleeping after it has set it, under the mutex, so an entry is either
+     *  seen by that check or followed by the notification
+     */
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeCondition.notify_one();
+        }
+    }
+
+  private:
+    Owner *owner;
+    const char *threadName;
+    const char *waitName;
+    const char *waitCategory;
+
+    std::vector<Entry> entries;
+    // Entries logged so far / replayed so far
+    std::atomic<uint64_t> head{0}, tail{0};
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::atomic<bool> sleeping{false};
+
+    void threadLoop()
+    {
+        if (Timeline::enabled)
+            Timeline::setThreadName(threadName);
+
+        uint32_t idleCount = 0;
+        while (true) {
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t index = tail.load(std::memory_order_relaxed);
+
+            if (index == end) {
+                if (!running.load(std::memory_order_acquire))
+                    break;
+
+                if (++idleCount < REPLAY_LOG_SPIN_COUNT) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(mutex);
+                sleeping = true;
+                wakeCondition.wait(lock, [&] { return head != index || !running; });
+                sleeping = false;
+                idleCount = 0;
+                continue;
+            }
+
+            idleCount = 0;
+            for (; index < end; ++index) {
+                (owner->*replay)(entries[index & (size - 1)]);
+                tail.store(index + 1, std::memory_order_release);
+            }
+        }
+    }
+
+    void waitForSpace(uint64_t index)
+    {
+        TIMELINE_SCOPE(waitName, waitCategory);
+        while (index - tail.load(std::memory_order_acquire) >= size) {
+            wake();
+            std::this_thread::yield();
+        }
+    }
+};
+
+#endif // __REPLAY_LOG_H__
@@ -0,0 +1,71 @@
+#ifndef __HASH_STREAM_H__
+#define __HASH_STREAM_H__
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define HASH_STREAM_MAGIC "GBHASH01"
+
+enum HashRecordType : uint32_t { HASH_FRAME, HASH_AUDIO };
+
+// Written to the stream files as is
+struct HashRecord
+{
+    // Frame the record was produced in; audio blocks don't line up with frames
+    uint32_t frame;
+    uint32_t type;
+    uint64_t hash;
+};
+
+static_assert(sizeof(HashRecord) == 16, "HashRecord is written to files as is");
+
+/**
+ *  xxHash64 of every frame and audio block of a run, for regression checks that don't need
+ *  screenshots. Hash stream files are HASH_STREAM_MAGIC followed by HashRecords in the order they
+ *  were produced.
+ *
+ *  The records are written to the output file as they are produced and, if a golden stream was
+ *  loaded, compared to it one by one; the first record that differs marks the stream as diverged.
+ */
+class HashStream
+{
+  public:
+    // Frame the next records belong to
+    uint32_t frame;
+    // Records produced so far
+    uint64_t count;
+
+    std::vector<HashRecord> golden;
+    bool comparing;
+    bool diverged;
+    // The first record that differs; expected.frame is UINT32_MAX if the golden stream ended
+    // before it
+    HashRecord expected, actual;
+
+    HashStream();
+    ~HashStream();
+
+    // Starts writing the records to path; returns false on error
+    bool open(std::string path);
+    bool close();
+    // Reads the golden stream and compares every following record to it
+    bool loadGolden(std::string path);
+
+    void addFrame(const void *pixels, size_t size);
+    // Hashes count floats of interleaved stereo samples
+    void addAudio(const float *samples, uint32_t count);
+
+    // Prints where the stream diverged, or that it matches the golden one
+    void printResult();
+
+  private:
+    FILE *file;
+    std::string path;
+
+    void add(HashRecordType type, uint64_t hash);
+};
+
+#endif // __HASH_STREAM_H__
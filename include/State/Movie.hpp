@@ -0,0 +1,70 @@
+#ifndef __MOVIE_H__
+#define __MOVIE_H__
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define MOVIE_MAGIC 0x564D4247 // "GBMV"
+#define MOVIE_VERSION 1
+
+class StateSerializer;
+
+/**
+ *  Input movie: the joypad state of every frame, plus everything else needed to replay a run
+ *  exactly: the emulator mode, the ROM checksum, the fixed time used for the MBC3 RTC, the audio
+ *  batch size and the starting point of the run.
+ *
+ *  A movie starts either from power-on (startState is empty) or from a saved emulator state. The
+ *  joypad is only sampled once per frame while a movie is active, so the same inputs always reach
+ *  the game on the same cycle.
+ */
+class Movie
+{
+  public:
+    enum Mode { NONE, RECORD, PLAYBACK };
+
+    Movie();
+
+    Mode mode;
+    std::string path;
+
+    /* HEADER */
+
+    uint8_t emulatorMode;
+    uint16_t romChecksum;
+    int64_t rtcSeed;
+    uint8_t audioBatchCycles;
+    bool useBootrom;
+    std::vector<uint8_t> startState;
+
+    // One byte per frame: bits 0-3 are the direction keys, bits 4-7 the action keys
+    std::vector<uint8_t> frames;
+    uint32_t currentFrame;
+
+    bool isActive();
+    bool isRecording();
+    bool isPlaying();
+
+    void startRecording(std::string path);
+    bool stopRecording();
+
+    // Reads the movie at path and starts the playback
+    bool load(std::string path);
+
+    void recordFrame(uint8_t keys);
+
+    // Returns false when there are no frames left
+    bool nextFrame(uint8_t &keys);
+
+    static uint8_t packKeys(bool keyState[2][4]);
+    static void unpackKeys(uint8_t keys, bool keyState[2][4]);
+
+    void serialize(StateSerializer &state);
+
+  private:
+    void serializeBuffer(StateSerializer &state, std::vector<uint8_t> &buffer);
+};
+
+#endif // __MOVIE_H__
@@ -0,0 +1,72 @@
+#ifndef __REWIND_H__
+#define __REWIND_H__
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#define REWIND_DEFAULT_BUFFER_SIZE_MB 32
+#define REWIND_DEFAULT_FRAME_INTERVAL 2
+
+/**
+ *  Ring of emulator snapshots used for stepping backwards in time.
+ *
+ *  Every pushed snapshot is XOR-ed with the previous one and the result is run-length encoded,
+ *  so only the bytes that changed between the two snapshots take up space. All entries live in a
+ *  single preallocated arena; when the arena is full the oldest entries are dropped.
+ *
+ *  The most recent snapshot is kept uncompressed. Going back one entry decodes its delta and XORs
+ *  it into that snapshot, which yields the one before it. Because of this the deltas are only
+ *  ever applied from newest to oldest and no keyframes are needed.
+ *
+ *  All snapshots must have the same size. Pushing a snapshot with a different size clears the
+ *  ring.
+ */
+class Rewind
+{
+  public:
+    Rewind();
+
+    // Allocates the arena; bufferSize is in bytes
+    void init(size_t bufferSize);
+    void clear();
+
+    bool isEnabled();
+
+    // Adds a new snapshot in front of the ring
+    void push(const std::vector<uint8_t> &state);
+
+    // Writes the most recent snapshot in state and removes it from the ring, unless it is the
+    // only one left. Returns false if the ring is empty
+    bool rewind(std::vector<uint8_t> &state);
+
+    size_t getNumEntries();
+    size_t getUsedBytes();
+    size_t getBufferSize();
+
+  private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+    };
+
+    std::vector<uint8_t> arena;
+    std::deque<Entry> entries;
+    size_t head; // offset where the next entry will be written
+
+    std::vector<uint8_t> lastState; // uncompressed copy of the newest snapshot
+    std::vector<uint8_t> encoded;   // scratch buffer for encoding
+
+    // XORs state with lastState and run-length encodes the result in encoded
+    void encodeDelta(const std::vector<uint8_t> &state);
+
+    // XORs the encoded delta into lastState
+    void applyDelta(const uint8_t *delta, size_t size);
+
+    // Reserves size bytes in the arena, dropping the oldest entries if needed
+    size_t allocate(size_t size);
+};
+
+#endif // __REWIND_H__
@@ -0,0 +1,92 @@
+#ifndef __STATE_SERIALIZER_H__
+#define __STATE_SERIALIZER_H__
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <set>
+#include <vector>
+
+/**
+ *  Reads or writes the emulator state to a flat byte buffer.
+ *
+ *  Every component has a serialize(StateSerializer &) function that passes all of its fields to
+ *  value() / bytes(). The same function is used for saving and loading, so the field order is
+ *  always the same. When saving, the buffer grows as needed; when loading, the data is consumed
+ *  from the start of the buffer.
+ */
+class StateSerializer
+{
+  public:
+    enum Mode { SAVE, LOAD };
+
+    StateSerializer(std::vector<uint8_t> &buffer, Mode mode);
+
+    bool isLoading();
+
+    // Number of bytes that have been read / written so far
+    size_t getPosition();
+
+    // Returns false if a load tried to read past the end of the buffer or the data was rejected
+    bool isValid();
+    void setInvalid();
+
+    // Number of bytes left to read when loading
+    size_t getRemaining();
+
+    void bytes(void *data, size_t size);
+
+    template <typename T> void value(T &val) { bytes(&val, sizeof(T)); }
+
+    template <typename T> void queue(std::queue<T> &q)
+    {
+        uint32_t size = q.size();
+        value(size);
+
+        if (isLoading()) {
+            while (!q.empty())
+                q.pop();
+
+            for (uint32_t i = 0; i < size && valid; ++i) {
+                T element;
+                value(element);
+                q.push(element);
+            }
+        } else {
+            // std::queue has no iterators, so rotate through it once
+            for (uint32_t i = 0; i < size; ++i) {
+                T element = q.front();
+                q.pop();
+                value(element);
+                q.push(element);
+            }
+        }
+    }
+
+    template <typename T> void set(std::set<T> &s)
+    {
+        uint32_t size = s.size();
+        value(size);
+
+        if (isLoading()) {
+            s.clear();
+            for (uint32_t i = 0; i < size && valid; ++i) {
+                T element;
+                value(element);
+                s.insert(element);
+            }
+        } else {
+            for (T element : s)
+                value(element);
+        }
+    }
+
+  private:
+    std::vector<uint8_t> &buffer;
+    Mode mode;
+    size_t position;
+    bool valid;
+};
+
+#endif // __STATE_SERIALIZER_H__
@@ -0,0 +1,15 @@
+#ifndef __XXHASH_H__
+#define __XXHASH_H__
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ *  64-bit xxHash (XXH64) of size bytes. It reads 32 bytes per round in 4 independent lanes, so a
+ *  whole frame is hashed in a few microseconds, and gives the same values as the reference
+ *  implementation.
+ */
+uint64_t xxHash64(const void *data, size_t size, uint64_t seed = 0);
+
+#endif // __XXHASH_H__
@@ -0,0 +1,40 @@
+#ifndef __FRAME_METRICS_H__
+#define __FRAME_METRICS_H__
+
+#pragma once
+#include "Histogram.hpp"
+#include <string>
+
+// All the metrics are recorded in microseconds
+enum FrameMetric {
+    METRIC_EMULATION_TIME, // running the frame, run ahead included
+    METRIC_PRESENT_TIME,   // drawing the frame and waiting for vsync
+    METRIC_AUDIO_QUEUED,   // audio queued to SDL after the frame, in playback time
+    METRIC_INPUT_LATENCY,  // from a change of the joypad keys to the end of the next present
+    METRIC_COUNT
+};
+
+/**
+ *  Histograms of the per-frame metrics, for the current interval and for the whole run
+ */
+class FrameMetrics
+{
+  public:
+    Histogram interval[METRIC_COUNT];
+    Histogram total[METRIC_COUNT];
+
+    void record(FrameMetric metric, uint64_t value) { interval[metric].record(value); }
+
+    // Every value recorded so far, in the past intervals and in the current one
+    Histogram get(FrameMetric metric) const;
+
+    // Adds the interval to the totals and starts a new one
+    void endInterval();
+
+    // Prints p50 / p95 / p99 / max of the current interval, or of the whole run
+    void printSummary(std::string title, bool wholeRun) const;
+
+    static const char *getName(FrameMetric metric);
+};
+
+#endif // __FRAME_METRICS_H__
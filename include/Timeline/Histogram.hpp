@@ -0,0 +1,47 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#pragma once
+#include <cstdint>
+
+// Every power of 2 range above HISTOGRAM_LINEAR_VALUES is split into this many buckets, which keeps
+// the relative error of a recorded value below 1 / HISTOGRAM_SUB_BUCKETS (~3%)
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+// Values below this one have a bucket each
+#define HISTOGRAM_LINEAR_VALUES (HISTOGRAM_SUB_BUCKETS * 2)
+#define HISTOGRAM_NUM_BUCKETS                                                                    \
+    (HISTOGRAM_LINEAR_VALUES + (64 - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ *  Log-linear histogram of unsigned values, in the style of HdrHistogram: the buckets get wider as
+ *  the values grow, so the whole uint64_t range is covered with a fixed precision and recording a
+ *  value is a couple of shifts and an increment.
+ */
+class Histogram
+{
+  public:
+    uint64_t buckets[HISTOGRAM_NUM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min, max;
+
+    Histogram();
+
+    void record(uint64_t value);
+    // Adds the values recorded in other
+    void add(const Histogram &other);
+    void reset();
+
+    // Smallest value that is bigger than or equal to percentile% of the recorded ones; the highest
+    // value of its bucket is returned, capped to max
+    uint64_t getPercentile(double percentile) const;
+    double getMean() const;
+
+    static uint32_t getBucket(uint64_t value);
+    // Lowest and highest value counted in a bucket
+    static uint64_t getBucketStart(uint32_t bucket);
+    static uint64_t getBucketEnd(uint32_t bucket);
+};
+
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,123 @@
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Events kept per thread; older ones are overwritten
+#define TIMELINE_THREAD_EVENTS (1 << 18)
+
+// Records the time from here to the end of the enclosing scope as an event
+#define TIMELINE_CONCAT_(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_(a, b)
+#define TIMELINE_SCOPE(name, category)                                                           \
+    TimelineScope TIMELINE_CONCAT(timelineScope, __LINE__)(name, category)
+
+struct TimelineEvent
+{
+    // String literals; only the pointers are stored
+    const char *name;
+    const char *category;
+    // Nanoseconds since the timeline was enabled
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Events of one thread. Only the owning thread writes to it
+struct TimelineThread
+{
+    uint32_t id;
+    std::string name;
+    std::unique_ptr<TimelineEvent[]> events;
+    std::atomic<uint64_t> count;
+};
+
+/**
+ *  Records timed events of the emulator threads and exports them in the Chrome trace format, which
+ *  can be opened in chrome://tracing or Perfetto.
+ *
+ *  Every thread writes to its own ring of events, so recording doesn't lock or share cache lines
+ *  with other threads; the mutex is only taken the first time a thread records an event. When the
+ *  timeline is disabled, an event costs a relaxed load of enabled.
+ */
+class Timeline
+{
+  public:
+    static inline std::atomic<bool> enabled{false};
+    // Also record the PPU modes of every line. They are 4 events a line, which fill the ring of
+    // the emulator thread in seconds instead of minutes
+    static inline bool ppuModes = false;
+
+    static void enable();
+    // Stops recording; the events recorded so far can still be written
+    static void disable();
+
+    // Nanoseconds since the timeline was enabled
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - startTime)
+            .count();
+    }
+
+    static void record(const char *name, const char *category, uint64_t start, uint64_t end)
+    {
+        TimelineThread *thread = getThread();
+        uint64_t index = thread->count.load(std::memory_order_relaxed);
+        thread->events[index & (TIMELINE_THREAD_EVENTS - 1)] = {name, category, start,
+                                                                 end - start};
+        thread->count.store(index + 1, std::memory_order_release);
+    }
+
+    // Name shown for the calling thread
+    static void setThreadName(std::string name);
+
+    // Writes the events of every thread as Chrome trace JSON; returns false on error
+    static bool write(std::string path);
+
+  private:
+    static inline std::chrono::steady_clock::time_point startTime;
+    static inline std::mutex threadsMutex;
+    static inline std::vector<std::unique_ptr<TimelineThread>> threads;
+
+    static TimelineThread *getThread()
+    {
+        thread_local TimelineThread *thread = addThread();
+        return thread;
+    }
+
+    static TimelineThread *addThread();
+};
+
+class TimelineScope
+{
+  public:
+    TimelineScope(const char *name, const char *category)
+    {
+        this->name = name;
+        this->category = category;
+        active = Timeline::enabled.load(std::memory_order_relaxed);
+        if (active)
+            start = Timeline::now();
+    }
+
+    ~TimelineScope()
+    {
+        if (active)
+            Timeline::record(name, category, start, Timeline::now());
+    }
+
+  private:
+    const char *name;
+    const char *category;
+    bool active;
+    uint64_t start;
+};
+
+#endif // __TIMELINE_H__
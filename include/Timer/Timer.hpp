@@ -8,6 +8,7 @@
 
 class SM83;
 class Memory;
+class StateSerializer;
 
 class Timer
 {
@@ -32,6 +33,8 @@ class Timer
     uint16_t clockSelectBitMask[4];
 
     void cycle();
+    // Same as calling cycle() tCycles times, but skips ahead to the next TIMA increment
+    void advance(uint32_t tCycles);
 
     // DIV - 0xFF04
     uint8_t getDividerRegister();
@@ -53,6 +56,8 @@ class Timer
     void setTimerControl(uint8_t val);
     void setTimerEnable(uint8_t val);
     void setInputClockSelect(uint8_t val);
+
+    void serialize(StateSerializer &state);
 };
 
 #endif // __TIMER_H__
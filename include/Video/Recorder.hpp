@@ -0,0 +1,157 @@
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#pragma once
+#include "Enums.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Frames and audio chunks that can wait for the writer thread; more are dropped, and the writer
+// fills their place in the file
+#define RECORDER_FRAME_SLOTS 16
+#define RECORDER_AUDIO_SLOTS 32
+// Floats (interleaved stereo) per audio slot
+#define RECORDER_AUDIO_SLOT_SAMPLES 4096
+// Data is written to the files in blocks of this size, aligned for O_DIRECT
+#define RECORDER_WRITE_BUFFER_SIZE (1 << 20)
+#define RECORDER_IO_ALIGNMENT 4096
+#define RECORDER_WAV_HEADER_SIZE 44
+
+// Preallocated slots of a fixed number of values, handed from one producer to one consumer
+template <class T> struct RecorderRing
+{
+    std::vector<T> data;
+    std::vector<uint32_t> counts;
+    uint32_t slotSize = 0;
+    uint32_t numSlots = 0;
+    // Slots filled so far / slots written so far
+    std::atomic<uint64_t> head{0}, tail{0};
+    // Slots the producer found no room for
+    uint64_t dropped = 0;
+    // Values dropped right before each slot, and since the last slot that was filled
+    std::vector<uint64_t> skipped;
+    uint64_t pendingSkipped = 0;
+
+    void init(uint32_t numSlots, uint32_t slotSize)
+    {
+        this->numSlots = numSlots;
+        this->slotSize = slotSize;
+        data.assign((size_t)numSlots * slotSize, T());
+        counts.assign(numSlots, 0);
+        skipped.assign(numSlots, 0);
+        head = 0;
+        tail = 0;
+        dropped = 0;
+        pendingSkipped = 0;
+    }
+
+    // Fills the next slot, unless the consumer is a whole ring behind
+    bool push(const T *values, uint32_t count)
+    {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        if (index - tail.load(std::memory_order_acquire) >= numSlots) {
+            ++dropped;
+            pendingSkipped += count;
+            return false;
+        }
+
+        memcpy(slot(index), values, count * sizeof(T));
+        counts[index % numSlots] = count;
+        skipped[index % numSlots] = pendingSkipped;
+        pendingSkipped = 0;
+        head.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    T *slot(uint64_t index) { return &data[(index % numSlots) * slotSize]; }
+};
+
+// A file written in RECORDER_WRITE_BUFFER_SIZE blocks
+struct RecorderFile
+{
+    std::string path;
+    int fd = -1;
+    bool directIo = false;
+    // Regular files can be seeked to fill in the sizes of the WAV header; pipes can't
+    bool seekable = false;
+    bool failed = false;
+    uint8_t *buffer = nullptr;
+    size_t used = 0;
+    // Bytes appended so far, including the ones still in the buffer
+    uint64_t size = 0;
+};
+
+/**
+ *  Records the frames and the audio to files or named pipes, for bug reports and videos.
+ *
+ *  Video is written as YUV4MPEG2 (4:4:4) or as raw RGBA bytes, audio as 16-bit stereo WAV; both
+ *  can be read by ffmpeg and most players. The emulator thread only copies the frame or the audio
+ *  chunk into a free slot of a preallocated ring: it never allocates, locks or waits for the disk.
+ *  If the writer thread falls a whole ring behind, the new frames are dropped and counted. The
+ *  writer puts the last frame in their place again and silence in place of the dropped audio, so
+ *  the video and the audio keep their timing.
+ *
+ *  The writer thread converts the data and writes it in RECORDER_WRITE_BUFFER_SIZE blocks, with
+ *  O_DIRECT when directIo is set and the file system supports it, so the recording doesn't push
+ *  the rest of the page cache out.
+ */
+class Recorder
+{
+  public:
+    bool enabled = false;
+    RecordFormat format = RECORD_Y4M;
+    uint32_t width = 0, height = 0;
+
+    RecorderFile videoFile, audioFile;
+    RecorderRing<uint32_t> frames;
+    RecorderRing<float> audio;
+
+    Recorder();
+    ~Recorder();
+
+    // Opens the files and starts the writer thread; an empty path doesn't record that stream.
+    // The frame rate is frameRateNum / frameRateDen frames per second
+    bool start(std::string videoPath, std::string audioPath, RecordFormat format, uint32_t width,
+               uint32_t height, uint32_t frameRateNum, uint32_t frameRateDen, uint32_t sampleRate,
+               bool directIo);
+    // Writes everything that is still queued and closes the files
+    void stop();
+
+    // Queues a frame of width x height RGBA8888 words
+    void pushFrame(const uint32_t *pixels);
+    // Queues count floats of interleaved stereo samples
+    void pushAudio(const float *samples, uint32_t count);
+
+    static const char *getFormatName(RecordFormat format);
+    // Returns false if name isn't a format
+    static bool getFormatByName(const std::string &name, RecordFormat &format);
+
+  private:
+    uint32_t sampleRate = 0;
+    std::thread writerThread;
+    std::atomic<bool> writerRunning{false};
+    // The last frame written, converted; repeated in place of the dropped ones
+    std::vector<uint8_t> lastFrame;
+    // Converted audio chunk, before it is appended to the file
+    std::vector<uint8_t> scratch;
+
+    void writerLoop();
+    void writeFrame(const uint32_t *pixels);
+    void writeAudio(const float *samples, uint32_t count);
+    void repeatLastFrame(uint64_t count);
+    // count is in floats, like the samples
+    void writeSilence(uint64_t count);
+
+    static bool openFile(RecorderFile &file, const std::string &path, bool directIo);
+    static void append(RecorderFile &file, const void *data, size_t size);
+    static void flush(RecorderFile &file, size_t size);
+    static void closeFile(RecorderFile &file, const uint8_t *header = nullptr,
+                          size_t headerSize = 0);
+    static void writeWavHeader(uint8_t *header, uint32_t sampleRate, uint64_t dataSize);
+};
+
+#endif // __RECORDER_H__
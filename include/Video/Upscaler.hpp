@@ -0,0 +1,115 @@
+#ifndef __UPSCALER_H__
+#define __UPSCALER_H__
+
+#pragma once
+#include "Color.hpp"
+#include "Enums.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Border of replicated pixels around the padded copy of the source; xBR reads 2 pixels away
+#define UPSCALER_BORDER 2
+#define UPSCALER_MAX_AUTO_THREADS 4
+
+/**
+ *  Scales the frame with a pixel art filter on the CPU, before it is uploaded to the texture.
+ *
+ *  The pixels are 32-bit RGBA8888 words. Scale2x, Scale3x and xBR-lite output a fixed multiple of
+ *  the source size; sharp bilinear scales to any size, blending only the output pixels that fall
+ *  on the border between two source pixels. Every filter processes 4 pixels (2 in the
+ *  horizontal pass of sharp bilinear) at a time with SSE2 and has a scalar version for other
+ *  targets.
+ *
+ *  The output is split into bands of rows, which are taken by a pool of worker threads. start()
+ *  hands them a frame and returns at once, so the caller can go on while it is scaled; wait()
+ *  returns when the whole frame is done. No workers are started for SCALE_NONE, whose frames are
+ *  copied on the calling thread.
+ */
+class Upscaler
+{
+  public:
+    ScaleFilter filter = SCALE_NONE;
+    uint32_t srcWidth = 0, srcHeight = 0;
+    uint32_t outWidth = 0, outHeight = 0;
+    // Worker threads scaling a frame
+    uint32_t numThreads = 1;
+
+    Upscaler();
+    ~Upscaler();
+
+    // Sets the filter and starts the worker threads. outWidth / outHeight are only used by the
+    // sharp bilinear filter, the others scale by getFilterFactor. numThreads 0 uses one thread
+    // per core, up to UPSCALER_MAX_AUTO_THREADS
+    void init(ScaleFilter filter, uint32_t srcWidth, uint32_t srcHeight, uint32_t outWidth = 0,
+              uint32_t outHeight = 0, uint32_t numThreads = 0);
+    void stop();
+
+    // Starts scaling src (srcWidth x srcHeight pixels) into dest (outWidth x outHeight); destPitch
+    // is given in pixels. src is copied before it returns, dest is written until wait() returns
+    void start(const uint32_t *src, uint32_t *dest, uint32_t destPitch);
+    // Waits for the frame given to start() to be done
+    void wait();
+    void scale(const uint32_t *src, uint32_t *dest, uint32_t destPitch)
+    {
+        start(src, dest, destPitch);
+        wait();
+    }
+
+    // Output size of a filter as a multiple of the source, 0 for sharp bilinear
+    static uint32_t getFilterFactor(ScaleFilter filter);
+    static const char *getFilterName(ScaleFilter filter);
+    // Returns false if name isn't a filter
+    static bool getFilterByName(const std::string &name, ScaleFilter &filter);
+
+    // Converts the PPU colors to RGBA8888 words
+    static void packColors(const Color *src, uint32_t *dest, uint32_t count);
+
+  private:
+    // Source with UPSCALER_BORDER replicated pixels on every side
+    std::vector<uint32_t> padded;
+    uint32_t paddedWidth = 0;
+
+    // Source coordinates and weights (0-128) of every output column and row for sharp bilinear
+    std::vector<uint32_t> columnIndex[2], rowIndex[2];
+    std::vector<uint16_t> columnWeight, rowWeight;
+
+    // Rows are source rows, except for sharp bilinear where they are output rows
+    uint32_t numRows = 0;
+    uint32_t bandRows = 1;
+    uint32_t numBands = 0;
+
+    uint32_t *dest = nullptr;
+    uint32_t destPitch = 0;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startCondition, doneCondition;
+    uint64_t generation = 0;
+    uint32_t busyWorkers = 0;
+    std::atomic<uint32_t> nextBand;
+    bool stopping = false;
+
+    void workerLoop(uint64_t seenGeneration);
+    void runBands();
+    void filterRows(uint32_t firstRow, uint32_t lastRow);
+
+    const uint32_t *pixel(int32_t x, int32_t y) const
+    {
+        return &padded[(y + UPSCALER_BORDER) * paddedWidth + x + UPSCALER_BORDER];
+    }
+
+    void copyRows(uint32_t firstRow, uint32_t lastRow);
+    void scale2x(uint32_t firstRow, uint32_t lastRow);
+    void scale3x(uint32_t firstRow, uint32_t lastRow);
+    void xbr(uint32_t firstRow, uint32_t lastRow);
+    void sharpBilinear(uint32_t firstRow, uint32_t lastRow);
+    // Scales one source row horizontally for sharp bilinear
+    void scaleRow(const uint32_t *src, uint32_t *out);
+};
+
+#endif // __UPSCALER_H__
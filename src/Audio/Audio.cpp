@@ -1,6 +1,11 @@
 #include "Audio.hpp"
+#include "AudioThread.hpp"
 #include "Config.hpp"
+#include "HashStream.hpp"
 #include "Memory.hpp"
+#include "Recorder.hpp"
+#include "StateSerializer.hpp"
+#include "Timeline.hpp"
 
 Audio::Audio()
 {
@@ -70,6 +75,13 @@ void Audio::initSDL()
     SDL_PauseAudio(0);
 }
 
+uint32_t Audio::getQueuedMicroseconds()
+{
+    // Stereo float samples
+    uint64_t queuedSamples = SDL_GetQueuedAudioSize(1) / (2 * sizeof(float));
+    return queuedSamples * 1000000 / AUDIO_FREQUENCY;
+}
+
 /* CHANNEL 1 */
 /* NR10 - 0xFF10 */
 
@@ -679,6 +691,19 @@ void Audio::setChannel2SoundOn(uint8_t val) { memory->writebit(val, 1, 0xFF26, t
 void Audio::setChannel1SoundOn(uint8_t val) { memory->writebit(val, 0, 0xFF26, true); }
 
 void Audio::cycle(uint8_t numCycles)
+{
+    if (audioThread != nullptr) {
+        cycleChannels<false>(numCycles);
+        audioThread->logCycles(numCycles, mixSamples);
+        return;
+    }
+
+    cycleChannels<true>(numCycles);
+    if (mixSamples)
+        mix(numCycles);
+}
+
+template <bool synthesize> void Audio::cycleChannels(uint8_t numCycles)
 {
     if (getAllSoundOn() != 0) {
         if (!initialInit) {
@@ -692,10 +717,12 @@ void Audio::cycle(uint8_t numCycles)
 
         currentWaitCycles += numCycles;
 
-        channel1.cycleDuty(numCycles);
-        channel2.cycleDuty(numCycles);
-        channel3.cycle(numCycles);
-        channel4.cycleLfsr(numCycles);
+        if constexpr (synthesize) {
+            channel1.cycleDuty(numCycles);
+            channel2.cycleDuty(numCycles);
+            channel3.cycle(numCycles);
+            channel4.cycleLfsr(numCycles);
+        }
 
         if (currentWaitCycles >= AUDIO_WAIT_CYCLES) {
             currentWaitCycles -= AUDIO_WAIT_CYCLES;
@@ -735,14 +762,19 @@ void Audio::cycle(uint8_t numCycles)
                 channel4.cycleLength();
                 break;
             case 7:
-                channel1.cycleEnvelope();
-                channel2.cycleEnvelope();
-                channel4.cycleEnvelope();
+                if constexpr (synthesize) {
+                    channel1.cycleEnvelope();
+                    channel2.cycleEnvelope();
+                    channel4.cycleEnvelope();
+                }
                 break;
             }
         }
     }
+}
 
+void Audio::mix(uint8_t numCycles)
+{
     currentCyclesUntilSampleCollection += numCycles;
     if (currentCyclesUntilSampleCollection >= AUDIO_CYCLES_UNTIL_SAMPLE_COLLECTION) {
         currentCyclesUntilSampleCollection -= AUDIO_CYCLES_UNTIL_SAMPLE_COLLECTION;
@@ -814,6 +846,28 @@ void Audio::cycle(uint8_t numCycles)
         currentAudioSamples -= AUDIO_NUM_SAMPLES;
 
         // Queue audio
-        SDL_QueueAudio(1, audioBuffer, AUDIO_NUM_SAMPLES * sizeof(float));
+        TIMELINE_SCOPE("Queue audio", "Audio");
+        if (queueToSdl)
+            SDL_QueueAudio(1, audioBuffer, AUDIO_NUM_SAMPLES * sizeof(float));
+
+        if (recorder != nullptr && recorder->enabled)
+            recorder->pushAudio(audioBuffer, AUDIO_NUM_SAMPLES);
+
+        if (hashStream != nullptr)
+            hashStream->addAudio(audioBuffer, AUDIO_NUM_SAMPLES);
     }
 }
+
+void Audio::serialize(StateSerializer &state)
+{
+    channel1.serialize(state);
+    channel2.serialize(state);
+    channel3.serialize(state);
+    channel4.serialize(state);
+
+    state.value(currentCycles);
+    state.value(currentCyclesUntilSampleCollection);
+    state.value(currentWaitCycles);
+    state.value(frameSequencer);
+    state.value(initialInit);
+}
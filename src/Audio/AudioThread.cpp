@@ -0,0 +1,95 @@
+#include "AudioThread.hpp"
+#include <cstring>
+
+AudioThread::AudioThread()
+{
+    memory.audio = &audio;
+    memory.ppu = &ppu;
+    audio.memory = &memory;
+    ppu.memory = &memory;
+}
+
+AudioThread::~AudioThread() { stop(); }
+
+void AudioThread::start(Audio *source)
+{
+    stop();
+
+    this->source = source;
+    memory.mode = source->memory->mode;
+
+    audio.recorder = source->recorder;
+    audio.hashStream = source->hashStream;
+    audio.queueToSdl = source->queueToSdl;
+    audio.sdlAudioFormat = source->sdlAudioFormat;
+
+    // The buffer goes on from the samples the emulator Audio collected so far
+    memcpy(audio.audioBuffer, source->audioBuffer, sizeof(audio.audioBuffer));
+    audio.currentAudioSamples = source->currentAudioSamples;
+    syncFromSource();
+
+    pendingBatches = 0;
+    replayLog.start();
+
+    source->audioThread = this;
+}
+
+void AudioThread::stop()
+{
+    if (!replayLog.isRunning())
+        return;
+
+    drain();
+    syncToSource();
+    memcpy(source->audioBuffer, audio.audioBuffer, sizeof(audio.audioBuffer));
+    source->currentAudioSamples = audio.currentAudioSamples;
+    replayLog.stop();
+
+    source->audioThread = nullptr;
+    source = nullptr;
+}
+
+void AudioThread::syncFromSource()
+{
+    memcpy(memory.ioRegisters, source->memory->ioRegisters, sizeof(memory.ioRegisters));
+    copyState(audio, *source);
+}
+
+void AudioThread::syncToSource() { copyState(*source, audio); }
+
+void AudioThread::copyState(Audio &dest, const Audio &source)
+{
+    dest.channel1 = source.channel1;
+    dest.channel2 = source.channel2;
+    dest.channel3 = source.channel3;
+    dest.channel4 = source.channel4;
+    dest.channel1.audio = &dest;
+    dest.channel2.audio = &dest;
+    dest.channel3.audio = &dest;
+    dest.channel4.audio = &dest;
+
+    dest.currentCycles = source.currentCycles;
+    dest.currentCyclesUntilSampleCollection = source.currentCyclesUntilSampleCollection;
+    dest.currentWaitCycles = source.currentWaitCycles;
+    dest.frameSequencer = source.frameSequencer;
+    dest.initialInit = source.initialInit;
+}
+
+void AudioThread::replay(const AudioLogEntry &entry)
+{
+    switch (entry.type) {
+    case AUDIO_LOG_WRITE:
+        if (entry.address <= 0xFF26)
+            memory.writeAudioRegister(entry.value, entry.address, false);
+        else
+            memory.ioRegisters[entry.address - MEM_IO_START] = entry.value;
+        break;
+
+    case AUDIO_LOG_CYCLES:
+    case AUDIO_LOG_CYCLES_NO_MIX:
+        audio.mixSamples = entry.type == AUDIO_LOG_CYCLES;
+        for (uint16_t i = 0; i < entry.address; ++i)
+            audio.cycle(entry.value);
+        break;
+    }
+}
@@ -1,5 +1,6 @@
 #include "Channel1.hpp"
 #include "Audio.hpp"
+#include "StateSerializer.hpp"
 #include <iostream>
 
 Channel1::Channel1()
@@ -131,3 +132,26 @@ void Channel1::updateSoundLengthCycles(uint8_t soundLength)
 {
     remainingSoundLengthCycles = 64 - soundLength;
 }
+
+void Channel1::serialize(StateSerializer &state)
+{
+    state.value(internalVolume);
+    state.value(soundLengthData);
+    state.value(remainingSoundLengthCycles);
+    state.value(currentDutyStep);
+
+    state.value(sweepShiftNumber);
+    state.value(sweepDirection);
+    state.value(sweepTime);
+    state.value(remainingSweepCycles);
+    state.value(sweepOverflow);
+    state.value(currentSweepFrequency);
+
+    state.value(defaultEnvelopeValue);
+    state.value(envelopeDirection);
+    state.value(envelopeStepLength);
+    state.value(remainingEnvelopeCycles);
+
+    state.value(currentCycles);
+    state.value(cyclesUntilNextStep);
+}
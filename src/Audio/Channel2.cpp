@@ -1,5 +1,6 @@
 #include "Channel2.hpp"
 #include "Audio.hpp"
+#include "StateSerializer.hpp"
 #include <iostream>
 
 Channel2::Channel2()
@@ -85,3 +86,19 @@ void Channel2::updateSoundLengthCycles(uint8_t soundLength)
 {
     remainingSoundLengthCycles = 64 - soundLength;
 }
+
+void Channel2::serialize(StateSerializer &state)
+{
+    state.value(internalVolume);
+    state.value(soundLengthData);
+    state.value(remainingSoundLengthCycles);
+    state.value(currentDutyStep);
+
+    state.value(defaultEnvelopeValue);
+    state.value(envelopeDirection);
+    state.value(envelopeStepLength);
+    state.value(remainingEnvelopeCycles);
+
+    state.value(currentCycles);
+    state.value(cyclesUntilNextStep);
+}
@@ -1,5 +1,6 @@
 #include "Channel3.hpp"
 #include "Audio.hpp"
+#include "StateSerializer.hpp"
 #include "Memory.hpp"
 #include <iostream>
 
@@ -86,3 +87,14 @@ void Channel3::updateSoundLengthCycles(uint8_t soundLength)
 {
     remainingSoundLengthCycles = 256 - soundLength;
 }
+
+void Channel3::serialize(StateSerializer &state)
+{
+    state.value(internalVolume);
+    state.value(samplePosition);
+    state.value(soundLengthData);
+    state.value(remainingSoundLengthCycles);
+
+    state.value(currentCycles);
+    state.value(cyclesUntilNextStep);
+}
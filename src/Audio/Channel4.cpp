@@ -1,5 +1,6 @@
 #include "Channel4.hpp"
 #include "Audio.hpp"
+#include "StateSerializer.hpp"
 #include <iostream>
 
 Channel4::Channel4()
@@ -104,3 +105,19 @@ uint64_t Channel4::calcStepCycles(uint8_t shiftClockFrequency, uint8_t dividingR
 {
     return divisor[dividingRatio & 7] << shiftClockFrequency;
 }
+
+void Channel4::serialize(StateSerializer &state)
+{
+    state.value(internalVolume);
+    state.value(lfsr);
+    state.value(soundLengthData);
+    state.value(remainingSoundLengthCycles);
+
+    state.value(defaultEnvelopeValue);
+    state.value(envelopeDirection);
+    state.value(envelopeStepLength);
+    state.value(remainingEnvelopeCycles);
+
+    state.value(currentCycles);
+    state.value(cyclesUntilNextStep);
+}
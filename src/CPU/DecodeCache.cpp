@@ -0,0 +1,116 @@
+#include "DecodeCache.hpp"
+#include "ROM.hpp"
+
+// Length in bytes of every non-CB opcode; CB prefixed instructions are 2 bytes long
+static const uint8_t instructionLengths[256] = {
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 0x00
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x10
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x20
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x30
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x50
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x70
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x90
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xA0
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xB0
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // 0xC0
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, // 0xD0
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // 0xE0
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // 0xF0
+};
+
+DecodeCache::DecodeCache()
+{
+    regionTables[0] = regionTables[1] = nullptr;
+    regionData[0] = regionData[1] = nullptr;
+    regionBanks[0] = regionBanks[1] = -1;
+    mappedRomData = nullptr;
+    mappedGeneration = 0;
+}
+
+/**
+ *  Drops every decoded instruction
+ */
+void DecodeCache::clear()
+{
+    banks.clear();
+    regionTables[0] = regionTables[1] = nullptr;
+    regionData[0] = regionData[1] = nullptr;
+    regionBanks[0] = regionBanks[1] = -1;
+    mappedRomData = nullptr;
+}
+
+DecodedInstruction *DecodeCache::lookup(ROM *rom, uint16_t addr)
+{
+    if (rom->rom != mappedRomData || rom->mappingGeneration != mappedGeneration)
+        mapRegions(rom);
+
+    uint8_t region = addr >> 14;
+    DecodedInstruction *table = regionTables[region];
+    if (table == nullptr)
+        return nullptr;
+
+    uint16_t offset = addr & (DECODE_CACHE_BANK_SIZE - 1);
+    DecodedInstruction *instruction = &table[offset];
+
+    if (instruction->length == 0) {
+        const uint8_t *data = regionData[region] + offset;
+        uint8_t length = getInstructionLength(data[0]);
+
+        // Instructions that continue in the other region are read through the memory bus
+        if (offset + length > DECODE_CACHE_BANK_SIZE)
+            return nullptr;
+
+        instruction->opcode = data[0];
+        instruction->operands[0] = length > 1 ? data[1] : 0;
+        instruction->operands[1] = length > 2 ? data[2] : 0;
+        instruction->length = length;
+    }
+
+    return instruction;
+}
+
+uint8_t DecodeCache::getInstructionLength(uint8_t opcode) { return instructionLengths[opcode]; }
+
+/**
+ *  Points each region to the table of the ROM bank currently mapped there
+ */
+void DecodeCache::mapRegions(ROM *rom)
+{
+    // A different ROM was loaded, the old entries are stale
+    if (rom->rom != mappedRomData) {
+        clear();
+        mappedRomData = rom->rom;
+    }
+
+    mappedGeneration = rom->mappingGeneration;
+
+    for (uint8_t region = 0; region < 2; ++region) {
+        regionTables[region] = nullptr;
+        regionData[region] = nullptr;
+        regionBanks[region] = -1;
+
+        if (rom->rom == nullptr)
+            continue;
+
+        // The bootrom is overlaid on the first region
+        if (region == 0 && rom->bootromActive)
+            continue;
+
+        int32_t bank = rom->getMappedBank(region * DECODE_CACHE_BANK_SIZE);
+        if (bank < 0 || (uint64_t)(bank + 1) * DECODE_CACHE_BANK_SIZE > rom->romFileSize)
+            continue;
+
+        if ((uint32_t)bank >= banks.size())
+            banks.resize(bank + 1);
+
+        if (banks[bank] == nullptr)
+            banks[bank].reset(new DecodedInstruction[DECODE_CACHE_BANK_SIZE]());
+
+        regionTables[region] = banks[bank].get();
+        regionData[region] = rom->rom + bank * DECODE_CACHE_BANK_SIZE;
+        regionBanks[region] = bank;
+    }
+}
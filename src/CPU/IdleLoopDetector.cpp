@@ -0,0 +1,468 @@
+#include "IdleLoopDetector.hpp"
+#include "Memory.hpp"
+#include "ROM.hpp"
+#include "SM83.hpp"
+#include "StateSerializer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// Register bits used by the analysis
+#define IDLE_REG_A 0x01
+#define IDLE_REG_B 0x02
+#define IDLE_REG_C 0x04
+#define IDLE_REG_D 0x08
+#define IDLE_REG_E 0x10
+#define IDLE_REG_H 0x20
+#define IDLE_REG_L 0x40
+#define IDLE_REG_F 0x80
+
+// Indexed like the r8 field of the opcodes; (HL) is handled separately
+static const uint8_t r8Bits[8] = {IDLE_REG_B, IDLE_REG_C, IDLE_REG_D, IDLE_REG_E,
+                                  IDLE_REG_H, IDLE_REG_L, 0,          IDLE_REG_A};
+
+IdleLoopDetector::IdleLoopDetector()
+{
+    enabled = false;
+
+    active = false;
+    currentKey = 0;
+    period = 0;
+    cyclesUntilCheck = 0;
+    numReads = 0;
+    currentSkippedCycles = 0;
+
+    candidateKey = 0;
+    candidateCycle = 0;
+
+    totalCycles = 0;
+    skippedCycles = 0;
+
+    for (uint8_t i = 0; i < IDLE_LOOP_MAX_READS; ++i) {
+        readAddresses[i] = 0;
+        readValues[i] = 0;
+        candidateValues[i] = 0;
+    }
+}
+
+bool IdleLoopDetector::cycle(SM83 &cpu)
+{
+    ++totalCycles;
+
+    if (!active)
+        return false;
+
+    // Let the interpreter service the interrupt
+    if (cpu.ime && cpu.memory->interrupts.anyPending()) {
+        stop();
+        return false;
+    }
+
+    // At the start of every iteration, check if the loop would read something different
+    if (cyclesUntilCheck == 0) {
+        uint8_t values[IDLE_LOOP_MAX_READS];
+        for (uint8_t i = 0; i < numReads; ++i)
+            values[i] = cpu.memory->readmem(readAddresses[i]);
+
+        if (memcmp(values, readValues, numReads) != 0) {
+            stop();
+            return false;
+        }
+
+        cyclesUntilCheck = period;
+    }
+
+    --cyclesUntilCheck;
+    ++skippedCycles;
+    ++currentSkippedCycles;
+    return true;
+}
+
+void IdleLoopDetector::onBackwardBranch(SM83 &cpu, uint16_t branchPc)
+{
+    ROM *rom = cpu.memory->rom;
+    uint16_t start = cpu.PC;
+
+    // Only ROM code is analyzed, RAM can be rewritten
+    if (branchPc >= 0x8000 || (start >> 14) != (branchPc >> 14))
+        return;
+
+    if (cpu.decodeCache.lookup(rom, start) == nullptr)
+        return;
+
+    int32_t bank = cpu.decodeCache.regionBanks[start >> 14];
+    uint64_t key = ((uint64_t)bank << 32) | ((uint32_t)start << 16) | branchPc;
+
+    auto it = loops.find(key);
+    if (it == loops.end())
+        it = loops.emplace(key, analyze(cpu, start, branchPc)).first;
+
+    IdleLoop &loop = it->second;
+    if (!loop.idle) {
+        candidateKey = 0;
+        return;
+    }
+
+    // Registers used as addresses are not written by the loop, so they can be read now
+    uint16_t addresses[IDLE_LOOP_MAX_READS];
+    uint8_t values[IDLE_LOOP_MAX_READS];
+    for (uint8_t i = 0; i < loop.numReads; ++i) {
+        switch (loop.readKinds[i]) {
+        case IDLE_READ_HL:
+            addresses[i] = (cpu.H << 8) | cpu.L;
+            break;
+        case IDLE_READ_BC:
+            addresses[i] = (cpu.B << 8) | cpu.C;
+            break;
+        case IDLE_READ_DE:
+            addresses[i] = (cpu.D << 8) | cpu.E;
+            break;
+        case IDLE_READ_FF00_C:
+            addresses[i] = 0xFF00 | cpu.C;
+            break;
+        default:
+            addresses[i] = loop.readAddresses[i];
+            break;
+        }
+
+        values[i] = cpu.memory->readmem(addresses[i]);
+    }
+
+    uint64_t iterationCycles = totalCycles - candidateCycle;
+
+    // Start skipping once a whole iteration ran between the same values
+    if (candidateKey == key && memcmp(values, candidateValues, loop.numReads) == 0 &&
+        iterationCycles > 0 && iterationCycles <= IDLE_LOOP_MAX_PERIOD) {
+        active = true;
+        currentKey = key;
+        period = iterationCycles;
+        cyclesUntilCheck = period;
+        numReads = loop.numReads;
+        memcpy(readAddresses, addresses, sizeof(addresses));
+        memcpy(readValues, values, sizeof(values));
+        currentSkippedCycles = 0;
+        ++loop.timesSkipped;
+
+        candidateKey = 0;
+        return;
+    }
+
+    candidateKey = key;
+    candidateCycle = totalCycles;
+    memcpy(candidateValues, values, sizeof(values));
+}
+
+/**
+ *  Stops skipping the current loop; the CPU continues at the start of the loop
+ */
+void IdleLoopDetector::stop()
+{
+    if (!active)
+        return;
+
+    auto it = loops.find(currentKey);
+    if (it != loops.end())
+        it->second.skippedCycles += currentSkippedCycles;
+
+    active = false;
+    currentSkippedCycles = 0;
+}
+
+/**
+ *  Checks if the loop from start to the branch at end is idle
+ */
+IdleLoop IdleLoopDetector::analyze(SM83 &cpu, uint16_t start, uint16_t end)
+{
+    IdleLoop loop = {};
+    loop.idle = false;
+    loop.start = start;
+    loop.end = end;
+
+    ROM *rom = cpu.memory->rom;
+
+    // Registers written so far in the iteration, read before being written, and written anywhere
+    uint8_t written = 0;
+    uint8_t liveIn = 0;
+    uint8_t allWritten = 0;
+
+    uint16_t pc = start;
+    while (pc <= end) {
+        DecodedInstruction *instruction = cpu.decodeCache.lookup(rom, pc);
+        if (instruction == nullptr)
+            return loop;
+
+        uint8_t opcode = instruction->opcode;
+        uint8_t n8 = instruction->operands[0];
+        uint16_t n16 = instruction->operands[0] | (instruction->operands[1] << 8);
+        uint8_t dst = (opcode >> 3) & 0x07;
+        uint8_t src = opcode & 0x07;
+
+        uint8_t reads = 0;
+        uint8_t writes = 0;
+        bool readsMemory = false;
+        IdleLoopRead readKind = IDLE_READ_FIXED;
+        uint16_t readAddress = 0;
+        bool isBranch = false;
+
+        if (opcode == 0x00) {
+            // NOP
+        } else if (opcode >= 0x40 && opcode < 0x80) {
+            // LD r8, r8 / LD r8, (HL); LD (HL), r8 and HALT are not allowed
+            if (dst == 6)
+                return loop;
+
+            writes = r8Bits[dst];
+            if (src == 6) {
+                reads = IDLE_REG_H | IDLE_REG_L;
+                readsMemory = true;
+                readKind = IDLE_READ_HL;
+            } else {
+                reads = r8Bits[src];
+            }
+        } else if (opcode >= 0x80 && opcode < 0xC0) {
+            // ADD, ADC, SUB, SBC, AND, XOR, OR, CP with a register or (HL)
+            reads = IDLE_REG_A;
+            if (src == 6) {
+                reads |= IDLE_REG_H | IDLE_REG_L;
+                readsMemory = true;
+                readKind = IDLE_READ_HL;
+            } else {
+                reads |= r8Bits[src];
+            }
+
+            if (dst == 1 || dst == 3)
+                reads |= IDLE_REG_F;
+
+            writes = IDLE_REG_F | (dst == 7 ? 0 : IDLE_REG_A);
+        } else {
+            switch (opcode) {
+            // LD r8, n8
+            case 0x06:
+            case 0x0E:
+            case 0x16:
+            case 0x1E:
+            case 0x26:
+            case 0x2E:
+            case 0x3E:
+                writes = r8Bits[dst];
+                break;
+            // INC r8 / DEC r8; the carry flag is kept
+            case 0x04:
+            case 0x0C:
+            case 0x14:
+            case 0x1C:
+            case 0x24:
+            case 0x2C:
+            case 0x3C:
+            case 0x05:
+            case 0x0D:
+            case 0x15:
+            case 0x1D:
+            case 0x25:
+            case 0x2D:
+            case 0x3D:
+                reads = r8Bits[dst] | IDLE_REG_F;
+                writes = r8Bits[dst] | IDLE_REG_F;
+                break;
+            // LD A, (BC) / LD A, (DE)
+            case 0x0A:
+            case 0x1A:
+                reads = opcode == 0x0A ? (IDLE_REG_B | IDLE_REG_C) : (IDLE_REG_D | IDLE_REG_E);
+                writes = IDLE_REG_A;
+                readsMemory = true;
+                readKind = opcode == 0x0A ? IDLE_READ_BC : IDLE_READ_DE;
+                break;
+            // LDH A, (n8)
+            case 0xF0:
+                writes = IDLE_REG_A;
+                readsMemory = true;
+                readAddress = 0xFF00 | n8;
+                break;
+            // LDH A, (C)
+            case 0xF2:
+                reads = IDLE_REG_C;
+                writes = IDLE_REG_A;
+                readsMemory = true;
+                readKind = IDLE_READ_FF00_C;
+                break;
+            // LD A, (n16)
+            case 0xFA:
+                writes = IDLE_REG_A;
+                readsMemory = true;
+                readAddress = n16;
+                break;
+            // RLCA, RRCA
+            case 0x07:
+            case 0x0F:
+                reads = IDLE_REG_A;
+                writes = IDLE_REG_A | IDLE_REG_F;
+                break;
+            // RLA, RRA, CPL
+            case 0x17:
+            case 0x1F:
+            case 0x2F:
+                reads = IDLE_REG_A | IDLE_REG_F;
+                writes = IDLE_REG_A | IDLE_REG_F;
+                break;
+            // SCF, CCF
+            case 0x37:
+            case 0x3F:
+                reads = IDLE_REG_F;
+                writes = IDLE_REG_F;
+                break;
+            // ADD, SUB, AND, XOR, OR, CP with n8
+            case 0xC6:
+            case 0xD6:
+            case 0xE6:
+            case 0xEE:
+            case 0xF6:
+            case 0xFE:
+                reads = IDLE_REG_A;
+                writes = IDLE_REG_F | (opcode == 0xFE ? 0 : IDLE_REG_A);
+                break;
+            // ADC, SBC with n8
+            case 0xCE:
+            case 0xDE:
+                reads = IDLE_REG_A | IDLE_REG_F;
+                writes = IDLE_REG_A | IDLE_REG_F;
+                break;
+            case 0xCB: {
+                uint8_t r = n8 & 0x07;
+                uint8_t rBits = r == 6 ? (IDLE_REG_H | IDLE_REG_L) : r8Bits[r];
+
+                if (n8 >= 0x40 && n8 < 0x80) {
+                    // BIT u3, r8 / BIT u3, (HL); the carry flag is kept
+                    reads = rBits | IDLE_REG_F;
+                    writes = IDLE_REG_F;
+                    if (r == 6) {
+                        readsMemory = true;
+                        readKind = IDLE_READ_HL;
+                    }
+                    break;
+                }
+
+                // Everything else writes back to (HL)
+                if (r == 6)
+                    return loop;
+
+                reads = rBits;
+                writes = rBits;
+                if (n8 < 0x40) {
+                    // Rotates and shifts; RL and RR use the carry flag
+                    writes |= IDLE_REG_F;
+                    if (n8 >= 0x10 && n8 < 0x20)
+                        reads |= IDLE_REG_F;
+                }
+                break;
+            }
+            // JR cc, e8 / JP cc, n16
+            case 0x20:
+            case 0x28:
+            case 0x30:
+            case 0x38:
+            case 0xC2:
+            case 0xCA:
+            case 0xD2:
+            case 0xDA:
+            // JR e8 / JP n16
+            case 0x18:
+            case 0xC3: {
+                bool conditional = opcode != 0x18 && opcode != 0xC3;
+                uint16_t target = opcode < 0x40 ? pc + 2 + (int8_t)n8 : n16;
+
+                if (conditional)
+                    reads = IDLE_REG_F;
+
+                if (pc == end) {
+                    // The branch that closes the loop
+                    if (target != start)
+                        return loop;
+                } else if (!conditional || (target >= start && target <= end)) {
+                    // Only conditional exits are allowed inside the loop
+                    return loop;
+                }
+
+                isBranch = true;
+                break;
+            }
+            default:
+                return loop;
+            }
+        }
+
+        if (pc == end && !isBranch)
+            return loop;
+
+        if (readsMemory) {
+            if (loop.numReads == IDLE_LOOP_MAX_READS)
+                return loop;
+
+            loop.readKinds[loop.numReads] = readKind;
+            loop.readAddresses[loop.numReads] = readAddress;
+            ++loop.numReads;
+        }
+
+        liveIn |= reads & ~written;
+        written |= writes;
+        allWritten |= writes;
+
+        if (pc == end)
+            break;
+
+        pc += instruction->length;
+    }
+
+    // The branch must be reached exactly
+    if (pc != end)
+        return loop;
+
+    // Every iteration starts from the same registers if the ones it depends on are never written
+    loop.idle = (liveIn & allWritten) == 0;
+    return loop;
+}
+
+void IdleLoopDetector::printStats(std::string gameTitle)
+{
+    stop();
+
+    double percentage = totalCycles > 0 ? 100.0 * skippedCycles / totalCycles : 0.0;
+    std::cout << std::dec << "Idle loop skipping (" << gameTitle << "): skipped " << skippedCycles
+              << " of " << totalCycles << " CPU cycles (" << percentage << "%)\n";
+
+    std::vector<const IdleLoop *> skippedLoops;
+    for (auto &it : loops)
+        if (it.second.skippedCycles > 0)
+            skippedLoops.push_back(&it.second);
+
+    std::sort(skippedLoops.begin(), skippedLoops.end(),
+              [](const IdleLoop *a, const IdleLoop *b) {
+                  return a->skippedCycles > b->skippedCycles;
+              });
+
+    for (size_t i = 0; i < skippedLoops.size() && i < 8; ++i) {
+        const IdleLoop *loop = skippedLoops[i];
+        printf("  0x%04X-0x%04X: %llu cycles skipped in %u runs\n", loop->start, loop->end,
+               (unsigned long long)loop->skippedCycles, loop->timesSkipped);
+    }
+}
+
+void IdleLoopDetector::serialize(StateSerializer &state)
+{
+    state.value(active);
+    state.value(currentKey);
+    state.value(period);
+    state.value(cyclesUntilCheck);
+    state.value(numReads);
+    state.bytes(readAddresses, sizeof(readAddresses));
+    state.bytes(readValues, sizeof(readValues));
+    state.value(currentSkippedCycles);
+
+    state.value(candidateKey);
+    state.value(candidateCycle);
+    state.bytes(candidateValues, sizeof(candidateValues));
+
+    state.value(totalCycles);
+    state.value(skippedCycles);
+}
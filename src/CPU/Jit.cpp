@@ -0,0 +1,575 @@
+#include "Jit.hpp"
+#include "DecodeCache.hpp"
+#include "Memory.hpp"
+#include "PPU.hpp"
+#include "ROM.hpp"
+#include "SM83.hpp"
+#include <iostream>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+/* INSTRUCTION CLASSIFICATION */
+
+/**
+ *  HALT, STOP, EI and the illegal opcodes change the way the CPU is stepped, so they are always
+ *  run by the interpreter
+ */
+static bool canCompile(uint8_t opcode)
+{
+    switch (opcode) {
+    case 0x10:
+    case 0x76:
+    case 0xFB:
+    case 0xD3:
+    case 0xDB:
+    case 0xDD:
+    case 0xE3:
+    case 0xE4:
+    case 0xEB:
+    case 0xEC:
+    case 0xED:
+    case 0xF4:
+    case 0xFC:
+    case 0xFD:
+        return false;
+    default:
+        return true;
+    }
+}
+
+static bool isControlFlow(uint8_t opcode)
+{
+    switch (opcode) {
+    // JR
+    case 0x18:
+    case 0x20:
+    case 0x28:
+    case 0x30:
+    case 0x38:
+    // JP
+    case 0xC2:
+    case 0xC3:
+    case 0xCA:
+    case 0xD2:
+    case 0xDA:
+    case 0xE9:
+    // CALL
+    case 0xC4:
+    case 0xCC:
+    case 0xCD:
+    case 0xD4:
+    case 0xDC:
+    // RET, RETI
+    case 0xC0:
+    case 0xC8:
+    case 0xC9:
+    case 0xD0:
+    case 0xD8:
+    case 0xD9:
+    // RST
+    case 0xC7:
+    case 0xCF:
+    case 0xD7:
+    case 0xDF:
+    case 0xE7:
+    case 0xEF:
+    case 0xF7:
+    case 0xFF:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool writesMemory(uint8_t opcode, uint8_t cbOpcode)
+{
+    switch (opcode) {
+    case 0x02:
+    case 0x08:
+    case 0x12:
+    case 0x22:
+    case 0x32:
+    case 0x34:
+    case 0x35:
+    case 0x36:
+    case 0xE0:
+    case 0xE2:
+    case 0xEA:
+    // PUSH
+    case 0xC5:
+    case 0xD5:
+    case 0xE5:
+    case 0xF5:
+    // CALL
+    case 0xC4:
+    case 0xCC:
+    case 0xCD:
+    case 0xD4:
+    case 0xDC:
+    // RST
+    case 0xC7:
+    case 0xCF:
+    case 0xD7:
+    case 0xDF:
+    case 0xE7:
+    case 0xEF:
+    case 0xF7:
+    case 0xFF:
+        return true;
+    case 0xCB:
+        // Everything but BIT u3, (HL) writes back
+        return (cbOpcode & 0x07) == 0x06 && (cbOpcode < 0x40 || cbOpcode >= 0x80);
+    default:
+        // LD (HL), r8
+        return opcode >= 0x70 && opcode < 0x78 && opcode != 0x76;
+    }
+}
+
+static bool accessesMemory(uint8_t opcode, uint8_t cbOpcode)
+{
+    if (writesMemory(opcode, cbOpcode))
+        return true;
+
+    switch (opcode) {
+    case 0x0A:
+    case 0x1A:
+    case 0x2A:
+    case 0x3A:
+    case 0xF0:
+    case 0xF2:
+    case 0xFA:
+    // POP
+    case 0xC1:
+    case 0xD1:
+    case 0xE1:
+    case 0xF1:
+    // RET, RETI
+    case 0xC0:
+    case 0xC8:
+    case 0xC9:
+    case 0xD0:
+    case 0xD8:
+    case 0xD9:
+        return true;
+    case 0xCB:
+        return (cbOpcode & 0x07) == 0x06;
+    default:
+        // LD r8, (HL) and the 8 bit ALU instructions with (HL)
+        return opcode >= 0x40 && opcode < 0xC0 && (opcode & 0x07) == 0x06;
+    }
+}
+
+/**
+ *  Runs a whole instruction on the interpreter and returns the number of M-cycles it took.
+ *  Called from the compiled blocks
+ */
+static uint32_t interpretInstruction(SM83 *cpu, DecodedInstruction *instruction)
+{
+    uint32_t cycles = 0;
+
+    cpu->currentInstruction = instruction;
+    do {
+        cpu->executeOpcode(instruction->opcode);
+        ++cycles;
+    } while (cpu->instructionCycle != 0);
+    cpu->currentInstruction = nullptr;
+
+    return cycles;
+}
+
+#ifdef JIT_SUPPORTED
+
+/**
+ *  Emits the few x86-64 instructions used by the compiled blocks. Registers are used as follows:
+ *      rbx: SM83 *cpu (callee saved)
+ *      r12d: cycles returned by the interpreter calls (callee saved)
+ *      eax: scratch
+ *  SM83 fields are addressed as [rbx + disp32]
+ */
+class X86Emitter
+{
+  public:
+    uint8_t *start;
+    uint8_t *ptr;
+
+    X86Emitter(uint8_t *buffer) : start(buffer), ptr(buffer) {}
+
+    size_t size() { return ptr - start; }
+
+    void emit8(uint8_t val) { *ptr++ = val; }
+
+    void emit16(uint16_t val)
+    {
+        emit8(val & 0xFF);
+        emit8(val >> 8);
+    }
+
+    void emit32(uint32_t val)
+    {
+        emit16(val & 0xFFFF);
+        emit16(val >> 16);
+    }
+
+    void emit64(uint64_t val)
+    {
+        emit32(val & 0xFFFFFFFF);
+        emit32(val >> 32);
+    }
+
+    // [rbx + disp32] with the given reg field
+    void memRbx(uint8_t reg, int32_t disp)
+    {
+        emit8(0x80 | (reg << 3) | 0x03);
+        emit32(disp);
+    }
+
+    void prologue()
+    {
+        emit8(0x53);                                   // push rbx
+        emit8(0x41), emit8(0x54);                      // push r12
+        emit8(0x48), emit8(0x83), emit8(0xEC), emit8(8); // sub rsp, 8
+        emit8(0x48), emit8(0x89), emit8(0xFB);         // mov rbx, rdi
+        emit8(0x45), emit8(0x31), emit8(0xE4);         // xor r12d, r12d
+    }
+
+    void epilogue(uint32_t cycles)
+    {
+        if (cycles > 0) {
+            emit8(0x41), emit8(0x81), emit8(0xC4); // add r12d, imm32
+            emit32(cycles);
+        }
+        emit8(0x44), emit8(0x89), emit8(0xE0);           // mov eax, r12d
+        emit8(0x48), emit8(0x83), emit8(0xC4), emit8(8); // add rsp, 8
+        emit8(0x41), emit8(0x5C);                        // pop r12
+        emit8(0x5B);                                     // pop rbx
+        emit8(0xC3);                                     // ret
+    }
+
+    // r12d += helper(cpu, arg)
+    void callHelper(void *helper, void *arg)
+    {
+        emit8(0x48), emit8(0x89), emit8(0xDF); // mov rdi, rbx
+        emit8(0x48), emit8(0xBE);              // mov rsi, imm64
+        emit64((uint64_t)arg);
+        emit8(0x48), emit8(0xB8); // mov rax, imm64
+        emit64((uint64_t)helper);
+        emit8(0xFF), emit8(0xD0);              // call rax
+        emit8(0x41), emit8(0x01), emit8(0xC4); // add r12d, eax
+    }
+
+    // movzx eax, byte [rbx + disp]
+    void loadByte(int32_t disp)
+    {
+        emit8(0x0F), emit8(0xB6);
+        memRbx(0, disp);
+    }
+
+    // mov byte [rbx + disp], al
+    void storeByte(int32_t disp)
+    {
+        emit8(0x88);
+        memRbx(0, disp);
+    }
+
+    // mov byte [rbx + disp], imm8
+    void storeByteImm(int32_t disp, uint8_t val)
+    {
+        emit8(0xC6);
+        memRbx(0, disp);
+        emit8(val);
+    }
+
+    // movzx eax, word [rbx + disp]
+    void loadWord(int32_t disp)
+    {
+        emit8(0x0F), emit8(0xB7);
+        memRbx(0, disp);
+    }
+
+    // mov word [rbx + disp], ax
+    void storeWord(int32_t disp)
+    {
+        emit8(0x66), emit8(0x89);
+        memRbx(0, disp);
+    }
+
+    // mov word [rbx + disp], imm16
+    void storeWordImm(int32_t disp, uint16_t val)
+    {
+        emit8(0x66), emit8(0xC7);
+        memRbx(0, disp);
+        emit16(val);
+    }
+
+    // rol ax, 8; swaps the two bytes of a register pair
+    void swapBytes() { emit8(0x66), emit8(0xC1), emit8(0xC0), emit8(8); }
+
+    // inc ax / dec ax
+    void incWord() { emit8(0x66), emit8(0xFF), emit8(0xC0); }
+    void decWord() { emit8(0x66), emit8(0xFF), emit8(0xC8); }
+};
+
+#endif
+
+Jit::Jit()
+{
+    codeBuffer = nullptr;
+    codeUsed = 0;
+    mappedRomData = nullptr;
+    hotThreshold = JIT_DEFAULT_HOT_THRESHOLD;
+    blocksCompiled = 0;
+    blocksRun = 0;
+}
+
+Jit::~Jit()
+{
+#ifdef JIT_SUPPORTED
+    if (codeBuffer != nullptr)
+        munmap(codeBuffer, JIT_CODE_BUFFER_SIZE);
+#endif
+}
+
+bool Jit::init()
+{
+#ifdef JIT_SUPPORTED
+    if (codeBuffer != nullptr)
+        return true;
+
+    void *buffer = mmap(nullptr, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (buffer == MAP_FAILED) {
+        std::cerr << "ERROR: Could not allocate executable memory for the JIT\n";
+        return false;
+    }
+
+    codeBuffer = (uint8_t *)buffer;
+    codeUsed = 0;
+    return true;
+#else
+    std::cerr << "ERROR: The JIT is only supported on x86-64 Linux\n";
+    return false;
+#endif
+}
+
+bool Jit::isAvailable() { return codeBuffer != nullptr; }
+
+/**
+ *  Drops every compiled block
+ */
+void Jit::flush()
+{
+    blocks.clear();
+    codeUsed = 0;
+}
+
+uint32_t Jit::run(SM83 &cpu)
+{
+    if (codeBuffer == nullptr)
+        return 0;
+
+    // Only start a block at an instruction boundary, when the interpreter has nothing else to do
+    if (cpu.PC >= 0x8000 || cpu.instructionCycle != 0 || cpu.halted || cpu.halt_bug ||
+        cpu.int_cycles >= 0 || cpu.ei_enable > 0 || cpu.idleLoop.active)
+        return 0;
+
+    if (cpu.memory->ppu->oamDmaActive)
+        return 0;
+
+    if (cpu.ime && cpu.memory->interrupts.anyPending())
+        return 0;
+
+    JitEntry *entry = getEntry(cpu);
+    if (entry == nullptr)
+        return 0;
+
+    if (entry->block == nullptr) {
+        if (entry->hits == JIT_NOT_COMPILABLE || ++entry->hits < hotThreshold)
+            return 0;
+
+        if (JIT_CODE_BUFFER_SIZE - codeUsed < JIT_MAX_BLOCK_SIZE) {
+            flush();
+            entry = getEntry(cpu);
+        }
+
+        JitBlock block = compile(cpu);
+        if (block == nullptr) {
+            entry->hits = JIT_NOT_COMPILABLE;
+            return 0;
+        }
+
+        entry->block = block;
+    }
+
+    ++blocksRun;
+    return entry->block(&cpu);
+}
+
+/**
+ *  Returns the entry of the block at PC, or nullptr if the code at PC can't be compiled
+ */
+JitEntry *Jit::getEntry(SM83 &cpu)
+{
+    ROM *rom = cpu.memory->rom;
+
+    // A different ROM was loaded
+    if (rom->rom != mappedRomData) {
+        flush();
+        mappedRomData = rom->rom;
+    }
+
+    if (cpu.decodeCache.lookup(rom, cpu.PC) == nullptr)
+        return nullptr;
+
+    uint8_t region = cpu.PC >> 14;
+    uint32_t index = (cpu.decodeCache.regionBanks[region] << 1) | region;
+
+    if (index >= blocks.size())
+        blocks.resize(index + 1);
+
+    if (blocks[index] == nullptr)
+        blocks[index].reset(new JitEntry[DECODE_CACHE_BANK_SIZE]());
+
+    return &blocks[index][cpu.PC & (DECODE_CACHE_BANK_SIZE - 1)];
+}
+
+/**
+ *  Translates the block starting at PC. Returns nullptr if not even the first instruction can be
+ *  compiled
+ */
+JitBlock Jit::compile(SM83 &cpu)
+{
+#ifdef JIT_SUPPORTED
+    ROM *rom = cpu.memory->rom;
+    uint8_t *base = (uint8_t *)&cpu;
+
+    // Offsets of the registers; indexed like the r8 field of the opcodes, (HL) is -1
+    int32_t r8[8] = {(int32_t)((uint8_t *)&cpu.B - base), (int32_t)((uint8_t *)&cpu.C - base),
+                     (int32_t)((uint8_t *)&cpu.D - base), (int32_t)((uint8_t *)&cpu.E - base),
+                     (int32_t)((uint8_t *)&cpu.H - base), (int32_t)((uint8_t *)&cpu.L - base),
+                     -1,
+                     (int32_t)((uint8_t *)&cpu.A - base)};
+    int32_t pcOffset = (uint8_t *)&cpu.PC - base;
+    int32_t spOffset = (uint8_t *)&cpu.SP - base;
+
+    X86Emitter e(codeBuffer + codeUsed);
+    e.prologue();
+
+    uint16_t startPc = cpu.PC;
+    uint8_t region = startPc >> 14;
+    uint16_t pc = startPc;
+    uint32_t cycles = 0;
+    uint32_t numInstructions = 0;
+    // Native instructions don't update PC; it is written before calling the interpreter or exiting
+    bool pcDirty = false;
+
+    while (numInstructions < JIT_MAX_BLOCK_INSTRUCTIONS && (pc >> 14) == region) {
+        DecodedInstruction *instruction = cpu.decodeCache.lookup(rom, pc);
+        if (instruction == nullptr)
+            break;
+
+        uint8_t opcode = instruction->opcode;
+        uint8_t cbOpcode = instruction->operands[0];
+        bool memoryAccess = accessesMemory(opcode, cbOpcode);
+
+        if (!canCompile(opcode) || (memoryAccess && numInstructions > 0))
+            break;
+
+        ++numInstructions;
+        uint16_t nextPc = pc + instruction->length;
+        bool native = true;
+
+        uint8_t dst = (opcode >> 3) & 0x07;
+        uint8_t src = opcode & 0x07;
+
+        if (opcode == 0x00) {
+            // NOP
+            cycles += 1;
+        } else if (opcode >= 0x40 && opcode < 0x80 && dst != 6 && src != 6) {
+            // LD r8, r8
+            if (dst != src) {
+                e.loadByte(r8[src]);
+                e.storeByte(r8[dst]);
+            }
+            cycles += 1;
+        } else if (opcode < 0x40 && (opcode & 0xC7) == 0x06 && dst != 6) {
+            // LD r8, n8
+            e.storeByteImm(r8[dst], instruction->operands[0]);
+            cycles += 2;
+        } else if (opcode < 0x40 && (opcode & 0xCF) == 0x01) {
+            // LD r16, n16
+            if (opcode == 0x31) {
+                e.storeWordImm(spOffset, instruction->operands[0] | (instruction->operands[1] << 8));
+            } else {
+                e.storeByteImm(r8[(opcode >> 3) & 0x06], instruction->operands[1]);
+                e.storeByteImm(r8[((opcode >> 3) & 0x06) + 1], instruction->operands[0]);
+            }
+            cycles += 3;
+        } else if (opcode < 0x40 && ((opcode & 0xCF) == 0x03 || (opcode & 0xCF) == 0x0B) &&
+                   (opcode >= 0x30 || r8[((opcode >> 3) & 0x06) + 1] ==
+                                          r8[(opcode >> 3) & 0x06] + 1)) {
+            // INC r16 / DEC r16; the high register is followed by the low one in SM83, so the
+            // pair is loaded as a word and byte swapped
+            bool isSp = opcode >= 0x30;
+            int32_t offset = isSp ? spOffset : r8[(opcode >> 3) & 0x06];
+
+            e.loadWord(offset);
+            if (!isSp)
+                e.swapBytes();
+            if ((opcode & 0x0F) == 0x03)
+                e.incWord();
+            else
+                e.decWord();
+            if (!isSp)
+                e.swapBytes();
+            e.storeWord(offset);
+            cycles += 2;
+        } else if (opcode == 0xC3 || opcode == 0x18) {
+            // JP n16 / JR e8
+            if (opcode == 0xC3)
+                nextPc = instruction->operands[0] | (instruction->operands[1] << 8);
+            else
+                nextPc += (int8_t)instruction->operands[0];
+
+            cycles += opcode == 0xC3 ? 4 : 3;
+        } else {
+            native = false;
+        }
+
+        if (native) {
+            pc = nextPc;
+            pcDirty = true;
+        } else {
+            if (pcDirty)
+                e.storeWordImm(pcOffset, pc);
+
+            e.callHelper((void *)&interpretInstruction, instruction);
+            pc = nextPc;
+            pcDirty = false;
+        }
+
+        if (isControlFlow(opcode) || writesMemory(opcode, cbOpcode))
+            break;
+    }
+
+    if (numInstructions == 0)
+        return nullptr;
+
+    if (pcDirty)
+        e.storeWordImm(pcOffset, pc);
+
+    e.epilogue(cycles);
+
+    JitBlock block = (JitBlock)(codeBuffer + codeUsed);
+    codeUsed += e.size();
+    ++blocksCompiled;
+
+    return block;
+#else
+    (void)cpu;
+    return nullptr;
+#endif
+}
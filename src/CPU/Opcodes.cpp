@@ -18,10 +18,7 @@ void SM83::op_adc_a_r8(const uint8_t &r8)
     uint8_t carry = getCarryFlag();
     uint16_t result = A + r8 + carry;
 
-    setZeroFlag((result & 0xFF) == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(((A & 0xF) + (r8 & 0xF) + carry) > 0xF);
-    setCarryFlag(result > 0xFF);
+    F.setAdd(A, r8, carry);
 
     A = result & 0xFF;
 
@@ -50,10 +47,7 @@ void SM83::op_adc_a_addr_hl()
     uint8_t carry = getCarryFlag();
     uint16_t result = A + byte + carry;
 
-    setZeroFlag((result & 0xFF) == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(((A & 0xF) + (byte & 0xF) + carry) > 0xF);
-    setCarryFlag(result > 0xFF);
+    F.setAdd(A, byte, carry);
 
     A = result & 0xFF;
 
@@ -76,15 +70,12 @@ void SM83::op_adc_a_n8()
         return;
 
     // uint8_t n8 = memory[PC + 1];
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     uint8_t carry = getCarryFlag();
     uint16_t result = A + n8 + carry;
 
-    setZeroFlag((result & 0xFF) == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(((A & 0xF) + (n8 & 0xF) + carry) > 0xF);
-    setCarryFlag(result > 0xFF);
+    F.setAdd(A, n8, carry);
 
     A = result & 0xFF;
 
@@ -105,10 +96,7 @@ void SM83::op_add_a_r8(const uint8_t &r8)
 {
     uint16_t result = A + r8;
 
-    setZeroFlag((result & 0xFF) == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(((A & 0xF) + (r8 & 0xF)) > 0xF);
-    setCarryFlag(result > 0xFF);
+    F.setAdd(A, r8);
 
     A = result & 0xFF;
 
@@ -136,10 +124,7 @@ void SM83::op_add_a_addr_hl()
 
     uint16_t result = A + byte;
 
-    setZeroFlag((result & 0xFF) == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(((A & 0xF) + (byte & 0xF)) > 0xF);
-    setCarryFlag(result > 0xFF);
+    F.setAdd(A, byte);
 
     A = result & 0xFF;
 
@@ -162,14 +147,11 @@ void SM83::op_add_a_n8()
         return;
 
     // uint8_t n8 = memory[PC + 1];
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     uint16_t result = A + n8;
 
-    setZeroFlag((result & 0xFF) == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(((A & 0xF) + (n8 & 0xF)) > 0xF);
-    setCarryFlag(result > 0xFF);
+    F.setAdd(A, n8);
 
     A = result & 0xFF;
 
@@ -189,9 +171,7 @@ void SM83::op_dec_r8(uint8_t &r8)
 {
     --r8;
 
-    setZeroFlag(r8 == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((r8 & 0xF) == 0xF);
+    F.setDec(r8);
 
     endInstruction(1);
 }
@@ -216,9 +196,7 @@ void SM83::op_dec_addr_hl()
     writemem_u8(--byte, hl);
     // --byte;
 
-    setZeroFlag(byte == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((byte & 0xF) == 0xF);
+    F.setDec(byte);
 
     endInstruction(1);
 }
@@ -234,12 +212,9 @@ void SM83::op_dec_addr_hl()
  */
 void SM83::op_inc_r8(uint8_t &r8)
 {
-    setHalfCarryFlag((r8 & 0xF) == 0xF);
-
     ++r8;
 
-    setZeroFlag(r8 == 0);
-    setSubtractFlag(0);
+    F.setInc(r8);
 
     endInstruction(1);
 }
@@ -262,13 +237,9 @@ void SM83::op_inc_addr_hl()
     // uint8_t &byte = *(memory + hl);
     uint8_t byte = readmem_u8(hl);
 
-    setHalfCarryFlag((byte & 0xF) == 0xF);
     writemem_u8(++byte, hl);
 
-    //++byte;
-
-    setZeroFlag(byte == 0);
-    setSubtractFlag(0);
+    F.setInc(byte);
 
     endInstruction(1);
 }
@@ -288,10 +259,7 @@ void SM83::op_sbc_a_r8(const uint8_t &r8)
     uint8_t carry = getCarryFlag();
     uint8_t result = A - r8 - carry;
 
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (r8 & 0xF) + carry);
-    setCarryFlag(A < r8 + carry);
+    F.setSub(A, r8, carry);
 
     A = result;
 
@@ -320,10 +288,7 @@ void SM83::op_sbc_a_addr_hl()
     uint8_t carry = getCarryFlag();
     uint8_t result = A - byte - carry;
 
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (byte & 0xF) + carry);
-    setCarryFlag(A < byte + carry);
+    F.setSub(A, byte, carry);
 
     A = result;
 
@@ -346,15 +311,12 @@ void SM83::op_sbc_a_n8()
         return;
 
     // uint8_t n8 = memory[PC + 1];
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     uint8_t carry = getCarryFlag();
     uint8_t result = A - n8 - carry;
 
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (n8 & 0xF) + carry);
-    setCarryFlag(A < n8 + carry);
+    F.setSub(A, n8, carry);
 
     A = result;
 
@@ -375,10 +337,7 @@ void SM83::op_sub_a_r8(const uint8_t &r8)
 {
     uint8_t result = A - r8;
 
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (r8 & 0xF));
-    setCarryFlag(A < r8);
+    F.setSub(A, r8);
 
     A = result;
 
@@ -405,10 +364,7 @@ void SM83::op_sub_a_addr_hl()
 
     uint8_t result = A - byte;
 
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (byte & 0xF));
-    setCarryFlag(A < byte);
+    F.setSub(A, byte);
 
     A = result;
 
@@ -430,13 +386,10 @@ void SM83::op_sub_a_n8()
     if (!checkInstructionCycle(2))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
     uint8_t result = A - n8;
 
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (n8 & 0xF));
-    setCarryFlag(A < n8);
+    F.setSub(A, n8);
 
     A = result;
 
@@ -459,10 +412,7 @@ void SM83::op_and_a_r8(const uint8_t &r8)
 {
     A &= r8;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(1);
-    setCarryFlag(0);
+    F.setLogic(A, 0x20);
 
     endInstruction(1);
 }
@@ -487,10 +437,7 @@ void SM83::op_and_a_addr_hl()
 
     A &= byte;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(1);
-    setCarryFlag(0);
+    F.setLogic(A, 0x20);
 
     endInstruction(1);
 }
@@ -510,14 +457,11 @@ void SM83::op_and_a_n8()
     if (!checkInstructionCycle(2))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     A &= n8;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(1);
-    setCarryFlag(0);
+    F.setLogic(A, 0x20);
 
     endInstruction(2);
 }
@@ -534,12 +478,7 @@ void SM83::op_and_a_n8()
  */
 void SM83::op_cp_a_r8(const uint8_t &r8)
 {
-    uint8_t result = A - r8;
-
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (r8 & 0xF));
-    setCarryFlag(A < r8);
+    F.setSub(A, r8);
 
     endInstruction(1);
 }
@@ -562,12 +501,7 @@ void SM83::op_cp_a_addr_hl()
     uint16_t hl = (H << 0x8) | L;
     uint8_t byte = readmem_u8(hl);
 
-    uint8_t result = A - byte;
-
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (byte & 0xF));
-    setCarryFlag(A < byte);
+    F.setSub(A, byte);
 
     endInstruction(1);
 }
@@ -587,14 +521,9 @@ void SM83::op_cp_a_n8()
     if (!checkInstructionCycle(2))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
-    uint8_t result = A - n8;
-
-    setZeroFlag(result == 0);
-    setSubtractFlag(1);
-    setHalfCarryFlag((A & 0xF) < (n8 & 0xF));
-    setCarryFlag(A < n8);
+    F.setSub(A, n8);
 
     endInstruction(2);
 }
@@ -613,10 +542,7 @@ void SM83::op_or_a_r8(const uint8_t &r8)
 {
     A |= r8;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(0);
-    setCarryFlag(0);
+    F.setLogic(A, 0);
 
     endInstruction(1);
 }
@@ -641,10 +567,7 @@ void SM83::op_or_a_addr_hl()
 
     A |= byte;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(0);
-    setCarryFlag(0);
+    F.setLogic(A, 0);
 
     endInstruction(1);
 }
@@ -664,14 +587,11 @@ void SM83::op_or_a_n8()
     if (!checkInstructionCycle(2))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     A |= n8;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(0);
-    setCarryFlag(0);
+    F.setLogic(A, 0);
 
     endInstruction(2);
 }
@@ -690,10 +610,7 @@ void SM83::op_xor_a_r8(const uint8_t &r8)
 {
     A ^= r8;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(0);
-    setCarryFlag(0);
+    F.setLogic(A, 0);
 
     endInstruction(1);
 }
@@ -718,10 +635,7 @@ void SM83::op_xor_a_addr_hl()
 
     A ^= byte;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(0);
-    setCarryFlag(0);
+    F.setLogic(A, 0);
 
     endInstruction(1);
 }
@@ -741,14 +655,11 @@ void SM83::op_xor_a_n8()
     if (!checkInstructionCycle(2))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     A ^= n8;
 
-    setZeroFlag(A == 0);
-    setSubtractFlag(0);
-    setHalfCarryFlag(0);
-    setCarryFlag(0);
+    F.setLogic(A, 0);
 
     endInstruction(2);
 }
@@ -1583,7 +1494,7 @@ void SM83::op_ld_r8_n8(uint8_t &r8)
     if (!checkInstructionCycle(2))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     r8 = n8;
 
@@ -1602,7 +1513,7 @@ void SM83::op_ld_r16_n16(uint8_t &r16_high, uint8_t &r16_low)
     if (!checkInstructionCycle(3))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     r16_high = (n16 & 0xFF00) >> 0x8;
     r16_low = n16 & 0x00FF;
@@ -1642,7 +1553,7 @@ void SM83::op_ld_addr_hl_n8()
         return;
 
     uint16_t hl = (H << 0x8) | L;
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     writemem_u8(n8, hl);
 
@@ -1699,7 +1610,7 @@ void SM83::op_ld_addr_n16_a()
     if (!checkInstructionCycle(4))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     writemem_u8(A, n16);
 
@@ -1718,7 +1629,7 @@ void SM83::op_ldh_addr_n16_a()
     if (!checkInstructionCycle(3))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     writemem_u8(A, 0xFF00 + n8);
 
@@ -1773,7 +1684,7 @@ void SM83::op_ld_a_addr_n16()
     if (!checkInstructionCycle(4))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     A = readmem_u8(n16);
 
@@ -1792,7 +1703,7 @@ void SM83::op_ldh_a_addr_n16()
     if (!checkInstructionCycle(3))
         return;
 
-    uint8_t n8 = readmem_u8(PC + 1);
+    uint8_t n8 = readImmediate_u8();
 
     A = readmem_u8(0xFF00 + n8);
 
@@ -1919,7 +1830,7 @@ void SM83::op_call_n16()
     if (!checkInstructionCycle(6))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
     uint16_t ret_addr = PC + 3;
 
     writemem_u8((ret_addr & 0xFF00) >> 0x8, --SP);
@@ -1949,7 +1860,7 @@ void SM83::op_call_cc_n16(uint8_t flag_bit, uint8_t required_value)
     if (!checkInstructionCycle(6, false))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
     uint16_t ret_addr = PC + 3;
 
     writemem_u8((ret_addr & 0xFF00) >> 0x8, --SP);
@@ -1988,7 +1899,7 @@ void SM83::op_jp_n16()
     if (!checkInstructionCycle(4))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     PC = n16;
 
@@ -2013,7 +1924,7 @@ void SM83::op_jp_cc_n16(uint8_t flag_bit, uint8_t required_value)
     if (!checkInstructionCycle(4, false))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     PC = n16;
 
@@ -2033,7 +1944,7 @@ void SM83::op_jr_e8()
     if (!checkInstructionCycle(3))
         return;
 
-    uint8_t ue8 = readmem_u8(PC + 1);
+    uint8_t ue8 = readImmediate_u8();
     int8_t e8 = *(int8_t *)&ue8;
 
     uint16_t addr = PC + 2;
@@ -2062,7 +1973,7 @@ void SM83::op_jr_cc_e8(uint8_t flag_bit, uint8_t required_value)
     if (!checkInstructionCycle(3, false))
         return;
 
-    uint8_t ue8 = readmem_u8(PC + 1);
+    uint8_t ue8 = readImmediate_u8();
     int8_t e8 = *(int8_t *)&ue8;
 
     uint16_t addr = PC + 2;
@@ -2210,7 +2121,7 @@ void SM83::op_add_sp_e8()
     if (!checkInstructionCycle(4))
         return;
 
-    uint8_t ue8 = readmem_u8(PC + 1);
+    uint8_t ue8 = readImmediate_u8();
     int8_t e8 = *(int8_t *)&ue8;
 
     uint32_t result = SP + e8;
@@ -2271,7 +2182,7 @@ void SM83::op_ld_sp_n16()
     if (!checkInstructionCycle(3))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     SP = n16;
 
@@ -2290,7 +2201,7 @@ void SM83::op_ld_addr_n16_sp()
     if (!checkInstructionCycle(5))
         return;
 
-    uint16_t n16 = readmem_u16(PC + 1);
+    uint16_t n16 = readImmediate_u16();
 
     writemem_u16(SP, n16);
 
@@ -2312,7 +2223,7 @@ void SM83::op_ld_hl_sp_plus_e8()
     if (!checkInstructionCycle(3))
         return;
 
-    uint8_t ue8 = readmem_u8(PC + 1);
+    uint8_t ue8 = readImmediate_u8();
     int8_t e8 = *(int8_t *)&ue8;
 
     uint32_t result = SP + e8;
@@ -2549,32 +2460,7 @@ void SM83::op_halt()
     }
 
     if (ime == 0) {
-        bool pending = false;
-
-        // VBlank
-        if (getVBlankInterruptEnable() && getVBlankInterruptFlag()) {
-            pending = true;
-        }
-
-        // LCD_STAT
-        if (getLCDSTATInterruptEnable() && getLCDSTATInterruptFlag()) {
-            pending = true;
-        }
-
-        // Timer
-        if (getTimerInterruptEnable() && getTimerInterruptFlag()) {
-            pending = true;
-        }
-
-        // Serial
-        if (getSerialInterruptEnable() && getSerialInterruptFlag()) {
-            pending = true;
-        }
-
-        // Joypad
-        if (getJoypadInterruptEnable() && getJoypadInterruptFlag()) {
-            pending = true;
-        }
+        bool pending = memory->interrupts.anyPending();
 
         if (!pending) {
             halted = true;
@@ -2644,4 +2530,11 @@ void SM83::op_stop()
 void SM83::op_illegal()
 {
     std::cerr << std::hex << "Invalid opcode: " << (uint)readmem_u8(PC) << "\n";
+    illegalOpcode = true;
+
+    // The CPU is stuck on this opcode from now on, so the trace would only fill up with it
+    if (tracer.enabled) {
+        tracer.dump("illegal opcode");
+        tracer.stop();
+    }
 }
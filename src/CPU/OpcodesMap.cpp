@@ -1387,7 +1387,7 @@ void SM83::OP_CA() { op_jp_cc_n16(getZeroFlag(), 1); }
 // Prefix CB
 void SM83::OP_CB()
 {
-    uint8_t cb_opcode = readmem_u8(PC + 1);
+    uint8_t cb_opcode = readImmediate_u8();
 
     switch (cb_opcode) {
     case 0x00:
@@ -0,0 +1,390 @@
+#include "Profiler.hpp"
+#include "Memory.hpp"
+#include "ROM.hpp"
+#include "SM83.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+Profiler::Profiler()
+{
+    enabled = false;
+    foldedStacks = false;
+    rom = nullptr;
+
+    for (int i = 0; i < PROFILER_NUM_OPCODES; ++i) {
+        opcodeCycles[i] = 0;
+        opcodeCounts[i] = 0;
+    }
+
+    totalCycles = 0;
+    interruptCycles = 0;
+    haltCycles = 0;
+    idleLoopCycles = 0;
+
+    currentKey = PROFILER_HALT_KEY;
+    currentOpcode = 0;
+    currentSp = 0;
+    currentCounter = &haltCycles;
+    currentOpcodeCounter = &noOpcodeCycles;
+    currentCycles = 0;
+    noOpcodeCycles = 0;
+
+    overflowFrames = 0;
+}
+
+void Profiler::init(ROM *rom, bool foldedStacks)
+{
+    this->rom = rom;
+    this->foldedStacks = foldedStacks;
+
+    romCycles.assign(rom->romFileSize, 0);
+    otherCycles.assign(0x10000, 0);
+}
+
+/**
+ *  Reads the symbols of an RGBDS .sym file, made of "BB:AAAA Name" lines and ; comments
+ */
+bool Profiler::loadSymbols(std::string path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == ';')
+            continue;
+
+        unsigned int bank, addr;
+        char name[256];
+        if (sscanf(line.c_str(), "%x:%x %255s", &bank, &addr, name) != 3 || bank > 0xFFFF ||
+            addr > 0xFFFF)
+            continue;
+
+        symbols.push_back({(uint16_t)bank, (uint16_t)addr, name});
+    }
+
+    std::sort(symbols.begin(), symbols.end(),
+              [](const ProfilerSymbol &a, const ProfilerSymbol &b) {
+                  return a.bank != b.bank ? a.bank < b.bank : a.addr < b.addr;
+              });
+
+    return true;
+}
+
+/**
+ *  Attributes the next CPU M-cycle. Must be called before SM83::cycle, while the state still tells
+ *  what the cycle is going to be spent on
+ */
+void Profiler::cycle(SM83 &cpu)
+{
+    ++totalCycles;
+
+    if (cpu.idleLoop.active) {
+        if (currentKey != PROFILER_IDLE_LOOP_KEY)
+            startOther(cpu, PROFILER_IDLE_LOOP_KEY, &idleLoopCycles);
+    } else if (cpu.halted && cpu.int_cycles < 0) {
+        if (currentKey != PROFILER_HALT_KEY)
+            startOther(cpu, PROFILER_HALT_KEY, &haltCycles);
+    } else if (cpu.int_cycles >= 0 ||
+               (cpu.instructionCycle == 0 && cpu.ime && cpu.memory->interrupts.anyPending())) {
+        if (currentKey != PROFILER_INTERRUPT_KEY)
+            startOther(cpu, PROFILER_INTERRUPT_KEY, &interruptCycles);
+    } else if (cpu.instructionCycle == 0) {
+        startInstruction(cpu);
+    }
+
+    ++*currentCounter;
+    ++*currentOpcodeCounter;
+    ++currentCycles;
+}
+
+uint32_t Profiler::getKey(uint16_t addr)
+{
+    if (addr < 0x8000) {
+        int32_t bank = rom->bootromActive && addr < 0x100 ? -1 : rom->getMappedBank(addr);
+        return ((bank < 0 ? PROFILER_NO_BANK : (uint32_t)bank) << 16) | addr;
+    }
+
+    // RGBDS puts WRAMX in bank 1 and every other RAM area in bank 0
+    uint32_t bank = addr >= 0xD000 && addr < 0xE000 ? 1 : 0;
+    return (bank << 16) | addr;
+}
+
+uint64_t *Profiler::getCounter(uint32_t key)
+{
+    uint16_t bank = key >> 16;
+    uint16_t addr = key & 0xFFFF;
+
+    if (addr < 0x8000 && bank != PROFILER_NO_BANK) {
+        size_t index = (size_t)bank * 0x4000 + (addr & 0x3FFF);
+        if (index < romCycles.size())
+            return &romCycles[index];
+    }
+
+    return &otherCycles[addr];
+}
+
+void Profiler::startInstruction(SM83 &cpu)
+{
+    endCurrent(cpu);
+
+    uint16_t opcode = cpu.memory->readmem(cpu.PC, true, true);
+    if (opcode == 0xCB)
+        opcode = 0x100 | cpu.memory->readmem(cpu.PC + 1, true, true);
+
+    currentKey = getKey(cpu.PC);
+    currentOpcode = opcode;
+    currentSp = cpu.SP;
+    currentCounter = getCounter(currentKey);
+    currentOpcodeCounter = &opcodeCycles[opcode];
+    ++opcodeCounts[opcode];
+}
+
+void Profiler::startOther(SM83 &cpu, uint32_t key, uint64_t *counter)
+{
+    endCurrent(cpu);
+
+    currentKey = key;
+    currentOpcode = 0;
+    currentSp = cpu.SP;
+    currentCounter = counter;
+    currentOpcodeCounter = &noOpcodeCycles;
+}
+
+void Profiler::endCurrent(SM83 &cpu)
+{
+    if (!foldedStacks)
+        return;
+
+    if (currentCycles > 0) {
+        stackKey = callStack;
+        stackKey.push_back(currentKey);
+        stackCycles[stackKey] += currentCycles;
+        currentCycles = 0;
+    }
+
+    bool call = false, ret = false;
+    if (currentKey == PROFILER_INTERRUPT_KEY) {
+        call = true;
+    } else if (currentKey != PROFILER_HALT_KEY && currentKey != PROFILER_IDLE_LOOP_KEY) {
+        switch (currentOpcode) {
+        // CALL, CALL cc
+        case 0xCD:
+        case 0xC4:
+        case 0xCC:
+        case 0xD4:
+        case 0xDC:
+        // RST
+        case 0xC7:
+        case 0xCF:
+        case 0xD7:
+        case 0xDF:
+        case 0xE7:
+        case 0xEF:
+        case 0xF7:
+        case 0xFF:
+            call = true;
+            break;
+        // RET, RETI, RET cc
+        case 0xC9:
+        case 0xD9:
+        case 0xC0:
+        case 0xC8:
+        case 0xD0:
+        case 0xD8:
+            ret = true;
+            break;
+        }
+    }
+
+    // Conditional calls and returns that were not taken leave SP unchanged
+    if (call && (uint16_t)(currentSp - 2) == cpu.SP) {
+        if (callStack.size() < PROFILER_MAX_STACK_DEPTH)
+            callStack.push_back(getKey(cpu.PC));
+        else
+            ++overflowFrames;
+    } else if (ret && (uint16_t)(currentSp + 2) == cpu.SP) {
+        if (overflowFrames > 0)
+            --overflowFrames;
+        else if (!callStack.empty())
+            callStack.pop_back();
+    }
+}
+
+std::string Profiler::resolve(uint32_t key, bool withOffset)
+{
+    if (key == PROFILER_INTERRUPT_KEY)
+        return "[interrupt dispatch]";
+    if (key == PROFILER_HALT_KEY)
+        return "[halt]";
+    if (key == PROFILER_IDLE_LOOP_KEY)
+        return "[idle loop]";
+
+    uint16_t bank = key >> 16;
+    uint16_t addr = key & 0xFFFF;
+
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), key,
+                               [](uint32_t key, const ProfilerSymbol &symbol) {
+                                   return key < ((uint32_t)symbol.bank << 16 | symbol.addr);
+                               });
+
+    char text[300];
+    if (it == symbols.begin() || (it - 1)->bank != bank || bank == PROFILER_NO_BANK) {
+        if (bank == PROFILER_NO_BANK)
+            snprintf(text, sizeof(text), "??:%04X", addr);
+        else
+            snprintf(text, sizeof(text), "%02X:%04X", bank, addr);
+        return text;
+    }
+
+    const ProfilerSymbol &symbol = *(it - 1);
+    if (!withOffset) {
+        // Group the local labels with their function
+        return symbol.name.substr(0, symbol.name.find('.'));
+    }
+
+    if (symbol.addr == addr)
+        return symbol.name;
+
+    snprintf(text, sizeof(text), "%s+0x%X", symbol.name.c_str(), addr - symbol.addr);
+    return text;
+}
+
+bool Profiler::write(std::string path, std::string gameTitle)
+{
+    // Count the last instruction
+    if (foldedStacks && currentCycles > 0) {
+        stackKey = callStack;
+        stackKey.push_back(currentKey);
+        stackCycles[stackKey] += currentCycles;
+        currentCycles = 0;
+    }
+
+    bool result = foldedStacks ? writeFoldedStacks(path) : writeReport(path, gameTitle);
+    if (result)
+        std::cout << "Profile written to " << path << "\n";
+
+    return result;
+}
+
+bool Profiler::writeReport(std::string path, std::string gameTitle)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        std::cerr << "Could not write the profile to " << path << "\n";
+        return false;
+    }
+
+    double total = totalCycles > 0 ? (double)totalCycles : 1.0;
+
+    fprintf(file, "Profile of %s: %llu M-cycles\n", gameTitle.c_str(),
+            (unsigned long long)totalCycles);
+    fprintf(file, "  interrupt dispatch: %llu (%.2f%%)\n", (unsigned long long)interruptCycles,
+            100.0 * interruptCycles / total);
+    fprintf(file, "  halt:               %llu (%.2f%%)\n", (unsigned long long)haltCycles,
+            100.0 * haltCycles / total);
+    fprintf(file, "  skipped idle loops: %llu (%.2f%%)\n", (unsigned long long)idleLoopCycles,
+            100.0 * idleLoopCycles / total);
+
+    // Addresses
+    std::vector<std::pair<uint32_t, uint64_t>> addresses;
+    for (size_t i = 0; i < romCycles.size(); ++i) {
+        if (romCycles[i] == 0)
+            continue;
+
+        uint32_t bank = i / 0x4000;
+        uint32_t addr = (i & 0x3FFF) | (bank == 0 ? 0 : 0x4000);
+        addresses.push_back({bank << 16 | addr, romCycles[i]});
+    }
+    for (uint32_t addr = 0; addr < otherCycles.size(); ++addr) {
+        if (otherCycles[addr] == 0)
+            continue;
+
+        uint32_t key = addr < 0x8000 ? (PROFILER_NO_BANK << 16 | addr) : getKey(addr);
+        addresses.push_back({key, otherCycles[addr]});
+    }
+
+    auto byCycles = [](const std::pair<uint32_t, uint64_t> &a,
+                       const std::pair<uint32_t, uint64_t> &b) { return a.second > b.second; };
+    std::sort(addresses.begin(), addresses.end(), byCycles);
+
+    fprintf(file, "\nHot spots:\n%12s %7s  %s\n", "cycles", "%", "address");
+    for (size_t i = 0; i < addresses.size() && i < PROFILER_REPORT_ENTRIES; ++i)
+        fprintf(file, "%12llu %6.2f%%  %s\n", (unsigned long long)addresses[i].second,
+                100.0 * addresses[i].second / total, resolve(addresses[i].first).c_str());
+
+    // Functions, if there are symbols to group the addresses by
+    if (!symbols.empty()) {
+        std::map<std::string, uint64_t> functionCycles;
+        for (auto &address : addresses)
+            functionCycles[resolve(address.first, false)] += address.second;
+
+        std::vector<std::pair<std::string, uint64_t>> functions(functionCycles.begin(),
+                                                                functionCycles.end());
+        std::sort(functions.begin(), functions.end(),
+                  [](const std::pair<std::string, uint64_t> &a,
+                     const std::pair<std::string, uint64_t> &b) { return a.second > b.second; });
+
+        fprintf(file, "\nFunctions:\n%12s %7s  %s\n", "cycles", "%", "function");
+        for (size_t i = 0; i < functions.size() && i < PROFILER_REPORT_ENTRIES; ++i)
+            fprintf(file, "%12llu %6.2f%%  %s\n", (unsigned long long)functions[i].second,
+                    100.0 * functions[i].second / total, functions[i].first.c_str());
+    }
+
+    // Opcodes
+    std::vector<std::pair<uint32_t, uint64_t>> opcodes;
+    for (uint32_t i = 0; i < PROFILER_NUM_OPCODES; ++i)
+        if (opcodeCycles[i] > 0)
+            opcodes.push_back({i, opcodeCycles[i]});
+    std::sort(opcodes.begin(), opcodes.end(), byCycles);
+
+    fprintf(file, "\nOpcodes:\n%12s %7s %12s  %s\n", "cycles", "%", "count", "opcode");
+    for (auto &opcode : opcodes) {
+        char name[8];
+        if (opcode.first >= 0x100)
+            snprintf(name, sizeof(name), "CB %02X", opcode.first & 0xFF);
+        else
+            snprintf(name, sizeof(name), "%02X", opcode.first);
+
+        fprintf(file, "%12llu %6.2f%% %12llu  %s\n", (unsigned long long)opcode.second,
+                100.0 * opcode.second / total, (unsigned long long)opcodeCounts[opcode.first],
+                name);
+    }
+
+    fclose(file);
+    return true;
+}
+
+/**
+ *  Writes one "caller;callee;function cycles" line per stack, the input of flamegraph.pl and
+ *  similar tools
+ */
+bool Profiler::writeFoldedStacks(std::string path)
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not write the profile to " << path << "\n";
+        return false;
+    }
+
+    // Different addresses of the same function end up on the same line
+    std::map<std::string, uint64_t> lines;
+    for (auto &it : stackCycles) {
+        std::string line;
+        for (size_t i = 0; i < it.first.size(); ++i) {
+            if (i > 0)
+                line += ';';
+            line += resolve(it.first[i], false);
+        }
+
+        lines[line] += it.second;
+    }
+
+    for (auto &it : lines)
+        file << it.first << " " << it.second << "\n";
+
+    return true;
+}
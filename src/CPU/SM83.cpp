@@ -1,16 +1,29 @@
 #include "SM83.hpp"
 #include "GameBoy.hpp"
 #include "Memory.hpp"
+#include "PPU.hpp"
+#include "StateSerializer.hpp"
 
 SM83::SM83()
 {
+    A = B = C = D = E = H = L = 0;
+    F = 0;
+    PC = SP = 0;
+
     int_cycles = -1;
+    int_addr = 0;
     instructionCycle = 0;
+    ei_enable = 0;
+    stop_signal = false;
+    illegalOpcode = false;
 
     halted = false;
     halt_bug = false;
     just_started_halt_bug = false;
 
+    currentInstruction = nullptr;
+    instructionPc = 0;
+
     ime = 1;
 }
 
@@ -19,6 +32,10 @@ SM83::SM83()
  */
 void SM83::cycle()
 {
+    // Skip the cycle if the CPU is spinning in an idle loop
+    if (idleLoop.enabled && idleLoop.cycle(*this))
+        return;
+
     // Check if halted and not servicing an interrupt
     if (halted && int_cycles < 0) {
         // Check for pending interrupts
@@ -46,8 +63,15 @@ void SM83::cycle()
         return;
     }
 
+    if (instructionCycle == 0) {
+        instructionPc = PC;
+
+        if (tracer.enabled)
+            tracer.record(*this);
+    }
+
     // Fetch opcode
-    uint8_t opcode = readmem_u8(PC);
+    uint8_t opcode = fetchOpcode();
 
     // If the halt bug occurs, decrement PC so that it will be used twice
     if (halt_bug) {
@@ -70,6 +94,13 @@ void SM83::cycle()
         just_started_halt_bug = false;
     }
 
+    currentInstruction = nullptr;
+
+    // A short backward jump may close a loop that only waits for memory to change
+    if (idleLoop.enabled && instructionCycle == 0 && PC < instructionPc &&
+        instructionPc - PC <= IDLE_LOOP_MAX_SIZE)
+        idleLoop.onBackwardBranch(*this, instructionPc);
+
     // Check for IME enable after EI instruction
     if (instructionCycle == 0)
         if (ei_enable == 1)
@@ -96,77 +127,24 @@ void SM83::handleInterrupts()
  */
 bool SM83::checkInterrupts(int8_t *int_cycles, uint16_t *int_addr)
 {
-    // VBlank
-    if (getVBlankInterruptEnable() && getVBlankInterruptFlag()) {
-        if (int_addr != nullptr) {
-            *int_cycles = 5;
-            *int_addr = SM83_VBLANK_INT;
-            setVBlankInterruptFlag(0);
-        }
-
-        if (ime == 0)
-            *int_cycles = 4;
-
-        return true;
-    }
-
-    // LCD_STAT
-    if (getLCDSTATInterruptEnable() && getLCDSTATInterruptFlag()) {
-        if (int_addr != nullptr) {
-            *int_cycles = 5;
-            *int_addr = SM83_LCD_STAT_INT;
-            setLCDSTATInterruptFlag(0);
-        }
+    InterruptController &interrupts = memory->interrupts;
 
-        if (ime == 0)
-            *int_cycles = 4;
-
-        return true;
-    }
-
-    // Timer
-    if (getTimerInterruptEnable() && getTimerInterruptFlag()) {
-        if (int_addr != nullptr) {
-            *int_cycles = 5;
-            *int_addr = SM83_TIMER_INT;
-            setTimerInterruptFlag(0);
-        }
-
-        if (ime == 0)
-            *int_cycles = 4;
-
-        return true;
-    }
-
-    // Serial
-    if (getSerialInterruptEnable() && getSerialInterruptFlag()) {
-        if (int_addr != nullptr) {
-            *int_cycles = 5;
-            *int_addr = SM83_SERIAL_INT;
-            setSerialInterruptFlag(0);
-        }
+    if (!interrupts.anyPending())
+        return false;
 
-        if (ime == 0)
-            *int_cycles = 4;
+    if (int_addr != nullptr) {
+        // Lowest set bit has the highest priority (VBlank -> Joypad)
+        uint8_t index = interrupts.getHighestPriority();
 
-        return true;
+        *int_cycles = 5;
+        *int_addr = InterruptController::getVector(index);
+        memory->acknowledgeInterrupt(1 << index);
     }
 
-    // Joypad
-    if (getJoypadInterruptEnable() && getJoypadInterruptFlag()) {
-        if (int_addr != nullptr) {
-            *int_cycles = 5;
-            *int_addr = SM83_JOYPAD_INT;
-            setJoypadInterruptFlag(0);
-        }
-
-        if (ime == 0)
-            *int_cycles = 4;
-
-        return true;
-    }
+    if (ime == 0)
+        *int_cycles = 4;
 
-    return false;
+    return true;
 }
 
 /**
@@ -202,6 +180,35 @@ bool SM83::serviceInterrupt()
     return true;
 }
 
+void SM83::serialize(StateSerializer &state)
+{
+    state.value(A);
+    uint8_t f = F;
+    state.value(f);
+    F = f;
+    state.value(B);
+    state.value(C);
+    state.value(D);
+    state.value(E);
+    state.value(H);
+    state.value(L);
+    state.value(PC);
+    state.value(SP);
+
+    state.value(instructionCycle);
+    state.value(ime);
+    state.value(ei_enable);
+    state.value(int_cycles);
+    state.value(int_addr);
+    state.value(halted);
+    state.value(halt_bug);
+    state.value(just_started_halt_bug);
+    state.value(stop_signal);
+    state.value(instructionPc);
+
+    idleLoop.serialize(state);
+}
+
 /* MEMORY READ AND WRITE */
 
 uint8_t SM83::readmem_u8(uint16_t addr) { return memory->readmem(addr); }
@@ -211,6 +218,45 @@ uint16_t SM83::readmem_u16(uint16_t addr)
     return memory->readmem(addr) | (memory->readmem(addr + 1) << 0x8);
 }
 
+/**
+ *  Reads the opcode at PC. Code running from ROM is read from the decode cache; code running from
+ *  RAM, fetches during OAM DMA and the HALT bug go through the memory bus
+ */
+uint8_t SM83::fetchOpcode()
+{
+    currentInstruction = nullptr;
+
+    if (PC < 0x8000 && !halt_bug && !memory->ppu->oamDmaActive)
+        currentInstruction = decodeCache.lookup(memory->rom, PC);
+
+    if (currentInstruction != nullptr)
+        return currentInstruction->opcode;
+
+    return readmem_u8(PC);
+}
+
+/**
+ *  Reads the byte following the opcode at PC
+ */
+uint8_t SM83::readImmediate_u8()
+{
+    if (currentInstruction != nullptr)
+        return currentInstruction->operands[0];
+
+    return readmem_u8(PC + 1);
+}
+
+/**
+ *  Reads the 2 bytes following the opcode at PC
+ */
+uint16_t SM83::readImmediate_u16()
+{
+    if (currentInstruction != nullptr)
+        return currentInstruction->operands[0] | (currentInstruction->operands[1] << 0x8);
+
+    return readmem_u16(PC + 1);
+}
+
 void SM83::writemem_u8(uint8_t val, uint16_t addr) { memory->writemem(val, addr); }
 
 void SM83::writemem_u16(uint16_t val, uint16_t addr)
@@ -244,13 +290,13 @@ void SM83::endInstruction(uint8_t opcode_length)
 
 /* FLAG GETTERS AND SETTERS */
 
-uint8_t SM83::getZeroFlag() { return (F & 0x80) >> 0x7; }
+uint8_t SM83::getZeroFlag() { return F.getZero(); }
 
-uint8_t SM83::getSubtractFlag() { return (F & 0x40) >> 0x6; }
+uint8_t SM83::getSubtractFlag() { return F.getSubtract(); }
 
-uint8_t SM83::getHalfCarryFlag() { return (F & 0x20) >> 0x5; }
+uint8_t SM83::getHalfCarryFlag() { return F.getHalfCarry(); }
 
-uint8_t SM83::getCarryFlag() { return (F & 0x10) >> 0x4; }
+uint8_t SM83::getCarryFlag() { return F.getCarry(); }
 
 void SM83::setZeroFlag(uint8_t value)
 {
@@ -0,0 +1,291 @@
+#include "Tracer.hpp"
+#include "Memory.hpp"
+#include "ROM.hpp"
+#include "SM83.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+// Tracer the signal handlers dump; there is only one CPU per process
+static Tracer *signalTracer = nullptr;
+
+Tracer::Tracer()
+{
+    enabled = false;
+    mode = TRACE_OFF;
+    mask = 0;
+    head = 0;
+    tail = 0;
+    dumpRequested = false;
+    streamFile = nullptr;
+    writerRunning = false;
+    signalPath[0] = '\0';
+}
+
+Tracer::~Tracer() { stop(); }
+
+bool Tracer::init(TraceMode mode, std::string path, size_t bufferSize)
+{
+    stop();
+
+    // Round down to a power of 2, so the index can be masked
+    size_t numRecords = 1;
+    while (numRecords * 2 * sizeof(TraceRecord) <= bufferSize)
+        numRecords *= 2;
+
+    records.assign(numRecords, TraceRecord{});
+    mask = numRecords - 1;
+    head = 0;
+    tail = 0;
+    dumpRequested = false;
+
+    this->mode = mode;
+    this->path = path;
+
+    // A crash while streaming leaves the file without the records that were still in the buffer,
+    // so those are dumped to their own file
+    std::string crashPath = mode == TRACE_STREAM ? path + ".crash" : path;
+    strncpy(signalPath, crashPath.c_str(), sizeof(signalPath) - 1);
+    signalPath[sizeof(signalPath) - 1] = '\0';
+
+    if (mode == TRACE_STREAM) {
+        streamFile = fopen(path.c_str(), "wb");
+        if (streamFile == nullptr) {
+            std::cerr << "Could not open the trace file " << path << "\n";
+            return false;
+        }
+
+        TraceFileHeader header = {};
+        memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+        header.recordSize = sizeof(TraceRecord);
+        fwrite(&header, sizeof(header), 1, streamFile);
+
+        writerRunning = true;
+        writerThread = std::thread(&Tracer::writerLoop, this);
+    }
+
+    enabled = true;
+    return true;
+}
+
+/**
+ *  Stops tracing; in stream mode, waits until every record is written to the file
+ */
+void Tracer::stop()
+{
+    enabled = false;
+
+    if (writerThread.joinable()) {
+        writerRunning = false;
+        writerThread.join();
+    }
+
+    if (streamFile != nullptr) {
+        fclose(streamFile);
+        streamFile = nullptr;
+    }
+
+    if (signalTracer == this)
+        signalTracer = nullptr;
+}
+
+void Tracer::record(SM83 &cpu)
+{
+    uint64_t index = head.load(std::memory_order_relaxed);
+
+    // The writer thread is a whole buffer behind; wait for it instead of losing records
+    if (mode == TRACE_STREAM) {
+        while (index - tail.load(std::memory_order_acquire) > mask)
+            std::this_thread::yield();
+    }
+
+    TraceRecord &record = records[index & mask];
+    record.pc = cpu.PC;
+    record.sp = cpu.SP;
+    record.a = cpu.A;
+    record.f = cpu.F;
+    record.b = cpu.B;
+    record.c = cpu.C;
+    record.d = cpu.D;
+    record.e = cpu.E;
+    record.h = cpu.H;
+    record.l = cpu.L;
+    record.ime = cpu.ime;
+    record.padding = 0;
+
+    ROM *rom = cpu.memory->rom;
+    int32_t bank = -1;
+    if (rom != nullptr && !(rom->bootromActive && cpu.PC < 0x100))
+        bank = rom->getMappedBank(cpu.PC);
+    record.bank = bank < 0 ? TRACE_NO_BANK : bank;
+
+    for (uint8_t i = 0; i < 4; ++i)
+        record.pcmem[i] = cpu.memory->readmem(cpu.PC + i, true, true);
+
+    head.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::dump(const char *reason)
+{
+    if (mode == TRACE_STREAM) {
+        std::cerr << "Trace (" << reason << "): instructions are streamed to " << path << "\n";
+        return true;
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Could not open the trace file " << path << "\n";
+        return false;
+    }
+
+    TraceFileHeader header = {};
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.recordSize = sizeof(TraceRecord);
+    fwrite(&header, sizeof(header), 1, file);
+
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t start = end > records.size() ? end - records.size() : 0;
+    writeRange(file, start, end);
+    fclose(file);
+
+    std::cerr << std::dec << "Trace (" << reason << "): last " << end - start
+              << " instructions written to " << path << "\n";
+    return true;
+}
+
+void Tracer::update()
+{
+    if (dumpRequested.exchange(false))
+        dump("requested");
+}
+
+void Tracer::installSignalHandlers()
+{
+    signalTracer = this;
+
+    struct sigaction action = {};
+    action.sa_handler = &Tracer::signalHandler;
+    sigemptyset(&action.sa_mask);
+
+    const int crashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    for (int signal : crashSignals)
+        sigaction(signal, &action, nullptr);
+
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+/**
+ *  Only uses async-signal-safe calls: the records are written with write(2), oldest first
+ */
+void Tracer::signalHandler(int signal)
+{
+    Tracer *tracer = signalTracer;
+
+    if (signal == SIGUSR1) {
+        if (tracer != nullptr)
+            tracer->dumpRequested = true;
+        return;
+    }
+
+    if (tracer != nullptr && !tracer->records.empty()) {
+        int fd = open(tracer->signalPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            TraceFileHeader header = {};
+            memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+            header.recordSize = sizeof(TraceRecord);
+            ssize_t written = write(fd, &header, sizeof(header));
+
+            // A stream trace only needs the records the writer thread hasn't written yet, so the
+            // crash file can be appended to it
+            uint64_t end = tracer->head.load();
+            uint64_t size = tracer->records.size();
+            uint64_t start = tracer->mode == TRACE_STREAM ? tracer->tail.load()
+                             : end > size                ? end - size
+                                                         : 0;
+            for (uint64_t i = start; i < end && written >= 0; ++i)
+                written = write(fd, &tracer->records[i & tracer->mask], sizeof(TraceRecord));
+
+            close(fd);
+
+            const char message[] = "Crashed; CPU trace written\n";
+            written = write(STDERR_FILENO, message, sizeof(message) - 1);
+        }
+    }
+
+    // Let the default action end the process
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+void Tracer::writerLoop()
+{
+    while (true) {
+        bool running = writerRunning.load(std::memory_order_acquire);
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t start = tail.load(std::memory_order_relaxed);
+
+        if (start != end) {
+            // tail only counts records that are in the file, not in the buffer of stdio, so a
+            // crash dump starts right after them
+            writeRange(streamFile, start, end);
+            fflush(streamFile);
+            tail.store(end, std::memory_order_release);
+        } else if (!running) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    fflush(streamFile);
+}
+
+/**
+ *  Writes the records from..to (counted like head), which must still be in the buffer
+ */
+void Tracer::writeRange(FILE *file, uint64_t from, uint64_t to)
+{
+    while (from < to) {
+        uint64_t index = from & mask;
+        // Up to the end of the range or of the buffer, whichever comes first
+        uint64_t count = std::min<uint64_t>(to - from, records.size() - index);
+        fwrite(&records[index], sizeof(TraceRecord), count, file);
+        from += count;
+    }
+}
+
+bool Tracer::convertToDoctor(std::string tracePath, FILE *out)
+{
+    FILE *file = fopen(tracePath.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "Could not open the trace file " << tracePath << "\n";
+        return false;
+    }
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.recordSize != sizeof(TraceRecord)) {
+        std::cerr << tracePath << " is not a trace file\n";
+        fclose(file);
+        return false;
+    }
+
+    TraceRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        fprintf(out,
+                "A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X "
+                "PCMEM:%02X,%02X,%02X,%02X\n",
+                record.a, record.f, record.b, record.c, record.d, record.e, record.h, record.l,
+                record.sp, record.pc, record.pcmem[0], record.pcmem[1], record.pcmem[2],
+                record.pcmem[3]);
+    }
+
+    fclose(file);
+    return true;
+}
@@ -1,4 +1,8 @@
 #include "Config.hpp"
+#include "Recorder.hpp"
+#include "Rewind.hpp"
+#include "Tracer.hpp"
+#include "Upscaler.hpp"
 
 Config *Config::instance = nullptr;
 
@@ -10,7 +14,26 @@ Config::Config()
     useBootrom = false;
     bootromPath = "";
     printPerformanceInfo = false;
+    performanceInfoInterval = 5;
     useCustomDMGPalette = false;
+    runAheadFrames = 0;
+    useJit = false;
+    idleLoopSkipping = false;
+    accuracyProfile = ACCURATE;
+    renderThread = false;
+    audioThread = false;
+    profilerOutput = PROFILER_OFF;
+    traceMode = TRACE_OFF;
+    timelineEnable = false;
+    timelinePpuModes = false;
+    scaleFilter = SCALE_NONE;
+    scaleThreads = 0;
+    traceBufferSize = TRACE_DEFAULT_BUFFER_SIZE_MB;
+    rewindEnable = false;
+    rewindFrameInterval = REWIND_DEFAULT_FRAME_INTERVAL;
+    rewindBufferSize = REWIND_DEFAULT_BUFFER_SIZE_MB;
+    recordFormat = RECORD_Y4M;
+    recordDirectIo = false;
 
     for (uint8_t i = 0; i < 4; ++i) {
         uint8_t val = 255 - (i * (255 / 3));
@@ -37,7 +60,33 @@ std::string Config::getConfigAsString()
         "\naudioVolume=" + std::to_string(audioVolume) +
         "\nuseBootrom=" + std::to_string(useBootrom) + "\nbootromPath=" + bootromPath +
         "\nprintPerformanceInfo=" + std::to_string(printPerformanceInfo) +
+        "\n; seconds between two summaries of the frame metrics\nperformanceInfoInterval=" +
+        std::to_string(performanceInfoInterval) +
         "\nuseCustomDMGPalette=" + std::to_string(useCustomDMGPalette) +
+        "\nrunAheadFrames=" + std::to_string(runAheadFrames) +
+        "\nuseJit=" + std::to_string(useJit) +
+        "\nidleLoopSkipping=" + std::to_string(idleLoopSkipping) +
+        "\n; accurate or fast\naccuracyProfile=" + (accuracyProfile == FAST ? "fast" : "accurate") +
+        "\n; draw the lines of the fast profile on another thread\nrenderThread=" + std::to_string(renderThread) +
+        "\n; make the samples on another thread\naudioThread=" + std::to_string(audioThread) +
+        "\n; off, report or folded\nprofiler=" +
+        (profilerOutput == PROFILER_REPORT ? "report" : profilerOutput == PROFILER_FOLDED ? "folded" : "off") +
+        "\ntimeline=" + std::to_string(timelineEnable) +
+        "\n; record the PPU modes of every line too; the timeline then holds only a few seconds\ntimelinePpuModes=" +
+        std::to_string(timelinePpuModes) +
+        "\n; none, scale2x, scale3x, xbr or sharp-bilinear\nscaleFilter=" +
+        Upscaler::getFilterName(scaleFilter) +
+        "\n; 0 uses one thread per core, up to 4\nscaleThreads=" + std::to_string(scaleThreads) +
+        "\n\n[Trace]\n; off, ring or stream. traceBufferSize is given in MB\n\n" +
+        "trace=" + (traceMode == TRACE_RING ? "ring" : traceMode == TRACE_STREAM ? "stream" : "off") +
+        "\ntraceBufferSize=" + std::to_string(traceBufferSize) +
+        "\n\n[Rewind]\n; Hold R to rewind. rewindBufferSize is given in MB\n\n" +
+        "rewindEnable=" + std::to_string(rewindEnable) +
+        "\nrewindFrameInterval=" + std::to_string(rewindFrameInterval) +
+        "\nrewindBufferSize=" + std::to_string(rewindBufferSize) +
+        "\n\n[Record]\n; Format of the video recorded with -V: y4m or rgba. recordDirectIo bypasses the page cache\n\n" +
+        "recordFormat=" + Recorder::getFormatName(recordFormat) +
+        "\nrecordDirectIo=" + std::to_string(recordDirectIo) +
         "\n\n[Colors]\n; Colors should be given in the following format: #rrggbb\n\n" +
         "bgColor0=#ffffff\nbgColor1=#aaaaaa\nbgColor2=#555555\nbgColor3=#000000\n\n" +
         "obp0Color0=#ffffff\nobp0Color1=#aaaaaa\nobp0Color2=#555555\nopb0Color3=#000000\n\n" +
@@ -58,10 +107,84 @@ std::string Config::getBootromPath() { return bootromPath; }
 
 bool Config::getPrintPerformanceInfo() { return printPerformanceInfo; }
 
+int Config::getPerformanceInfoInterval() { return performanceInfoInterval; }
+
 bool Config::getUseCustomDMGPalette() {
     return useCustomDMGPalette;
 }
 
+int Config::getRunAheadFrames() {
+    return runAheadFrames;
+}
+
+bool Config::getUseJit() {
+    return useJit;
+}
+
+bool Config::getIdleLoopSkipping() {
+    return idleLoopSkipping;
+}
+
+AccuracyProfile Config::getAccuracyProfile() {
+    return accuracyProfile;
+}
+
+bool Config::getRenderThread() {
+    return renderThread;
+}
+
+bool Config::getAudioThread() {
+    return audioThread;
+}
+
+ProfilerOutput Config::getProfilerOutput() {
+    return profilerOutput;
+}
+
+TraceMode Config::getTraceMode() {
+    return traceMode;
+}
+
+bool Config::getTimelineEnable() {
+    return timelineEnable;
+}
+
+bool Config::getTimelinePpuModes() {
+    return timelinePpuModes;
+}
+
+ScaleFilter Config::getScaleFilter() {
+    return scaleFilter;
+}
+
+int Config::getScaleThreads() {
+    return scaleThreads;
+}
+
+int Config::getTraceBufferSize() {
+    return traceBufferSize;
+}
+
+bool Config::getRewindEnable() {
+    return rewindEnable;
+}
+
+int Config::getRewindFrameInterval() {
+    return rewindFrameInterval;
+}
+
+int Config::getRewindBufferSize() {
+    return rewindBufferSize;
+}
+
+RecordFormat Config::getRecordFormat() {
+    return recordFormat;
+}
+
+bool Config::getRecordDirectIo() {
+    return recordDirectIo;
+}
+
 Color Config::getBgCustomDMGPalette(int index) {
     return bgCustomDMGPalette[index];
 }
@@ -92,10 +215,87 @@ void Config::setPrintPerformanceInfo(bool printPerformanceInfo)
     this->printPerformanceInfo = printPerformanceInfo;
 }
 
+void Config::setPerformanceInfoInterval(int performanceInfoInterval)
+{
+    this->performanceInfoInterval = performanceInfoInterval;
+}
+
 void Config::setUseCustomDMGPalette(bool useCustomDMGPalette) {
     this->useCustomDMGPalette = useCustomDMGPalette;
 }
 
+void Config::setRunAheadFrames(int runAheadFrames) {
+    this->runAheadFrames = runAheadFrames;
+}
+
+void Config::setUseJit(bool useJit) {
+    this->useJit = useJit;
+}
+
+void Config::setIdleLoopSkipping(bool idleLoopSkipping) {
+    this->idleLoopSkipping = idleLoopSkipping;
+}
+
+void Config::setAccuracyProfile(AccuracyProfile accuracyProfile) {
+    this->accuracyProfile = accuracyProfile;
+}
+
+void Config::setRenderThread(bool renderThread) {
+    this->renderThread = renderThread;
+}
+
+void Config::setAudioThread(bool audioThread) {
+    this->audioThread = audioThread;
+}
+
+void Config::setProfilerOutput(ProfilerOutput profilerOutput) {
+    this->profilerOutput = profilerOutput;
+}
+
+void Config::setTraceMode(TraceMode traceMode) {
+    this->traceMode = traceMode;
+}
+
+void Config::setTimelineEnable(bool timelineEnable) {
+    this->timelineEnable = timelineEnable;
+}
+
+void Config::setTimelinePpuModes(bool timelinePpuModes) {
+    this->timelinePpuModes = timelinePpuModes;
+}
+
+void Config::setScaleFilter(ScaleFilter scaleFilter) {
+    this->scaleFilter = scaleFilter;
+}
+
+void Config::setScaleThreads(int scaleThreads) {
+    this->scaleThreads = scaleThreads;
+}
+
+void Config::setTraceBufferSize(int traceBufferSize) {
+    this->traceBufferSize = traceBufferSize;
+}
+
+void Config::setRewindEnable(bool rewindEnable) {
+    this->rewindEnable = rewindEnable;
+}
+
+void Config::setRewindFrameInterval(int rewindFrameInterval) {
+    this->rewindFrameInterval = rewindFrameInterval;
+}
+
+void Config::setRewindBufferSize(int rewindBufferSize) {
+    this->rewindBufferSize = rewindBufferSize;
+}
+
+void Config::setRecordFormat(RecordFormat recordFormat) {
+    this->recordFormat = recordFormat;
+}
+
+void Config::setRecordDirectIo(bool recordDirectIo) {
+    this->recordDirectIo = recordDirectIo;
+}
+
 void Config::setBgCustomDMGPalette(int index, Color color) {
     bgCustomDMGPalette[index] = color;
 }
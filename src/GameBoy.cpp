@@ -1,5 +1,9 @@
 #include "GameBoy.hpp"
 #include "Config.hpp"
+#include "StateSerializer.hpp"
+#include "Timeline.hpp"
+#include <algorithm>
+#include <cstdio>
 
 GameBoy::GameBoy(EmulatorMode emulatorMode)
 {
@@ -15,6 +19,9 @@ GameBoy::GameBoy(EmulatorMode emulatorMode)
     ppu.cpu = &cpu;
     ppu.emulatorMode = emulatorMode;
 
+    // The hardware model is fixed for the whole run, so the frame loop is picked only once
+    selectFrameLoop(ACCURATE);
+
     cpu.memory = &memory;
     cpu.gameboy = this;
 
@@ -25,10 +32,18 @@ GameBoy::GameBoy(EmulatorMode emulatorMode)
     joypad.memory = &memory;
 
     audio.memory = &memory;
+    audio.recorder = &recorder;
 
     speedSwitchSleepCycles = 0;
 
     cpuWaitTCycles = 3;
+    cpuBlockCycles = 0;
+    useJit = false;
+
+    rewindFrameInterval = REWIND_DEFAULT_FRAME_INTERVAL;
+    framesSinceSnapshot = 0;
+
+    runAheadFrames = 0;
 
     for (uint i = 0; i < 4; ++i) {
         currentKeysState[0][i] = false;
@@ -87,9 +102,17 @@ void GameBoy::initSDL()
     sdlRenderer =
         SDL_CreateRenderer(sdlWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 
+    // Sharp bilinear scales to the size of the window in pixels, which is bigger on HiDPI
+    // displays; the other filters to a multiple of the screen, and SDL scales the rest
+    int outputWidth, outputHeight;
+    SDL_GetRendererOutputSize(sdlRenderer, &outputWidth, &outputHeight);
+    upscaler.init(Config::getInstance()->getScaleFilter(), PPU_SCREEN_WIDTH, PPU_SCREEN_HEIGHT,
+                  outputWidth, outputHeight, Config::getInstance()->getScaleThreads());
+    scaledPixels.resize(upscaler.outWidth * upscaler.outHeight);
+
     sdlTexture =
         SDL_CreateTexture(sdlRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
-                          PPU_SCREEN_WIDTH, PPU_SCREEN_HEIGHT);
+                          upscaler.outWidth, upscaler.outHeight);
 
     sdlPixelFormat = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
 
@@ -107,11 +130,29 @@ void GameBoy::initSDL()
 
 bool GameBoy::getInput()
 {
+    TIMELINE_SCOPE("Poll input", "Input");
     SDL_PumpEvents();
 
     if (keyboardState[SDL_SCANCODE_ESCAPE])
         return true;
 
+    // F12 dumps the CPU trace
+    bool traceKey = keyboardState[SDL_SCANCODE_F12];
+    if (traceKey && !traceKeyPressed)
+        cpu.tracer.dumpRequested = true;
+    traceKeyPressed = traceKey;
+
+    // While a movie is active the joypad is only updated once per frame, in updateMovieInput()
+    if (!movie.isActive())
+        readKeyboard();
+
+    return false;
+}
+
+void GameBoy::readKeyboard()
+{
+    uint8_t previousKeys = Movie::packKeys(joypad.keyState);
+
     // direction buttons
     joypad.keyState[0][0] = keyboardState[SDL_SCANCODE_RIGHT];
     joypad.keyState[0][1] = keyboardState[SDL_SCANCODE_LEFT];
@@ -124,7 +165,10 @@ bool GameBoy::getInput()
     joypad.keyState[1][2] = keyboardState[SDL_SCANCODE_BACKSPACE];
     joypad.keyState[1][3] = keyboardState[SDL_SCANCODE_SPACE];
 
-    return false;
+    if (!inputChangePending && Movie::packKeys(joypad.keyState) != previousKeys) {
+        inputChangeTime = std::chrono::high_resolution_clock::now();
+        inputChangePending = true;
+    }
 }
 
 // Sets the initial state after the bootrom
@@ -196,6 +240,7 @@ void GameBoy::setInitialState()
 
     // IE
     memory.ieRegister = 0x00;
+    memory.updateInterrupts();
 
     if (emulatorMode == CGB) {
         cpu.A = 0x11;
@@ -206,161 +251,725 @@ void GameBoy::setInitialState()
     ppu.setLcdDisplayEnable(1);
 }
 
-void GameBoy::run()
+/**
+ *  Loads the movie and the ROM and sets the state at power-on: the start of the boot ROM, or the
+ *  state it leaves if it isn't used. A reproducible run without a movie ignores the battery save
+ *  and the time of day
+ */
+bool GameBoy::powerOn(bool reproducible)
 {
+    if (!prepareMovie())
+        return false;
+
+    if (reproducible && !movie.isActive()) {
+        rom.useSaveFile = false;
+        rom.useFixedTime = true;
+        rom.fixedTime = 0;
+    }
+
     if (!rom.loadROM(romPath))
-        return;
+        return false;
+
+    bool useBootrom =
+        movie.isPlaying() ? movie.useBootrom : Config::getInstance()->getUseBootrom();
 
-    if (Config::getInstance()->getUseBootrom() && emulatorMode != CGB) {
+    if (useBootrom && emulatorMode != CGB) {
         rom.loadBootrom(Config::getInstance()->getBootromPath());
         cpu.PC = 0;
     } else {
         setInitialState();
     }
 
-    // set PC and register values
     setDoubleSpeedMode(false, false);
 
+    // uint numCyclesPerFrame = 70224.0 * 60.0 / 59.73;
+    numCyclesPerFrame = 70224.0 * 59.73 / 60;
+    // uint numCyclesPerFrame = 70224;
+    currentCycles = 0;
+
+    audioBatchCycles = movie.isPlaying() ? movie.audioBatchCycles
+                                         : Config::getInstance()->getAudioBatchCycles();
+
+    return startMovie();
+}
+
+void GameBoy::selectConfiguredFrameLoop()
+{
+    // Skipping loops moves the time their reads happen by up to one iteration
+    cpu.idleLoop.enabled = Config::getInstance()->getIdleLoopSkipping() && !movie.isActive();
+
+    // Movies are recorded and played back with the accurate profile
+    selectFrameLoop(movie.isActive() ? ACCURATE : Config::getInstance()->getAccuracyProfile(),
+                    Config::getInstance()->getRenderThread());
+}
+
+void GameBoy::run()
+{
+    if (!powerOn(false))
+        return;
+
     bool quit = false;
     tp1 = tp2 = std::chrono::high_resolution_clock::now();
     currentCycleTime = 0;
 
     std::cout << "PC: " << std::hex << cpu.PC << "\n";
 
-    // uint numCyclesPerFrame = 70224.0 * 60.0 / 59.73;
-    numCyclesPerFrame = 70224.0 * 59.73 / 60;
-    // uint numCyclesPerFrame = 70224;
-    currentCycles = 0;
-
-    audioBatchCycles = Config::getInstance()->getAudioBatchCycles();
     bool printPerformanceInfo = Config::getInstance()->getPrintPerformanceInfo();
+    int metricsInterval = std::max(Config::getInstance()->getPerformanceInfoInterval(), 1);
+    metricsIntervalStart = std::chrono::high_resolution_clock::now();
+
+    if (Config::getInstance()->getTimelineEnable()) {
+        Timeline::ppuModes = Config::getInstance()->getTimelinePpuModes();
+        Timeline::enable();
+        Timeline::setThreadName("Emulator");
+    }
+
+    // Rewinding would desync a movie
+    if (Config::getInstance()->getRewindEnable() && !movie.isActive()) {
+        rewind.init((size_t)Config::getInstance()->getRewindBufferSize() * 1024 * 1024);
+        rewindFrameInterval = std::max(Config::getInstance()->getRewindFrameInterval(), 1);
+    }
+
+    ProfilerOutput profilerOutput = Config::getInstance()->getProfilerOutput();
+    if (profilerOutput != PROFILER_OFF) {
+        profiler.enabled = true;
+        profiler.init(&rom, profilerOutput == PROFILER_FOLDED);
+
+        fs::path symbolsPath = rom.romFilePath;
+        if (profiler.loadSymbols(symbolsPath.replace_extension(".sym")))
+            std::cout << "Loaded " << profiler.symbols.size() << " symbols\n";
+    }
+
+    TraceMode traceMode = Config::getInstance()->getTraceMode();
+    if (traceMode != TRACE_OFF) {
+        fs::path tracePath = rom.romFilePath;
+        size_t traceBufferSize = (size_t)std::max(Config::getInstance()->getTraceBufferSize(), 1);
+        if (cpu.tracer.init(traceMode, tracePath.replace_extension(".trace"),
+                            traceBufferSize * 1024 * 1024))
+            cpu.tracer.installSignalHandlers();
+    }
+
+    // Movies are always run on the interpreter, since the JIT changes the timing. Blocks run by the
+    // JIT can't be profiled or traced
+    if (Config::getInstance()->getUseJit() && !movie.isActive() && !profiler.enabled &&
+        !cpu.tracer.enabled)
+        useJit = jit.init();
+
+    // The frames run ahead are thrown away, and the profile and the trace would count them as well
+    runAheadFrames = profiler.enabled || cpu.tracer.enabled
+                         ? 0
+                         : std::max(Config::getInstance()->getRunAheadFrames(), 0);
+
+    selectConfiguredFrameLoop();
+
+    batterySaver.start(&rom);
+
+    // The frame rate of the video matches the audio, which is sampled every
+    // AUDIO_CYCLES_UNTIL_SAMPLE_COLLECTION cycles
+    if (!recordVideoPath.empty() || !recordAudioPath.empty()) {
+        if (!recorder.start(recordVideoPath, recordAudioPath,
+                            Config::getInstance()->getRecordFormat(), PPU_SCREEN_WIDTH,
+                            PPU_SCREEN_HEIGHT, AUDIO_FREQUENCY * AUDIO_CYCLES_UNTIL_SAMPLE_COLLECTION,
+                            numCyclesPerFrame, AUDIO_FREQUENCY,
+                            Config::getInstance()->getRecordDirectIo()))
+            return;
+    }
+
+    if (Config::getInstance()->getAudioThread())
+        audioThread.start(&audio);
 
     while (!quit) {
 
         tp1 = std::chrono::high_resolution_clock::now();
 
-        currentCycles = 0;
-        while (currentCycles < numCyclesPerFrame) {
-            if (currentCycles % 1000 == 0) {
-                if ((quit = getInput()) == true) {
-                    break;
-                }
-            }
+        if (movie.isActive() && !updateMovieInput())
+            break;
 
-            joypad.cycle();
+        if ((quit = runFrame()) == true)
+            break;
 
-            // DMA
-            if (ppu.oamDmaActive) {
-                ppu.oamDmaCycle();
-            }
+        {
+            TIMELINE_SCOPE("Save RAM", "IO");
+            batterySaver.update();
+        }
+
+        // The speculative frames and the state load don't change the save
+        bool ramDirty = rom.ramDirty;
+        if (runAheadFrames > 0)
+            runAhead();
 
-            if (emulatorMode == CGB && ppu.vramGeneralDmaActive) {
-                ppu.vramDmaCycle();
+        tp2 = std::chrono::high_resolution_clock::now();
+
+        drawFrame();
+
+        if (runAheadFrames > 0) {
+            loadState(runAheadState);
+            rom.ramDirty = ramDirty;
+        }
+
+        afterDraw = std::chrono::high_resolution_clock::now();
+
+        updateMetrics();
+
+        if (printPerformanceInfo &&
+            getDeltaTime(metricsIntervalStart, afterDraw) >= metricsInterval * 1000.0) {
+            metrics.printSummary("Frame metrics of the last " + std::to_string(metricsInterval) +
+                                     " s:",
+                                 false);
+            metrics.endInterval();
+            metricsIntervalStart = afterDraw;
+        }
+
+        quit = getInput();
+
+        if (cpu.tracer.enabled)
+            cpu.tracer.update();
+
+        if (rewind.isEnabled())
+            updateRewind();
+    }
+
+    if (movie.isRecording())
+        movie.stopRecording();
+
+    audioThread.stop();
+    batterySaver.stop();
+
+    if (recorder.enabled) {
+        recorder.stop();
+        std::cout << std::dec << "Recorded " << recorder.frames.head << " frames ("
+                  << recorder.frames.dropped << " dropped) and " << recorder.audio.head
+                  << " audio chunks (" << recorder.audio.dropped << " dropped)\n";
+    }
+
+    if (cpu.idleLoop.enabled)
+        cpu.idleLoop.printStats(rom.gameTitle);
+
+    cpu.tracer.stop();
+
+    metrics.printSummary("Frame metrics of " + rom.gameTitle + ":", true);
+
+    if (Timeline::enabled) {
+        fs::path timelinePath = rom.romFilePath;
+        Timeline::write(timelinePath.replace_extension(".timeline.json"));
+    }
+
+    if (profiler.enabled) {
+        fs::path profilePath = rom.romFilePath;
+        profiler.write(profilePath.replace_extension(profiler.foldedStacks ? ".folded"
+                                                                           : ".profile.txt"),
+                       rom.gameTitle);
+    }
+}
+
+bool GameBoy::runFrame(bool speculative)
+{
+    TIMELINE_SCOPE(speculative ? "Emulate speculative frame" : "Emulate frame", "Frame");
+    return (this->*runFrameForMode)(speculative);
+}
+
+void GameBoy::benchmark(uint frames)
+{
+    // The runs must not depend on a movie or on a battery save left by an earlier one
+    playMoviePath.clear();
+    recordMoviePath.clear();
+    if (!powerOn(true))
+        return;
+
+    audio.mixSamples = false;
+
+    // Every profile starts from the same state
+    std::vector<uint8_t> startState;
+    saveState(startState);
+
+    const AccuracyProfile profiles[] = {ACCURATE, FAST, FAST};
+    const bool useRenderThread[] = {false, false, true};
+    const char *profileNames[] = {"accurate", "fast", "threaded"};
+
+    for (int i = 0; i < 3; ++i) {
+        selectFrameLoop(profiles[i], useRenderThread[i]);
+        loadState(startState);
+        cpu.illegalOpcode = false;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint frame = 0; frame < frames; ++frame) {
+            runFrame(true);
+
+            // A stuck CPU only measures how fast the error is printed
+            if (cpu.illegalOpcode) {
+                std::cerr << "benchmark() error: the CPU ran into an illegal opcode in frame "
+                          << std::dec << frame << "; use a ROM that runs a program\n";
+                return;
             }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double ms = getDeltaTime(start, end);
+        double fps = ms > 0 ? frames * 1000.0 / ms : 0;
+        printf("%-8s %u frames in %.1f ms: %.1f frames/s, %.2fx real time\n", profileNames[i],
+               frames, ms, fps, fps / 59.73);
+    }
+
+    // Scale the last frame with every filter; sharp bilinear scales it to the height of a
+    // 1080p screen
+    std::vector<uint32_t> pixels(PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT);
+    Upscaler::packColors(&displayBuffer[0][0], pixels.data(), pixels.size());
+
+    for (int filter = SCALE_NONE; filter <= SCALE_SHARP_BILINEAR; ++filter) {
+        Upscaler benchmarkUpscaler;
+        benchmarkUpscaler.init((ScaleFilter)filter, PPU_SCREEN_WIDTH, PPU_SCREEN_HEIGHT, 1200,
+                               1080, Config::getInstance()->getScaleThreads());
+        std::vector<uint32_t> output(benchmarkUpscaler.outWidth * benchmarkUpscaler.outHeight);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint frame = 0; frame < frames; ++frame)
+            benchmarkUpscaler.scale(pixels.data(), output.data(), benchmarkUpscaler.outWidth);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        printf("%-14s %4ux%-4u %u threads: %.3f ms/frame\n",
+               Upscaler::getFilterName((ScaleFilter)filter), benchmarkUpscaler.outWidth,
+               benchmarkUpscaler.outHeight, benchmarkUpscaler.numThreads,
+               getDeltaTime(start, end) / frames);
+    }
+}
+
+bool GameBoy::runHeadless(uint frames, HashStream &hashes)
+{
+    if (!powerOn(true))
+        return false;
+
+    selectConfiguredFrameLoop();
+
+    // The hashes of DMG frames don't depend on the colors picked in the config
+    bool useCustomDMGPalette = Config::getInstance()->getUseCustomDMGPalette();
+    Config::getInstance()->setUseCustomDMGPalette(false);
+
+    audio.queueToSdl = false;
+    audio.hashStream = &hashes;
+
+    if (Config::getInstance()->getAudioThread())
+        audioThread.start(&audio);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint frame;
+    for (frame = 0; frames == 0 || frame < frames; ++frame) {
+        hashes.frame = frame;
+
+        if (movie.isActive() && !updateMovieInput())
+            break;
+
+        // Speculative frames don't poll the keyboard
+        runFrame(true);
+
+        // The audio blocks of the frame are hashed before it
+        if (audio.audioThread != nullptr)
+            audioThread.drain();
+        hashes.addFrame(displayBuffer, sizeof(displayBuffer));
+
+        if (hashes.diverged) {
+            ++frame;
+            break;
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    audioThread.stop();
+    audio.hashStream = nullptr;
+    Config::getInstance()->setUseCustomDMGPalette(useCustomDMGPalette);
+
+    double ms = getDeltaTime(start, end);
+    printf("%u frames in %.1f ms: %.1f frames/s\n", frame, ms, ms > 0 ? frame * 1000.0 / ms : 0);
+    hashes.printResult();
+
+    return !hashes.diverged;
+}
+
+void GameBoy::selectFrameLoop(AccuracyProfile profile, bool useRenderThread)
+{
+    renderThread.stop();
+
+    if (profile == FAST) {
+        runFrameForMode = selectFrameLoop<FastPolicy>();
+
+        // Only the scanline PPU draws whole lines at points the render thread can replay
+        if (useRenderThread)
+            renderThread.start(&ppu);
+    } else {
+        runFrameForMode = selectFrameLoop<AccuratePolicy>();
+    }
+}
+
+template <class Policy> bool (GameBoy::*GameBoy::selectFrameLoop())(bool)
+{
+    if (profiler.enabled)
+        return emulatorMode == CGB ? &GameBoy::runFrame<CGB, ProfilingPolicy<Policy>>
+                                   : &GameBoy::runFrame<DMG, ProfilingPolicy<Policy>>;
 
-            // CPU
-            if ((emulatorMode == EmulatorMode::DMG ||
-                 !(ppu.vramGeneralDmaActive || ppu.vramHblankDmaActive)) &&
-                speedSwitchSleepCycles == 0) {
-                --cpuWaitTCycles;
-                if (cpuWaitTCycles == 0) {
-                    cpu.cycle();
-                    cpuWaitTCycles = 4;
+    return emulatorMode == CGB ? &GameBoy::runFrame<CGB, Policy> : &GameBoy::runFrame<DMG, Policy>;
+}
+
+template <EmulatorMode mode, class Policy> bool GameBoy::runFrame(bool speculative)
+{
+    // T-cycles the timer is behind, with the lazy timer
+    uint32_t timerTCycles = 0;
+    uint8_t audioCycles = std::max(audioBatchCycles, Policy::minAudioBatchCycles);
+
+    currentCycles = 0;
+    while (currentCycles < numCyclesPerFrame) {
+        if (!speculative && currentCycles % 1000 == 0) {
+            if (getInput())
+                return true;
+        }
+
+        joypad.cycle();
+
+        // DMA
+        if (ppu.oamDmaActive) {
+            ppu.oamDmaCycle();
+        }
+
+        if (mode == CGB && ppu.vramGeneralDmaActive) {
+            ppu.vramDmaCycle();
+        }
+
+        // CPU
+        if ((mode == EmulatorMode::DMG ||
+             !(ppu.vramGeneralDmaActive || ppu.vramHblankDmaActive)) &&
+            speedSwitchSleepCycles == 0) {
+            --cpuWaitTCycles;
+            if (cpuWaitTCycles == 0) {
+                if (cpuBlockCycles > 0) {
+                    // The CPU is still busy with the block the JIT or the instruction ran
+                    --cpuBlockCycles;
+                } else {
+                    if constexpr (Policy::lazyTimer) {
+                        timer.advance(timerTCycles);
+                        timerTCycles = 0;
+                    }
+
+                    uint32_t blockCycles = useJit ? jit.run(cpu) : 0;
+                    if (blockCycles == 0) {
+                        if constexpr (Policy::instructionLevelCpu) {
+                            // Run the whole instruction, or interrupt dispatch
+                            do {
+                                if constexpr (Policy::profiler)
+                                    profiler.cycle(cpu);
+                                cpu.cycle();
+                                ++blockCycles;
+                            } while (cpu.instructionCycle != 0 || cpu.int_cycles >= 0);
+                        } else {
+                            if constexpr (Policy::profiler)
+                                profiler.cycle(cpu);
+                            cpu.cycle();
+                        }
+                    }
+
+                    if (blockCycles > 0)
+                        cpuBlockCycles = blockCycles - 1;
                 }
+                cpuWaitTCycles = 4;
             }
+        }
 
-            // Audio
-            if (doubleSpeedMode && currentCycles % (audioBatchCycles * 2) == 0) {
-                audio.cycle(audioBatchCycles);
-            } else if (currentCycles % audioBatchCycles == 0) {
-                audio.cycle(audioBatchCycles);
-            }
+        // Audio
+        if (doubleSpeedMode && currentCycles % (audioCycles * 2) == 0) {
+            audio.cycle(audioCycles);
+        } else if (currentCycles % audioCycles == 0) {
+            audio.cycle(audioCycles);
+        }
 
-            // PPU
-            if (ppu.getLcdDisplayEnable()) {
-                ppu.cycle();
-            }
+        // PPU
+        if (ppu.getLcdDisplayEnable()) {
+            ppu.cycle<mode, Policy::scanlinePpu>();
+        }
 
-            // Timer
+        // Timer
+        if constexpr (Policy::lazyTimer)
+            ++timerTCycles;
+        else
             timer.cycle();
 
-            if (ppu.readyToDraw) {
-                savePpuBuffer();
-                ppu.readyToDraw = false;
-                // doCycles = false;
-                // break;
-            }
+        if (ppu.readyToDraw) {
+            savePpuBuffer();
+            ppu.readyToDraw = false;
+            // doCycles = false;
+            // break;
+        }
 
-            // ROM RTC Timer
-            if (rom.mbc == MBC::MBC3 && rom.cartridgeTimer) {
-                if (doubleSpeedMode && currentCycles % (ROM_RTC_T_CYCLES_UNTIL_TICK * 2) == 0) {
-                    rom.cycleRtc();
-                } else if (!doubleSpeedMode && currentCycles % ROM_RTC_T_CYCLES_UNTIL_TICK == 0) {
-                    rom.cycleRtc();
-                }
+        // ROM RTC Timer
+        if (rom.mbc == MBC::MBC3 && rom.cartridgeTimer) {
+            if (doubleSpeedMode && currentCycles % (ROM_RTC_T_CYCLES_UNTIL_TICK * 2) == 0) {
+                rom.cycleRtc();
+            } else if (!doubleSpeedMode && currentCycles % ROM_RTC_T_CYCLES_UNTIL_TICK == 0) {
+                rom.cycleRtc();
             }
+        }
+
+        if (speedSwitchSleepCycles > 0)
+            --speedSwitchSleepCycles;
+
+        ++currentCycles;
+    }
+
+    if constexpr (Policy::lazyTimer)
+        timer.advance(timerTCycles);
+
+    // The last lines of the frame may still be being drawn
+    if (Policy::scanlinePpu && ppu.renderThread != nullptr)
+        renderThread.collectFrame(&displayBuffer[0][0]);
+
+    if (audio.audioThread != nullptr)
+        audioThread.flushCycles();
+
+    return false;
+}
+
+/**
+ *  Run-ahead hides the input lag of the game: after the real frame, the state is saved and
+ *  runAheadFrames more frames are emulated with the same input. The last of them is the one that
+ *  gets drawn, then the saved state is restored. Audio is only mixed during the real frame.
+ */
+void GameBoy::runAhead()
+{
+    TIMELINE_SCOPE("Run ahead", "Frame");
+    saveState(runAheadState);
+
+    audio.mixSamples = false;
+    for (uint i = 0; i < runAheadFrames; ++i)
+        runFrame(true);
+    audio.mixSamples = true;
+}
+
+void GameBoy::updateRewind()
+{
+    TIMELINE_SCOPE("Rewind", "State");
+
+    // Holding R steps back one snapshot per frame; otherwise take a snapshot every
+    // rewindFrameInterval frames
+    if (keyboardState[SDL_SCANCODE_R]) {
+        if (rewind.rewind(stateBuffer))
+            loadState(stateBuffer);
 
-            if (speedSwitchSleepCycles > 0)
-                --speedSwitchSleepCycles;
+        framesSinceSnapshot = 0;
+        return;
+    }
+
+    if (++framesSinceSnapshot >= rewindFrameInterval) {
+        framesSinceSnapshot = 0;
+        saveState(stateBuffer);
+        rewind.push(stateBuffer);
+    }
+}
 
-            ++currentCycles;
+bool GameBoy::prepareMovie()
+{
+    if (!playMoviePath.empty()) {
+        if (!movie.load(playMoviePath))
+            return false;
+
+        if (movie.emulatorMode != emulatorMode) {
+            std::cerr << "ERROR: Movie was recorded in "
+                      << (movie.emulatorMode == CGB ? "CGB" : "DMG") << " mode\n";
+            return false;
         }
 
-        tp2 = std::chrono::high_resolution_clock::now();
+        // The battery RAM comes from the movie's start state, if it has one
+        rom.useSaveFile = false;
+        rom.useFixedTime = true;
+        rom.fixedTime = movie.rtcSeed;
+    } else if (!recordMoviePath.empty()) {
+        movie.rtcSeed = time(NULL);
 
-        rom.saveRam();
-        drawFrame();
+        rom.useSaveFile = recordMovieFromSave;
+        rom.useFixedTime = true;
+        rom.fixedTime = movie.rtcSeed;
+    }
 
-        afterDraw = std::chrono::high_resolution_clock::now();
+    return true;
+}
 
-        if (printPerformanceInfo) {
-            std::cout << std::dec << "Time to do " << (uint)currentCycles
-                      << " cycles: " << getDeltaTime(tp1, tp2)
-                      << "; time to wait/draw frame: " << getDeltaTime(tp2, afterDraw)
-                      << "; refresh rate: " << (uint)refreshRate << "\n";
+bool GameBoy::startMovie()
+{
+    if (movie.isPlaying()) {
+        if (movie.romChecksum != rom.globalChecksum) {
+            std::cerr << "ERROR: Movie was recorded with a different ROM\n";
+            return false;
         }
 
-        quit = getInput();
+        if (!movie.startState.empty() && !loadState(movie.startState))
+            return false;
+
+        std::cout << "Playing back " << std::dec << movie.frames.size() << " frames from "
+                  << movie.path << "\n";
+    } else if (!recordMoviePath.empty()) {
+        movie.emulatorMode = emulatorMode;
+        movie.romChecksum = rom.globalChecksum;
+        movie.audioBatchCycles = audioBatchCycles;
+        movie.useBootrom = Config::getInstance()->getUseBootrom() && emulatorMode != CGB;
+
+        movie.startState.clear();
+        if (recordMovieFromSave)
+            saveState(movie.startState);
+
+        movie.startRecording(recordMoviePath);
+    }
+
+    return true;
+}
+
+bool GameBoy::updateMovieInput()
+{
+    if (movie.isRecording()) {
+        readKeyboard();
+        movie.recordFrame(Movie::packKeys(joypad.keyState));
+        return true;
+    }
+
+    uint8_t keys;
+    if (!movie.nextFrame(keys)) {
+        std::cout << "Movie playback finished after " << std::dec << movie.currentFrame
+                  << " frames\n";
+        return false;
+    }
+
+    Movie::unpackKeys(keys, joypad.keyState);
+    return true;
+}
+
+void GameBoy::saveState(std::vector<uint8_t> &state)
+{
+    StateSerializer serializer(state, StateSerializer::SAVE);
+
+    // The window line counter and the sprites of the line are only up to date on the render
+    // thread
+    if (ppu.renderThread != nullptr) {
+        renderThread.drain();
+        renderThread.syncToSource();
+    }
+
+    // So are the duty, wave, noise and envelope state of the channels on the audio thread
+    if (audio.audioThread != nullptr) {
+        audioThread.drain();
+        audioThread.syncToSource();
+    }
+
+    serializer.value(doubleSpeedMode);
+    serializer.value(speedSwitchSleepCycles);
+    serializer.value(cpuWaitTCycles);
+    serializer.value(cpuBlockCycles);
+    serializer.value(currentCycles);
+
+    cpu.serialize(serializer);
+    memory.serialize(serializer);
+    rom.serialize(serializer);
+    ppu.serialize(serializer);
+    timer.serialize(serializer);
+    joypad.serialize(serializer);
+    audio.serialize(serializer);
+}
+
+bool GameBoy::loadState(std::vector<uint8_t> &state)
+{
+    StateSerializer serializer(state, StateSerializer::LOAD);
+
+    bool doubleSpeed = doubleSpeedMode;
+    serializer.value(doubleSpeed);
+    serializer.value(speedSwitchSleepCycles);
+    serializer.value(cpuWaitTCycles);
+    serializer.value(cpuBlockCycles);
+    serializer.value(currentCycles);
+
+    cpu.serialize(serializer);
+    memory.serialize(serializer);
+    rom.serialize(serializer);
+    ppu.serialize(serializer);
+    timer.serialize(serializer);
+    joypad.serialize(serializer);
+    audio.serialize(serializer);
+
+    if (ppu.renderThread != nullptr) {
+        renderThread.drain();
+        renderThread.syncFromSource();
+    }
+
+    if (audio.audioThread != nullptr) {
+        audioThread.drain();
+        audioThread.syncFromSource();
+    }
+
+    if (!serializer.isValid()) {
+        std::cerr << "loadState() error: state is truncated\n";
+        return false;
+    }
+
+    // restore the clock duration as well, without the speed switch pause
+    setDoubleSpeedMode(doubleSpeed, false);
+
+    return true;
+}
+
+void GameBoy::updateMetrics()
+{
+    using namespace std::chrono;
+
+    metrics.record(METRIC_EMULATION_TIME, duration_cast<microseconds>(tp2 - tp1).count());
+    metrics.record(METRIC_PRESENT_TIME, duration_cast<microseconds>(afterDraw - tp2).count());
+    metrics.record(METRIC_AUDIO_QUEUED, audio.getQueuedMicroseconds());
+
+    if (inputChangePending) {
+        metrics.record(METRIC_INPUT_LATENCY,
+                       duration_cast<microseconds>(afterDraw - inputChangeTime).count());
+        inputChangePending = false;
     }
 }
 
 void GameBoy::savePpuBuffer()
 {
+    // The render thread copies the frame when it gets to its end; runFrame collects it
+    if (ppu.renderThread != nullptr) {
+        renderThread.endFrame();
+        return;
+    }
+
     memcpy(displayBuffer, ppu.display, PPU_SCREEN_HEIGHT * PPU_SCREEN_WIDTH * sizeof(Color));
 }
 
 void GameBoy::drawFrame()
 {
-    SDL_RenderClear(sdlRenderer);
-
-    // update texture
-    void *texturePixels;
-    int texturePitch; // pitch is length of row in bytes
-    SDL_LockTexture(sdlTexture, NULL, &texturePixels, &texturePitch);
+    TIMELINE_SCOPE("Present", "Video");
 
-    uint8_t pixelSize = texturePitch / PPU_SCREEN_WIDTH;
-
-    if (sdlTexturePixels == nullptr)
-        sdlTexturePixels = new uint8_t[texturePitch * PPU_SCREEN_HEIGHT];
+    SDL_RenderClear(sdlRenderer);
 
-    // Put the pixels from the PPU in sdlTexturePixels
-    for (int i = 0; i < PPU_SCREEN_HEIGHT; ++i) {
-        for (int j = 0; j < PPU_SCREEN_WIDTH; ++j) {
-            Color &ppuPixel = displayBuffer[i][j];
+    framePixels.resize(PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT);
+    Upscaler::packColors(&displayBuffer[0][0], framePixels.data(), framePixels.size());
 
-            uint32_t rgbPixel =
-                SDL_MapRGB(sdlPixelFormat, ppuPixel.red, ppuPixel.green, ppuPixel.blue);
+    if (recorder.enabled)
+        recorder.pushFrame(framePixels.data());
 
-            memcpy(sdlTexturePixels + i * texturePitch + j * pixelSize, &rgbPixel,
-                   sizeof(uint32_t));
+    // update texture
+    if (upscaler.filter == SCALE_NONE) {
+        SDL_UpdateTexture(sdlTexture, NULL, framePixels.data(),
+                          PPU_SCREEN_WIDTH * sizeof(uint32_t));
+    } else {
+        // The frame handed to the scaler by the last call is shown, and this one is scaled while
+        // the next frame is emulated
+        {
+            TIMELINE_SCOPE("Wait for scaler", "Video");
+            upscaler.wait();
         }
-    }
 
-    // Copy sdlTexturePixels to texture pixels (the pointer from SDL_LockTexture)
-    memcpy(texturePixels, sdlTexturePixels, texturePitch * PPU_SCREEN_HEIGHT * sizeof(uint8_t));
+        if (scaledFrameReady)
+            SDL_UpdateTexture(sdlTexture, NULL, scaledPixels.data(),
+                              upscaler.outWidth * sizeof(uint32_t));
 
-    SDL_UnlockTexture(sdlTexture);
+        upscaler.start(framePixels.data(), scaledPixels.data(), upscaler.outWidth);
+        scaledFrameReady = true;
+    }
 
     SDL_RenderCopy(sdlRenderer, sdlTexture, NULL, NULL);
+
+    // Waits for vsync
+    TIMELINE_SCOPE("Render present", "Video");
     SDL_RenderPresent(sdlRenderer);
 }
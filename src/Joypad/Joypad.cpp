@@ -1,6 +1,7 @@
 #include "Joypad.hpp"
 #include "Memory.hpp"
 #include "SM83.hpp"
+#include "StateSerializer.hpp"
 
 Joypad::Joypad()
 {
@@ -24,7 +25,7 @@ void Joypad::cycle()
         if (directionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xFE;
@@ -43,7 +44,7 @@ void Joypad::cycle()
         if (directionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xFD;
@@ -62,7 +63,7 @@ void Joypad::cycle()
         if (directionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xFB;
@@ -81,7 +82,7 @@ void Joypad::cycle()
         if (directionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xF7;
@@ -105,7 +106,7 @@ void Joypad::cycle()
         if (actionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xFE;
@@ -125,7 +126,7 @@ void Joypad::cycle()
         if (actionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xFD;
@@ -145,7 +146,7 @@ void Joypad::cycle()
         if (actionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xFB;
@@ -165,7 +166,7 @@ void Joypad::cycle()
         if (actionButtonsEnabled) {
             // button pressed and enabled
             if (buttonState == 1) {
-                cpu->setJoypadInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_JOYPAD);
             }
 
             joypadRegister = joypadRegister & 0xF7;
@@ -182,3 +183,5 @@ void Joypad::cycle()
     // Write joypad register
     memory->writemem(joypadRegister, 0xFF00, true, true);
 }
+
+void Joypad::serialize(StateSerializer &state) { state.bytes(keyState, sizeof(keyState)); }
@@ -0,0 +1,115 @@
+#include "BatterySaver.hpp"
+#include "ROM.hpp"
+
+BatterySaver::BatterySaver()
+{
+    rom = nullptr;
+    enabled = false;
+    unsaved = false;
+    quietFrames = 0;
+    unsavedFrames = 0;
+    savesWritten = 0;
+    pending = false;
+    stopRequested = false;
+}
+
+BatterySaver::~BatterySaver() { stop(); }
+
+void BatterySaver::start(ROM *rom)
+{
+    stop();
+
+    this->rom = rom;
+    unsaved = false;
+    quietFrames = 0;
+    unsavedFrames = 0;
+    pending = false;
+    stopRequested = false;
+
+    enabled = rom->batterySave;
+    if (!enabled)
+        return;
+
+    rom->ramDirty = false;
+    writerThread = std::thread(&BatterySaver::writerLoop, this);
+}
+
+void BatterySaver::update()
+{
+    if (!enabled)
+        return;
+
+    if (rom->ramDirty) {
+        rom->ramDirty = false;
+        quietFrames = 0;
+        unsaved = true;
+    } else if (unsaved) {
+        ++quietFrames;
+    }
+
+    if (!unsaved)
+        return;
+
+    if (quietFrames >= BATTERY_SAVE_QUIET_FRAMES || ++unsavedFrames >= BATTERY_SAVE_MAX_DELAY_FRAMES)
+        queueSave();
+}
+
+void BatterySaver::stop()
+{
+    if (!writerThread.joinable())
+        return;
+
+    // The RTC keeps counting while the emulator is closed, so its save holds the time it stopped at
+    if (unsaved || rom->ramDirty || rom->cartridgeTimer) {
+        rom->ramDirty = false;
+        queueSave();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    condition.notify_one();
+    writerThread.join();
+
+    enabled = false;
+}
+
+/**
+ *  Copies the save data for the writer thread; a save it has not started yet is replaced
+ */
+void BatterySaver::queueSave()
+{
+    unsaved = false;
+    quietFrames = 0;
+    unsavedFrames = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rom->getSaveData(pendingData);
+        pending = true;
+    }
+    condition.notify_one();
+}
+
+void BatterySaver::writerLoop()
+{
+    std::vector<uint8_t> data;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        condition.wait(lock, [this] { return pending || stopRequested; });
+
+        if (pending) {
+            data.swap(pendingData);
+            pending = false;
+
+            lock.unlock();
+            if (ROM::writeSaveFile(rom->saveFilePath, data))
+                ++savesWritten;
+            lock.lock();
+        } else if (stopRequested) {
+            break;
+        }
+    }
+}
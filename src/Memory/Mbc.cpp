@@ -0,0 +1,285 @@
+#include "Mbc.hpp"
+#include "ROM.hpp"
+
+Mbc::Mbc(ROM *rom) { this->rom = rom; }
+
+Mbc::~Mbc() {}
+
+std::unique_ptr<Mbc> Mbc::create(ROM *rom)
+{
+    switch (rom->mbc) {
+    case MBC::None:
+        return std::make_unique<NoMbc>(rom);
+    case MBC::MBC1:
+        return std::make_unique<Mbc1>(rom);
+    case MBC::MBC2:
+        return std::make_unique<Mbc2>(rom);
+    case MBC::MBC3:
+        return std::make_unique<Mbc3>(rom);
+    case MBC::MBC5:
+        return std::make_unique<Mbc5>(rom);
+    default:
+        return std::make_unique<Mbc>(rom);
+    }
+}
+
+void Mbc::writeRegister(uint8_t, uint16_t) {}
+
+void Mbc::mapBanks()
+{
+    rom->unmapRomBank(0);
+    rom->unmapRomBank(1);
+    rom->unmapRamBank();
+}
+
+uint8_t Mbc::readRam(uint16_t) { return 0xFF; }
+
+void Mbc::writeRam(uint8_t, uint16_t) {}
+
+/* NO MBC */
+
+void NoMbc::writeRegister(uint8_t val, uint16_t addr)
+{
+    // Set RAM enable
+    if (addr < 0x2000) {
+        rom->ramEnable = (val & 0x0F) == 0x0A;
+    }
+}
+
+void NoMbc::mapBanks()
+{
+    rom->mapRomBank(0, 0);
+    rom->mapRomBank(1, 1);
+    rom->mapRamBank(0);
+}
+
+/* MBC1 */
+
+void Mbc1::writeRegister(uint8_t val, uint16_t addr)
+{
+    // RAM Enable
+    if (addr < 0x2000) {
+        rom->ramEnable = (val & 0x0F) == 0x0A;
+    }
+
+    // ROM Bank Number
+    if (addr >= 0x2000 && addr < 0x4000) {
+        rom->currentROMBank = val & 0x1F;
+        if (rom->currentROMBank == 0x00)
+            rom->currentROMBank = 0x01;
+    }
+
+    // RAM Bank or Secondary ROM Bank
+    if (addr >= 0x4000 && addr < 0x6000) {
+        rom->currentRAMBank = val & 0x3;
+    }
+
+    // Bank Mode
+    if (addr >= 0x6000 && addr < 0x8000) {
+        rom->bankMode = val & 1;
+    }
+}
+
+void Mbc1::mapBanks()
+{
+    // ROM bank 0x00/0x20/0x40/0x60
+    if (rom->bankMode == 0) {
+        // Bank 0x00
+        rom->mapRomBank(0, 0);
+    } else {
+        // Bank 0x20/0x40/0x60
+        // depending on bank size, not all bits are used
+        uint8_t mask;
+        if (rom->romBanks > 96) {
+            mask = 0x60;
+        } else if (rom->romBanks > 64 && rom->romBanks <= 96) {
+            mask = 0x40;
+        } else if (rom->romBanks > 32 && rom->romBanks <= 64) {
+            mask = 0x20;
+        } else {
+            mask = 0;
+        }
+
+        rom->mapRomBank(0, (rom->currentRAMBank << 5) & mask);
+    }
+
+    // Switchable ROM Bank
+    uint8_t romMask = rom->romBanks - 1;
+    rom->mapRomBank(1, (uint8_t)(((rom->currentRAMBank << 5) | rom->currentROMBank) & romMask));
+
+    // RAM
+    if (rom->bankMode == 0) {
+        // ROM Bank Mode
+        rom->mapRamBank(0);
+    } else {
+        // RAM Bank Mode
+        uint8_t ramMask = rom->ramBanks - 1;
+        rom->mapRamBank(rom->currentRAMBank & ramMask);
+    }
+}
+
+/* MBC2 */
+
+void Mbc2::writeRegister(uint8_t val, uint16_t addr)
+{
+    // RAM Enable
+    if (addr < 0x4000 && (addr & 0x100) == 0) {
+        rom->ramEnable = (val & 0xF) == 0xA;
+    }
+
+    // ROM Bank
+    if (addr < 0x4000 && (addr & 0x100) == 0x100) {
+        rom->currentROMBank = val /*& 0xF*/;
+        if ((rom->currentROMBank & 0xF) == 0)
+            rom->currentROMBank = 1;
+    }
+}
+
+void Mbc2::mapBanks()
+{
+    uint8_t mask = rom->romBanks - 1;
+    rom->mapRomBank(0, 0);
+    rom->mapRomBank(1, rom->currentROMBank & mask);
+    rom->unmapRamBank();
+}
+
+uint8_t Mbc2::readRam(uint16_t addr)
+{
+    addr = (addr - 0xA000) & 0x1FF;
+    return ((rom->ram[addr] & 0x0F) | 0xF0);
+}
+
+void Mbc2::writeRam(uint8_t val, uint16_t addr)
+{
+    addr = (addr - 0xA000) & 0x1FF;
+    rom->writeRam(addr, val & 0xF);
+}
+
+/* MBC3 */
+
+void Mbc3::writeRegister(uint8_t val, uint16_t addr)
+{
+    // RAM / Timer Enable
+    if (addr < 0x2000) {
+        rom->ramEnable = (val & 0x0A) == 0x0A;
+    }
+
+    // ROM Bank Number
+    if (addr >= 0x2000 && addr < 0x4000) {
+        rom->currentROMBank = val;
+        if (rom->currentROMBank == 0)
+            rom->currentROMBank = 1;
+    }
+
+    // RAM Bank Number / RTC Register Select
+    if (addr >= 0x4000 && addr < 0x6000) {
+        rom->currentRAMBank = val;
+    }
+
+    // Latch Clock Data
+    if (addr >= 0x6000 && addr < 0x8000) {
+        if (val == 0x01 && rom->rtcLatchClockLastWritten == 0x00) {
+            // Toggle Latch
+            rom->rtcLatch = !rom->rtcLatch;
+
+            if (rom->rtcLatch == false) {
+                // Latch reset
+                rom->incrementRtc(rom->rtcLatchedSeconds);
+                rom->rtcLatchedSeconds = 0;
+            } else if (rom->rtcLatch) {
+                // Latch set
+                rom->rtcLatchedSeconds = 0;
+            }
+        }
+        rom->rtcLatchClockLastWritten = val;
+    }
+}
+
+void Mbc3::mapBanks()
+{
+    rom->mapRomBank(0, 0);
+    rom->mapRomBank(1, rom->currentROMBank);
+
+    if (rom->currentRAMBank < 0x4)
+        rom->mapRamBank(rom->currentRAMBank);
+    else
+        rom->unmapRamBank();
+}
+
+uint8_t Mbc3::readRam(uint16_t addr)
+{
+    switch (rom->currentRAMBank) {
+    case 0x08:
+        return rom->rtcS;
+    case 0x09:
+        return rom->rtcM;
+    case 0x0A:
+        return rom->rtcH;
+    case 0x0B:
+        return rom->rtcDL;
+    case 0x0C:
+        return rom->rtcDH;
+    }
+
+    // Invalid address
+    fprintf(stderr, "WARNING: Trying to read from invalid ROM address: 0x%04X\n", addr);
+    return 0xFF;
+}
+
+void Mbc3::writeRam(uint8_t val, uint16_t)
+{
+    switch (rom->currentRAMBank) {
+    case 0x08:
+        rom->rtcS = val;
+        break;
+    case 0x09:
+        rom->rtcM = val;
+        break;
+    case 0x0A:
+        rom->rtcH = val;
+        break;
+    case 0x0B:
+        rom->rtcDL = val;
+        break;
+    case 0x0C:
+        rom->rtcDH = val;
+        break;
+    default:
+        return;
+    }
+
+    rom->ramDirty = true;
+}
+
+/* MBC5 */
+
+void Mbc5::writeRegister(uint8_t val, uint16_t addr)
+{
+    // RAM Enable
+    if (addr < 0x2000) {
+        rom->ramEnable = (val & 0xFF) == 0x0A;
+    }
+
+    // Low 8 bits of ROM Bank number
+    if (addr >= 0x2000 && addr < 0x3000) {
+        rom->currentROMBank = (rom->currentROMBank & 0x0100) | val;
+    }
+
+    // High bit (bit 9) of ROM Bank number
+    if (addr >= 0x3000 && addr < 0x4000) {
+        rom->currentROMBank = ((val & 0x1) << 8) | (rom->currentROMBank & 0xFF);
+    }
+
+    // RAM Bank Number
+    if (addr >= 0x4000 && addr < 0x6000) {
+        rom->currentRAMBank = val & 0xF;
+    }
+}
+
+void Mbc5::mapBanks()
+{
+    // romBanks doesn't fit the 512 banks of the largest ROMs; mapRomBank wraps the bank instead
+    rom->mapRomBank(0, 0);
+    rom->mapRomBank(1, rom->currentROMBank);
+    rom->mapRamBank(rom->currentRAMBank);
+}
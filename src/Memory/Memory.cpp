@@ -1,7 +1,10 @@
 #include "Memory.hpp"
 #include "Audio.hpp"
+#include "AudioThread.hpp"
 #include "GameBoy.hpp"
 #include "PPU.hpp"
+#include "RenderThread.hpp"
+#include "StateSerializer.hpp"
 #include "Timer.hpp"
 
 Memory::Memory(EmulatorMode mode)
@@ -12,8 +15,10 @@ Memory::Memory(EmulatorMode mode)
     setCurrentVramBank(0);
     setCurrentWramBank(1);
 
-    for (int i = 0; i < 0x40; ++i)
+    for (int i = 0; i < 0x40; ++i) {
         cgbBgColorPalette[i] = 255;
+        cgbObjColorPalette[i] = 255;
+    }
 
     // Zero-out memory
     memset(vram, 0, 2 * 0x2000);
@@ -22,6 +27,7 @@ Memory::Memory(EmulatorMode mode)
     memset(ioRegisters, 0, 0x80);
     memset(hram, 0, 0x7F);
     ieRegister = 0;
+    updateInterrupts();
 }
 
 uint8_t Memory::readmem(uint16_t addr, bool bypass, bool bypassOamDma)
@@ -245,6 +251,9 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
             currentVramBank = getCurrentVramBank();
             uint16_t actualAddr = (addr - MEM_VRAM_START) + currentVramBank * 0x2000;
             vram[actualAddr] = val;
+
+            if (ppu->renderThread != nullptr)
+                ppu->renderThread->log(RENDER_LOG_VRAM, actualAddr, val);
         }
     }
 
@@ -284,8 +293,12 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
         if (!ppu->oamDmaActive || (bypass && bypassOamDma)) {
             LcdMode lcdMode = (LcdMode)getLcdMode();
             if ((lcdMode != OAM_SEARCH || (bypass && bypassOamDma)) &&
-                (lcdMode != DRAW || (bypass && bypassOamDma)))
+                (lcdMode != DRAW || (bypass && bypassOamDma))) {
                 oam[addr - MEM_OAM_START] = val;
+
+                if (ppu->renderThread != nullptr)
+                    ppu->renderThread->log(RENDER_LOG_OAM, addr - MEM_OAM_START, val);
+            }
         }
     }
 
@@ -355,110 +368,12 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
                 return;
             }
 
-            if (addr >= 0xFF10 && addr <= 0xFF26) {
-                // Audio Registers
-
-                // NR52
-                if (addr == 0xFF26) {
-                    if (bypass) {
-                        ioRegisters[addr - MEM_IO_START] = val & 0x8F;
-                    } else {
-                        ioRegisters[addr - MEM_IO_START] = val & 0x80;
-                    }
-
-                    if ((ioRegisters[addr - MEM_IO_START] & 0x80) == 0) {
-                        // Reset all channel registers
-                        for (uint i = 0xFF10; i <= 0xFF23; ++i) {
-                            ioRegisters[i - MEM_IO_START] = 0;
-                        }
-                    }
-
-                    return;
-                }
-
-                if (audio->getAllSoundOn() == 0 && !bypass) {
-                    // can't set sound registers if all sound is off
-                    return;
-                }
-
-                // NR10
-                if (addr == 0xFF10) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0x7F;
-                    return;
-                }
-
-                // NR11
-                if (addr == 0xFF11) {
-                    ioRegisters[addr - MEM_IO_START] = val;
-                    audio->channel1.updateSoundLengthCycles(val & 0x3F);
-                }
-
-                // NR14
-                if (addr == 0xFF14) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0xC7;
-                    if ((val & 0x80) != 0) {
-                        audio->channel1.initCh();
-                    }
-
-                    return;
-                }
-
-                // NR21
-                if (addr == 0xFF16) {
-                    ioRegisters[addr - MEM_IO_START] = val;
-                    audio->channel2.updateSoundLengthCycles(val & 0x3F);
-                }
+            // The audio thread replays the writes of the CPU to the audio registers and the wave RAM
+            if (addr >= 0xFF10 && addr <= 0xFF3F && !bypass && audio->audioThread != nullptr)
+                audio->audioThread->logWrite(addr, val);
 
-                // NR24
-                if (addr == 0xFF19) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0xC7;
-                    if ((val & 0x80) != 0) {
-                        audio->channel2.initCh();
-                    }
-
-                    return;
-                }
-
-                // NR30
-                if (addr == 0xFF1A) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0x80;
-                    return;
-                }
-
-                // NR32
-                if (addr == 0xFF1C) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0x60;
-                    return;
-                }
-
-                // NR34
-                if (addr == 0xFF1E) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0xC7;
-                    if ((val & 0x80) != 0) {
-                        audio->channel3.initCh();
-                    }
-
-                    return;
-                }
-
-                // NR41
-                if (addr == 0xFF20) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0x3F;
-                    audio->channel4.updateSoundLengthCycles(val & 0x3F);
-                    return;
-                }
-
-                // NR44
-                if (addr == 0xFF23) {
-                    ioRegisters[addr - MEM_IO_START] = val & 0xC0;
-                    if ((val & 0x80) != 0) {
-                        audio->channel4.initCh();
-                    }
-
-                    return;
-                }
-
-                ioRegisters[addr - MEM_IO_START] = val;
+            if (addr >= 0xFF10 && addr <= 0xFF26) {
+                writeAudioRegister(val, addr, bypass);
                 return;
             }
 
@@ -540,6 +455,8 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
                     if (lcdMode != DRAW || bypass) {
                         uint8_t index = ppu->getBgColorPaletteIndex();
                         cgbBgColorPalette[index & 0x3F] = val;
+                        if (ppu->renderThread != nullptr)
+                            ppu->renderThread->log(RENDER_LOG_BG_PALETTE, index & 0x3F, val);
                         // AutoIncrement
                         if (index & 0x80)
                             ppu->setBgColorPaletteIndex(0x80 | (((index & 0x3F) + 1) & 0x3F));
@@ -553,6 +470,8 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
                     if (lcdMode != DRAW || bypass) {
                         uint8_t index = ppu->getObjColorPaletteIndex();
                         cgbObjColorPalette[index & 0x3F] = val;
+                        if (ppu->renderThread != nullptr)
+                            ppu->renderThread->log(RENDER_LOG_OBJ_PALETTE, index & 0x3F, val);
                         // AutoIncrement
                         if (index & 0x80)
                             ppu->setObjColorPaletteIndex(0x80 | (((index & 0x3F) + 1) & 0x3F));
@@ -563,6 +482,12 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
             }
 
             ioRegisters[addr - MEM_IO_START] = val;
+
+            if (addr == 0xFF0F)
+                updateInterrupts();
+
+            if (ppu->renderThread != nullptr && RenderThread::isLoggedRegister(addr))
+                ppu->renderThread->log(RENDER_LOG_IO, addr - MEM_IO_START, val);
         }
     }
 
@@ -571,9 +496,117 @@ void Memory::writemem(uint8_t val, uint16_t addr, bool bypass, bool bypassOamDma
         hram[addr - MEM_HRAM_START] = val;
 
     // IE Register
-    if (addr == MEM_IE_REG)
-        if (!ppu->oamDmaActive || bypass)
+    if (addr == MEM_IE_REG) {
+        if (!ppu->oamDmaActive || bypass) {
             ieRegister = val;
+            updateInterrupts();
+        }
+    }
+}
+
+void Memory::writeAudioRegister(uint8_t val, uint16_t addr, bool bypass)
+{
+    // NR52
+    if (addr == 0xFF26) {
+        if (bypass) {
+            ioRegisters[addr - MEM_IO_START] = val & 0x8F;
+        } else {
+            ioRegisters[addr - MEM_IO_START] = val & 0x80;
+        }
+
+        if ((ioRegisters[addr - MEM_IO_START] & 0x80) == 0) {
+            // Reset all channel registers
+            for (uint i = 0xFF10; i <= 0xFF23; ++i) {
+                ioRegisters[i - MEM_IO_START] = 0;
+            }
+        }
+
+        return;
+    }
+
+    if (audio->getAllSoundOn() == 0 && !bypass) {
+        // can't set sound registers if all sound is off
+        return;
+    }
+
+    // NR10
+    if (addr == 0xFF10) {
+        ioRegisters[addr - MEM_IO_START] = val & 0x7F;
+        return;
+    }
+
+    // NR11
+    if (addr == 0xFF11) {
+        ioRegisters[addr - MEM_IO_START] = val;
+        audio->channel1.updateSoundLengthCycles(val & 0x3F);
+    }
+
+    // NR14
+    if (addr == 0xFF14) {
+        ioRegisters[addr - MEM_IO_START] = val & 0xC7;
+        if ((val & 0x80) != 0) {
+            audio->channel1.initCh();
+        }
+
+        return;
+    }
+
+    // NR21
+    if (addr == 0xFF16) {
+        ioRegisters[addr - MEM_IO_START] = val;
+        audio->channel2.updateSoundLengthCycles(val & 0x3F);
+    }
+
+    // NR24
+    if (addr == 0xFF19) {
+        ioRegisters[addr - MEM_IO_START] = val & 0xC7;
+        if ((val & 0x80) != 0) {
+            audio->channel2.initCh();
+        }
+
+        return;
+    }
+
+    // NR30
+    if (addr == 0xFF1A) {
+        ioRegisters[addr - MEM_IO_START] = val & 0x80;
+        return;
+    }
+
+    // NR32
+    if (addr == 0xFF1C) {
+        ioRegisters[addr - MEM_IO_START] = val & 0x60;
+        return;
+    }
+
+    // NR34
+    if (addr == 0xFF1E) {
+        ioRegisters[addr - MEM_IO_START] = val & 0xC7;
+        if ((val & 0x80) != 0) {
+            audio->channel3.initCh();
+        }
+
+        return;
+    }
+
+    // NR41
+    if (addr == 0xFF20) {
+        ioRegisters[addr - MEM_IO_START] = val & 0x3F;
+        audio->channel4.updateSoundLengthCycles(val & 0x3F);
+        return;
+    }
+
+    // NR44
+    if (addr == 0xFF23) {
+        ioRegisters[addr - MEM_IO_START] = val & 0xC0;
+        if ((val & 0x80) != 0) {
+            audio->channel4.initCh();
+        }
+
+        return;
+    }
+
+    ioRegisters[addr - MEM_IO_START] = val;
 }
 
 void Memory::writebit(uint8_t val, uint8_t bit, uint16_t addr, bool bypass, bool bypassOamDma)
@@ -605,3 +638,38 @@ void Memory::setCurrentVramBank(uint8_t val) { ioRegisters[0xFF4F - MEM_IO_START
 void Memory::setCurrentWramBank(uint8_t val) { ioRegisters[0xFF70 - MEM_IO_START] = val & 0x3; }
 
 uint8_t Memory::getLcdMode() { return (ioRegisters[0xFF41 - MEM_IO_START] & 0x2); }
+
+void Memory::updateInterrupts()
+{
+    interrupts.update(ieRegister, ioRegisters[0xFF0F - MEM_IO_START]);
+}
+
+void Memory::requestInterrupt(uint8_t interrupt)
+{
+    ioRegisters[0xFF0F - MEM_IO_START] |= interrupt;
+    updateInterrupts();
+}
+
+void Memory::acknowledgeInterrupt(uint8_t interrupt)
+{
+    ioRegisters[0xFF0F - MEM_IO_START] &= ~interrupt;
+    updateInterrupts();
+}
+
+void Memory::serialize(StateSerializer &state)
+{
+    state.bytes(vram, sizeof(vram));
+    state.value(currentVramBank);
+    state.bytes(wram, sizeof(wram));
+    state.value(currentWramBank);
+    state.bytes(oam, sizeof(oam));
+    state.bytes(ioRegisters, sizeof(ioRegisters));
+    state.bytes(hram, sizeof(hram));
+    state.value(ieRegister);
+
+    state.bytes(cgbBgColorPalette, sizeof(cgbBgColorPalette));
+    state.bytes(cgbObjColorPalette, sizeof(cgbObjColorPalette));
+
+    if (state.isLoading())
+        updateInterrupts();
+}
@@ -1,4 +1,15 @@
 #include "ROM.hpp"
+#include "Mbc.hpp"
+#include "RomImageCache.hpp"
+#include "StateSerializer.hpp"
+#include <algorithm>
+#include <array>
+#include <system_error>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 ROM::ROM()
 {
@@ -9,6 +20,7 @@ ROM::ROM()
     currentROMBank = 1;
     currentRAMBank = 0;
     bankMode = 0;
+    mappingGeneration = 0;
     isMulticart = false;
 
     bootromActive = false;
@@ -22,23 +34,25 @@ ROM::ROM()
     rtcLatch = false;
     rtcLatchedSeconds = 0;
     rtcNumCycles = 0;
+
+    useSaveFile = true;
+    batterySave = false;
+    ramDirty = false;
+    useFixedTime = false;
+    fixedTime = 0;
+
+    mbcController = std::make_unique<Mbc>(this);
+    mapBanks();
 }
 
 ROM::~ROM()
 {
-    if (rom != nullptr) {
-        delete[] rom;
-        rom = nullptr;
-    }
+    rom = nullptr;
 
     if (ram != nullptr) {
         delete[] ram;
         ram = nullptr;
     }
-
-    if (saveFile != NULL) {
-        fclose(saveFile);
-    }
 }
 
 /**
@@ -50,95 +64,76 @@ bool ROM::loadROM(std::string romPath)
     saveFilePath = romPath;
     saveFilePath.replace_extension(".sav");
 
-    FILE *f = fopen(romPath.c_str(), "rb");
-
-    if (f != NULL) {
-        fseek(f, 0, SEEK_END);
-        romFileSize = ftell(f);
-        fseek(f, 0, SEEK_SET);
+    // The image is shared with the other instances that loaded the same ROM
+    romImage = RomImageCache::get(romPath);
+    if (romImage == nullptr)
+        return false;
 
-        // Allocate mem for ROM
-        try {
-            rom = new uint8_t[romFileSize];
-        } catch (const std::bad_alloc &e) {
-            std::cerr << "ERROR: Could not allocate memory for ROM: " << e.what() << "\n";
-            return false;
-        }
+    rom = romImage->data;
+    romFileSize = romImage->size;
 
-        fread(rom, sizeof(uint8_t), romFileSize, f);
-        fclose(f);
+    // After the ROM has been loaded, read the header and run the checks
+    readHeader();
 
-        // After the ROM has been loaded, read the header and run the checks
-        readHeader();
+    nintendoLogoOk = checkNintendoLogo();
+    headerChecksumOk = checkHeaderChecksum();
 
-        nintendoLogoOk = checkNintendoLogo();
-        headerChecksumOk = checkHeaderChecksum();
-        globalchecksumOk = checkGlobalChecksum();
+    // Allocate cartridge RAM if necessary
+    if (cartridgeRam || mbc == MBC::MBC2)
+        ram = new uint8_t[ramSize]();
 
-        // Allocate cartridge RAM if necessary
-        if (cartridgeRam || mbc == MBC::MBC2)
-            ram = new uint8_t[ramSize];
+    mbcController = Mbc::create(this);
+    mapBanks();
 
-        // Load save file
+    // Load save file
+    if (useSaveFile)
         loadSaveFile(saveFilePath);
 
-        return true;
-
-    } else {
-        std::cerr << "ERROR: ROM " << romPath << " could not be opened\n";
-        return false;
-    }
+    return true;
 }
 
 bool ROM::loadSaveFile(fs::path savePath)
 {
     if ((cartridgeRam || mbc == MBC::MBC2) && cartridgeBattery) {
-        if (fs::exists(savePath)) {
-            // Load the data in ram
-            saveFile = fopen(savePath.c_str(), "r+b");
-            if (saveFile == NULL) {
-                std::cerr << "ERROR: Save file " << savePath.string() << " could not be opened\n";
-                return false;
-            }
-
-            fseek(saveFile, 0, SEEK_SET);
+        batterySave = true;
 
-            if (mbc == MBC3 && cartridgeTimer) {
-                // Read rtc registers and increment time if necessary
-                fread(&rtcS, sizeof(uint8_t), 1, saveFile);
-                fread(&rtcM, sizeof(uint8_t), 1, saveFile);
-                fread(&rtcH, sizeof(uint8_t), 1, saveFile);
-                fread(&rtcDL, sizeof(uint8_t), 1, saveFile);
-                fread(&rtcDH, sizeof(uint8_t), 1, saveFile);
-                fread(&rtcLatchClockLastWritten, sizeof(uint8_t), 1, saveFile);
-                fread(&rtcLatch, sizeof(bool), 1, saveFile);
-                fread(&rtcLatchedSeconds, sizeof(uint64_t), 1, saveFile);
-                fread(&rtcNumCycles, sizeof(uint16_t), 1, saveFile);
-
-                time_t oldTime;
-                fread(&oldTime, sizeof(time_t), 1, saveFile);
+        // The file is created the first time the RAM is saved
+        if (!fs::exists(savePath))
+            return true;
 
-                time_t currentTime = time(NULL);
+        // Load the data in ram
+        FILE *saveFile = fopen(savePath.c_str(), "rb");
+        if (saveFile == NULL) {
+            std::cerr << "ERROR: Save file " << savePath.string() << " could not be opened\n";
+            return false;
+        }
 
-                if ((rtcDH & 0x40) == 0) {
-                    incrementRtc(currentTime - oldTime);
-                }
+        if (mbc == MBC3 && cartridgeTimer) {
+            // Read rtc registers and increment time if necessary
+            fread(&rtcS, sizeof(uint8_t), 1, saveFile);
+            fread(&rtcM, sizeof(uint8_t), 1, saveFile);
+            fread(&rtcH, sizeof(uint8_t), 1, saveFile);
+            fread(&rtcDL, sizeof(uint8_t), 1, saveFile);
+            fread(&rtcDH, sizeof(uint8_t), 1, saveFile);
+            fread(&rtcLatchClockLastWritten, sizeof(uint8_t), 1, saveFile);
+            fread(&rtcLatch, sizeof(bool), 1, saveFile);
+            fread(&rtcLatchedSeconds, sizeof(uint64_t), 1, saveFile);
+            fread(&rtcNumCycles, sizeof(uint16_t), 1, saveFile);
+
+            time_t oldTime;
+            fread(&oldTime, sizeof(time_t), 1, saveFile);
+
+            time_t currentTime = getCurrentTime();
+
+            if ((rtcDH & 0x40) == 0) {
+                incrementRtc(currentTime - oldTime);
             }
+        }
 
-            fread(ram, sizeof(uint8_t), ramSize, saveFile);
-
-            return true;
-
-        } else {
-            // Create the file
-            saveFile = fopen(savePath.c_str(), "w+b");
-            if (saveFile == NULL) {
-                std::cerr << "ERROR: Save file " << savePath.string() << " could not be created\n";
-                return false;
-            }
+        fread(ram, sizeof(uint8_t), ramSize, saveFile);
+        fclose(saveFile);
 
-            return true;
-        }
+        return true;
     }
 
     return false;
@@ -146,29 +141,76 @@ bool ROM::loadSaveFile(fs::path savePath)
 
 bool ROM::saveRam()
 {
-    if (saveFile == NULL) {
+    if (!batterySave) {
         return false;
     }
 
-    fseek(saveFile, 0, SEEK_SET);
+    std::vector<uint8_t> data;
+    getSaveData(data);
+    ramDirty = false;
+
+    return writeSaveFile(saveFilePath, data);
+}
+
+/**
+ *  Uses the same layout the save files had when they were written field by field with fwrite
+ */
+void ROM::getSaveData(std::vector<uint8_t> &data)
+{
+    data.clear();
+
+    auto append = [&data](const void *field, size_t size) {
+        const uint8_t *bytes = (const uint8_t *)field;
+        data.insert(data.end(), bytes, bytes + size);
+    };
 
     if (mbc == MBC3 && cartridgeTimer) {
-        // write rtc registers and current time
-        fwrite(&rtcS, sizeof(uint8_t), 1, saveFile);
-        fwrite(&rtcM, sizeof(uint8_t), 1, saveFile);
-        fwrite(&rtcH, sizeof(uint8_t), 1, saveFile);
-        fwrite(&rtcDL, sizeof(uint8_t), 1, saveFile);
-        fwrite(&rtcDH, sizeof(uint8_t), 1, saveFile);
-        fwrite(&rtcLatchClockLastWritten, sizeof(uint8_t), 1, saveFile);
-        fwrite(&rtcLatch, sizeof(bool), 1, saveFile);
-        fwrite(&rtcLatchedSeconds, sizeof(uint64_t), 1, saveFile);
-        fwrite(&rtcNumCycles, sizeof(uint16_t), 1, saveFile);
-
-        time_t currentTime = time(NULL);
-        fwrite(&currentTime, sizeof(time_t), 1, saveFile);
+        // rtc registers and current time
+        append(&rtcS, sizeof(uint8_t));
+        append(&rtcM, sizeof(uint8_t));
+        append(&rtcH, sizeof(uint8_t));
+        append(&rtcDL, sizeof(uint8_t));
+        append(&rtcDH, sizeof(uint8_t));
+        append(&rtcLatchClockLastWritten, sizeof(uint8_t));
+        append(&rtcLatch, sizeof(bool));
+        append(&rtcLatchedSeconds, sizeof(uint64_t));
+        append(&rtcNumCycles, sizeof(uint16_t));
+
+        time_t currentTime = getCurrentTime();
+        append(&currentTime, sizeof(time_t));
+    }
+
+    append(ram, ramSize);
+}
+
+bool ROM::writeSaveFile(fs::path path, const std::vector<uint8_t> &data)
+{
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+
+    FILE *f = fopen(tempPath.c_str(), "wb");
+    if (f == NULL) {
+        std::cerr << "ERROR: Save file " << tempPath.string() << " could not be created\n";
+        return false;
+    }
+
+    bool ok = fwrite(data.data(), sizeof(uint8_t), data.size(), f) == data.size();
+    // The data must be on the disk before the rename makes it the save file
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok) {
+        std::cerr << "ERROR: Save file " << tempPath.string() << " could not be written\n";
+        fs::remove(tempPath);
+        return false;
     }
 
-    if (fwrite(ram, sizeof(uint8_t), ramSize, saveFile) == 0) {
+    std::error_code error;
+    fs::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "ERROR: Save file " << path.string() << " could not be replaced: "
+                  << error.message() << "\n";
         return false;
     }
 
@@ -189,10 +231,15 @@ bool ROM::loadBootrom(std::string bootromPath)
     fclose(f);
 
     bootromActive = true;
+    ++mappingGeneration;
     return true;
 }
 
-void ROM::disableBootrom() { bootromActive = false; }
+void ROM::disableBootrom()
+{
+    bootromActive = false;
+    ++mappingGeneration;
+}
 
 /* ROM CHECKS */
 
@@ -232,16 +279,48 @@ bool ROM::checkHeaderChecksum()
  */
 bool ROM::checkGlobalChecksum()
 {
-    uint16_t sum = 0;
-    for (uint32_t i = 0; i < 0x014E; ++i)
-        sum += rom[i];
-
-    for (uint32_t i = 0x0150; i < romSize; ++i)
-        sum += rom[i];
+    // The checksum bytes are not part of the sum
+    uint32_t size = std::min(romSize, romFileSize);
+    uint16_t sum = sumBytes(rom, size) - rom[0x014E] - rom[0x014F];
 
     return sum == globalChecksum;
 }
 
+bool ROM::isGlobalChecksumOk()
+{
+    if (romImage == nullptr)
+        return checkGlobalChecksum();
+
+    std::call_once(romImage->globalChecksumChecked,
+                   [this]() { romImage->globalChecksumOk = checkGlobalChecksum(); });
+    return romImage->globalChecksumOk;
+}
+
+/**
+ *  Adds up size bytes, 16 at a time with SSE2
+ */
+uint64_t ROM::sumBytes(const uint8_t *data, size_t size)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // psadbw adds up each half of the 16 bytes into a 64 bit lane
+    __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i));
+        total = _mm_add_epi64(total, _mm_sad_epu8(bytes, zero));
+    }
+    sum = _mm_cvtsi128_si64(total) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+#endif
+
+    for (; i < size; ++i)
+        sum += data[i];
+
+    return sum;
+}
+
 /* HEADER FLAGS GETTERS */
 
 /**
@@ -268,7 +347,8 @@ void ROM::getGameTitle()
     uint8_t title[16];
     memcpy(title, rom + 0x0134, 16 * sizeof(uint8_t));
 
-    gameTitle.assign((char *)title);
+    // The title fills all 16 bytes when it is not terminated
+    gameTitle.assign((char *)title, strnlen((char *)title, 16));
 }
 
 /**
@@ -515,403 +595,102 @@ void ROM::getGlobalChecksum() { globalChecksum = (rom[0x014E] << 0x8) | rom[0x01
 
 /* CARTRIDGE READ AND WRITE */
 
-/**
- *  Wrapper for calling the read on specific MBC
- */
-uint8_t ROM::readmem(uint16_t addr)
-{
-    // There is no ROM loaded
-    if (addr < 0x8000 && rom == nullptr)
-        return 0xFF;
-
-    // There is no RAM or RAM is not enabled
-    if (addr >= 0xA000 && addr < 0xC000 && (!cartridgeRam || !ramEnable)) {
-        return 0xFF;
-    }
-
-    if (bootromActive && addr < 0x100) {
-        return bootrom[addr];
-    }
-
-    switch (mbc) {
-    case MBC::None:
-        return readmemNoMBC(addr);
-        break;
-    case MBC::MBC1:
-        return readmemMBC1(addr);
-        break;
-    case MBC::MBC2:
-        return readmemMBC2(addr);
-        break;
-    case MBC::MBC3:
-        return readmemMBC3(addr);
-        break;
-    case MBC::MBC5:
-        return readmemMBC5(addr);
-        break;
-    default:
-        return 0xFF;
-        break;
-    }
-}
+// What the ROM windows read when no bank is mapped
+static const std::array<uint8_t, 0x4000> openBus = [] {
+    std::array<uint8_t, 0x4000> bytes;
+    bytes.fill(0xFF);
+    return bytes;
+}();
 
-/**
- * Wrapper for calling the write on specific MBC
- */
 void ROM::writemem(uint8_t val, uint16_t addr)
 {
-    // Do nothing if there is no RAM or RAM is not enabled
-    if (addr >= 0xA000 && addr < 0xC000 && (!cartridgeRam || !ramEnable)) {
+    // Writes to the ROM area go to the MBC registers and may switch banks
+    if (addr < 0x8000) {
+        mbcController->writeRegister(val, addr);
+        mapBanks();
         return;
     }
 
-    switch (mbc) {
-    case MBC::None:
-        writememNoMBC(val, addr);
-        break;
-    case MBC::MBC1:
-        writememMBC1(val, addr);
-        break;
-    case MBC::MBC2:
-        writememMBC2(val, addr);
-        break;
-    case MBC::MBC3:
-        writememMBC3(val, addr);
-        break;
-    case MBC::MBC5:
-        writememMBC5(val, addr);
-        break;
-    default:
-        return;
-        break;
-    }
-}
-
-uint8_t ROM::readmemNoMBC(uint16_t addr)
-{
-    // Read the ROM portion
-    if (addr < 0x8000)
-        return rom[addr];
-
-    // Read the RAM portion
-    if (addr >= 0xA000 && addr < 0xC000)
-        return ram[addr - 0xA000];
-
-    // Invalid address
-    fprintf(stderr, "WARNING: Trying to read from invalid ROM address: 0x%04X\n", addr);
-    return 0xFF;
-}
-
-void ROM::writememNoMBC(uint8_t val, uint16_t addr)
-{
-    // Set RAM enable
-    if (addr < 0x2000) {
-        ramEnable = (val & 0x0F) == 0x0A;
-    }
-
-    // Write to RAM
     if (addr >= 0xA000 && addr < 0xC000) {
-        ram[addr - 0xA000] = val;
-    }
-}
-
-uint8_t ROM::readmemMBC1(uint16_t addr)
-{
-    // ROM bank 0x00/0x20/0x40/0x60
-    if (addr < 0x4000) {
-        if (bankMode == 0) {
-            // Bank 0x00
-            return rom[addr];
-        } else {
-            // Bank 0x20/0x40/0x60
-            // depending on bank size, not all bits are used
-            uint8_t mask;
-            if (romBanks > 96) {
-                mask = 0x60;
-            } else if (romBanks > 64 && romBanks <= 96) {
-                mask = 0x40;
-            } else if (romBanks > 32 && romBanks <= 64) {
-                mask = 0x20;
-            } else {
-                mask = 0;
-            }
+        // Do nothing if there is no RAM or RAM is not enabled
+        if (!cartridgeRam || !ramEnable)
+            return;
 
-            uint8_t actualBank = (currentRAMBank << 5) & mask;
-            uint32_t actualAddr = addr + 0x4000 * actualBank;
-            return rom[actualAddr];
+        if (ramWindow == nullptr) {
+            mbcController->writeRam(val, addr);
+            return;
         }
-    }
-
-    // Switchable ROM Bank
-    if (addr >= 0x4000 && addr < 0x8000) {
-        uint8_t mask = romBanks - 1;
-        uint8_t actualBank = ((currentRAMBank << 5) | currentROMBank) & mask;
-        uint32_t actualAddr = (addr - 0x4000) + 0x4000 * actualBank;
-
-        return rom[actualAddr];
-    }
 
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000) {
-        if (bankMode == 0) {
-            // ROM Bank Mode
-            return ram[addr - 0xA000];
-        } else {
-            // RAM Bank Mode
-            uint8_t mask = ramBanks - 1;
-            uint32_t actualAddr = (addr - 0xA000) + 0x2000 * (currentRAMBank & mask);
-            return ram[actualAddr];
+        uint8_t &byte = ramWindow[(addr - 0xA000) & ramWindowMask];
+        if (byte != val) {
+            byte = val;
+            ramDirty = true;
         }
     }
-
-    // Invalid address
-    fprintf(stderr, "WARNING: Trying to read from invalid ROM address: 0x%04X\n", addr);
-    return 0xFF;
 }
 
-void ROM::writememMBC1(uint8_t val, uint16_t addr)
-{
-    // RAM Enable
-    if (addr < 0x2000) {
-        ramEnable = (val & 0x0F) == 0x0A;
-    }
-
-    // ROM Bank Number
-    if (addr >= 0x2000 && addr < 0x4000) {
-        currentROMBank = val & 0x1F;
-        if (currentROMBank == 0x00)
-            currentROMBank = 0x01;
-    }
-
-    // RAM Bank or Secondary ROM Bank
-    if (addr >= 0x4000 && addr < 0x6000) {
-        currentRAMBank = val & 0x3;
-    }
-
-    // Bank Mode
-    if (addr >= 0x6000 && addr < 0x8000) {
-        bankMode = val & 1;
-    }
-
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000) {
-        if (bankMode == 0) {
-            // ROM Bank Mode
-            ram[addr - 0xA000] = val;
-        } else {
-            // RAM Bank Mode
-            uint8_t mask = ramBanks - 1;
-            uint32_t actualAddr = (addr - 0xA000) + 0x2000 * (currentRAMBank & mask);
-            ram[actualAddr] = val;
-        }
-    }
-}
+uint8_t ROM::readUnmappedRam(uint16_t addr) { return mbcController->readRam(addr); }
 
-uint8_t ROM::readmemMBC2(uint16_t addr)
+uint8_t ROM::readInvalid(uint16_t addr)
 {
-    // ROM Bank 0
-    if (addr < 0x4000)
-        return rom[addr];
-
-    // Switchable ROM Bank
-    if (addr >= 0x4000 && addr < 0x8000) {
-        uint8_t mask = romBanks - 1;
-        uint32_t actualAddr = (addr - 0x4000) + 0x4000 * (currentROMBank & mask);
-        return rom[actualAddr];
-    }
-
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000) {
-        addr = (addr - 0xA000) & 0x1FF;
-        return ((ram[addr] & 0x0F) | 0xF0);
-    }
-
-    // Invalid address
     fprintf(stderr, "WARNING: Trying to read from invalid ROM address: 0x%04X\n", addr);
     return 0xFF;
 }
 
-void ROM::writememMBC2(uint8_t val, uint16_t addr)
+void ROM::mapBanks()
 {
-    // RAM Enable
-    if (addr < 0x4000 && (addr & 0x100) == 0) {
-        ramEnable = (val & 0xF) == 0xA;
-    }
-
-    // ROM Bank
-    if (addr < 0x4000 && (addr & 0x100) == 0x100) {
-        currentROMBank = val /*& 0xF*/;
-        if ((currentROMBank & 0xF) == 0)
-            currentROMBank = 1;
-    }
-
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000) {
-        addr = (addr - 0xA000) & 0x1FF;
-        ram[addr] = val & 0xF;
-    }
+    mbcController->mapBanks();
+    ++mappingGeneration;
 }
 
-uint8_t ROM::readmemMBC3(uint16_t addr)
+void ROM::mapRomBank(uint8_t window, uint32_t bank)
 {
-    // ROM Bank 0
-    if (addr < 0x4000)
-        return rom[addr];
-
-    // Switchable ROM Bank
-    if (addr >= 0x4000 && addr < 0x8000) {
-        uint32_t acutalAddr = (addr - 0x4000) + 0x4000 * currentROMBank;
-        return rom[acutalAddr];
-    }
-
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000 && currentRAMBank < 0x4) {
-        uint32_t actualAddr = (addr - 0xA000) + 0x2000 * currentRAMBank;
-        return ram[actualAddr];
-    }
-
-    // RTC Register
-    if (addr >= 0xA000 && addr < 0xC000 && currentRAMBank >= 0x08 && currentRAMBank < 0x0D) {
-        switch (currentRAMBank) {
-        case 0x08:
-            return rtcS;
-            break;
-        case 0x09:
-            return rtcM;
-            break;
-        case 0x0A:
-            return rtcH;
-            break;
-        case 0x0B:
-            return rtcDL;
-            break;
-        case 0x0C:
-            return rtcDH;
-            break;
-        }
+    uint32_t numBanks = romFileSize / 0x4000;
+    if (rom == nullptr || numBanks == 0) {
+        unmapRomBank(window);
+        return;
     }
 
-    // Invalid address
-    fprintf(stderr, "WARNING: Trying to read from invalid ROM address: 0x%04X\n", addr);
-    return 0xFF;
+    bank %= numBanks;
+    romWindow[window] = rom + bank * 0x4000;
+    romWindowBank[window] = bank;
 }
 
-void ROM::writememMBC3(uint8_t val, uint16_t addr)
+void ROM::unmapRomBank(uint8_t window)
 {
-    // RAM / Timer Enable
-    if (addr < 0x2000) {
-        ramEnable = (val & 0x0A) == 0x0A;
-    }
-
-    // ROM Bank Number
-    if (addr >= 0x2000 && addr < 0x4000) {
-        currentROMBank = val;
-        if (currentROMBank == 0)
-            currentROMBank = 1;
-    }
-
-    // RAM Bank Number / RTC Register Select
-    if (addr >= 0x4000 && addr < 0x6000) {
-        currentRAMBank = val;
-    }
-
-    // Latch Clock Data
-    if (addr >= 0x6000 && addr < 0x8000) {
-        if (val == 0x01 && rtcLatchClockLastWritten == 0x00) {
-            // Toggle Latch
-            rtcLatch = !rtcLatch;
-
-            if (rtcLatch == false) {
-                // Latch reset
-                incrementRtc(rtcLatchedSeconds);
-                rtcLatchedSeconds = 0;
-            } else if (rtcLatch) {
-                // Latch set
-                rtcLatchedSeconds = 0;
-            }
-        }
-        rtcLatchClockLastWritten = val;
-    }
-
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000 && currentRAMBank < 0x4) {
-        uint32_t actualAddr = (addr - 0xA000) + 0x2000 * currentRAMBank;
-        ram[actualAddr] = val;
-    }
-
-    // RTC Registers
-    if (addr >= 0xA000 && addr < 0xC000 && currentRAMBank >= 0x08 && currentRAMBank < 0x0D) {
-        switch (currentRAMBank) {
-        case 0x08:
-            rtcS = val;
-            break;
-        case 0x09:
-            rtcM = val;
-            break;
-        case 0x0A:
-            rtcH = val;
-            break;
-        case 0x0B:
-            rtcDL = val;
-            break;
-        case 0x0C:
-            rtcDH = val;
-            break;
-        }
-    }
+    romWindow[window] = openBus.data();
+    romWindowBank[window] = -1;
 }
 
-uint8_t ROM::readmemMBC5(uint16_t addr)
+void ROM::mapRamBank(uint32_t bank)
 {
-    // ROM Bank 0
-    if (addr < 0x4000)
-        return rom[addr];
-
-    // Switchable ROM Bank
-    if (addr >= 0x4000 && addr < 0x8000) {
-        uint8_t mask = romBanks - 1;
-        uint32_t actualAddr = (addr - 0x4000) + 0x4000 * (currentROMBank & mask);
-        return rom[actualAddr];
-    }
-
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000) {
-        uint32_t acutalAddr = (addr - 0xA000) + 0x2000 * currentRAMBank;
-        return ram[acutalAddr];
+    if (ram == nullptr || ramSize == 0) {
+        unmapRamBank();
+        return;
     }
 
-    // Invalid address
-    fprintf(stderr, "WARNING: Trying to read from invalid ROM address: 0x%04X\n", addr);
-    return 0xFF;
+    // RAM smaller than a bank (2KB) is repeated over the whole area
+    uint32_t bankSize = std::min<uint32_t>(ramSize, 0x2000);
+    ramWindow = ram + (bank % (ramSize / bankSize)) * bankSize;
+    ramWindowMask = bankSize - 1;
 }
 
-void ROM::writememMBC5(uint8_t val, uint16_t addr)
+void ROM::unmapRamBank()
 {
-    // RAM Enable
-    if (addr < 0x2000) {
-        ramEnable = (val & 0xFF) == 0x0A;
-    }
-
-    // Low 8 bits of ROM Bank number
-    if (addr >= 0x2000 && addr < 0x3000) {
-        currentROMBank = (currentROMBank & 0x0100) | val;
-    }
-
-    // High bit (bit 9) of ROM Bank number
-    if (addr >= 0x3000 && addr < 0x4000) {
-        currentROMBank = ((val & 0x1) << 8) | (currentROMBank & 0xFF);
-    }
+    ramWindow = nullptr;
+    ramWindowMask = 0;
+}
 
-    // RAM Bank Number
-    if (addr >= 0x4000 && addr < 0x6000) {
-        currentRAMBank = val & 0xF;
-    }
+/**
+ *  Returns the ROM bank mapped at addr (0x0000-0x7FFF). Returns -1 if the area is not mapped to
+ *  the ROM
+ */
+int32_t ROM::getMappedBank(uint16_t addr)
+{
+    if (addr >= 0x8000)
+        return -1;
 
-    // RAM
-    if (addr >= 0xA000 && addr < 0xC000) {
-        uint32_t acutalAddr = (addr - 0xA000) + 0x2000 * currentRAMBank;
-        ram[acutalAddr] = val;
-    }
+    return romWindowBank[addr >> 14];
 }
 
 void ROM::cycleRtc()
@@ -962,3 +741,41 @@ void ROM::incrementRtc(uint64_t numSeconds)
 
     rtcS = newTime;
 }
+
+time_t ROM::getCurrentTime()
+{
+    if (useFixedTime)
+        return fixedTime;
+
+    return time(NULL);
+}
+
+void ROM::serialize(StateSerializer &state)
+{
+    if (ram != nullptr)
+        state.bytes(ram, ramSize);
+
+    // A loaded state may have a different save
+    if (state.isLoading())
+        ramDirty = true;
+
+    state.value(bootromActive);
+
+    state.value(ramEnable);
+    state.value(currentROMBank);
+    state.value(currentRAMBank);
+    state.value(bankMode);
+
+    // The loaded bank registers may map different banks
+    mapBanks();
+
+    state.value(rtcS);
+    state.value(rtcM);
+    state.value(rtcH);
+    state.value(rtcDL);
+    state.value(rtcDH);
+    state.value(rtcLatchClockLastWritten);
+    state.value(rtcLatch);
+    state.value(rtcLatchedSeconds);
+    state.value(rtcNumCycles);
+}
@@ -0,0 +1,99 @@
+#include "RomImageCache.hpp"
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RomImage::RomImage()
+{
+    data = nullptr;
+    size = 0;
+}
+
+RomImage::~RomImage()
+{
+    if (data != nullptr)
+        munmap((void *)data, size);
+}
+
+std::shared_ptr<RomImage> RomImageCache::get(fs::path path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERROR: ROM " << path.string() << " could not be opened\n";
+        return nullptr;
+    }
+
+    struct stat fileStat;
+    uint8_t header[ROM_IMAGE_HEADER_END - ROM_IMAGE_HEADER_START];
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < ROM_IMAGE_HEADER_END ||
+        pread(fd, header, sizeof(header), ROM_IMAGE_HEADER_START) != sizeof(header)) {
+        std::cerr << "ERROR: ROM " << path.string() << " is too small\n";
+        close(fd);
+        return nullptr;
+    }
+
+    RomImageKey key;
+    std::error_code error;
+    fs::path canonicalPath = fs::canonical(path, error);
+    key.path = error ? path.string() : canonicalPath.string();
+    key.device = fileStat.st_dev;
+    key.inode = fileStat.st_ino;
+    key.size = fileStat.st_size;
+    key.modifiedTime = (int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+
+    // FNV-1a
+    key.headerHash = 0xCBF29CE484222325;
+    for (uint8_t byte : header) {
+        key.headerHash ^= byte;
+        key.headerHash *= 0x100000001B3;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::shared_ptr<RomImage> image = images[key].lock();
+    if (image != nullptr) {
+        close(fd);
+        return image;
+    }
+
+    void *data = mmap(nullptr, key.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        std::cerr << "ERROR: ROM " << path.string() << " could not be mapped\n";
+        images.erase(key);
+        return nullptr;
+    }
+
+    // Only the banks the game switches to are read, so don't read ahead of the touched pages
+    madvise(data, key.size, MADV_RANDOM);
+
+    image = std::make_shared<RomImage>();
+    image->data = (const uint8_t *)data;
+    image->size = key.size;
+    image->key = key;
+    images[key] = image;
+
+    // Forget the images nobody uses anymore
+    for (auto it = images.begin(); it != images.end();) {
+        if (it->second.expired())
+            it = images.erase(it);
+        else
+            ++it;
+    }
+
+    return image;
+}
+
+size_t RomImageCache::getNumImages()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t numImages = 0;
+    for (auto &entry : images)
+        numImages += !entry.second.expired();
+
+    return numImages;
+}
@@ -0,0 +1,293 @@
+#include "RomLibrary.hpp"
+#include "RomImageCache.hpp"
+#include "StateSerializer.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static void serializeString(StateSerializer &state, std::string &s)
+{
+    uint32_t size = s.size();
+    state.value(size);
+
+    if (state.isLoading()) {
+        if (!state.isValid() || size > state.getRemaining()) {
+            state.setInvalid();
+            s.clear();
+            return;
+        }
+
+        s.resize(size);
+    }
+
+    state.bytes(&s[0], s.size());
+}
+
+void RomLibraryEntry::serialize(StateSerializer &state)
+{
+    serializeString(state, path);
+    state.value(fileSize);
+    state.value(modifiedTime);
+
+    serializeString(state, gameTitle);
+    state.value(gbcFlag);
+    state.value(sgbFlag);
+    state.value(cartridgeType);
+    state.value(mbc);
+    state.value(romSize);
+    state.value(ramSize);
+    state.value(cartridgeBattery);
+    state.value(cartridgeTimer);
+    state.value(romVersion);
+    state.value(headerChecksum);
+    state.value(globalChecksum);
+
+    state.value(nintendoLogoOk);
+    state.value(headerChecksumOk);
+    state.value(globalChecksumState);
+}
+
+RomLibrary::RomLibrary() { headersRead = 0; }
+
+bool RomLibrary::loadIndex(fs::path indexPath)
+{
+    FILE *f = fopen(indexPath.c_str(), "rb");
+    if (f == NULL)
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    std::vector<uint8_t> buffer(fileSize > 0 ? fileSize : 0);
+    size_t read = fread(buffer.data(), sizeof(uint8_t), buffer.size(), f);
+    fclose(f);
+
+    if (read != buffer.size())
+        return false;
+
+    StateSerializer state(buffer, StateSerializer::LOAD);
+
+    uint32_t magic = 0, version = 0, numEntries = 0;
+    state.value(magic);
+    state.value(version);
+    state.value(numEntries);
+
+    // An index of another version is rebuilt by the next scan
+    if (!state.isValid() || magic != ROM_LIBRARY_MAGIC || version != ROM_LIBRARY_VERSION)
+        return false;
+
+    std::vector<RomLibraryEntry> loadedEntries;
+    for (uint32_t i = 0; i < numEntries && state.isValid(); ++i) {
+        RomLibraryEntry entry;
+        entry.serialize(state);
+        loadedEntries.push_back(entry);
+    }
+
+    if (!state.isValid()) {
+        std::cerr << "ERROR: ROM library index " << indexPath.string() << " is corrupted\n";
+        return false;
+    }
+
+    entries = std::move(loadedEntries);
+    return true;
+}
+
+bool RomLibrary::saveIndex(fs::path indexPath)
+{
+    std::vector<uint8_t> buffer;
+    StateSerializer state(buffer, StateSerializer::SAVE);
+
+    uint32_t magic = ROM_LIBRARY_MAGIC;
+    uint32_t version = ROM_LIBRARY_VERSION;
+    uint32_t numEntries = entries.size();
+    state.value(magic);
+    state.value(version);
+    state.value(numEntries);
+
+    for (RomLibraryEntry &entry : entries)
+        entry.serialize(state);
+
+    // Replaced like the battery saves, so an interrupted write doesn't lose the index
+    return ROM::writeSaveFile(indexPath, buffer);
+}
+
+void RomLibrary::scan(fs::path directory, uint32_t numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // The index is only read while the workers run
+    std::map<std::string, const RomLibraryEntry *> indexed;
+    for (const RomLibraryEntry &entry : entries)
+        indexed[entry.path] = &entry;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<fs::path> directories = {directory};
+    // Workers that are listing a directory, and may still add subdirectories
+    uint32_t busyWorkers = 0;
+    std::vector<RomLibraryEntry> found;
+
+    headersRead = 0;
+
+    auto worker = [&]() {
+        std::vector<RomLibraryEntry> workerFound;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            condition.wait(lock, [&] { return !directories.empty() || busyWorkers == 0; });
+            if (directories.empty())
+                break;
+
+            fs::path current = directories.front();
+            directories.pop_front();
+            ++busyWorkers;
+            lock.unlock();
+
+            std::vector<fs::path> subdirectories;
+            std::error_code error;
+            for (fs::directory_iterator it(current, error), end; !error && it != end;
+                 it.increment(error)) {
+                const fs::path &path = it->path();
+
+                if (fs::is_directory(it->symlink_status())) {
+                    subdirectories.push_back(path);
+                    continue;
+                }
+
+                if (!isRomFile(path))
+                    continue;
+
+                struct stat fileStat;
+                if (stat(path.c_str(), &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+                    continue;
+
+                int64_t modifiedTime =
+                    (int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+
+                auto indexedEntry = indexed.find(path.string());
+                if (indexedEntry != indexed.end() &&
+                    indexedEntry->second->fileSize == (uint64_t)fileStat.st_size &&
+                    indexedEntry->second->modifiedTime == modifiedTime) {
+                    workerFound.push_back(*indexedEntry->second);
+                    continue;
+                }
+
+                RomLibraryEntry entry;
+                if (readEntry(path, entry)) {
+                    entry.fileSize = fileStat.st_size;
+                    entry.modifiedTime = modifiedTime;
+                    workerFound.push_back(entry);
+                }
+                ++headersRead;
+            }
+
+            lock.lock();
+            --busyWorkers;
+            for (fs::path &subdirectory : subdirectories)
+                directories.push_back(subdirectory);
+            condition.notify_all();
+        }
+
+        found.insert(found.end(), workerFound.begin(), workerFound.end());
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < numThreads; ++i)
+        threads.emplace_back(worker);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    std::sort(found.begin(), found.end(),
+              [](const RomLibraryEntry &a, const RomLibraryEntry &b) { return a.path < b.path; });
+    entries = std::move(found);
+}
+
+bool RomLibrary::readEntry(const fs::path &path, RomLibraryEntry &entry)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    uint8_t header[ROM_IMAGE_HEADER_END] = {};
+    ssize_t read = pread(fd, header, sizeof(header), 0);
+    close(fd);
+
+    if (read != sizeof(header))
+        return false;
+
+    // Parse it like a loaded ROM that ends after the header
+    ROM rom;
+    rom.rom = header;
+    rom.romFileSize = sizeof(header);
+    rom.readHeader();
+
+    entry.path = path.string();
+    entry.gameTitle = rom.gameTitle;
+    entry.gbcFlag = rom.gbcFlag;
+    entry.sgbFlag = rom.sgbFlag;
+    entry.cartridgeType = header[0x0147];
+    entry.mbc = rom.mbc;
+    entry.romSize = rom.romSize;
+    entry.ramSize = rom.ramSize;
+    entry.cartridgeBattery = rom.cartridgeBattery;
+    entry.cartridgeTimer = rom.cartridgeTimer;
+    entry.romVersion = rom.romVersion;
+    entry.headerChecksum = rom.headerChecksum;
+    entry.globalChecksum = rom.globalChecksum;
+    entry.nintendoLogoOk = rom.checkNintendoLogo();
+    entry.headerChecksumOk = rom.checkHeaderChecksum();
+    entry.globalChecksumState = CHECKSUM_UNKNOWN;
+
+    rom.rom = nullptr;
+    return true;
+}
+
+bool RomLibrary::verifyGlobalChecksum(RomLibraryEntry &entry)
+{
+    std::shared_ptr<RomImage> image = RomImageCache::get(entry.path);
+    if (image == nullptr)
+        return false;
+
+    uint32_t size = std::min(image->size, entry.romSize);
+    uint16_t sum = ROM::sumBytes(image->data, size) - image->data[0x014E] - image->data[0x014F];
+
+    entry.globalChecksumState = sum == entry.globalChecksum ? CHECKSUM_OK : CHECKSUM_BAD;
+    return entry.globalChecksumState == CHECKSUM_OK;
+}
+
+bool RomLibrary::isRomFile(const fs::path &path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".gb" || extension == ".gbc";
+}
+
+void RomLibrary::print(FILE *out)
+{
+    const char *mbcNames[] = {"ROM",  "MBC1", "MBC2", "MMM01", "MBC3",
+                              "MBC5", "MBC6", "MBC7", "HuC1",  "HuC3"};
+    const char *checksumStates[] = {"?", "ok", "bad"};
+
+    fprintf(out, "%-16s %-5s %-5s %6s %6s %-4s %-6s %-8s %s\n", "Title", "Type", "MBC", "ROM",
+            "RAM", "Logo", "Header", "Checksum", "Path");
+
+    for (RomLibraryEntry &entry : entries) {
+        const char *type = entry.gbcFlag == 0xC0 ? "CGB" : entry.gbcFlag == 0x80 ? "DMG+C" : "DMG";
+
+        fprintf(out, "%-16s %-5s %-5s %5uK %5uK %-4s %-6s %-8s %s\n", entry.gameTitle.c_str(),
+                type, entry.mbc <= HuC3 ? mbcNames[entry.mbc] : "?", entry.romSize / 1024,
+                entry.ramSize / 1024, entry.nintendoLogoOk ? "ok" : "bad",
+                entry.headerChecksumOk ? "ok" : "bad",
+                checksumStates[std::min<uint8_t>(entry.globalChecksumState, CHECKSUM_BAD)],
+                entry.path.c_str());
+    }
+}
@@ -1,6 +1,7 @@
 #include "BgFifo.hpp"
 #include "Memory.hpp"
 #include "PPU.hpp"
+#include "StateSerializer.hpp"
 
 BgFifo::BgFifo()
     : isDrawingWindow(false), scxPixelsToDiscard(0), pushedPixels(0), fetcherStage(GET_TILE),
@@ -12,6 +13,11 @@ BgFifo::BgFifo()
 BgFifo::BgFifo(PPU *ppu) : ppu(ppu) {}
 
 FifoPixel *BgFifo::cycle()
+{
+    return ppu->emulatorMode == CGB ? cycle<CGB>() : cycle<DMG>();
+}
+
+template <EmulatorMode mode> FifoPixel *BgFifo::cycle()
 {
     FifoPixel *returnedPixel = nullptr;
 
@@ -54,17 +60,17 @@ FifoPixel *BgFifo::cycle()
     }
 
     // if bg is disabled push blank(white) pixel
-    if (ppu->emulatorMode == DMG && ppu->getBgWindowDisplayPriority() == 0 &&
+    if (mode == DMG && ppu->getBgWindowDisplayPriority() == 0 &&
         returnedPixel != nullptr) {
         *returnedPixel = FifoPixel(0, 0, 0, 0, 0, false);
     }
 
-    cycleFetcher();
+    cycleFetcher<mode>();
 
     return returnedPixel;
 }
 
-void BgFifo::cycleFetcher()
+template <EmulatorMode mode> void BgFifo::cycleFetcher()
 {
     switch (fetcherStage) {
     case GET_TILE:
@@ -77,7 +83,7 @@ void BgFifo::cycleFetcher()
         if (isDrawingWindow) {
             if (ppu->getWindowDisplayEnable() == 0) {
                 isDrawingWindow = false;
-                cycleFetcher();
+                cycleFetcher<mode>();
                 return;
             }
 
@@ -137,7 +143,7 @@ void BgFifo::cycleFetcher()
 
         // if in CGB mode, get tile from vram bank in mapAttr
         BgMapAttributes bgMapAttr;
-        if (ppu->emulatorMode == EmulatorMode::CGB) {
+        if constexpr (mode == EmulatorMode::CGB) {
             bgMapAttr = ppu->getBgMapByIndex(tileMapIndex, tilemapBaseAddr == 0x9800 ? 0 : 1);
 
             uint8_t originalVramBank = ppu->memory->getCurrentVramBank();
@@ -149,7 +155,7 @@ void BgFifo::cycleFetcher()
         }
 
         // if in CGB mode, get bg map attributes and flip the tile if necessary
-        if (ppu->emulatorMode == EmulatorMode::CGB) {
+        if constexpr (mode == EmulatorMode::CGB) {
             if (bgMapAttr.horizontalFlip)
                 tile.flipHor();
             if (bgMapAttr.verticalFlip)
@@ -168,7 +174,7 @@ void BgFifo::cycleFetcher()
         // push the row of pixels into the queue
         for (uint8_t i = 0; i < 8; ++i) {
             FifoPixel pixel = FifoPixel(tileRow[i], 0, 0, 0, 0, false);
-            if (ppu->emulatorMode == EmulatorMode::CGB) {
+            if constexpr (mode == EmulatorMode::CGB) {
                 pixel.palette = bgMapAttr.bgPaletteNumber;
                 pixel.bgPriority = bgMapAttr.bgToOamPriority;
             }
@@ -227,3 +233,28 @@ void BgFifo::prepareForLine(uint8_t line)
 
     clearQueue();
 }
+
+void BgFifo::serialize(StateSerializer &state)
+{
+    state.value(isDrawingWindow);
+    state.queue(pixelQueue);
+    state.value(scxPixelsToDiscard);
+    state.value(pushedPixels);
+
+    state.value(fetcherStage);
+    state.value(fetcherStageCycles);
+    state.value(spriteFetchingActive);
+
+    state.value(fetcherXPos);
+    state.value(fetcherYPos);
+    state.value(tileXPos);
+    state.value(tileYPos);
+
+    state.value(tilemapBaseAddr);
+    state.bytes(tile.tileData, sizeof(tile.tileData));
+}
+
+template FifoPixel *BgFifo::cycle<DMG>();
+template FifoPixel *BgFifo::cycle<CGB>();
+template void BgFifo::cycleFetcher<DMG>();
+template void BgFifo::cycleFetcher<CGB>();
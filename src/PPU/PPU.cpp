@@ -2,7 +2,13 @@
 #include "Config.hpp"
 #include "GameBoy.hpp"
 #include "Memory.hpp"
+#include "RenderThread.hpp"
 #include "SM83.hpp"
+#include "StateSerializer.hpp"
+#include "Timeline.hpp"
+
+// Indexed by LcdMode
+static const char *timelineModeNames[4] = {"HBlank", "VBlank", "OAM search", "Draw"};
 
 PPU::PPU()
 {
@@ -16,6 +22,9 @@ PPU::PPU()
     oamDmaActive = false;
     vramGeneralDmaActive = false;
     vramHblankDmaActive = false;
+    modeStartTime = 0;
+    oamDmaStartTime = 0;
+    vramDmaStartTime = 0;
     currentModeTCycles = 0;
     hBlankModeLength = PPU_DEFAULT_HBLANK_T_CYCLES;
     drawModeLength = PPU_DEFAULT_DRAW_T_CYCLES;
@@ -94,8 +103,16 @@ void PPU::setModeFlag(uint8_t val)
     if (val > 3)
         return;
 
-    uint8_t byte = memory->readmem(0xFF41, true) & 0xFC;
-    byte |= val;
+    uint8_t byte = memory->readmem(0xFF41, true);
+
+    if (Timeline::ppuModes && Timeline::enabled.load(std::memory_order_relaxed)) {
+        uint64_t now = Timeline::now();
+        if (modeStartTime != 0)
+            Timeline::record(timelineModeNames[byte & 0x3], "PPU", modeStartTime, now);
+        modeStartTime = now;
+    }
+
+    byte = (byte & 0xFC) | val;
     memory->writemem(byte, 0xFF41, true);
 }
 
@@ -258,6 +275,14 @@ BgMapAttributes PPU::getBgMapByIndex(int index, int tilemap)
 }
 
 void PPU::searchSpritesOnLine()
+{
+    if (emulatorMode == CGB)
+        searchSpritesOnLine<CGB>();
+    else
+        searchSpritesOnLine<DMG>();
+}
+
+template <EmulatorMode mode> void PPU::searchSpritesOnLine()
 {
     // In 8x8 mode sprite is from yPos-16 to yPos-8, and in 8x16 form yPos-16 to yPos
     uint8_t spriteHeightDiff = getObjSize() == 0 ? 8 : 0;
@@ -269,7 +294,7 @@ void PPU::searchSpritesOnLine()
 
     numSpritesOnCurrentLine = 0;
 
-    if (emulatorMode == EmulatorMode::DMG) {
+    if constexpr (mode == EmulatorMode::DMG) {
         std::vector<OAMSprite> spritesOnCurrentLineVec;
         for (uint i = 0; i < PPU_NUM_SPRITES; ++i) {
             OAMSprite sprite = getSpriteByIndex(i);
@@ -297,7 +322,7 @@ void PPU::searchSpritesOnLine()
         }
     }
 
-    else if (emulatorMode == EmulatorMode::CGB) {
+    else if constexpr (mode == EmulatorMode::CGB) {
         for (int i = 0; i < PPU_NUM_SPRITES && numSpritesOnCurrentLine < PPU_MAX_SPRITES_ON_LINE;
              ++i) {
             OAMSprite sprite = getSpriteByIndex(i);
@@ -306,6 +331,53 @@ void PPU::searchSpritesOnLine()
                 spritesOnCurrentLine[numSpritesOnCurrentLine++] = i;
         }
     }
+
+    // OAM and VRAM can't be written during mode 3, so the rows can be fetched now
+    for (uint8_t i = 0; i < numSpritesOnCurrentLine; ++i)
+        fetchSpriteRow<mode>(spritesOnCurrentLine[i], spriteRows[i]);
+}
+
+template <EmulatorMode mode> void PPU::fetchSpriteRow(uint8_t spriteIndex, SpriteRow &spriteRow)
+{
+    OAMSprite sprite = getSpriteByIndex(spriteIndex);
+    uint8_t vramBank = mode == EmulatorMode::DMG ? 0 : sprite.tileVramBank;
+
+    // In 8x16 mode the two tiles are consecutive, so the row can be addressed past the first one
+    uint8_t height = getObjSize() == 0 ? 8 : 16;
+    uint8_t tileNumber = getObjSize() == 0 ? sprite.tileNumber : sprite.tileNumber & 0xFE;
+    uint8_t row = (getLy() - sprite.yPos + 16) & (height - 1);
+    if (sprite.yFlip)
+        row = height - 1 - row;
+
+    uint16_t rowAddr = 0x8000 + tileNumber * 16 + row * 2;
+
+    uint8_t oldVramBank = memory->getCurrentVramBank();
+    memory->setCurrentVramBank(vramBank);
+    uint8_t low = memory->readmem(rowAddr, true);
+    uint8_t high = memory->readmem(rowAddr + 1, true);
+    memory->setCurrentVramBank(oldVramBank);
+
+    uint8_t colors[8];
+    Tile::decodeRow(low, high, colors, sprite.xFlip);
+
+    spriteRow.sprite = sprite;
+    for (uint8_t i = 0; i < 8; ++i) {
+        FifoPixel &pixel = spriteRow.pixels[i];
+        pixel = FifoPixel();
+        pixel.isSprite = true;
+        pixel.color = colors[i];
+        pixel.spriteBgAndWindowOverObjPriority = sprite.objToBgPriority;
+        pixel.spriteIndex = spriteIndex;
+        if constexpr (mode == EmulatorMode::DMG) {
+            pixel.palette = sprite.dmgPaletteNumber;
+            pixel.spritePriority = sprite.xPos;
+        } else {
+            // Only in CGB mode the sprite index priority matters
+            pixel.palette = sprite.cgbPaletteNumber;
+            pixel.spritePriority = spriteIndex;
+            pixel.bgPriority = sprite.objToBgPriority;
+        }
+    }
 }
 
 Tile PPU::getSpriteTile(int index, int tileNo, int vramBank)
@@ -334,7 +406,14 @@ Tile PPU::getSpriteTile(int index, int tileNo, int vramBank)
 
 Color PPU::getColorFromFifoPixel(FifoPixel *fifoPixel, bool normalizeCgbColor)
 {
-    if (emulatorMode == EmulatorMode::DMG) {
+    return emulatorMode == CGB ? getColorFromFifoPixel<CGB>(fifoPixel, normalizeCgbColor)
+                               : getColorFromFifoPixel<DMG>(fifoPixel, normalizeCgbColor);
+}
+
+template <EmulatorMode mode>
+Color PPU::getColorFromFifoPixel(FifoPixel *fifoPixel, bool normalizeCgbColor)
+{
+    if constexpr (mode == EmulatorMode::DMG) {
         // DMG Mode
         if (!fifoPixel->isSprite) {
             // BG/Window Pixel
@@ -397,6 +476,14 @@ Color PPU::getColorFromFifoPixel(FifoPixel *fifoPixel, bool normalizeCgbColor)
 }
 
 void PPU::cycle()
+{
+    if (emulatorMode == CGB)
+        cycle<CGB>();
+    else
+        cycle<DMG>();
+}
+
+template <EmulatorMode mode, bool scanline> void PPU::cycle()
 {
     LcdMode currentMode = getLcdMode();
     FifoPixel *bgPixel = nullptr;
@@ -414,21 +501,24 @@ void PPU::cycle()
             if (getLy() == getLyc()) {
                 setCoincidenceFlag(1);
                 if (getLycLyCoincidence())
-                    cpu->setLCDSTATInterruptFlag(1);
+                    memory->requestInterrupt(INTERRUPT_LCD_STAT);
             } else {
                 setCoincidenceFlag(0);
             }
 
             // check oam interrupt
             if (getMode2OamInterrupt())
-                cpu->setLCDSTATInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_LCD_STAT);
         }
 
         ++currentModeTCycles;
 
         // check for transition to next mode
         if (currentModeTCycles == PPU_OAM_SEARCH_T_CYCLES) {
-            searchSpritesOnLine();
+            if (scanline && renderThread != nullptr)
+                renderThread->log(RENDER_LOG_SEARCH, getLy(), windowYTrigger);
+            else
+                searchSpritesOnLine<mode>();
             setModeFlag(DRAW);
             xPos = 0;
             windowXCounter = 0;
@@ -438,6 +528,33 @@ void PPU::cycle()
         break;
 
     case DRAW:
+        if constexpr (scanline) {
+            if (currentModeTCycles == 0) {
+                if (renderThread != nullptr)
+                    renderThread->log(RENDER_LOG_DRAW, getLy());
+                else
+                    renderScanline<mode>();
+            }
+
+            ++currentModeTCycles;
+
+            if (currentModeTCycles == PPU_DEFAULT_DRAW_T_CYCLES) {
+                if (renderThread != nullptr)
+                    renderThread->log(RENDER_LOG_DRAW_END, getLy());
+                else if (bgFifo.isDrawingWindow)
+                    ++windowYCounter;
+
+                setModeFlag(H_BLANK);
+                hBlankModeLength = PPU_DEFAULT_HBLANK_T_CYCLES;
+                currentModeTCycles = 0;
+
+                if (lcdWasTurnedOn)
+                    lcdWasTurnedOn = false;
+            }
+
+            break;
+        }
+
         // Note: Mode 3 can be lengthened by 117 t cycles
         // 1 sprite lengthens mode 3 by 11 cycles, and the SCX penalty lengthens mode 3 by a maximum
         // of 7 t cycles
@@ -467,12 +584,12 @@ void PPU::cycle()
             windowXTrigger = false;
         }
 
-        spriteFifo.checkForSprite();
+        spriteFifo.checkForSprite<mode>();
 
-        spritePixel = spriteFifo.cycle();
-        bgPixel = bgFifo.cycle();
+        spritePixel = spriteFifo.cycle<mode>();
+        bgPixel = bgFifo.cycle<mode>();
 
-        colorPixel = mixPixels(bgPixel, spritePixel);
+        colorPixel = mixPixels<mode>(bgPixel, spritePixel);
 
         if (colorPixel != nullptr) {
             display[getLy()][xPos++] = *colorPixel;
@@ -526,7 +643,7 @@ void PPU::cycle()
         if (currentModeTCycles == 0) {
             // Check HBlank interrupt
             if (getMode0HBlankInterrupt())
-                cpu->setLCDSTATInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_LCD_STAT);
         }
 
         ++currentModeTCycles;
@@ -543,6 +660,7 @@ void PPU::cycle()
             // HBlank DMA
             if (vramHblankDmaActive) {
                 // Transfers 0x10 bytes per hblank
+                TIMELINE_SCOPE("HBlank DMA", "DMA");
                 uint16_t srcAddr = getHdmaSrcAddress() + vramDmaTransferredBytes;
                 uint16_t destAddr = getHdmaDestAddress() + vramDmaTransferredBytes;
 
@@ -574,7 +692,7 @@ void PPU::cycle()
                 if (getLy() == getLyc()) {
                     setCoincidenceFlag(1);
                     if (getLycLyCoincidence())
-                        cpu->setLCDSTATInterruptFlag(1);
+                        memory->requestInterrupt(INTERRUPT_LCD_STAT);
                 } else {
                     setCoincidenceFlag(0);
                 }
@@ -596,9 +714,9 @@ void PPU::cycle()
     case V_BLANK:
         if (currentModeTCycles == 0) {
             // trigger vblank interrupt
-            cpu->setVBlankInterruptFlag(1);
+            memory->requestInterrupt(INTERRUPT_VBLANK);
             if (getMode1VBlankInterrupt())
-                cpu->setLCDSTATInterruptFlag(1);
+                memory->requestInterrupt(INTERRUPT_LCD_STAT);
             // Set that frame is ready to be drawn
             readyToDraw = true;
             ++renderedFrames;
@@ -611,7 +729,7 @@ void PPU::cycle()
             // if (getLy() == getLyc()) {
             //     setCoincidenceFlag(1);
             //     if (getLycLyCoincidence())
-            //         cpu->setLCDSTATInterruptFlag(1);
+            //         memory->requestInterrupt(INTERRUPT_LCD_STAT);
             // } else {
             //     setCoincidenceFlag(0);
             // }
@@ -627,12 +745,14 @@ void PPU::cycle()
                 if (getLy() == getLyc()) {
                     setCoincidenceFlag(1);
                     if (getLycLyCoincidence())
-                        cpu->setLCDSTATInterruptFlag(1);
+                        memory->requestInterrupt(INTERRUPT_LCD_STAT);
                 } else {
                     setCoincidenceFlag(0);
                 }
 
                 windowYCounter = 0;
+                if (scanline && renderThread != nullptr)
+                    renderThread->log(RENDER_LOG_FRAME_START, 0);
 
                 // Change mode
                 setModeFlag(OAM_SEARCH);
@@ -648,12 +768,14 @@ void PPU::cycle()
                 if (getLy() == getLyc()) {
                     setCoincidenceFlag(1);
                     if (getLycLyCoincidence())
-                        cpu->setLCDSTATInterruptFlag(1);
+                        memory->requestInterrupt(INTERRUPT_LCD_STAT);
                 } else {
                     setCoincidenceFlag(0);
                 }
 
-                if (bgFifo.isDrawingWindow && getWindowDisplayEnable())
+                if (scanline && renderThread != nullptr)
+                    renderThread->log(RENDER_LOG_VBLANK_LINE, getLy());
+                else if (bgFifo.isDrawingWindow && getWindowDisplayEnable())
                     ++windowYCounter;
             }
         }
@@ -667,6 +789,9 @@ void PPU::cycle()
 void PPU::oamDmaCycle()
 {
     if (oamDmaActive) {
+        if (oamDmaCurrentCycles == 0 && Timeline::enabled.load(std::memory_order_relaxed))
+            oamDmaStartTime = Timeline::now();
+
         ++oamDmaCurrentCycles;
         if (oamDmaCurrentCycles == PPU_OAM_DMA_T_CYCLES) {
             // Copy the data from src to dest
@@ -676,6 +801,11 @@ void PPU::oamDmaCycle()
                 memory->writemem(val, MEM_OAM_START + i, true, true);
             }
 
+            if (oamDmaStartTime != 0) {
+                Timeline::record("OAM DMA", "DMA", oamDmaStartTime, Timeline::now());
+                oamDmaStartTime = 0;
+            }
+
             // Cleanup
             oamDmaActive = false;
             oamDmaCurrentCycles = 0;
@@ -691,6 +821,10 @@ void PPU::vramDmaCycle()
         // to transfer 0x10 bytes
         // inc by 2 in normal speed mode, and by 1 in double speed mode
         // does not modify 0xFF55 because all data is transferred at once and the program is halted
+        if (vramDmaTransferredBytes == 0 && vramDmaCurrentCycles == 0 &&
+            Timeline::enabled.load(std::memory_order_relaxed))
+            vramDmaStartTime = Timeline::now();
+
         if (doubleSpeedMode)
             ++vramDmaCurrentCycles;
         else
@@ -710,6 +844,11 @@ void PPU::vramDmaCycle()
 
             // Check if transfer has ended
             if ((vramDmaTransferredBytes / 16) - 1 >= vramDmaLength) {
+                if (vramDmaStartTime != 0) {
+                    Timeline::record("VRAM DMA", "DMA", vramDmaStartTime, Timeline::now());
+                    vramDmaStartTime = 0;
+                }
+
                 vramGeneralDmaActive = false;
                 vramDmaTransferredBytes = 0;
                 memory->ioRegisters[0xFF55 - MEM_IO_START] = 0xFF;
@@ -719,6 +858,12 @@ void PPU::vramDmaCycle()
 }
 
 Color *PPU::mixPixels(FifoPixel *bgPixel, FifoPixel *spritePixel)
+{
+    return emulatorMode == CGB ? mixPixels<CGB>(bgPixel, spritePixel)
+                               : mixPixels<DMG>(bgPixel, spritePixel);
+}
+
+template <EmulatorMode mode> Color *PPU::mixPixels(FifoPixel *bgPixel, FifoPixel *spritePixel)
 {
     // If there is no bg pixel, return null by default
     if (bgPixel == nullptr) {
@@ -727,78 +872,228 @@ Color *PPU::mixPixels(FifoPixel *bgPixel, FifoPixel *spritePixel)
 
     // TODO: Do I need to check if sprites are enabled?
     if (spritePixel == nullptr || !getObjDisplayEnable()) {
-        if (emulatorMode == EmulatorMode::DMG && getBgWindowDisplayPriority() == 0) {
+        if (mode == EmulatorMode::DMG && getBgWindowDisplayPriority() == 0) {
             // Only sprites can be displayed, bg and window become blank (white)
             return new Color(255, 255, 255);
         } else {
-            return new Color(getColorFromFifoPixel(bgPixel));
+            return new Color(getColorFromFifoPixel<mode>(bgPixel));
         }
     }
 
     // If there is a bg pixel and a sprite pixel
-    if (emulatorMode == EmulatorMode::DMG) {
+    if constexpr (mode == EmulatorMode::DMG) {
         // Transparent sprite pixel
         if (spritePixel->color == 0) {
             if (getBgWindowDisplayPriority() == 0) {
                 return new Color(255, 255, 255);
             } else {
-                return new Color(getColorFromFifoPixel(bgPixel));
+                return new Color(getColorFromFifoPixel<mode>(bgPixel));
             }
         }
 
         // LCDC.0 = 0, only sprites can be displayed, bg and window become blank
         if (getBgWindowDisplayPriority() == 0) {
-            return new Color(getColorFromFifoPixel(spritePixel));
+            return new Color(getColorFromFifoPixel<mode>(spritePixel));
         }
 
         if (spritePixel->spriteBgAndWindowOverObjPriority == 0) {
-            return new Color(getColorFromFifoPixel(spritePixel));
+            return new Color(getColorFromFifoPixel<mode>(spritePixel));
         }
 
         else if (spritePixel->spriteBgAndWindowOverObjPriority == 1) {
             if (bgPixel->color == 0) {
-                return new Color(getColorFromFifoPixel(spritePixel));
+                return new Color(getColorFromFifoPixel<mode>(spritePixel));
             } else {
-                return new Color(getColorFromFifoPixel(bgPixel));
+                return new Color(getColorFromFifoPixel<mode>(bgPixel));
             }
         }
     }
 
-    else if (emulatorMode == EmulatorMode::CGB) {
+    else if constexpr (mode == EmulatorMode::CGB) {
         // priority order:
         // LCDC.0 > bg map attr > oam priority
 
         // Transparent Sprite Pixel
         if (spritePixel->color == 0) {
-            return new Color(getColorFromFifoPixel(bgPixel));
+            return new Color(getColorFromFifoPixel<mode>(bgPixel));
         }
 
         // LCDC.0 = 0
         if (getBgWindowDisplayPriority() == 0) {
-            return new Color(getColorFromFifoPixel(spritePixel));
+            return new Color(getColorFromFifoPixel<mode>(spritePixel));
         }
 
         // Bg Map Attr priority
         if (bgPixel->bgPriority == 1) {
             if (bgPixel->color == 0) {
-                return new Color(getColorFromFifoPixel(spritePixel));
+                return new Color(getColorFromFifoPixel<mode>(spritePixel));
             } else {
-                return new Color(getColorFromFifoPixel(bgPixel));
+                return new Color(getColorFromFifoPixel<mode>(bgPixel));
             }
         }
 
         if (spritePixel->spriteBgAndWindowOverObjPriority == 0) {
-            return new Color(getColorFromFifoPixel(spritePixel));
+            return new Color(getColorFromFifoPixel<mode>(spritePixel));
         }
 
         else if (spritePixel->spriteBgAndWindowOverObjPriority == 1) {
             if (bgPixel->color == 0) {
-                return new Color(getColorFromFifoPixel(spritePixel));
+                return new Color(getColorFromFifoPixel<mode>(spritePixel));
             } else {
-                return new Color(getColorFromFifoPixel(bgPixel));
+                return new Color(getColorFromFifoPixel<mode>(bgPixel));
             }
         }
     }
 
     return nullptr;
 }
+
+void PPU::serialize(StateSerializer &state)
+{
+    state.value(renderedFrames);
+    state.value(doubleSpeedMode);
+    state.value(readyToDraw);
+    state.value(lcdWasTurnedOn);
+
+    state.value(drawModeLength);
+    state.value(hBlankModeLength);
+
+    state.bytes(spritesOnCurrentLine, sizeof(spritesOnCurrentLine));
+    state.value(numSpritesOnCurrentLine);
+    state.bytes(spriteRows, sizeof(spriteRows));
+
+    state.value(windowYCounter);
+    state.value(windowXCounter);
+    state.value(windowYTrigger);
+    state.value(windowXTrigger);
+
+    bgFifo.serialize(state);
+    spriteFifo.serialize(state);
+
+    state.value(oamDmaActive);
+    state.value(oamDmaCurrentCycles);
+
+    state.value(vramGeneralDmaActive);
+    state.value(vramHblankDmaActive);
+    state.value(vramDmaLength);
+    state.value(vramDmaTransferredBytes);
+    state.value(vramDmaCurrentCycles);
+
+    state.value(tCycles);
+    state.value(currentModeTCycles);
+    state.value(currentOamDmaTCycles);
+
+    state.value(xPos);
+}
+
+template <EmulatorMode mode> void PPU::renderScanline()
+{
+    uint8_t line = getLy();
+    uint8_t scrollX = getScrollX();
+    uint8_t scrollY = getScrollY();
+    uint8_t wx = getWx();
+    bool windowEnabled = getWindowDisplayEnable() && windowYTrigger;
+    bool drawingWindow = false;
+
+    // The sprite rows were fetched by the OAM search
+    uint8_t numSprites = getObjDisplayEnable() ? numSpritesOnCurrentLine : 0;
+    int16_t spriteX[PPU_MAX_SPRITES_ON_LINE];
+    for (uint8_t i = 0; i < numSprites; ++i)
+        spriteX[i] = spriteRows[i].sprite.xPos - 8;
+
+    int fetchedTile = -1;
+    uint8_t bgRow[8];
+    BgMapAttributes bgMapAttr;
+
+    for (uint8_t x = 0; x < PPU_SCREEN_WIDTH; ++x) {
+        if (!drawingWindow && windowEnabled && x + 7 >= wx) {
+            drawingWindow = true;
+            fetchedTile = -1;
+        }
+
+        uint16_t tilemapBaseAddr;
+        uint8_t mapX, mapY, fineX, fineY;
+        if (drawingWindow) {
+            tilemapBaseAddr = getWindowTileMapDisplaySelect() == 0 ? 0x9800 : 0x9C00;
+            uint8_t windowX = x + 7 - wx;
+            mapX = windowX / 8;
+            fineX = windowX % 8;
+            mapY = (windowYCounter / 8) & 0x1F;
+            fineY = windowYCounter % 8;
+        } else {
+            tilemapBaseAddr = getBgTileMapDisplaySelect() == 0 ? 0x9800 : 0x9C00;
+            uint8_t bgX = scrollX + x;
+            uint8_t bgY = scrollY + line;
+            mapX = bgX / 8;
+            fineX = bgX % 8;
+            mapY = bgY / 8;
+            fineY = bgY % 8;
+        }
+
+        // Fetch the tile row once per tile
+        int tileMapIndex = (mapY & 0x1F) * 32 + (mapX & 0x1F);
+        if (tileMapIndex != fetchedTile) {
+            fetchedTile = tileMapIndex;
+
+            uint8_t originalVramBank = memory->getCurrentVramBank();
+            memory->setCurrentVramBank(0);
+            uint8_t tileIndex = memory->readmem(tilemapBaseAddr + tileMapIndex, true);
+
+            Tile tile;
+            if constexpr (mode == EmulatorMode::CGB) {
+                bgMapAttr = getBgMapByIndex(tileMapIndex, tilemapBaseAddr == 0x9800 ? 0 : 1);
+                memory->setCurrentVramBank(bgMapAttr.tileVramBankNumber);
+                tile = getTileByIndex(tileIndex);
+
+                if (bgMapAttr.horizontalFlip)
+                    tile.flipHor();
+                if (bgMapAttr.verticalFlip)
+                    tile.flipVert();
+            } else {
+                tile = getTileByIndex(tileIndex);
+            }
+
+            memory->setCurrentVramBank(originalVramBank);
+            tile.getTileRow(fineY, bgRow);
+        }
+
+        FifoPixel bgPixel = FifoPixel(bgRow[fineX], 0, 0, 0, 0, false);
+        if constexpr (mode == EmulatorMode::CGB) {
+            bgPixel.palette = bgMapAttr.bgPaletteNumber;
+            bgPixel.bgPriority = bgMapAttr.bgToOamPriority;
+        }
+
+        // Pick the opaque sprite pixel with the highest priority
+        FifoPixel *spritePixel = nullptr;
+        for (uint8_t i = 0; i < numSprites; ++i) {
+            if (x < spriteX[i] || x >= spriteX[i] + 8)
+                continue;
+
+            FifoPixel *pixel = &spriteRows[i].pixels[x - spriteX[i]];
+            if (pixel->color == 0)
+                continue;
+
+            if (spritePixel == nullptr || pixel->spritePriority < spritePixel->spritePriority ||
+                (pixel->spritePriority == spritePixel->spritePriority &&
+                 pixel->spriteIndex < spritePixel->spriteIndex))
+                spritePixel = pixel;
+        }
+
+        Color *colorPixel = mixPixels<mode>(&bgPixel, spritePixel);
+        display[line][x] = *colorPixel;
+        delete colorPixel;
+    }
+
+    bgFifo.isDrawingWindow = drawingWindow;
+}
+
+template void PPU::cycle<DMG, false>();
+template void PPU::cycle<DMG, true>();
+template void PPU::cycle<CGB, false>();
+template void PPU::cycle<CGB, true>();
+template void PPU::searchSpritesOnLine<DMG>();
+template void PPU::searchSpritesOnLine<CGB>();
+template void PPU::renderScanline<DMG>();
+template void PPU::renderScanline<CGB>();
+template void PPU::fetchSpriteRow<DMG>(uint8_t spriteIndex, SpriteRow &spriteRow);
+template void PPU::fetchSpriteRow<CGB>(uint8_t spriteIndex, SpriteRow &spriteRow);
@@ -0,0 +1,166 @@
+#include "RenderThread.hpp"
+#include "Timeline.hpp"
+#include <cstring>
+
+RenderThread::RenderThread()
+{
+    memory.ppu = &ppu;
+    ppu.memory = &memory;
+    ppu.cpu = nullptr;
+}
+
+RenderThread::~RenderThread() { stop(); }
+
+void RenderThread::start(PPU *source)
+{
+    stop();
+
+    this->source = source;
+    memory.mode = source->memory->mode;
+    ppu.emulatorMode = source->emulatorMode;
+
+    // Lines that are never drawn (e.g. while the LCD is off) keep what the emulator PPU had
+    memcpy(ppu.display, source->display, sizeof(ppu.display));
+    syncFromSource();
+
+    queuedFrames = 0;
+    collectedFrames = 0;
+    completedFrames = 0;
+
+    replayLog.start();
+
+    source->renderThread = this;
+}
+
+void RenderThread::stop()
+{
+    if (!replayLog.isRunning())
+        return;
+
+    drain();
+    syncToSource();
+    replayLog.stop();
+
+    source->renderThread = nullptr;
+    source = nullptr;
+}
+
+void RenderThread::endFrame()
+{
+    log(RENDER_LOG_FRAME_END, 0);
+    ++queuedFrames;
+}
+
+bool RenderThread::collectFrame(Color *dest)
+{
+    if (collectedFrames == queuedFrames)
+        return false;
+
+    if (completedFrames.load(std::memory_order_acquire) < queuedFrames) {
+        TIMELINE_SCOPE("Wait for render thread", "Video");
+        while (completedFrames.load(std::memory_order_acquire) < queuedFrames)
+            std::this_thread::yield();
+    }
+
+    // Nothing else is logged until the next frame ends, so frame isn't written meanwhile
+    memcpy(dest, frame, sizeof(frame));
+    collectedFrames = queuedFrames;
+    return true;
+}
+
+void RenderThread::syncFromSource()
+{
+    Memory *sourceMemory = source->memory;
+    memcpy(memory.vram, sourceMemory->vram, sizeof(memory.vram));
+    memcpy(memory.oam, sourceMemory->oam, sizeof(memory.oam));
+    memcpy(memory.ioRegisters, sourceMemory->ioRegisters, sizeof(memory.ioRegisters));
+    memcpy(memory.cgbBgColorPalette, sourceMemory->cgbBgColorPalette,
+           sizeof(memory.cgbBgColorPalette));
+    memcpy(memory.cgbObjColorPalette, sourceMemory->cgbObjColorPalette,
+           sizeof(memory.cgbObjColorPalette));
+
+    ppu.windowYCounter = source->windowYCounter;
+    ppu.windowYTrigger = source->windowYTrigger;
+    ppu.bgFifo.isDrawingWindow = source->bgFifo.isDrawingWindow;
+    memcpy(ppu.spritesOnCurrentLine, source->spritesOnCurrentLine,
+           sizeof(ppu.spritesOnCurrentLine));
+    ppu.numSpritesOnCurrentLine = source->numSpritesOnCurrentLine;
+    memcpy(ppu.spriteRows, source->spriteRows, sizeof(ppu.spriteRows));
+}
+
+void RenderThread::syncToSource()
+{
+    // windowYTrigger is set by the emulator PPU, the shadow one only gets a copy
+    source->windowYCounter = ppu.windowYCounter;
+    source->bgFifo.isDrawingWindow = ppu.bgFifo.isDrawingWindow;
+    memcpy(source->spritesOnCurrentLine, ppu.spritesOnCurrentLine,
+           sizeof(ppu.spritesOnCurrentLine));
+    source->numSpritesOnCurrentLine = ppu.numSpritesOnCurrentLine;
+    memcpy(source->spriteRows, ppu.spriteRows, sizeof(ppu.spriteRows));
+}
+
+void RenderThread::replay(const RenderLogEntry &entry)
+{
+    if (ppu.emulatorMode == CGB)
+        replay<CGB>(entry);
+    else
+        replay<DMG>(entry);
+}
+
+template <EmulatorMode mode> void RenderThread::replay(const RenderLogEntry &entry)
+{
+    switch (entry.type) {
+    case RENDER_LOG_VRAM:
+        memory.vram[entry.address] = entry.value;
+        break;
+
+    case RENDER_LOG_OAM:
+        memory.oam[entry.address] = entry.value;
+        break;
+
+    case RENDER_LOG_IO:
+        memory.ioRegisters[entry.address] = entry.value;
+        break;
+
+    case RENDER_LOG_BG_PALETTE:
+        memory.cgbBgColorPalette[entry.address] = entry.value;
+        break;
+
+    case RENDER_LOG_OBJ_PALETTE:
+        memory.cgbObjColorPalette[entry.address] = entry.value;
+        break;
+
+    // The rest is what PPU::cycle does at the same points with the scanline PPU
+
+    case RENDER_LOG_SEARCH:
+        memory.ioRegisters[0xFF44 - MEM_IO_START] = entry.address;
+        ppu.windowYTrigger = entry.value;
+        ppu.searchSpritesOnLine<mode>();
+        break;
+
+    case RENDER_LOG_DRAW:
+        memory.ioRegisters[0xFF44 - MEM_IO_START] = entry.address;
+        ppu.renderScanline<mode>();
+        break;
+
+    case RENDER_LOG_DRAW_END:
+        if (ppu.bgFifo.isDrawingWindow)
+            ++ppu.windowYCounter;
+        break;
+
+    case RENDER_LOG_VBLANK_LINE:
+        if (ppu.bgFifo.isDrawingWindow && ppu.getWindowDisplayEnable())
+            ++ppu.windowYCounter;
+        break;
+
+    case RENDER_LOG_FRAME_START:
+        ppu.windowYCounter = 0;
+        break;
+
+    case RENDER_LOG_FRAME_END:
+        memcpy(frame, ppu.display, sizeof(frame));
+        completedFrames.store(completedFrames.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_release);
+        break;
+    }
+}
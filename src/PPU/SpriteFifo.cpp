@@ -1,20 +1,34 @@
 #include "SpriteFifo.hpp"
 #include "PPU.hpp"
+#include "StateSerializer.hpp"
 
 SpriteFifo::SpriteFifo() {}
 
 SpriteFifo::SpriteFifo(PPU *ppu) : ppu(ppu) {}
 
 void SpriteFifo::checkForSprite()
+{
+    if (ppu->emulatorMode == CGB)
+        checkForSprite<CGB>();
+    else
+        checkForSprite<DMG>();
+}
+
+FifoPixel *SpriteFifo::cycle()
+{
+    return ppu->emulatorMode == CGB ? cycle<CGB>() : cycle<DMG>();
+}
+
+template <EmulatorMode mode> void SpriteFifo::checkForSprite()
 {
     if (!fetchingSprite &&
-        !(ppu->emulatorMode == EmulatorMode::DMG && !ppu->getObjDisplayEnable())) {
+        !(mode == EmulatorMode::DMG && !ppu->getObjDisplayEnable())) {
         for (int i = 0; i < ppu->numSpritesOnCurrentLine; ++i) {
             int8_t spriteIndex = ppu->spritesOnCurrentLine[i];
             if (spriteIndex == -1 || processedSprites.find(spriteIndex) != processedSprites.end())
                 continue;
 
-            OAMSprite sprite = ppu->getSpriteByIndex(spriteIndex);
+            const OAMSprite &sprite = ppu->spriteRows[i].sprite;
 
             if (sprite.xPos - 8 == fetcherXPos || (sprite.xPos - 8 < 0 && fetcherXPos == 0) ||
                 (sprite.xPos - 8 > 160 && fetcherXPos == 160)) {
@@ -41,7 +55,7 @@ void SpriteFifo::checkForSprite()
     }
 }
 
-FifoPixel *SpriteFifo::cycle()
+template <EmulatorMode mode> FifoPixel *SpriteFifo::cycle()
 {
     FifoPixel *returnedPixel = nullptr;
 
@@ -137,56 +151,10 @@ FifoPixel *SpriteFifo::cycle()
 
         // Stage 6 (get sprite)
         else if (fetcherStage == 6) {
-            OAMSprite sprite = ppu->getSpriteByIndex(currentSpriteIndex);
-
-            // Get tile
-            uint8_t screenLine = ppu->getLy();
-            uint8_t tileNo = 0;
-            uint8_t vramBank = ppu->emulatorMode == EmulatorMode::DMG ? 0 : sprite.tileVramBank;
-
-            if (ppu->getObjSize() == 1) {
-                // 8x16
-                tileNo = (screenLine - sprite.yPos + 16) / 8;
-                if (sprite.yFlip)
-                    tileNo = !tileNo;
-            }
-
-            Tile tile;
-            if (ppu->getObjSize() == 0)
-                tile = ppu->getSpriteTile(sprite.tileNumber, tileNo, vramBank);
-            else
-                tile = ppu->getSpriteTile(sprite.tileNumber & 0xFE, tileNo, vramBank);
-
-            // Flip tile if necessary
-            if (sprite.xFlip)
-                tile.flipHor();
-
-            if (sprite.yFlip)
-                tile.flipVert();
-
-            // Get row from tile
-            uint8_t tileRow = (screenLine - sprite.yPos + 16) % 8;
-            uint8_t tileRowData[8];
-
-            tile.getTileRow(tileRow, tileRowData);
-
-            // Set pixels
-            FifoPixel pixels[8];
-            for (int i = 0; i < 8; ++i) {
-                pixels[i].isSprite = true;
-                pixels[i].color = tileRowData[i];
-                pixels[i].spriteBgAndWindowOverObjPriority = sprite.objToBgPriority;
-                pixels[i].spriteIndex = currentSpriteIndex;
-                if (ppu->emulatorMode == EmulatorMode::DMG) {
-                    pixels[i].palette = sprite.dmgPaletteNumber;
-                    pixels[i].spritePriority = sprite.xPos;
-                } else {
-                    // Only in CGB mode the sprite index priority matters
-                    pixels[i].palette = sprite.cgbPaletteNumber;
-                    pixels[i].spritePriority = currentSpriteIndex;
-                    pixels[i].bgPriority = sprite.objToBgPriority;
-                }
-            }
+            // The row was fetched and flipped by the OAM search
+            const SpriteRow &spriteRow = ppu->spriteRows[spriteIndexInFoundSprites];
+            const OAMSprite &sprite = spriteRow.sprite;
+            const FifoPixel *pixels = spriteRow.pixels;
 
             // Check for previous pixels and do the mixing
             std::vector<FifoPixel> pixelQueueVector;
@@ -216,7 +184,7 @@ FifoPixel *SpriteFifo::cycle()
 
                     else {
                         // check the sprite priorities
-                        if (ppu->emulatorMode == EmulatorMode::DMG) {
+                        if constexpr (mode == EmulatorMode::DMG) {
                             // DMG
                             // smallest x pos; smallest oam index
                             if (pixels[i].spritePriority < pixelQueueVector[i].spritePriority) {
@@ -229,7 +197,7 @@ FifoPixel *SpriteFifo::cycle()
                                 pixelQueueVector[i] = pixels[i];
                             }
 
-                        } else if (ppu->emulatorMode == EmulatorMode::CGB) {
+                        } else if constexpr (mode == EmulatorMode::CGB) {
                             // CGB
                             // smallest oam index
                             if (pixels[i].spritePriority < pixelQueueVector[i].spritePriority) {
@@ -257,12 +225,12 @@ FifoPixel *SpriteFifo::cycle()
             fetchedSprite = true;
             fetchingSprite = false;
             bgFifo->spriteFetchingActive = false;
-            checkForSprite();
+            checkForSprite<mode>();
         }
     }
 
 checkAbort:
-    if (checkForAbort && ppu->emulatorMode == DMG) {
+    if (checkForAbort && mode == DMG) {
         // TODO: Check how abort works on the CGB
         abortFetch = !ppu->getObjDisplayEnable();
 
@@ -288,14 +256,14 @@ checkAbort:
 
     // If not fetching and queue is not empty then push pixel and x pos less than 160
     if (returnedPixel == nullptr && !fetchingSprite && pixelQueue.size() > 0 && fetcherXPos < 160) {
-        if (ppu->emulatorMode == EmulatorMode::DMG ||
-            (ppu->emulatorMode == EmulatorMode::CGB && ppu->getObjDisplayEnable() == 1)) {
+        if (mode == EmulatorMode::DMG ||
+            (mode == EmulatorMode::CGB && ppu->getObjDisplayEnable() == 1)) {
             returnedPixel = new FifoPixel(pixelQueue.front());
         }
 
         pixelQueue.pop();
 
-        checkForSprite();
+        checkForSprite<mode>();
     }
 
     return returnedPixel;
@@ -323,3 +291,31 @@ void SpriteFifo::prepareForLine()
 
     processedSprites.clear();
 }
+
+void SpriteFifo::serialize(StateSerializer &state)
+{
+    state.value(abortFetch);
+    state.value(fetchingSprite);
+    state.value(fetchedSprite);
+    state.value(appliedPenaltyAtXPos0);
+    state.value(checkForAbort);
+    state.value(fetcherStep);
+    state.value(fetcherStage);
+
+    state.value(currentSpriteIndex);
+    state.value(spriteIndexInFoundSprites);
+
+    state.value(oamPenalty);
+    state.value(xPos0Penalty);
+
+    state.queue(pixelQueue);
+    state.set(processedSprites);
+
+    state.value(fetcherXPos);
+    state.value(fetcherYPos);
+}
+
+template void SpriteFifo::checkForSprite<DMG>();
+template void SpriteFifo::checkForSprite<CGB>();
+template FifoPixel *SpriteFifo::cycle<DMG>();
+template FifoPixel *SpriteFifo::cycle<CGB>();
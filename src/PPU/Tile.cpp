@@ -1,36 +1,110 @@
 #include "Tile.hpp"
+#include <array>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The 8 pixels of one bitplane byte, one per byte of the uint64_t (leftmost pixel in the first
+// byte in memory), each 0 or 1
+static constexpr std::array<uint64_t, 256> spreadBits = [] {
+    std::array<uint64_t, 256> table = {};
+    for (int byte = 0; byte < 256; ++byte) {
+        for (int pixel = 0; pixel < 8; ++pixel) {
+            uint64_t bit = (byte >> (7 - pixel)) & 1;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            table[byte] |= bit << (56 - pixel * 8);
+#else
+            table[byte] |= bit << (pixel * 8);
+#endif
+        }
+    }
+    return table;
+}();
+
+// Bitplane bytes with the pixels in the opposite order
+static constexpr std::array<uint8_t, 256> reverseBits = [] {
+    std::array<uint8_t, 256> table = {};
+    for (int byte = 0; byte < 256; ++byte) {
+        for (int bit = 0; bit < 8; ++bit)
+            table[byte] |= ((byte >> bit) & 1) << (7 - bit);
+    }
+    return table;
+}();
 
 Tile::Tile() {}
 
 Tile::Tile(uint8_t *tileAddr)
 {
-    int currPixel = 0;
-    for (int i = 0; i < 16; i += 2) {
-        for (int j = 0; j < 8; ++j) {
-            uint8_t lowBit = (tileAddr[i] & (0x1 << (7 - j))) >> (7 - j);
-            uint8_t highBit = (tileAddr[i + 1] & (0x1 << (7 - j))) >> (7 - j);
+#ifdef __SSE2__
+    // Each pixel is 1 if its bit is set in the plane byte of its row: the plane byte is repeated
+    // once per pixel and tested against the bit of the pixel
+    const __m128i pixelBits =
+        _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0x01, 0x02, 0x04, 0x08,
+                     0x10, 0x20, 0x40, (char)0x80);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+
+    __m128i bytes = _mm_loadu_si128((const __m128i *)tileAddr);
+    // Low and high planes of rows 0-7 in the first 8 bytes
+    __m128i low = _mm_packus_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0xFF)), _mm_setzero_si128());
+    __m128i high = _mm_packus_epi16(_mm_srli_epi16(bytes, 8), _mm_setzero_si128());
+
+    // Every byte 8 times: rows 0-3 from the first half, rows 4-7 from the second
+    __m128i low2 = _mm_unpacklo_epi8(low, low);
+    __m128i high2 = _mm_unpacklo_epi8(high, high);
+    __m128i low4[2] = {_mm_unpacklo_epi16(low2, low2), _mm_unpackhi_epi16(low2, low2)};
+    __m128i high4[2] = {_mm_unpacklo_epi16(high2, high2), _mm_unpackhi_epi16(high2, high2)};
+
+    for (int half = 0; half < 2; ++half) {
+        __m128i low8[2] = {_mm_unpacklo_epi32(low4[half], low4[half]),
+                           _mm_unpackhi_epi32(low4[half], low4[half])};
+        __m128i high8[2] = {_mm_unpacklo_epi32(high4[half], high4[half]),
+                            _mm_unpackhi_epi32(high4[half], high4[half])};
 
-            tileData[currPixel++] = (highBit << 1) | lowBit;
+        // Two rows at a time
+        for (int i = 0; i < 2; ++i) {
+            __m128i lowSet = _mm_cmpeq_epi8(_mm_and_si128(low8[i], pixelBits), pixelBits);
+            __m128i highSet = _mm_cmpeq_epi8(_mm_and_si128(high8[i], pixelBits), pixelBits);
+            __m128i colors = _mm_or_si128(_mm_and_si128(lowSet, one), _mm_and_si128(highSet, two));
+            _mm_storeu_si128((__m128i *)(tileData + half * 32 + i * 16), colors);
         }
     }
+#else
+    for (int row = 0; row < 8; ++row)
+        decodeRow(tileAddr[row * 2], tileAddr[row * 2 + 1], tileData + row * 8);
+#endif
 }
 
-void Tile::getTileRow(uint8_t row, uint8_t *dest)
-{
-    for (int i = 0; i < 8; ++i)
-        dest[i] = tileData[row * 8 + i];
-}
+void Tile::getTileRow(uint8_t row, uint8_t *dest) { memcpy(dest, tileData + row * 8, 8); }
 
 void Tile::flipHor()
 {
-    for (int i = 0; i < 8; ++i)
-        for (int j = 0; j < 4; ++j)
-            std::swap(tileData[i * 8 + j], tileData[i * 8 + 7 - j]);
+    // Reversing the bytes of a row reverses its pixels
+    for (int row = 0; row < 8; ++row) {
+        uint64_t pixels;
+        memcpy(&pixels, tileData + row * 8, 8);
+        pixels = __builtin_bswap64(pixels);
+        memcpy(tileData + row * 8, &pixels, 8);
+    }
 }
 
 void Tile::flipVert()
 {
-    for (int i = 0; i < 4; ++i)
-        for (int j = 0; j < 8; ++j)
-            std::swap(tileData[i * 8 + j], tileData[(7 - i) * 8 + j]);
+    uint64_t rows[8];
+    memcpy(rows, tileData, 64);
+    for (int row = 0; row < 8; ++row)
+        memcpy(tileData + row * 8, &rows[7 - row], 8);
+}
+
+void Tile::decodeRow(uint8_t low, uint8_t high, uint8_t *dest, bool flip)
+{
+    if (flip) {
+        low = reverseBits[low];
+        high = reverseBits[high];
+    }
+
+    uint64_t pixels = spreadBits[low] | (spreadBits[high] << 1);
+    memcpy(dest, &pixels, 8);
 }
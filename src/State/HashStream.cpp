@@ -0,0 +1,136 @@
+#include "HashStream.hpp"
+#include "XXHash.hpp"
+#include <cinttypes>
+#include <cstring>
+#include <iostream>
+
+HashStream::HashStream()
+{
+    frame = 0;
+    count = 0;
+    comparing = false;
+    diverged = false;
+    expected = actual = {};
+    file = nullptr;
+}
+
+HashStream::~HashStream() { close(); }
+
+bool HashStream::open(std::string path)
+{
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "ERROR: Hash stream " << path << " could not be created\n";
+        return false;
+    }
+
+    this->path = path;
+    fwrite(HASH_STREAM_MAGIC, 1, strlen(HASH_STREAM_MAGIC), file);
+    return true;
+}
+
+bool HashStream::close()
+{
+    if (file == nullptr)
+        return true;
+
+    bool error = ferror(file);
+    error |= fclose(file) != 0;
+    file = nullptr;
+
+    if (error) {
+        std::cerr << "ERROR: Hash stream " << path << " could not be written\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool HashStream::loadGolden(std::string path)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        std::cerr << "ERROR: Hash stream " << path << " could not be opened\n";
+        return false;
+    }
+
+    char magic[sizeof(HASH_STREAM_MAGIC) - 1];
+    bool valid = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                 memcmp(magic, HASH_STREAM_MAGIC, sizeof(magic)) == 0;
+
+    golden.clear();
+    HashRecord record;
+    while (valid && fread(&record, sizeof(record), 1, f) == 1)
+        golden.push_back(record);
+    fclose(f);
+
+    if (!valid) {
+        std::cerr << "ERROR: " << path << " is not a hash stream\n";
+        return false;
+    }
+
+    comparing = true;
+    diverged = false;
+    return true;
+}
+
+void HashStream::addFrame(const void *pixels, size_t size)
+{
+    add(HASH_FRAME, xxHash64(pixels, size));
+}
+
+void HashStream::addAudio(const float *samples, uint32_t count)
+{
+    add(HASH_AUDIO, xxHash64(samples, count * sizeof(float)));
+}
+
+void HashStream::add(HashRecordType type, uint64_t hash)
+{
+    HashRecord record = {frame, type, hash};
+
+    if (file != nullptr)
+        fwrite(&record, sizeof(record), 1, file);
+
+    if (comparing && !diverged) {
+        if (count >= golden.size()) {
+            diverged = true;
+            expected = {UINT32_MAX, HASH_FRAME, 0};
+            actual = record;
+        } else if (memcmp(&golden[count], &record, sizeof(record)) != 0) {
+            diverged = true;
+            expected = golden[count];
+            actual = record;
+        }
+    }
+
+    ++count;
+}
+
+void HashStream::printResult()
+{
+    if (!comparing)
+        return;
+
+    if (!diverged) {
+        printf("Hashes match the golden stream (%" PRIu64 " of %zu records compared)\n", count,
+               golden.size());
+        return;
+    }
+
+    if (expected.frame == UINT32_MAX) {
+        printf("Diverged at frame %u: the golden stream ends after %zu records\n", actual.frame,
+               golden.size());
+    } else if (expected.frame != actual.frame || expected.type != actual.type) {
+        // One of the runs produced an audio block the other didn't
+        printf("Diverged at frame %u: expected the %s hash of frame %u, got the %s hash of "
+               "frame %u\n",
+               actual.frame, expected.type == HASH_AUDIO ? "audio" : "frame", expected.frame,
+               actual.type == HASH_AUDIO ? "audio" : "frame", actual.frame);
+    } else {
+        printf("Diverged at frame %u: %s hash %016" PRIx64 ", expected %016" PRIx64 "\n",
+               actual.frame, actual.type == HASH_AUDIO ? "audio" : "frame", actual.hash,
+               expected.hash);
+    }
+}
@@ -0,0 +1,176 @@
+#include "Movie.hpp"
+#include "StateSerializer.hpp"
+#include <cstdio>
+#include <iostream>
+
+Movie::Movie()
+{
+    mode = NONE;
+
+    emulatorMode = 0;
+    romChecksum = 0;
+    rtcSeed = 0;
+    audioBatchCycles = 0;
+    useBootrom = false;
+
+    currentFrame = 0;
+}
+
+bool Movie::isActive() { return mode != NONE; }
+
+bool Movie::isRecording() { return mode == RECORD; }
+
+bool Movie::isPlaying() { return mode == PLAYBACK; }
+
+void Movie::startRecording(std::string path)
+{
+    this->path = path;
+    mode = RECORD;
+    frames.clear();
+    currentFrame = 0;
+}
+
+/**
+ *  Writes the recorded movie to its file. Returns true on success
+ */
+bool Movie::stopRecording()
+{
+    if (mode != RECORD)
+        return false;
+
+    mode = NONE;
+
+    std::vector<uint8_t> buffer;
+    StateSerializer state(buffer, StateSerializer::SAVE);
+    serialize(state);
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == NULL) {
+        std::cerr << "ERROR: Movie " << path << " could not be created\n";
+        return false;
+    }
+
+    size_t written = fwrite(buffer.data(), sizeof(uint8_t), buffer.size(), f);
+    fclose(f);
+
+    if (written != buffer.size()) {
+        std::cerr << "ERROR: Movie " << path << " could not be written\n";
+        return false;
+    }
+
+    std::cout << "Recorded " << frames.size() << " frames to " << path << "\n";
+
+    return true;
+}
+
+bool Movie::load(std::string path)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL) {
+        std::cerr << "ERROR: Movie " << path << " could not be opened\n";
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    std::vector<uint8_t> buffer(fileSize > 0 ? fileSize : 0);
+    size_t read = fread(buffer.data(), sizeof(uint8_t), buffer.size(), f);
+    fclose(f);
+
+    if (read != buffer.size()) {
+        std::cerr << "ERROR: Movie " << path << " could not be read\n";
+        return false;
+    }
+
+    StateSerializer state(buffer, StateSerializer::LOAD);
+    serialize(state);
+
+    if (!state.isValid()) {
+        std::cerr << "ERROR: Movie " << path << " is not a valid movie file\n";
+        return false;
+    }
+
+    this->path = path;
+    mode = PLAYBACK;
+    currentFrame = 0;
+
+    return true;
+}
+
+void Movie::recordFrame(uint8_t keys)
+{
+    frames.push_back(keys);
+    ++currentFrame;
+}
+
+bool Movie::nextFrame(uint8_t &keys)
+{
+    if (currentFrame >= frames.size())
+        return false;
+
+    keys = frames[currentFrame++];
+    return true;
+}
+
+uint8_t Movie::packKeys(bool keyState[2][4])
+{
+    uint8_t keys = 0;
+    for (uint8_t i = 0; i < 4; ++i) {
+        keys |= keyState[0][i] << i;
+        keys |= keyState[1][i] << (i + 4);
+    }
+
+    return keys;
+}
+
+void Movie::unpackKeys(uint8_t keys, bool keyState[2][4])
+{
+    for (uint8_t i = 0; i < 4; ++i) {
+        keyState[0][i] = (keys >> i) & 1;
+        keyState[1][i] = (keys >> (i + 4)) & 1;
+    }
+}
+
+void Movie::serialize(StateSerializer &state)
+{
+    uint32_t magic = MOVIE_MAGIC;
+    uint32_t version = MOVIE_VERSION;
+
+    state.value(magic);
+    state.value(version);
+
+    // Stop before reading the rest of a file that is not a movie
+    if (magic != MOVIE_MAGIC || version != MOVIE_VERSION) {
+        state.setInvalid();
+        return;
+    }
+
+    state.value(emulatorMode);
+    state.value(romChecksum);
+    state.value(rtcSeed);
+    state.value(audioBatchCycles);
+    state.value(useBootrom);
+
+    serializeBuffer(state, startState);
+    serializeBuffer(state, frames);
+}
+
+void Movie::serializeBuffer(StateSerializer &state, std::vector<uint8_t> &buffer)
+{
+    uint32_t size = buffer.size();
+    state.value(size);
+
+    if (state.isLoading()) {
+        if (!state.isValid() || size > state.getRemaining()) {
+            state.setInvalid();
+            buffer.clear();
+            return;
+        }
+
+        buffer.resize(size);
+    }
+
+    state.bytes(buffer.data(), buffer.size());
+}
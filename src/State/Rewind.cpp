@@ -0,0 +1,183 @@
+#include "Rewind.hpp"
+#include <cstring>
+
+/**
+ *  The encoded delta is a sequence of runs. Each run starts with the number of unchanged (zero)
+ *  bytes, followed by the number of changed bytes and the changed bytes themselves. Both numbers
+ *  are stored as LEB128 varints.
+ */
+
+static void writeVarint(std::vector<uint8_t> &dest, size_t val)
+{
+    while (val >= 0x80) {
+        dest.push_back((val & 0x7F) | 0x80);
+        val >>= 7;
+    }
+
+    dest.push_back(val);
+}
+
+static size_t readVarint(const uint8_t *&src, const uint8_t *end)
+{
+    size_t val = 0;
+    uint8_t shift = 0;
+
+    while (src < end) {
+        uint8_t byte = *src++;
+        val |= (size_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+            break;
+
+        shift += 7;
+    }
+
+    return val;
+}
+
+Rewind::Rewind() : head(0) {}
+
+void Rewind::init(size_t bufferSize)
+{
+    arena.assign(bufferSize, 0);
+    arena.shrink_to_fit();
+    clear();
+}
+
+void Rewind::clear()
+{
+    entries.clear();
+    head = 0;
+    lastState.clear();
+}
+
+bool Rewind::isEnabled() { return !arena.empty(); }
+
+void Rewind::push(const std::vector<uint8_t> &state)
+{
+    if (arena.empty())
+        return;
+
+    if (state.size() != lastState.size())
+        clear();
+
+    encodeDelta(state);
+
+    // A single entry that does not fit is dropped; the next one will be encoded against the same
+    // previous snapshot, so the chain stays valid
+    if (encoded.size() > arena.size())
+        return;
+
+    size_t offset = allocate(encoded.size());
+    memcpy(arena.data() + offset, encoded.data(), encoded.size());
+    entries.push_back({offset, encoded.size()});
+
+    lastState = state;
+}
+
+bool Rewind::rewind(std::vector<uint8_t> &state)
+{
+    if (entries.empty())
+        return false;
+
+    state = lastState;
+
+    // The delta of the oldest entry refers to a snapshot that has already been dropped, so the
+    // oldest entry stays in the ring
+    if (entries.size() > 1) {
+        Entry &newest = entries.back();
+        applyDelta(arena.data() + newest.offset, newest.size);
+
+        head = newest.offset;
+        entries.pop_back();
+    }
+
+    return true;
+}
+
+size_t Rewind::getNumEntries() { return entries.size(); }
+
+size_t Rewind::getUsedBytes()
+{
+    size_t used = 0;
+    for (const Entry &entry : entries)
+        used += entry.size;
+
+    return used;
+}
+
+size_t Rewind::getBufferSize() { return arena.size(); }
+
+void Rewind::encodeDelta(const std::vector<uint8_t> &state)
+{
+    encoded.clear();
+
+    const uint8_t *prev = lastState.empty() ? nullptr : lastState.data();
+    size_t size = state.size();
+    size_t i = 0;
+
+    while (i < size) {
+        // Count unchanged bytes
+        size_t zeroStart = i;
+        if (prev != nullptr) {
+            while (i < size && state[i] == prev[i])
+                ++i;
+        } else {
+            while (i < size && state[i] == 0)
+                ++i;
+        }
+
+        // Count changed bytes; short unchanged gaps are kept inside the literal run because a
+        // new run header would cost more than the bytes it skips
+        size_t literalStart = i;
+        size_t gap = 0;
+        while (i < size && gap < 3) {
+            uint8_t delta = prev != nullptr ? state[i] ^ prev[i] : state[i];
+            gap = delta == 0 ? gap + 1 : 0;
+            ++i;
+        }
+        i -= gap;
+
+        writeVarint(encoded, literalStart - zeroStart);
+        writeVarint(encoded, i - literalStart);
+
+        for (size_t j = literalStart; j < i; ++j)
+            encoded.push_back(prev != nullptr ? state[j] ^ prev[j] : state[j]);
+    }
+}
+
+void Rewind::applyDelta(const uint8_t *delta, size_t size)
+{
+    const uint8_t *end = delta + size;
+    size_t position = 0;
+
+    while (delta < end) {
+        position += readVarint(delta, end);
+        size_t literalLength = readVarint(delta, end);
+
+        for (size_t i = 0; i < literalLength && position < lastState.size(); ++i)
+            lastState[position++] ^= *delta++;
+    }
+}
+
+size_t Rewind::allocate(size_t size)
+{
+    // Wrap around if the entry does not fit at the end of the arena; everything between the
+    // head and the end belongs to the oldest entries, which are dropped
+    if (head + size > arena.size()) {
+        while (!entries.empty() && entries.front().offset >= head)
+            entries.pop_front();
+
+        head = 0;
+    }
+
+    // Drop the oldest entries that overlap the new one
+    while (!entries.empty() && entries.front().offset < head + size &&
+           entries.front().offset + entries.front().size > head)
+        entries.pop_front();
+
+    size_t offset = head;
+    head += size;
+
+    return offset;
+}
@@ -0,0 +1,38 @@
+#include "StateSerializer.hpp"
+
+StateSerializer::StateSerializer(std::vector<uint8_t> &buffer, Mode mode)
+    : buffer(buffer), mode(mode), position(0), valid(true)
+{
+    if (mode == SAVE)
+        buffer.clear();
+}
+
+bool StateSerializer::isLoading() { return mode == LOAD; }
+
+size_t StateSerializer::getPosition() { return position; }
+
+bool StateSerializer::isValid() { return valid; }
+
+void StateSerializer::setInvalid() { valid = false; }
+
+size_t StateSerializer::getRemaining()
+{
+    return position < buffer.size() ? buffer.size() - position : 0;
+}
+
+void StateSerializer::bytes(void *data, size_t size)
+{
+    if (mode == SAVE) {
+        buffer.resize(position + size);
+        memcpy(buffer.data() + position, data, size);
+    } else {
+        if (!valid || position + size > buffer.size()) {
+            valid = false;
+            return;
+        }
+
+        memcpy(data, buffer.data() + position, size);
+    }
+
+    position += size;
+}
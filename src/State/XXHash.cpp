@@ -0,0 +1,100 @@
+#include "XXHash.hpp"
+#include <cstring>
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Reads little-endian values from any address
+static inline uint64_t read64(const uint8_t *data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static inline uint32_t read32(const uint8_t *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+static inline uint64_t xxhRound(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * XXH_PRIME64_2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxhMergeRound(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= xxhRound(0, accumulator);
+    return hash * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t xxHash64(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    const uint8_t *end = bytes + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t lanes[4] = {seed + XXH_PRIME64_1 + XXH_PRIME64_2, seed + XXH_PRIME64_2, seed,
+                             seed - XXH_PRIME64_1};
+
+        do {
+            for (int i = 0; i < 4; ++i)
+                lanes[i] = xxhRound(lanes[i], read64(bytes + i * 8));
+            bytes += 32;
+        } while (end - bytes >= 32);
+
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) +
+               rotateLeft(lanes[3], 18);
+        for (int i = 0; i < 4; ++i)
+            hash = xxhMergeRound(hash, lanes[i]);
+    } else {
+        hash = seed + XXH_PRIME64_5;
+    }
+
+    hash += size;
+
+    // The last 0-31 bytes
+    for (; end - bytes >= 8; bytes += 8) {
+        hash ^= xxhRound(0, read64(bytes));
+        hash = rotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+    if (end - bytes >= 4) {
+        hash ^= read32(bytes) * XXH_PRIME64_1;
+        hash = rotateLeft(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        bytes += 4;
+    }
+
+    for (; bytes < end; ++bytes) {
+        hash ^= *bytes * XXH_PRIME64_5;
+        hash = rotateLeft(hash, 11) * XXH_PRIME64_1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
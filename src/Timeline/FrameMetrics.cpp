@@ -0,0 +1,51 @@
+#include "FrameMetrics.hpp"
+#include <cstdio>
+
+Histogram FrameMetrics::get(FrameMetric metric) const
+{
+    Histogram histogram = total[metric];
+    histogram.add(interval[metric]);
+    return histogram;
+}
+
+void FrameMetrics::endInterval()
+{
+    for (int i = 0; i < METRIC_COUNT; ++i) {
+        total[i].add(interval[i]);
+        interval[i].reset();
+    }
+}
+
+void FrameMetrics::printSummary(std::string title, bool wholeRun) const
+{
+    printf("%s\n", title.c_str());
+
+    for (int i = 0; i < METRIC_COUNT; ++i) {
+        Histogram histogram = wholeRun ? get((FrameMetric)i) : interval[i];
+        if (histogram.count == 0)
+            continue;
+
+        printf("  %-16s p50 %8.2f ms  p95 %8.2f ms  p99 %8.2f ms  max %8.2f ms  (%llu samples)\n",
+               getName((FrameMetric)i), histogram.getPercentile(50) / 1000.0,
+               histogram.getPercentile(95) / 1000.0, histogram.getPercentile(99) / 1000.0,
+               histogram.max / 1000.0, (unsigned long long)histogram.count);
+    }
+
+    fflush(stdout);
+}
+
+const char *FrameMetrics::getName(FrameMetric metric)
+{
+    switch (metric) {
+    case METRIC_EMULATION_TIME:
+        return "emulation";
+    case METRIC_PRESENT_TIME:
+        return "present";
+    case METRIC_AUDIO_QUEUED:
+        return "audio queued";
+    case METRIC_INPUT_LATENCY:
+        return "input latency";
+    default:
+        return "";
+    }
+}
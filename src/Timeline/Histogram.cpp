@@ -0,0 +1,104 @@
+#include "Histogram.hpp"
+#include <cstring>
+
+Histogram::Histogram() { reset(); }
+
+void Histogram::record(uint64_t value)
+{
+    ++buckets[getBucket(value)];
+    ++count;
+    sum += value;
+
+    if (value < min)
+        min = value;
+    if (value > max)
+        max = value;
+}
+
+void Histogram::add(const Histogram &other)
+{
+    for (uint32_t i = 0; i < HISTOGRAM_NUM_BUCKETS; ++i)
+        buckets[i] += other.buckets[i];
+
+    count += other.count;
+    sum += other.sum;
+
+    if (other.min < min)
+        min = other.min;
+    if (other.max > max)
+        max = other.max;
+}
+
+void Histogram::reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum = 0;
+    min = UINT64_MAX;
+    max = 0;
+}
+
+uint64_t Histogram::getPercentile(double percentile) const
+{
+    if (count == 0)
+        return 0;
+
+    // Number of values that have to be at or below the result
+    uint64_t rank = (uint64_t)(percentile / 100.0 * count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_NUM_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t end = getBucketEnd(i);
+            return end < max ? end : max;
+        }
+    }
+
+    return max;
+}
+
+double Histogram::getMean() const { return count > 0 ? (double)sum / count : 0.0; }
+
+uint32_t Histogram::getBucket(uint64_t value)
+{
+    if (value < HISTOGRAM_LINEAR_VALUES)
+        return value;
+
+    // Position of the highest set bit; at least HISTOGRAM_SUB_BUCKET_BITS + 1 here
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    uint32_t subBucket = (value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+
+    return HISTOGRAM_LINEAR_VALUES + (msb - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS +
+           subBucket;
+}
+
+uint64_t Histogram::getBucketStart(uint32_t bucket)
+{
+    if (bucket < HISTOGRAM_LINEAR_VALUES)
+        return bucket;
+
+    uint32_t msb = (bucket - HISTOGRAM_LINEAR_VALUES) / HISTOGRAM_SUB_BUCKETS +
+                   HISTOGRAM_SUB_BUCKET_BITS + 1;
+    uint32_t subBucket = (bucket - HISTOGRAM_LINEAR_VALUES) % HISTOGRAM_SUB_BUCKETS;
+    uint32_t shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+
+    return (uint64_t)(HISTOGRAM_SUB_BUCKETS + subBucket) << shift;
+}
+
+uint64_t Histogram::getBucketEnd(uint32_t bucket)
+{
+    if (bucket < HISTOGRAM_LINEAR_VALUES)
+        return bucket;
+
+    uint32_t msb = (bucket - HISTOGRAM_LINEAR_VALUES) / HISTOGRAM_SUB_BUCKETS +
+                   HISTOGRAM_SUB_BUCKET_BITS + 1;
+    uint32_t shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+
+    return getBucketStart(bucket) + ((uint64_t)1 << shift) - 1;
+}
@@ -0,0 +1,77 @@
+#include "Timeline.hpp"
+#include <cstdio>
+#include <iostream>
+
+void Timeline::enable()
+{
+    startTime = std::chrono::steady_clock::now();
+    enabled = true;
+}
+
+void Timeline::disable() { enabled = false; }
+
+void Timeline::setThreadName(std::string name)
+{
+    // Registers the thread first, which takes the mutex too
+    TimelineThread *thread = getThread();
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    thread->name = name;
+}
+
+TimelineThread *Timeline::addThread()
+{
+    std::lock_guard<std::mutex> lock(threadsMutex);
+
+    std::unique_ptr<TimelineThread> thread(new TimelineThread);
+    thread->id = threads.size() + 1;
+    thread->name = "Thread " + std::to_string(thread->id);
+    thread->events.reset(new TimelineEvent[TIMELINE_THREAD_EVENTS]);
+    thread->count = 0;
+
+    threads.push_back(std::move(thread));
+    return threads.back().get();
+}
+
+/**
+ *  Writes "X" (complete) events, with timestamps in microseconds, and the names of the threads as
+ *  metadata events
+ */
+bool Timeline::write(std::string path)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        std::cerr << "Could not write the timeline to " << path << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (auto &thread : threads) {
+        fprintf(file,
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", thread->id, thread->name.c_str());
+        first = false;
+
+        uint64_t end = thread->count.load(std::memory_order_acquire);
+        uint64_t start = end > TIMELINE_THREAD_EVENTS ? end - TIMELINE_THREAD_EVENTS : 0;
+        for (uint64_t i = start; i < end; ++i) {
+            TimelineEvent &event = thread->events[i & (TIMELINE_THREAD_EVENTS - 1)];
+            fprintf(file,
+                    ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    event.name, event.category, thread->id, event.start / 1000.0,
+                    event.duration / 1000.0);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    std::cout << "Timeline written to " << path << "\n";
+    return true;
+}
@@ -1,6 +1,8 @@
 #include "Timer.hpp"
 #include "Memory.hpp"
 #include "SM83.hpp"
+#include "StateSerializer.hpp"
+#include <algorithm>
 
 Timer::Timer() : divCounter(0), timaTicks(0), timaSelectedBitPreviousValue(0)
 {
@@ -88,7 +90,7 @@ void Timer::cycle()
             if (timaReloadTCyclesDelay == 0) {
                 // Reload TIMA and trigger INT
                 if (!timaChangedDuringWait) {
-                    cpu->setTimerInterruptFlag(1);
+                    memory->requestInterrupt(INTERRUPT_TIMER);
                     setTimerCounter(timaReloadValue, true);
                 }
 
@@ -116,3 +118,47 @@ void Timer::cycle()
 
     timaSelectedBitPreviousValue = timaSelectedBit;
 }
+
+void Timer::advance(uint32_t tCycles)
+{
+    while (tCycles > 0) {
+        // A pending reload or a falling edge from the last cycle has to be stepped normally
+        if (timaReloadTCyclesDelay != -1 || timaSelectedBitPreviousValue == 1) {
+            cycle();
+            --tCycles;
+            continue;
+        }
+
+        // Truncated like in cycle(), where the selected bit is kept in an uint8_t
+        uint8_t mask = clockSelectBitMask[getInputClockSelect()];
+        uint32_t skip = tCycles;
+
+        // The selected bit falls when the bits below it wrap around
+        if (getTimerEnable() && mask != 0) {
+            uint32_t untilFallingEdge = (mask << 1) - (divCounter & ((mask << 1) - 1));
+            skip = std::min(skip, untilFallingEdge - 1);
+        }
+
+        if (skip == 0) {
+            cycle();
+            --tCycles;
+            continue;
+        }
+
+        divCounter += skip;
+        memory->ioRegisters[0xFF04 - MEM_IO_START] = (divCounter & 0xFF00) >> 8;
+        timaSelectedBitPreviousValue = getTimerEnable() && (divCounter & mask) ? 1 : 0;
+        tCycles -= skip;
+    }
+}
+
+void Timer::serialize(StateSerializer &state)
+{
+    state.value(divCounter);
+    state.value(timaTicks);
+    state.value(timaSelectedBitPreviousValue);
+    state.value(tmaPreviousValue);
+    state.value(timaReloadValue);
+    state.value(timaReloadTCyclesDelay);
+    state.value(timaChangedDuringWait);
+}
@@ -0,0 +1,382 @@
+#include "Recorder.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <numeric>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void putU16(uint8_t *dest, uint16_t value)
+{
+    dest[0] = value & 0xFF;
+    dest[1] = value >> 8;
+}
+
+static void putU32(uint8_t *dest, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        dest[i] = (value >> (i * 8)) & 0xFF;
+}
+
+Recorder::Recorder() {}
+
+Recorder::~Recorder() { stop(); }
+
+bool Recorder::start(std::string videoPath, std::string audioPath, RecordFormat format,
+                     uint32_t width, uint32_t height, uint32_t frameRateNum,
+                     uint32_t frameRateDen, uint32_t sampleRate, bool directIo)
+{
+    stop();
+
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    this->sampleRate = sampleRate;
+
+    if (!videoPath.empty()) {
+        if (!openFile(videoFile, videoPath, directIo))
+            return false;
+        frames.init(RECORDER_FRAME_SLOTS, width * height);
+
+        if (format == RECORD_Y4M) {
+            uint32_t divisor = std::gcd(frameRateNum, frameRateDen);
+            std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" +
+                                 std::to_string(height) + " F" +
+                                 std::to_string(frameRateNum / divisor) + ":" +
+                                 std::to_string(frameRateDen / divisor) + " Ip A1:1 C444\n";
+            append(videoFile, header.data(), header.size());
+        }
+    }
+
+    if (!audioPath.empty()) {
+        if (!openFile(audioFile, audioPath, directIo)) {
+            closeFile(videoFile);
+            return false;
+        }
+        audio.init(RECORDER_AUDIO_SLOTS, RECORDER_AUDIO_SLOT_SAMPLES);
+
+        // The sizes are filled in when the recording stops, if the file can be seeked
+        uint8_t header[RECORDER_WAV_HEADER_SIZE];
+        writeWavHeader(header, sampleRate, UINT32_MAX);
+        append(audioFile, header, sizeof(header));
+    }
+
+    // A reader that closes its end of a pipe ends the recording with an error, instead of
+    // killing the emulator
+    if ((videoFile.fd >= 0 && !videoFile.seekable) || (audioFile.fd >= 0 && !audioFile.seekable))
+        signal(SIGPIPE, SIG_IGN);
+
+    lastFrame.reserve(6 + (size_t)width * height * 4);
+    lastFrame.clear();
+    scratch.reserve(RECORDER_AUDIO_SLOT_SAMPLES * sizeof(int16_t));
+
+    enabled = videoFile.fd >= 0 || audioFile.fd >= 0;
+    if (enabled) {
+        writerRunning = true;
+        writerThread = std::thread(&Recorder::writerLoop, this);
+    }
+
+    return true;
+}
+
+void Recorder::stop()
+{
+    enabled = false;
+
+    if (writerThread.joinable()) {
+        writerRunning = false;
+        writerThread.join();
+    }
+
+    // What was dropped after the last frame and audio chunk that were queued
+    if (videoFile.fd >= 0)
+        repeatLastFrame(frames.pendingSkipped / frames.slotSize);
+    if (audioFile.fd >= 0)
+        writeSilence(audio.pendingSkipped);
+
+    closeFile(videoFile);
+
+    if (audioFile.fd >= 0) {
+        uint8_t header[RECORDER_WAV_HEADER_SIZE];
+        writeWavHeader(header, sampleRate, audioFile.size - RECORDER_WAV_HEADER_SIZE);
+        closeFile(audioFile, header, sizeof(header));
+    }
+}
+
+void Recorder::pushFrame(const uint32_t *pixels)
+{
+    if (videoFile.fd < 0)
+        return;
+
+    frames.push(pixels, frames.slotSize);
+}
+
+void Recorder::pushAudio(const float *samples, uint32_t count)
+{
+    if (audioFile.fd < 0)
+        return;
+
+    while (count > 0) {
+        uint32_t slotCount = std::min(count, audio.slotSize);
+        if (!audio.push(samples, slotCount)) {
+            // The rest of the chunk is dropped with it
+            audio.pendingSkipped += count - slotCount;
+            return;
+        }
+
+        samples += slotCount;
+        count -= slotCount;
+    }
+}
+
+void Recorder::writerLoop()
+{
+    while (true) {
+        bool running = writerRunning.load(std::memory_order_acquire);
+        bool wrote = false;
+
+        uint64_t end = frames.head.load(std::memory_order_acquire);
+        for (uint64_t index = frames.tail.load(std::memory_order_relaxed); index < end; ++index) {
+            repeatLastFrame(frames.skipped[index % frames.numSlots] / frames.slotSize);
+            writeFrame(frames.slot(index));
+            frames.tail.store(index + 1, std::memory_order_release);
+            wrote = true;
+        }
+
+        end = audio.head.load(std::memory_order_acquire);
+        for (uint64_t index = audio.tail.load(std::memory_order_relaxed); index < end; ++index) {
+            writeSilence(audio.skipped[index % audio.numSlots]);
+            writeAudio(audio.slot(index), audio.counts[index % audio.numSlots]);
+            audio.tail.store(index + 1, std::memory_order_release);
+            wrote = true;
+        }
+
+        if (!wrote) {
+            if (!running)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void Recorder::writeFrame(const uint32_t *pixels)
+{
+    uint32_t numPixels = width * height;
+
+    if (format == RECORD_RGBA) {
+        lastFrame.resize(numPixels * 4);
+        for (uint32_t i = 0; i < numPixels; ++i) {
+            lastFrame[i * 4] = pixels[i] >> 24;
+            lastFrame[i * 4 + 1] = pixels[i] >> 16;
+            lastFrame[i * 4 + 2] = pixels[i] >> 8;
+            lastFrame[i * 4 + 3] = pixels[i];
+        }
+    } else {
+        // BT.601 limited range, one plane after the other
+        static const char frameHeader[] = "FRAME\n";
+        lastFrame.resize(sizeof(frameHeader) - 1 + numPixels * 3);
+        memcpy(lastFrame.data(), frameHeader, sizeof(frameHeader) - 1);
+
+        uint8_t *y = &lastFrame[sizeof(frameHeader) - 1];
+        uint8_t *u = y + numPixels;
+        uint8_t *v = u + numPixels;
+        for (uint32_t i = 0; i < numPixels; ++i) {
+            int32_t r = pixels[i] >> 24, g = (pixels[i] >> 16) & 0xFF, b = (pixels[i] >> 8) & 0xFF;
+            y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            u[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            v[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+
+    append(videoFile, lastFrame.data(), lastFrame.size());
+}
+
+void Recorder::writeAudio(const float *samples, uint32_t count)
+{
+    scratch.resize(count * sizeof(int16_t));
+    for (uint32_t i = 0; i < count; ++i) {
+        float sample = std::clamp(samples[i], -1.0f, 1.0f);
+        putU16(&scratch[i * 2], (int16_t)std::lround(sample * 32767));
+    }
+
+    append(audioFile, scratch.data(), scratch.size());
+}
+
+void Recorder::repeatLastFrame(uint64_t count)
+{
+    for (uint64_t i = 0; i < count; ++i)
+        append(videoFile, lastFrame.data(), lastFrame.size());
+}
+
+void Recorder::writeSilence(uint64_t count)
+{
+    while (count > 0) {
+        uint32_t chunk = std::min<uint64_t>(count, RECORDER_AUDIO_SLOT_SAMPLES);
+        scratch.assign(chunk * sizeof(int16_t), 0);
+        append(audioFile, scratch.data(), scratch.size());
+        count -= chunk;
+    }
+}
+
+bool Recorder::openFile(RecorderFile &file, const std::string &path, bool directIo)
+{
+    // Named pipes block here until a reader opens them
+    file.fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file.fd < 0) {
+        std::cerr << "Could not open the recording file " << path << ": " << strerror(errno)
+                  << "\n";
+        return false;
+    }
+
+    struct stat fileStat;
+    file.path = path;
+    file.seekable = fstat(file.fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode);
+    file.directIo = false;
+    file.failed = false;
+    file.used = 0;
+    file.size = 0;
+
+#ifdef O_DIRECT
+    // Some file systems (e.g. older tmpfs) don't support it
+    if (directIo && file.seekable)
+        file.directIo = fcntl(file.fd, F_SETFL, fcntl(file.fd, F_GETFL) | O_DIRECT) == 0;
+#else
+    (void)directIo;
+#endif
+
+    file.buffer = (uint8_t *)aligned_alloc(RECORDER_IO_ALIGNMENT, RECORDER_WRITE_BUFFER_SIZE);
+    if (file.buffer == nullptr) {
+        std::cerr << "Could not allocate the write buffer of " << path << "\n";
+        close(file.fd);
+        file.fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void Recorder::append(RecorderFile &file, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    file.size += size;
+
+    while (size > 0) {
+        size_t count = std::min(size, RECORDER_WRITE_BUFFER_SIZE - file.used);
+        memcpy(file.buffer + file.used, bytes, count);
+        file.used += count;
+        bytes += count;
+        size -= count;
+
+        // Whole buffers keep the file offset aligned for O_DIRECT
+        if (file.used == RECORDER_WRITE_BUFFER_SIZE) {
+            flush(file, file.used);
+            file.used = 0;
+        }
+    }
+}
+
+/**
+ *  Writes the first size bytes of the buffer; after an error the rest of the data is discarded
+ */
+void Recorder::flush(RecorderFile &file, size_t size)
+{
+    size_t written = 0;
+    while (!file.failed && written < size) {
+        ssize_t result = write(file.fd, file.buffer + written, size - written);
+        if (result >= 0) {
+            written += result;
+            continue;
+        }
+
+        if (errno == EINTR)
+            continue;
+
+#ifdef O_DIRECT
+        // The file system accepted the flag but not the write; go on without it
+        if (errno == EINVAL && file.directIo) {
+            fcntl(file.fd, F_SETFL, fcntl(file.fd, F_GETFL) & ~O_DIRECT);
+            file.directIo = false;
+            continue;
+        }
+#endif
+
+        std::cerr << "Could not write to the recording file " << file.path << ": "
+                  << strerror(errno) << "\n";
+        file.failed = true;
+    }
+}
+
+/**
+ *  Writes what is left in the buffer and, if the file can be seeked, replaces its first bytes
+ *  with header
+ */
+void Recorder::closeFile(RecorderFile &file, const uint8_t *header, size_t headerSize)
+{
+    if (file.fd < 0)
+        return;
+
+#ifdef O_DIRECT
+    // The last block is usually not a whole one
+    if (file.directIo)
+        fcntl(file.fd, F_SETFL, fcntl(file.fd, F_GETFL) & ~O_DIRECT);
+#endif
+
+    flush(file, file.used);
+    file.used = 0;
+
+    if (header != nullptr && file.seekable && !file.failed &&
+        pwrite(file.fd, header, headerSize, 0) != (ssize_t)headerSize)
+        std::cerr << "Could not write the header of " << file.path << "\n";
+
+    close(file.fd);
+    file.fd = -1;
+
+    free(file.buffer);
+    file.buffer = nullptr;
+}
+
+/**
+ *  16-bit stereo PCM; sizes that don't fit (or aren't known yet) are written as UINT32_MAX, which
+ *  players read as "until the end of the file"
+ */
+void Recorder::writeWavHeader(uint8_t *header, uint32_t sampleRate, uint64_t dataSize)
+{
+    uint32_t dataSize32 = dataSize > UINT32_MAX - 36 ? UINT32_MAX : dataSize;
+    uint32_t riffSize = dataSize32 == UINT32_MAX ? UINT32_MAX : dataSize32 + 36;
+
+    memcpy(header, "RIFF", 4);
+    putU32(header + 4, riffSize);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putU32(header + 16, 16);
+    putU16(header + 20, 1); // PCM
+    putU16(header + 22, 2); // channels
+    putU32(header + 24, sampleRate);
+    putU32(header + 28, sampleRate * 2 * sizeof(int16_t));
+    putU16(header + 32, 2 * sizeof(int16_t));
+    putU16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    putU32(header + 40, dataSize32);
+}
+
+const char *Recorder::getFormatName(RecordFormat format)
+{
+    return format == RECORD_RGBA ? "rgba" : "y4m";
+}
+
+bool Recorder::getFormatByName(const std::string &name, RecordFormat &format)
+{
+    if (name == "y4m")
+        format = RECORD_Y4M;
+    else if (name == "rgba")
+        format = RECORD_RGBA;
+    else
+        return false;
+
+    return true;
+}
@@ -0,0 +1,583 @@
+#include "Upscaler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Source pixel index on each side of every output pixel, and the weight (0-128) of the second
+// one. The weight goes from 0 to 128 over a single output pixel around the border of two source
+// pixels, so the image stays sharp at any scale but the pixels keep the same size
+static void computeSharpBilinearWeights(uint32_t srcSize, uint32_t outSize,
+                                        std::vector<uint32_t> index[2],
+                                        std::vector<uint16_t> &weight)
+{
+    double scale = (double)outSize / srcSize;
+
+    index[0].resize(outSize);
+    index[1].resize(outSize);
+    weight.resize(outSize);
+
+    for (uint32_t i = 0; i < outSize; ++i) {
+        double position = (i + 0.5) / scale - 0.5;
+        double first = std::floor(position);
+        double fraction = std::clamp((position - first - 0.5) * scale + 0.5, 0.0, 1.0);
+
+        index[0][i] = std::clamp<int32_t>(first, 0, srcSize - 1);
+        index[1][i] = std::clamp<int32_t>(first + 1, 0, srcSize - 1);
+        weight[i] = std::lround(fraction * 128);
+    }
+}
+
+// Sum of the differences of the 4 channels
+static inline uint32_t distance(uint32_t a, uint32_t b)
+{
+    uint32_t sum = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+        sum += std::abs((int32_t)((a >> shift) & 0xFF) - (int32_t)((b >> shift) & 0xFF));
+    return sum;
+}
+
+// Rounds up, like _mm_avg_epu8
+static inline uint32_t average(uint32_t a, uint32_t b)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+        result |= ((((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + 1) >> 1) << shift;
+    return result;
+}
+
+// weight is between 0 (a) and 128 (b)
+static inline uint32_t lerp(uint32_t a, uint32_t b, int32_t weight)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int32_t channelA = (a >> shift) & 0xFF;
+        int32_t channelB = (b >> shift) & 0xFF;
+        result |= (uint32_t)(channelA + (((channelB - channelA) * weight) >> 7)) << shift;
+    }
+    return result;
+}
+
+#ifdef __SSE2__
+static inline __m128i load4(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+
+static inline void store4(uint32_t *p, __m128i v) { _mm_storeu_si128((__m128i *)p, v); }
+
+// mask ? a : b
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Stores the pixels of a, b and c interleaved: a0 b0 c0 a1 b1 c1 ...
+static inline void store3(uint32_t *p, __m128i a, __m128i b, __m128i c)
+{
+    __m128 abLow = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));
+    __m128 abHigh = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));
+    __m128 bcLow = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));
+    __m128 bcHigh = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));
+    __m128 caLow = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a));
+    __m128 caHigh = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a));
+
+    store4(p, _mm_castps_si128(_mm_shuffle_ps(abLow, caLow, _MM_SHUFFLE(3, 0, 1, 0))));
+    store4(p + 4, _mm_castps_si128(_mm_shuffle_ps(bcLow, abHigh, _MM_SHUFFLE(1, 0, 3, 2))));
+    store4(p + 8, _mm_castps_si128(_mm_shuffle_ps(caHigh, bcHigh, _MM_SHUFFLE(3, 2, 3, 0))));
+}
+
+static inline __m128i distance4(__m128i a, __m128i b)
+{
+    __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+    __m128i pairs =
+        _mm_add_epi16(_mm_and_si128(diff, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(diff, 8));
+    return _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+}
+
+// Channels as 16-bit lanes; weight is between 0 (a) and 128 (b)
+static inline __m128i lerp2(__m128i a, __m128i b, __m128i weight)
+{
+    return _mm_add_epi16(a, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(b, a), weight), 7));
+}
+#endif
+
+Upscaler::Upscaler() { nextBand = 0; }
+
+Upscaler::~Upscaler() { stop(); }
+
+void Upscaler::init(ScaleFilter filter, uint32_t srcWidth, uint32_t srcHeight, uint32_t outWidth,
+                    uint32_t outHeight, uint32_t numThreads)
+{
+    stop();
+
+    this->filter = filter;
+    this->srcWidth = srcWidth;
+    this->srcHeight = srcHeight;
+
+    uint32_t factor = getFilterFactor(filter);
+    this->outWidth = factor != 0 ? srcWidth * factor : outWidth;
+    this->outHeight = factor != 0 ? srcHeight * factor : outHeight;
+
+    paddedWidth = srcWidth + 2 * UPSCALER_BORDER;
+    padded.assign(paddedWidth * (srcHeight + 2 * UPSCALER_BORDER), 0);
+
+    if (filter == SCALE_SHARP_BILINEAR) {
+        computeSharpBilinearWeights(srcWidth, this->outWidth, columnIndex, columnWeight);
+        computeSharpBilinearWeights(srcHeight, this->outHeight, rowIndex, rowWeight);
+    }
+
+    if (numThreads == 0)
+        numThreads = std::min(std::max(1u, std::thread::hardware_concurrency()),
+                              (uint32_t)UPSCALER_MAX_AUTO_THREADS);
+    this->numThreads = numThreads;
+
+    // A few bands per thread, so a thread that starts late doesn't hold up the frame
+    numRows = filter == SCALE_SHARP_BILINEAR ? this->outHeight : srcHeight;
+    bandRows = std::max(1u, (numRows + numThreads * 4 - 1) / (numThreads * 4));
+    numBands = (numRows + bandRows - 1) / bandRows;
+
+    // The workers are given the current generation, so a frame started before one of them runs
+    // is not missed. Copying the frame is cheaper than handing it to another thread
+    stopping = false;
+    busyWorkers = 0;
+    if (filter == SCALE_NONE) {
+        this->numThreads = 0;
+        return;
+    }
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+        workers.emplace_back(&Upscaler::workerLoop, this, generation);
+}
+
+void Upscaler::stop()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+void Upscaler::start(const uint32_t *src, uint32_t *dest, uint32_t destPitch)
+{
+    // The workers may still read the padded copy of the last frame
+    wait();
+
+    // Replicate the edges, so the filters never check the bounds
+    for (int32_t y = -UPSCALER_BORDER; y < (int32_t)srcHeight + UPSCALER_BORDER; ++y) {
+        uint32_t *row = &padded[(y + UPSCALER_BORDER) * paddedWidth];
+        int32_t srcY = std::clamp<int32_t>(y, 0, srcHeight - 1);
+
+        memcpy(row + UPSCALER_BORDER, src + srcY * srcWidth, srcWidth * sizeof(uint32_t));
+        for (int32_t i = 0; i < UPSCALER_BORDER; ++i) {
+            row[i] = row[UPSCALER_BORDER];
+            row[UPSCALER_BORDER + srcWidth + i] = row[UPSCALER_BORDER + srcWidth - 1];
+        }
+    }
+
+    this->dest = dest;
+    this->destPitch = destPitch;
+    nextBand = 0;
+
+    if (workers.empty()) {
+        runBands();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        busyWorkers = workers.size();
+    }
+    startCondition.notify_all();
+}
+
+void Upscaler::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [&] { return busyWorkers == 0; });
+}
+
+void Upscaler::workerLoop(uint64_t seenGeneration)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        startCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+        if (stopping)
+            break;
+
+        seenGeneration = generation;
+        lock.unlock();
+        runBands();
+        lock.lock();
+
+        if (--busyWorkers == 0)
+            doneCondition.notify_one();
+    }
+}
+
+void Upscaler::runBands()
+{
+    for (uint32_t band; (band = nextBand.fetch_add(1)) < numBands;)
+        filterRows(band * bandRows, std::min(numRows, (band + 1) * bandRows));
+}
+
+void Upscaler::filterRows(uint32_t firstRow, uint32_t lastRow)
+{
+    switch (filter) {
+    case SCALE_NONE:
+        copyRows(firstRow, lastRow);
+        break;
+    case SCALE_2X:
+        scale2x(firstRow, lastRow);
+        break;
+    case SCALE_3X:
+        scale3x(firstRow, lastRow);
+        break;
+    case SCALE_XBR:
+        xbr(firstRow, lastRow);
+        break;
+    case SCALE_SHARP_BILINEAR:
+        sharpBilinear(firstRow, lastRow);
+        break;
+    }
+}
+
+void Upscaler::copyRows(uint32_t firstRow, uint32_t lastRow)
+{
+    for (uint32_t y = firstRow; y < lastRow; ++y)
+        memcpy(dest + y * destPitch, pixel(0, y), srcWidth * sizeof(uint32_t));
+}
+
+/**
+ *  Scale2x (AdvMAME2x): each pixel E becomes 2x2 pixels, and a corner takes the color of the two
+ *  neighbours next to it when they are equal and the edge doesn't continue in another direction
+ *
+ *    B      E0 E1
+ *  D E F    E2 E3
+ *    H
+ */
+void Upscaler::scale2x(uint32_t firstRow, uint32_t lastRow)
+{
+    for (uint32_t y = firstRow; y < lastRow; ++y) {
+        uint32_t *out0 = dest + y * 2 * destPitch;
+        uint32_t *out1 = out0 + destPitch;
+        uint32_t x = 0;
+
+#ifdef __SSE2__
+        for (; x + 4 <= srcWidth; x += 4) {
+            __m128i B = load4(pixel(x, y - 1));
+            __m128i D = load4(pixel(x - 1, y));
+            __m128i E = load4(pixel(x, y));
+            __m128i F = load4(pixel(x + 1, y));
+            __m128i H = load4(pixel(x, y + 1));
+
+            __m128i BD = _mm_cmpeq_epi32(B, D);
+            __m128i BF = _mm_cmpeq_epi32(B, F);
+            __m128i DH = _mm_cmpeq_epi32(D, H);
+            __m128i FH = _mm_cmpeq_epi32(F, H);
+
+            __m128i e0 = select(_mm_andnot_si128(_mm_or_si128(BF, DH), BD), D, E);
+            __m128i e1 = select(_mm_andnot_si128(_mm_or_si128(BD, FH), BF), F, E);
+            __m128i e2 = select(_mm_andnot_si128(_mm_or_si128(BD, FH), DH), D, E);
+            __m128i e3 = select(_mm_andnot_si128(_mm_or_si128(BF, DH), FH), F, E);
+
+            store4(out0 + x * 2, _mm_unpacklo_epi32(e0, e1));
+            store4(out0 + x * 2 + 4, _mm_unpackhi_epi32(e0, e1));
+            store4(out1 + x * 2, _mm_unpacklo_epi32(e2, e3));
+            store4(out1 + x * 2 + 4, _mm_unpackhi_epi32(e2, e3));
+        }
+#endif
+
+        for (; x < srcWidth; ++x) {
+            uint32_t B = *pixel(x, y - 1), D = *pixel(x - 1, y), E = *pixel(x, y);
+            uint32_t F = *pixel(x + 1, y), H = *pixel(x, y + 1);
+
+            out0[x * 2] = D == B && B != F && D != H ? D : E;
+            out0[x * 2 + 1] = B == F && B != D && F != H ? F : E;
+            out1[x * 2] = D == H && D != B && H != F ? D : E;
+            out1[x * 2 + 1] = H == F && D != H && B != F ? F : E;
+        }
+    }
+}
+
+/**
+ *  Scale3x (AdvMAME3x): each pixel E becomes 3x3 pixels; the corners follow the same rules as
+ *  Scale2x and the edges between them continue the diagonals
+ *
+ *  A B C    E0 E1 E2
+ *  D E F    E3 E4 E5
+ *  G H I    E6 E7 E8
+ */
+void Upscaler::scale3x(uint32_t firstRow, uint32_t lastRow)
+{
+    for (uint32_t y = firstRow; y < lastRow; ++y) {
+        uint32_t *out0 = dest + y * 3 * destPitch;
+        uint32_t *out1 = out0 + destPitch;
+        uint32_t *out2 = out1 + destPitch;
+        uint32_t x = 0;
+
+#ifdef __SSE2__
+        for (; x + 4 <= srcWidth; x += 4) {
+            __m128i A = load4(pixel(x - 1, y - 1));
+            __m128i B = load4(pixel(x, y - 1));
+            __m128i C = load4(pixel(x + 1, y - 1));
+            __m128i D = load4(pixel(x - 1, y));
+            __m128i E = load4(pixel(x, y));
+            __m128i F = load4(pixel(x + 1, y));
+            __m128i G = load4(pixel(x - 1, y + 1));
+            __m128i H = load4(pixel(x, y + 1));
+            __m128i I = load4(pixel(x + 1, y + 1));
+
+            __m128i BD = _mm_cmpeq_epi32(B, D);
+            __m128i BF = _mm_cmpeq_epi32(B, F);
+            __m128i DH = _mm_cmpeq_epi32(D, H);
+            __m128i FH = _mm_cmpeq_epi32(F, H);
+            __m128i EA = _mm_cmpeq_epi32(E, A);
+            __m128i EC = _mm_cmpeq_epi32(E, C);
+            __m128i EG = _mm_cmpeq_epi32(E, G);
+            __m128i EI = _mm_cmpeq_epi32(E, I);
+
+            // The corner conditions of Scale2x
+            __m128i c0 = _mm_andnot_si128(_mm_or_si128(BF, DH), BD);
+            __m128i c1 = _mm_andnot_si128(_mm_or_si128(BD, FH), BF);
+            __m128i c2 = _mm_andnot_si128(_mm_or_si128(BD, FH), DH);
+            __m128i c3 = _mm_andnot_si128(_mm_or_si128(BF, DH), FH);
+
+            __m128i e0 = select(c0, D, E);
+            __m128i e1 = select(
+                _mm_or_si128(_mm_andnot_si128(EC, c0), _mm_andnot_si128(EA, c1)), B, E);
+            __m128i e2 = select(c1, F, E);
+            __m128i e3 = select(
+                _mm_or_si128(_mm_andnot_si128(EG, c0), _mm_andnot_si128(EA, c2)), D, E);
+            __m128i e5 = select(
+                _mm_or_si128(_mm_andnot_si128(EI, c1), _mm_andnot_si128(EC, c3)), F, E);
+            __m128i e6 = select(c2, D, E);
+            __m128i e7 = select(
+                _mm_or_si128(_mm_andnot_si128(EI, c2), _mm_andnot_si128(EG, c3)), H, E);
+            __m128i e8 = select(c3, F, E);
+
+            store3(out0 + x * 3, e0, e1, e2);
+            store3(out1 + x * 3, e3, E, e5);
+            store3(out2 + x * 3, e6, e7, e8);
+        }
+#endif
+
+        for (; x < srcWidth; ++x) {
+            uint32_t A = *pixel(x - 1, y - 1), B = *pixel(x, y - 1), C = *pixel(x + 1, y - 1);
+            uint32_t D = *pixel(x - 1, y), E = *pixel(x, y), F = *pixel(x + 1, y);
+            uint32_t G = *pixel(x - 1, y + 1), H = *pixel(x, y + 1), I = *pixel(x + 1, y + 1);
+
+            bool c0 = D == B && B != F && D != H;
+            bool c1 = B == F && B != D && F != H;
+            bool c2 = D == H && D != B && H != F;
+            bool c3 = H == F && D != H && B != F;
+
+            out0[x * 3] = c0 ? D : E;
+            out0[x * 3 + 1] = (c0 && E != C) || (c1 && E != A) ? B : E;
+            out0[x * 3 + 2] = c1 ? F : E;
+            out1[x * 3] = (c0 && E != G) || (c2 && E != A) ? D : E;
+            out1[x * 3 + 1] = E;
+            out1[x * 3 + 2] = (c1 && E != I) || (c3 && E != C) ? F : E;
+            out2[x * 3] = c2 ? D : E;
+            out2[x * 3 + 1] = (c2 && E != I) || (c3 && E != G) ? H : E;
+            out2[x * 3 + 2] = c3 ? F : E;
+        }
+    }
+}
+
+/**
+ *  xBR-lite: the first level of xBR at 2x. Each corner of the 2x2 output of E compares the
+ *  color differences along the two diagonals of a 4x4 area towards it; if the edge runs along the
+ *  F-H diagonal, the corner is blended half way towards whichever of F and H is closer to E.
+ *  Shown for the bottom right corner, the others are mirrored:
+ *
+ *    B  C
+ *  D E  F  F4
+ *  G H  I  I4
+ *    H5 I5
+ *
+ *  edge: d(E,C) + d(E,G) + d(I,F4) + d(I,H5) + 4 d(H,F) < d(H,D) + d(H,I5) + d(F,I4) + d(F,B) + 4 d(E,I)
+ */
+void Upscaler::xbr(uint32_t firstRow, uint32_t lastRow)
+{
+    for (uint32_t y = firstRow; y < lastRow; ++y) {
+        uint32_t *out0 = dest + y * 2 * destPitch;
+        uint32_t *out1 = out0 + destPitch;
+        uint32_t x = 0;
+
+#ifdef __SSE2__
+        for (; x + 4 <= srcWidth; x += 4) {
+            auto at = [&](int32_t dx, int32_t dy) { return load4(pixel(x + dx, y + dy)); };
+
+            auto corner = [&](int32_t dx, int32_t dy) {
+                __m128i E = at(0, 0), F = at(dx, 0), H = at(0, dy), I = at(dx, dy);
+
+                __m128i weightE = _mm_add_epi32(
+                    _mm_add_epi32(distance4(E, at(dx, -dy)), distance4(E, at(-dx, dy))),
+                    _mm_add_epi32(_mm_add_epi32(distance4(I, at(2 * dx, 0)),
+                                                distance4(I, at(0, 2 * dy))),
+                                  _mm_slli_epi32(distance4(H, F), 2)));
+                __m128i weightI = _mm_add_epi32(
+                    _mm_add_epi32(distance4(H, at(-dx, 0)), distance4(H, at(dx, 2 * dy))),
+                    _mm_add_epi32(_mm_add_epi32(distance4(F, at(2 * dx, dy)),
+                                                distance4(F, at(0, -dy))),
+                                  _mm_slli_epi32(distance4(E, I), 2)));
+
+                __m128i edge = _mm_cmplt_epi32(weightE, weightI);
+                __m128i closer = select(_mm_cmpgt_epi32(distance4(E, F), distance4(E, H)), H, F);
+                return select(edge, _mm_avg_epu8(E, closer), E);
+            };
+
+            __m128i topLeft = corner(-1, -1), topRight = corner(1, -1);
+            __m128i bottomLeft = corner(-1, 1), bottomRight = corner(1, 1);
+
+            store4(out0 + x * 2, _mm_unpacklo_epi32(topLeft, topRight));
+            store4(out0 + x * 2 + 4, _mm_unpackhi_epi32(topLeft, topRight));
+            store4(out1 + x * 2, _mm_unpacklo_epi32(bottomLeft, bottomRight));
+            store4(out1 + x * 2 + 4, _mm_unpackhi_epi32(bottomLeft, bottomRight));
+        }
+#endif
+
+        for (; x < srcWidth; ++x) {
+            auto at = [&](int32_t dx, int32_t dy) { return *pixel(x + dx, y + dy); };
+
+            auto corner = [&](int32_t dx, int32_t dy) {
+                uint32_t E = at(0, 0), F = at(dx, 0), H = at(0, dy), I = at(dx, dy);
+
+                uint32_t weightE = distance(E, at(dx, -dy)) + distance(E, at(-dx, dy)) +
+                                   distance(I, at(2 * dx, 0)) + distance(I, at(0, 2 * dy)) +
+                                   4 * distance(H, F);
+                uint32_t weightI = distance(H, at(-dx, 0)) + distance(H, at(dx, 2 * dy)) +
+                                   distance(F, at(2 * dx, dy)) + distance(F, at(0, -dy)) +
+                                   4 * distance(E, I);
+
+                if (weightE >= weightI)
+                    return E;
+                return average(E, distance(E, F) > distance(E, H) ? H : F);
+            };
+
+            out0[x * 2] = corner(-1, -1);
+            out0[x * 2 + 1] = corner(1, -1);
+            out1[x * 2] = corner(-1, 1);
+            out1[x * 2 + 1] = corner(1, 1);
+        }
+    }
+}
+
+void Upscaler::sharpBilinear(uint32_t firstRow, uint32_t lastRow)
+{
+    // Scale the source rows of the band horizontally first; most output rows are then a copy of
+    // one of them, and the others a blend of two
+    uint32_t firstSrcRow = rowIndex[0][firstRow];
+    uint32_t lastSrcRow = rowIndex[1][lastRow - 1];
+
+    thread_local std::vector<uint32_t> rows;
+    rows.resize((lastSrcRow - firstSrcRow + 1) * outWidth);
+
+    for (uint32_t srcY = firstSrcRow; srcY <= lastSrcRow; ++srcY)
+        scaleRow(pixel(0, srcY), &rows[(srcY - firstSrcRow) * outWidth]);
+
+    for (uint32_t y = firstRow; y < lastRow; ++y) {
+        const uint32_t *top = &rows[(rowIndex[0][y] - firstSrcRow) * outWidth];
+        const uint32_t *bottom = &rows[(rowIndex[1][y] - firstSrcRow) * outWidth];
+        uint32_t *out = dest + y * destPitch;
+        uint16_t weight = rowWeight[y];
+
+        if (weight == 0 || weight == 128) {
+            memcpy(out, weight == 0 ? top : bottom, outWidth * sizeof(uint32_t));
+            continue;
+        }
+
+        uint32_t x = 0;
+
+#ifdef __SSE2__
+        __m128i zero = _mm_setzero_si128();
+        __m128i weightY = _mm_set1_epi16(weight);
+
+        for (; x + 4 <= outWidth; x += 4) {
+            __m128i topPixels = load4(top + x), bottomPixels = load4(bottom + x);
+            __m128i low = lerp2(_mm_unpacklo_epi8(topPixels, zero),
+                                _mm_unpacklo_epi8(bottomPixels, zero), weightY);
+            __m128i high = lerp2(_mm_unpackhi_epi8(topPixels, zero),
+                                 _mm_unpackhi_epi8(bottomPixels, zero), weightY);
+            store4(out + x, _mm_packus_epi16(low, high));
+        }
+#endif
+
+        for (; x < outWidth; ++x)
+            out[x] = lerp(top[x], bottom[x], weight);
+    }
+}
+
+void Upscaler::scaleRow(const uint32_t *src, uint32_t *out)
+{
+    uint32_t x = 0;
+
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+
+    // 2 pixels at a time, with the 4 channels of each one in 16-bit lanes
+    for (; x + 2 <= outWidth; x += 2) {
+        uint32_t left0 = columnIndex[0][x], right0 = columnIndex[1][x];
+        uint32_t left1 = columnIndex[0][x + 1], right1 = columnIndex[1][x + 1];
+        int16_t weight0 = columnWeight[x], weight1 = columnWeight[x + 1];
+        __m128i weight = _mm_set_epi16(weight1, weight1, weight1, weight1, weight0, weight0,
+                                       weight0, weight0);
+
+        __m128i left = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, src[left1], src[left0]), zero);
+        __m128i right = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, src[right1], src[right0]), zero);
+        __m128i result = lerp2(left, right, weight);
+
+        _mm_storel_epi64((__m128i *)(out + x), _mm_packus_epi16(result, result));
+    }
+#endif
+
+    for (; x < outWidth; ++x)
+        out[x] = lerp(src[columnIndex[0][x]], src[columnIndex[1][x]], columnWeight[x]);
+}
+
+uint32_t Upscaler::getFilterFactor(ScaleFilter filter)
+{
+    switch (filter) {
+    case SCALE_NONE:
+        return 1;
+    case SCALE_2X:
+    case SCALE_XBR:
+        return 2;
+    case SCALE_3X:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static const char *filterNames[] = {"none", "scale2x", "scale3x", "xbr", "sharp-bilinear"};
+
+const char *Upscaler::getFilterName(ScaleFilter filter) { return filterNames[filter]; }
+
+bool Upscaler::getFilterByName(const std::string &name, ScaleFilter &filter)
+{
+    for (int i = SCALE_NONE; i <= SCALE_SHARP_BILINEAR; ++i) {
+        if (name == filterNames[i]) {
+            filter = (ScaleFilter)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Upscaler::packColors(const Color *src, uint32_t *dest, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        dest[i] = (src[i].red << 24) | (src[i].green << 16) | (src[i].blue << 8) | 0xFF;
+}
@@ -1,6 +1,9 @@
 #include "Config.hpp"
 #include "Enums.hpp"
 #include "GameBoy.hpp"
+#include "Recorder.hpp"
+#include "RomLibrary.hpp"
+#include "Upscaler.hpp"
 #include <iostream>
 #include <string>
 #include <experimental/filesystem>
@@ -27,6 +30,16 @@ int main(int argc, char **argv)
     EmulatorMode emulatorMode = EmulatorMode::DMG;
     std::string romPath;
     bool romPathSet = false;
+    std::string recordMoviePath, playMoviePath;
+    bool recordMovieFromSave = false;
+    std::string recordVideoPath, recordAudioPath;
+    uint benchmarkFrames = 0;
+    bool headless = false;
+    uint headlessFrames = 0;
+    std::string hashOutputPath, goldenHashPath;
+    std::string convertTracePath;
+    std::string libraryPath;
+    bool verifyLibraryChecksums = false;
 
     // Parse args
     for (int i = 1; i < argc; ++i) {
@@ -93,6 +106,191 @@ int main(int argc, char **argv)
                     ++i;
                 }
                 break;
+            case 'r':
+            case 'p':
+                // Movie recording / playback
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                if (argv[i][1] == 'r')
+                    recordMoviePath = argv[i + 1];
+                else
+                    playMoviePath = argv[i + 1];
+
+                ++i;
+                break;
+            case 'V':
+            case 'A':
+                // Video / audio recording
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                if (argv[i][1] == 'V')
+                    recordVideoPath = argv[i + 1];
+                else
+                    recordAudioPath = argv[i + 1];
+
+                ++i;
+                break;
+            case 's':
+                // Start the movie recording from the save file
+                recordMovieFromSave = true;
+                break;
+            case 'j':
+                // JIT
+                Config::getInstance()->setUseJit(true);
+                break;
+            case 'a':
+                // Accuracy profile
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                if (strcmp(argv[i + 1], "accurate") == 0) {
+                    Config::getInstance()->setAccuracyProfile(ACCURATE);
+                } else if (strcmp(argv[i + 1], "fast") == 0) {
+                    Config::getInstance()->setAccuracyProfile(FAST);
+                } else {
+                    std::cerr << "Bad accuracy profile given\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                ++i;
+
+                break;
+            case 'P':
+                // Profiler
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                if (strcmp(argv[i + 1], "report") == 0) {
+                    Config::getInstance()->setProfilerOutput(PROFILER_REPORT);
+                } else if (strcmp(argv[i + 1], "folded") == 0) {
+                    Config::getInstance()->setProfilerOutput(PROFILER_FOLDED);
+                } else {
+                    std::cerr << "Bad profiler output given\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                ++i;
+
+                break;
+            case 't':
+                // CPU trace
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                if (strcmp(argv[i + 1], "ring") == 0) {
+                    Config::getInstance()->setTraceMode(TRACE_RING);
+                } else if (strcmp(argv[i + 1], "stream") == 0) {
+                    Config::getInstance()->setTraceMode(TRACE_STREAM);
+                } else {
+                    std::cerr << "Bad trace mode given\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                ++i;
+
+                break;
+            case 'T':
+                // Timeline
+                Config::getInstance()->setTimelineEnable(true);
+                break;
+            case 'D':
+                // Convert a CPU trace to the gameboy-doctor format
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                convertTracePath = argv[i + 1];
+                ++i;
+
+                break;
+            case 'L':
+                // List the ROMs of a library
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                libraryPath = argv[i + 1];
+                ++i;
+
+                break;
+            case 'C':
+                // Verify the global checksums of the library
+                verifyLibraryChecksums = true;
+                break;
+            case 'B':
+                // Benchmark
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                try {
+                    benchmarkFrames = std::stoi(argv[i + 1]);
+                } catch (const std::invalid_argument &ia) {
+                    std::cerr << "Bad number of benchmark frames\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                ++i;
+
+                break;
+            case 'H':
+                // Headless run
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                try {
+                    headlessFrames = std::stoi(argv[i + 1]);
+                } catch (const std::invalid_argument &ia) {
+                    std::cerr << "Bad number of headless frames\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                headless = true;
+                ++i;
+
+                break;
+            case 'O':
+            case 'G':
+                // Hash stream output / golden hash stream
+                if (!(i + 1 < argc)) {
+                    std::cerr << "Bad number of args\n";
+                    printUsage(argv[0]);
+                    return 1;
+                }
+
+                if (argv[i][1] == 'O')
+                    hashOutputPath = argv[i + 1];
+                else
+                    goldenHashPath = argv[i + 1];
+
+                ++i;
+                break;
             case 'h':
                 // Help
                 printUsage(argv[0]);
@@ -119,14 +317,79 @@ int main(int argc, char **argv)
         }
     }
 
+    if (!convertTracePath.empty())
+        return Tracer::convertToDoctor(convertTracePath, stdout) ? 0 : 1;
+
+    if (!libraryPath.empty()) {
+        RomLibrary library;
+        fs::path indexPath = fs::path(libraryPath) / ROM_LIBRARY_INDEX_NAME;
+
+        auto start = std::chrono::steady_clock::now();
+        library.loadIndex(indexPath);
+        library.scan(libraryPath);
+
+        if (verifyLibraryChecksums) {
+            for (RomLibraryEntry &entry : library.entries) {
+                if (entry.globalChecksumState == CHECKSUM_UNKNOWN)
+                    library.verifyGlobalChecksum(entry);
+            }
+        }
+
+        library.saveIndex(indexPath);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                        .count();
+
+        library.print(stdout);
+        std::cerr << library.entries.size() << " ROMs (" << library.headersRead
+                  << " headers read) in " << ms << " ms\n";
+        return 0;
+    }
+
     if (!romPathSet) {
         std::cerr << "No ROM file has been provided\n";
         printUsage(argv[0]);
         return 1;
     }
 
+    if (!recordMoviePath.empty() && !playMoviePath.empty()) {
+        std::cerr << "A movie can't be recorded and played back at the same time\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
     GameBoy gb = GameBoy(emulatorMode);
     gb.romPath = romPath;
+    gb.recordMoviePath = recordMoviePath;
+    gb.playMoviePath = playMoviePath;
+    gb.recordMovieFromSave = recordMovieFromSave;
+    gb.recordVideoPath = recordVideoPath;
+    gb.recordAudioPath = recordAudioPath;
+
+    if (benchmarkFrames > 0) {
+        gb.benchmark(benchmarkFrames);
+        return 0;
+    }
+
+    if (headless) {
+        if (!recordMoviePath.empty()) {
+            std::cerr << "A movie can't be recorded in a headless run\n";
+            return 1;
+        }
+
+        if (headlessFrames == 0 && playMoviePath.empty()) {
+            std::cerr << "-H 0 runs until the end of a movie, but none is played back\n";
+            return 1;
+        }
+
+        HashStream hashes;
+        if (!hashOutputPath.empty() && !hashes.open(hashOutputPath))
+            return 1;
+        if (!goldenHashPath.empty() && !hashes.loadGolden(goldenHashPath))
+            return 1;
+
+        bool match = gb.runHeadless(headlessFrames, hashes);
+        return hashes.close() && match ? 0 : 1;
+    }
 
     gb.initSDL();
     gb.run();
@@ -181,11 +444,125 @@ bool readConfig(char *execPath)
             config->setPrintPerformanceInfo(printPerformanceInfo);
         }
 
+        int performanceInfoInterval = reader.GetInteger("General", "performanceInfoInterval", config->getPerformanceInfoInterval());
+        if (performanceInfoInterval != config->getPerformanceInfoInterval()) {
+            config->setPerformanceInfoInterval(performanceInfoInterval);
+        }
+
         bool useCustomDMGPalette = reader.GetBoolean("General", "useCustomDMGPalette", config->getUseCustomDMGPalette());
         if (useCustomDMGPalette != config->getUseCustomDMGPalette()) {
             config->setUseCustomDMGPalette(useCustomDMGPalette);
         }
 
+        int runAheadFrames = reader.GetInteger("General", "runAheadFrames", config->getRunAheadFrames());
+        if (runAheadFrames != config->getRunAheadFrames()) {
+            config->setRunAheadFrames(runAheadFrames);
+        }
+
+        bool useJit = reader.GetBoolean("General", "useJit", config->getUseJit());
+        if (useJit != config->getUseJit()) {
+            config->setUseJit(useJit);
+        }
+
+        bool idleLoopSkipping = reader.GetBoolean("General", "idleLoopSkipping", config->getIdleLoopSkipping());
+        if (idleLoopSkipping != config->getIdleLoopSkipping()) {
+            config->setIdleLoopSkipping(idleLoopSkipping);
+        }
+
+        std::string accuracyProfile = reader.GetString("General", "accuracyProfile", "accurate");
+        if (accuracyProfile == "fast") {
+            config->setAccuracyProfile(FAST);
+        } else if (accuracyProfile != "accurate") {
+            std::cerr << "Bad accuracyProfile in " << configPath << '\n';
+            return false;
+        }
+
+        bool renderThread = reader.GetBoolean("General", "renderThread", config->getRenderThread());
+        if (renderThread != config->getRenderThread()) {
+            config->setRenderThread(renderThread);
+        }
+
+        bool audioThread = reader.GetBoolean("General", "audioThread", config->getAudioThread());
+        if (audioThread != config->getAudioThread()) {
+            config->setAudioThread(audioThread);
+        }
+
+        bool timelineEnable = reader.GetBoolean("General", "timeline", config->getTimelineEnable());
+        if (timelineEnable != config->getTimelineEnable()) {
+            config->setTimelineEnable(timelineEnable);
+        }
+
+        bool timelinePpuModes = reader.GetBoolean("General", "timelinePpuModes", config->getTimelinePpuModes());
+        if (timelinePpuModes != config->getTimelinePpuModes()) {
+            config->setTimelinePpuModes(timelinePpuModes);
+        }
+
+        ScaleFilter scaleFilter;
+        if (!Upscaler::getFilterByName(reader.GetString("General", "scaleFilter", "none"),
+                                       scaleFilter)) {
+            std::cerr << "Bad scaleFilter in " << configPath << '\n';
+            return false;
+        }
+        config->setScaleFilter(scaleFilter);
+
+        int scaleThreads = reader.GetInteger("General", "scaleThreads", config->getScaleThreads());
+        if (scaleThreads != config->getScaleThreads()) {
+            config->setScaleThreads(scaleThreads);
+        }
+
+        std::string trace = reader.GetString("Trace", "trace", "off");
+        if (trace == "ring") {
+            config->setTraceMode(TRACE_RING);
+        } else if (trace == "stream") {
+            config->setTraceMode(TRACE_STREAM);
+        } else if (trace != "off") {
+            std::cerr << "Bad trace in " << configPath << '\n';
+            return false;
+        }
+
+        int traceBufferSize = reader.GetInteger("Trace", "traceBufferSize", config->getTraceBufferSize());
+        if (traceBufferSize != config->getTraceBufferSize()) {
+            config->setTraceBufferSize(traceBufferSize);
+        }
+
+        std::string profiler = reader.GetString("General", "profiler", "off");
+        if (profiler == "report") {
+            config->setProfilerOutput(PROFILER_REPORT);
+        } else if (profiler == "folded") {
+            config->setProfilerOutput(PROFILER_FOLDED);
+        } else if (profiler != "off") {
+            std::cerr << "Bad profiler in " << configPath << '\n';
+            return false;
+        }
+
+        bool rewindEnable = reader.GetBoolean("Rewind", "rewindEnable", config->getRewindEnable());
+        if (rewindEnable != config->getRewindEnable()) {
+            config->setRewindEnable(rewindEnable);
+        }
+
+        int rewindFrameInterval = reader.GetInteger("Rewind", "rewindFrameInterval", config->getRewindFrameInterval());
+        if (rewindFrameInterval != config->getRewindFrameInterval()) {
+            config->setRewindFrameInterval(rewindFrameInterval);
+        }
+
+        int rewindBufferSize = reader.GetInteger("Rewind", "rewindBufferSize", config->getRewindBufferSize());
+        if (rewindBufferSize != config->getRewindBufferSize()) {
+            config->setRewindBufferSize(rewindBufferSize);
+        }
+
+        RecordFormat recordFormat;
+        if (!Recorder::getFormatByName(reader.GetString("Record", "recordFormat", "y4m"),
+                                       recordFormat)) {
+            std::cerr << "Bad recordFormat in " << configPath << '\n';
+            return false;
+        }
+        config->setRecordFormat(recordFormat);
+
+        bool recordDirectIo = reader.GetBoolean("Record", "recordDirectIo", config->getRecordDirectIo());
+        if (recordDirectIo != config->getRecordDirectIo()) {
+            config->setRecordDirectIo(recordDirectIo);
+        }
+
         // get colors
         std::string colorString;
         Color color;
@@ -269,5 +646,29 @@ void printUsage(char *programName)
               << "\t-w windowSize: How big should the window be compared to the gameboy's "
                  "resolution of 160x144\n"
               << "\t-b bootromPath: Path to the DMG bootrom\n"
+              << "\t-r moviePath: Record the input to a movie file\n"
+              << "\t-s: Start the recording from the battery save instead of power-on\n"
+              << "\t-p moviePath: Play back a movie file\n"
+              << "\t-V videoPath: Record the frames to a Y4M or raw RGBA file or named pipe\n"
+              << "\t-A audioPath: Record the audio to a WAV file or named pipe\n"
+              << "\t-j: Run hot ROM code with the x86-64 JIT instead of the interpreter\n"
+              << "\t-a accurate | fast: Selects the accuracy profile. By default accurate is "
+                 "selected\n"
+              << "\t-P report | folded: Profile the guest code and write a report or folded "
+                 "stacks next to the ROM on exit\n"
+              << "\t-t ring | stream: Record a CPU trace; ring keeps the last instructions and "
+                 "writes them on a crash, SIGUSR1 or F12, stream writes every instruction\n"
+              << "\t-T: Record a timeline of the emulator and write it in the Chrome trace format "
+                 "on exit\n"
+              << "\t-D tracePath: Print a CPU trace in the gameboy-doctor format and exit\n"
+              << "\t-L libraryPath: List the ROMs in a directory and its subdirectories and exit\n"
+              << "\t-C: Verify the global checksums of the ROMs listed with -L\n"
+              << "\t-B frames: Run the given number of frames without video and audio with every "
+                 "accuracy profile and print the throughput and the cost of every scale filter\n"
+              << "\t-H frames: Run the given number of frames (0 runs until the end of the movie) "
+                 "without video and audio as fast as possible and hash every frame and audio block\n"
+              << "\t-O hashPath: Write the hashes of the headless run to a file\n"
+              << "\t-G goldenPath: Compare the hashes of the headless run to a file written with "
+                 "-O and stop at the first difference\n"
               << "\t-h: Prints this message\n";
 }
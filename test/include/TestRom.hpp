@@ -0,0 +1,22 @@
+#ifndef __TEST_ROM_H__
+#define __TEST_ROM_H__
+
+#pragma once
+#include "ROM.hpp"
+#include <vector>
+
+class TestRom
+{
+  public:
+    // Loaded ROMs are mapped read-only and shared between the instances, so the tests that patch
+    // the ROM copy it into data first and map the banks from the copy. Returns the copy
+    static uint8_t *makeWritable(ROM &rom, std::vector<uint8_t> &data)
+    {
+        data.assign(rom.rom, rom.rom + rom.romFileSize);
+        rom.rom = data.data();
+        rom.mapBanks();
+        return data.data();
+    }
+};
+
+#endif // __TEST_ROM_H__
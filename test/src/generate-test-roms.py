@@ -15,11 +15,16 @@ def generate_nintendo_logo():
 
 def generate_cartridge(file_name, good_nintendo_logo=True, game_title='GAME TITLE', gbc_flag=0x80,
                        sgb_flag=0x00, cartridge_type=0x00, rom_size=0x00, ram_size=0x00,
-                       rom_version=0x00, header_checksum=0x00, global_checksum=0x00):
+                       rom_version=0x00, header_checksum=0x00, global_checksum=0x00, code=None):
 
     actual_rom_size = (0x8000 << rom_size)
     rom = [0x00] * actual_rom_size
 
+    # Program; address -> bytes
+    if code is not None:
+        for address, data in code.items():
+            rom[address:address + len(data)] = data
+
     # Nintendo logo
     if good_nintendo_logo:
         nintendo_logo = generate_nintendo_logo()
@@ -79,6 +84,108 @@ def generate_cartridge(file_name, good_nintendo_logo=True, game_title='GAME TITL
         f.write(rom_bytes)
 
 
+def generate_benchmark_code():
+    """
+    A small game loop for the benchmark: it shows a background of 256 tiles and 40 sprites,
+    then every frame waits for VBlank with HALT, starts the OAM DMA, moves the sprites, scrolls
+    the background, changes the pitch of a square wave and spends most of the rest of the frame
+    summing ROM bytes
+    """
+    tiles = [(i * 37 + (i >> 3)) & 0xFF for i in range(0x1000)]
+    sprites = []
+    for i in range(40):
+        sprites += [16 + (i % 18) * 8, 8 + i * 4, i, 0x00]
+
+    # Copies bc bytes from de to hl
+    copy = [0x1A, 0x22, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8, 0xC9]
+    # OAM DMA from a * 0x100, run from HRAM
+    dma = [0xE0, 0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9]
+
+    init = [
+        0xF3,                          # di
+        0x31, 0xFE, 0xFF,              # ld sp, 0xFFFE
+        0xAF,                          # xor a
+        0xE0, 0x40,                    # ldh (LCDC), a
+        0x21, 0x00, 0x80,              # ld hl, 0x8000
+        0x11, 0x00, 0x10,              # ld de, tiles
+        0x01, 0x00, 0x10,              # ld bc, 0x1000
+        0xCD, 0x00, 0x02,              # call copy
+        0x21, 0x00, 0xC0,              # ld hl, 0xC000
+        0x11, 0x00, 0x03,              # ld de, sprites
+        0x01, 0xA0, 0x00,              # ld bc, 160
+        0xCD, 0x00, 0x02,              # call copy
+        0x21, 0x80, 0xFF,              # ld hl, 0xFF80
+        0x11, 0x10, 0x02,              # ld de, dma
+        0x01, len(dma), 0x00,          # ld bc, len(dma)
+        0xCD, 0x00, 0x02,              # call copy
+        0x21, 0x00, 0x98,              # ld hl, 0x9800
+        0x01, 0x00, 0x04,              # ld bc, 0x400
+        0x7D,                          # map: ld a, l
+        0x22,                          # ld (hl+), a
+        0x0B,                          # dec bc
+        0x78,                          # ld a, b
+        0xB1,                          # or c
+        0x20, 0xF9,                    # jr nz, map
+        0x3E, 0xE4,                    # ld a, 0xE4
+        0xE0, 0x47,                    # ldh (BGP), a
+        0xE0, 0x48,                    # ldh (OBP0), a
+        0x3E, 0x80, 0xE0, 0x26,        # NR52 = 0x80
+        0x3E, 0x77, 0xE0, 0x24,        # NR50 = 0x77
+        0x3E, 0xFF, 0xE0, 0x25,        # NR51 = 0xFF
+        0x3E, 0x80, 0xE0, 0x16,        # NR21 = 0x80
+        0x3E, 0xF0, 0xE0, 0x17,        # NR22 = 0xF0
+        0x3E, 0x87, 0xE0, 0x19,        # NR24 = 0x87
+        0x3E, 0x93, 0xE0, 0x40,        # LCDC = 0x93
+        0x3E, 0x01, 0xE0, 0xFF,        # IE = VBlank
+        0xAF, 0xE0, 0x0F,              # IF = 0
+        0xFB,                          # ei
+    ]
+    frame = [
+        0x76,                          # main: halt
+        0x00,                          # nop
+        0x3E, 0xC0,                    # ld a, 0xC0
+        0xCD, 0x80, 0xFF,              # call dma
+        0x21, 0x01, 0xC0,              # ld hl, 0xC001
+        0x06, 0x28,                    # ld b, 40
+        0x7E,                          # sprite: ld a, (hl)
+        0x3C,                          # inc a
+        0x77,                          # ld (hl), a
+        0x23, 0x23, 0x23, 0x23,        # inc hl x4
+        0x05,                          # dec b
+        0x20, 0xF6,                    # jr nz, sprite
+        0xF0, 0x42,                    # ldh a, (SCY)
+        0x3C,                          # inc a
+        0xE0, 0x42,                    # ldh (SCY), a
+        0xE0, 0x18,                    # ldh (NR23), a
+        0x21, 0x00, 0x10,              # ld hl, tiles
+        0x01, 0x00, 0x05,              # ld bc, 0x500
+        0x1E, 0x00,                    # ld e, 0
+        0x2A,                          # sum: ld a, (hl+)
+        0x83,                          # add a, e
+        0x5F,                          # ld e, a
+        0x0B,                          # dec bc
+        0x78,                          # ld a, b
+        0xB1,                          # or c
+        0x20, 0xF8,                    # jr nz, sum
+        0x7B,                          # ld a, e
+        0xEA, 0x00, 0xC1,              # ld (0xC100), a
+    ]
+    main = 0x150 + len(init)
+    jump_back = main - (main + len(frame) + 2)
+    frame += [0x18, jump_back & 0xFF]  # jr main
+
+    return {
+        # VBlank: scroll the background horizontally
+        0x0040: [0xF5, 0xF0, 0x43, 0x3C, 0xE0, 0x43, 0xF1, 0xD9],
+        0x0100: [0x00, 0xC3, 0x50, 0x01],
+        0x0150: init + frame,
+        0x0200: copy,
+        0x0210: dma,
+        0x0300: sprites,
+        0x1000: tiles,
+    }
+
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Generate test roms')
     parser.add_argument('-d', '--dir', default='.',
@@ -154,3 +261,12 @@ if __name__ == '__main__':
     else:
         generate_cartridge(rom_path, game_title='MBC5',
                            cartridge_type=0x1A, rom_size=0x08, ram_size=0x04)
+
+    # A game loop to benchmark
+    rom_name = 'bench.gb'
+    rom_path = path.join(rom_folder_path, rom_name)
+    if path.exists(rom_path):
+        print(rom_name + ' already exists, skipping...')
+    else:
+        generate_cartridge(rom_path, game_title='BENCH', gbc_flag=0x00,
+                           code=generate_benchmark_code())
@@ -0,0 +1,104 @@
+#include "catch.hpp"
+
+#include "Audio.hpp"
+#include "AudioThread.hpp"
+#include "Memory.hpp"
+#include "PPU.hpp"
+#include <cstring>
+
+TEST_CASE("Audio Thread", "[AUDIO]")
+{
+    // The same writes are played by an Audio on its own and by one with an audio thread
+    PPU ppu[2];
+    Memory mem[2];
+    Audio audio[2];
+    AudioThread audioThread;
+
+    for (int i = 0; i < 2; ++i) {
+        ppu[i].memory = &mem[i];
+        mem[i].ppu = &ppu[i];
+        mem[i].audio = &audio[i];
+        audio[i].memory = &mem[i];
+        audio[i].queueToSdl = false;
+        memset(mem[i].ioRegisters, 0, sizeof(mem[i].ioRegisters));
+    }
+
+    audioThread.start(&audio[1]);
+    REQUIRE(audio[1].audioThread == &audioThread);
+
+    auto write = [&](uint16_t addr, uint8_t val) {
+        for (int i = 0; i < 2; ++i)
+            mem[i].writemem(val, addr);
+    };
+
+    // Sound on, full volume on both sides
+    write(0xFF26, 0x80);
+    write(0xFF24, 0x77);
+    write(0xFF25, 0xFF);
+
+    // Channel 1 with an increasing sweep, channel 2 with a length of 6, a wave and noise
+    write(0xFF10, 0x11);
+    write(0xFF11, 0x80);
+    write(0xFF12, 0xF3);
+    write(0xFF13, 0x00);
+    write(0xFF14, 0x87);
+
+    write(0xFF16, 0x7A);
+    write(0xFF17, 0xA1);
+    write(0xFF18, 0x40);
+    write(0xFF19, 0xC6);
+
+    for (uint16_t addr = 0xFF30; addr <= 0xFF3F; ++addr)
+        write(addr, (addr & 0xF) * 0x11);
+    write(0xFF1A, 0x80);
+    write(0xFF1C, 0x20);
+    write(0xFF1D, 0x00);
+    write(0xFF1E, 0x85);
+
+    write(0xFF21, 0xF1);
+    write(0xFF22, 0x21);
+    write(0xFF23, 0x80);
+
+    // The NR52 flags the CPU reads are the same on every cycle. Channel 3 is panned left halfway,
+    // and the samples of a stretch in the middle aren't mixed, like during run-ahead
+    bool sameFlags = true;
+    for (uint32_t t = 0; t < 3 * 70224; t += 4) {
+        if (t == 100000)
+            write(0xFF25, 0xBF);
+        if (t == 120000) {
+            audio[0].mixSamples = false;
+            audio[1].mixSamples = false;
+        } else if (t == 130000) {
+            audio[0].mixSamples = true;
+            audio[1].mixSamples = true;
+        }
+
+        audio[0].cycle(4);
+        audio[1].cycle(4);
+        sameFlags = sameFlags && mem[0].readmem(0xFF26) == mem[1].readmem(0xFF26);
+    }
+
+    REQUIRE(sameFlags);
+    // Channel 2 was turned off by its length counter, channel 1 by the sweep
+    REQUIRE((mem[1].readmem(0xFF26) & 0x3) == 0);
+    REQUIRE((mem[1].readmem(0xFF26) & 0xC) == 0xC);
+
+    // The samples and the state only the shadow channels keep come back when the thread stops
+    audioThread.stop();
+    REQUIRE(audio[1].audioThread == nullptr);
+
+    REQUIRE(audio[1].currentAudioSamples == audio[0].currentAudioSamples);
+    REQUIRE(memcmp(audio[1].audioBuffer, audio[0].audioBuffer, sizeof(audio[0].audioBuffer)) == 0);
+
+    bool silent = true;
+    for (uint32_t i = 0; i < audio[0].currentAudioSamples; ++i)
+        silent = silent && audio[0].audioBuffer[i] == 0;
+    REQUIRE_FALSE(silent);
+
+    REQUIRE(audio[1].currentCyclesUntilSampleCollection ==
+            audio[0].currentCyclesUntilSampleCollection);
+    REQUIRE(audio[1].channel1.currentDutyStep == audio[0].channel1.currentDutyStep);
+    REQUIRE(audio[1].channel2.internalVolume == audio[0].channel2.internalVolume);
+    REQUIRE(audio[1].channel3.samplePosition == audio[0].channel3.samplePosition);
+    REQUIRE(audio[1].channel4.lfsr == audio[0].channel4.lfsr);
+}
@@ -2,6 +2,7 @@
 
 #include "Memory.hpp"
 #include "TestConstants.hpp"
+#include "TestRom.hpp"
 #include "PPU.hpp"
 #include <cstdlib>
 #include <experimental/filesystem>
@@ -22,10 +23,13 @@ TEST_CASE("Read Memory", "[MEM]")
 
     rom.loadROM(romDirPath / "test_mbc5.gb");
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add data to ROM
     // Fill each rom bank with its number
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = i / 0x4000;
+        romBytes[i] = i / 0x4000;
 
     // Fill each ram bank with its number
     for (uint32_t i = 0; i < rom.ramSize; ++i)
@@ -2,6 +2,7 @@
 
 #include "Memory.hpp"
 #include "PPU.hpp"
+#include "RenderThread.hpp"
 #include "SM83.hpp"
 #include <cstdlib>
 #include <iostream>
@@ -1128,6 +1129,62 @@ TEST_CASE("Get Tile By Index", "[PPU]")
     }
 }
 
+TEST_CASE("Tile Decoding", "[PPU]")
+{
+    // Bit 7 of each plane byte is the leftmost pixel, the high plane is bit 1 of the color
+    auto referenceColor = [](uint8_t *bytes, int row, int col) {
+        int bit = 7 - col;
+        return ((bytes[row * 2] >> bit) & 1) | (((bytes[row * 2 + 1] >> bit) & 1) << 1);
+    };
+
+    srand(0x2B99);
+    uint8_t bytes[16];
+    for (int i = 0; i < 16; ++i)
+        bytes[i] = rand() & 0xFF;
+
+    Tile tile(bytes);
+
+    SECTION("Decode")
+    {
+        uint8_t row[8];
+        for (int i = 0; i < 8; ++i) {
+            tile.getTileRow(i, row);
+            for (int j = 0; j < 8; ++j)
+                REQUIRE(row[j] == referenceColor(bytes, i, j));
+        }
+    }
+
+    SECTION("Decode Row")
+    {
+        uint8_t row[8];
+        for (int i = 0; i < 8; ++i) {
+            Tile::decodeRow(bytes[i * 2], bytes[i * 2 + 1], row);
+            for (int j = 0; j < 8; ++j)
+                REQUIRE(row[j] == referenceColor(bytes, i, j));
+
+            Tile::decodeRow(bytes[i * 2], bytes[i * 2 + 1], row, true);
+            for (int j = 0; j < 8; ++j)
+                REQUIRE(row[j] == referenceColor(bytes, i, 7 - j));
+        }
+    }
+
+    SECTION("Flip Horizontal")
+    {
+        tile.flipHor();
+        for (int i = 0; i < 8; ++i)
+            for (int j = 0; j < 8; ++j)
+                REQUIRE(tile.tileData[i * 8 + j] == referenceColor(bytes, i, 7 - j));
+    }
+
+    SECTION("Flip Vertical")
+    {
+        tile.flipVert();
+        for (int i = 0; i < 8; ++i)
+            for (int j = 0; j < 8; ++j)
+                REQUIRE(tile.tileData[i * 8 + j] == referenceColor(bytes, 7 - i, j));
+    }
+}
+
 TEST_CASE("Get Sprite By Index", "[PPU]")
 {
     PPU ppu;
@@ -1487,6 +1544,56 @@ TEST_CASE("Search Sprites on Line", "[PPU]")
         for (uint8_t i = 0; i < ppu.numSpritesOnCurrentLine; ++i)
             REQUIRE(ppu.spritesOnCurrentLine[i] == goodSpriteIndexes[i]);
     }
+
+    SECTION("Sprite Rows")
+    {
+        ppu.emulatorMode = DMG;
+        ppu.setObjSize(1);
+        ppu.setLy(100);
+
+        // Tiles 4 and 5: the low plane of row n is 0x80 >> (n % 8), the high plane is set on the
+        // second tile
+        for (uint8_t i = 0; i < 16; ++i) {
+            mem.writemem(0x80 >> (i % 8), 0x8000 + 4 * 16 + i * 2, true, true);
+            mem.writemem(i < 8 ? 0x00 : 0xFF, 0x8000 + 4 * 16 + i * 2 + 1, true, true);
+        }
+
+        OAMSprite sprite;
+        sprite.tileNumber = 5;
+        sprite.dmgPaletteNumber = 1;
+
+        // Row 3 of the first tile
+        sprite.xPos = 20;
+        sprite.yPos = 113;
+        sprite.writeAsBytes(mem.oam + 0 * 4);
+
+        // Flipped in both directions: row 12, on the second tile, mirrored
+        sprite.xPos = 40;
+        sprite.xFlip = true;
+        sprite.yFlip = true;
+        sprite.writeAsBytes(mem.oam + 1 * 4);
+
+        ppu.searchSpritesOnLine();
+
+        REQUIRE(ppu.numSpritesOnCurrentLine == 2);
+
+        SpriteRow &row = ppu.spriteRows[0];
+        REQUIRE(row.sprite.xPos == 20);
+        for (uint8_t i = 0; i < 8; ++i) {
+            REQUIRE(row.pixels[i].isSprite);
+            REQUIRE(row.pixels[i].color == (i == 3 ? 1 : 0));
+            REQUIRE(row.pixels[i].palette == 1);
+            REQUIRE(row.pixels[i].spritePriority == 20);
+            REQUIRE(row.pixels[i].spriteIndex == 0);
+        }
+
+        SpriteRow &flippedRow = ppu.spriteRows[1];
+        REQUIRE(flippedRow.sprite.xPos == 40);
+        for (uint8_t i = 0; i < 8; ++i) {
+            REQUIRE(flippedRow.pixels[i].color == (i == 3 ? 3 : 2));
+            REQUIRE(flippedRow.pixels[i].spriteIndex == 1);
+        }
+    }
 }
 
 TEST_CASE("Get Color from FifoPixel", "[PPU]")
@@ -1685,3 +1792,166 @@ TEST_CASE("PPU Cycle", "[PPU]")
         }
     }
 }
+
+TEST_CASE("Scanline Rendering", "[PPU]")
+{
+    PPU ppu;
+    Memory mem;
+    SM83 cpu;
+
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+    mem.ppu = &ppu;
+    cpu.memory = &mem;
+
+    ppu.emulatorMode = EmulatorMode::DMG;
+    mem.mode = EmulatorMode::DMG;
+
+    // LCD on, BG tile data at 0x8000, sprites on, BG on
+    mem.writemem(0x93, 0xFF40, true);
+    ppu.setBgPaletteData(0xE4);
+    ppu.setObjPalette0Data(0xE4);
+    ppu.setScrollX(3);
+    ppu.setScrollY(0);
+    ppu.setWy(0xFF);
+
+    // Tile 1: the left half has color 1; tile 2: color 3
+    for (int row = 0; row < 8; ++row) {
+        mem.writemem(0xF0, 0x8010 + row * 2, true);
+        mem.writemem(0x00, 0x8011 + row * 2, true);
+        mem.writemem(0xFF, 0x8020 + row * 2, true);
+        mem.writemem(0xFF, 0x8021 + row * 2, true);
+    }
+
+    // The first tile map row alternates between tile 1 and tile 0
+    for (int i = 0; i < 32; ++i)
+        mem.writemem(i % 2 == 0 ? 1 : 0, 0x9800 + i, true);
+
+    // Sprite 0 covers x 20..27 on line 0
+    mem.writemem(16, MEM_OAM_START, true);
+    mem.writemem(28, MEM_OAM_START + 1, true);
+    mem.writemem(2, MEM_OAM_START + 2, true);
+    mem.writemem(0, MEM_OAM_START + 3, true);
+
+    ppu.setLy(0);
+    ppu.setModeFlag(LcdMode::OAM_SEARCH);
+    ppu.currentModeTCycles = 0;
+
+    uint32_t tCycles = 0;
+    while (ppu.getLcdMode() != LcdMode::H_BLANK) {
+        ppu.cycle<DMG, true>();
+        ++tCycles;
+    }
+
+    REQUIRE(tCycles == PPU_OAM_SEARCH_T_CYCLES + PPU_DEFAULT_DRAW_T_CYCLES);
+    REQUIRE(ppu.hBlankModeLength == PPU_DEFAULT_HBLANK_T_CYCLES);
+
+    for (int x = 0; x < PPU_SCREEN_WIDTH; ++x) {
+        uint8_t bgX = x + 3;
+        uint8_t color = (bgX / 8) % 2 == 0 && bgX % 8 < 4 ? 1 : 0;
+        if (x >= 20 && x < 28)
+            color = 3;
+
+        REQUIRE(ppu.display[0][x].red == Color::getDmgColor(color).red);
+    }
+}
+
+TEST_CASE("Render Thread", "[PPU]")
+{
+    // The same scene is drawn by a PPU on its own and by one with a render thread
+    PPU ppu[2];
+    Memory mem[2];
+    SM83 cpu[2];
+    RenderThread renderThread;
+
+    for (int i = 0; i < 2; ++i) {
+        ppu[i].memory = &mem[i];
+        ppu[i].cpu = &cpu[i];
+        mem[i].ppu = &ppu[i];
+        cpu[i].memory = &mem[i];
+        ppu[i].emulatorMode = EmulatorMode::DMG;
+        mem[i].mode = EmulatorMode::DMG;
+
+        // LCD on, window map at 0x9C00, window on, BG tile data at 0x8000, sprites on, BG on
+        mem[i].writemem(0xF3, 0xFF40, true);
+        ppu[i].setBgPaletteData(0xE4);
+        ppu[i].setObjPalette0Data(0xE4);
+        ppu[i].setWy(40);
+        ppu[i].setWx(87);
+
+        // Tile 1: the left half has color 1; tile 2: color 3; tile 3: the top half has color 2
+        for (int row = 0; row < 8; ++row) {
+            mem[i].writemem(0xF0, 0x8010 + row * 2, true);
+            mem[i].writemem(0xFF, 0x8020 + row * 2, true);
+            mem[i].writemem(0xFF, 0x8021 + row * 2, true);
+            mem[i].writemem(row < 4 ? 0xFF : 0x00, 0x8031 + row * 2, true);
+        }
+
+        for (int j = 0; j < 0x400; ++j) {
+            mem[i].writemem(j % 3 == 0 ? 1 : 0, 0x9800 + j, true);
+            mem[i].writemem(j % 2 == 0 ? 3 : 0, 0x9C00 + j, true);
+        }
+
+        // Sprite 0 at x 20, line 30; sprite 1 at x 100, line 60
+        uint8_t sprites[8] = {46, 28, 2, 0, 76, 108, 1, 0};
+        for (int j = 0; j < 8; ++j)
+            mem[i].writemem(sprites[j], MEM_OAM_START + j, true);
+
+        ppu[i].setLy(0);
+        ppu[i].setModeFlag(LcdMode::OAM_SEARCH);
+        ppu[i].currentModeTCycles = 0;
+    }
+
+    renderThread.start(&ppu[1]);
+    REQUIRE(ppu[1].renderThread == &renderThread);
+
+    // Runs both PPUs for the given number of lines. The CPU scrolls the BG in the HBlank of line
+    // 71, moves sprite 1 in the HBlank of line 99 and changes the BG palette in the one of line 119
+    auto runLines = [&](uint32_t lines) {
+        for (uint32_t t = 0; t < lines * PPU_LINE_T_CYCLES; ++t) {
+            for (int i = 0; i < 2; ++i) {
+                uint32_t time = ppu[i].tCycles % (PPU_LINE_T_CYCLES * 154);
+                if (time == 72 * PPU_LINE_T_CYCLES - 10)
+                    mem[i].writemem(13, 0xFF43);
+                else if (time == 100 * PPU_LINE_T_CYCLES - 10)
+                    mem[i].writemem(60, MEM_OAM_START + 5);
+                else if (time == 120 * PPU_LINE_T_CYCLES - 10)
+                    mem[i].writemem(0x1B, 0xFF47);
+
+                ppu[i].cycle<DMG, true>();
+
+                if (ppu[i].readyToDraw) {
+                    ppu[i].readyToDraw = false;
+                    if (ppu[i].renderThread != nullptr)
+                        renderThread.endFrame();
+                }
+            }
+        }
+    };
+
+    ppu[0].tCycles = 0;
+    ppu[1].tCycles = 0;
+
+    Color frame[PPU_SCREEN_HEIGHT][PPU_SCREEN_WIDTH];
+    for (int i = 0; i < 2; ++i) {
+        runLines(154);
+        REQUIRE(renderThread.collectFrame(&frame[0][0]));
+        REQUIRE_FALSE(renderThread.collectFrame(&frame[0][0]));
+
+        bool sameFrame = true;
+        for (int y = 0; y < PPU_SCREEN_HEIGHT; ++y)
+            for (int x = 0; x < PPU_SCREEN_WIDTH; ++x)
+                sameFrame = sameFrame && frame[y][x] == ppu[0].display[y][x];
+        REQUIRE(sameFrame);
+    }
+
+    // The state the emulator PPU didn't keep comes back when the thread stops
+    runLines(50);
+    renderThread.stop();
+
+    REQUIRE(ppu[1].renderThread == nullptr);
+    REQUIRE(ppu[0].windowYCounter > 0);
+    REQUIRE(ppu[1].windowYCounter == ppu[0].windowYCounter);
+    REQUIRE(ppu[1].bgFifo.isDrawingWindow == ppu[0].bgFifo.isDrawingWindow);
+    REQUIRE(ppu[1].numSpritesOnCurrentLine == ppu[0].numSpritesOnCurrentLine);
+}
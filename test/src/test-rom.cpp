@@ -1,9 +1,14 @@
 #include "catch.hpp"
 
+#include "BatterySaver.hpp"
 #include "ROM.hpp"
+#include "RomImageCache.hpp"
+#include "RomLibrary.hpp"
 #include "TestConstants.hpp"
+#include "TestRom.hpp"
 #include <cstdlib>
 #include <experimental/filesystem>
+#include <fstream>
 #include <iostream>
 
 namespace fs = std::experimental::filesystem;
@@ -20,7 +25,7 @@ TEST_CASE("Load ROM and set flags", "[ROM]")
         REQUIRE(loadResult);
         REQUIRE_FALSE(rom.nintendoLogoOk);
         REQUIRE_FALSE(rom.headerChecksumOk);
-        REQUIRE_FALSE(rom.globalchecksumOk);
+        REQUIRE_FALSE(rom.isGlobalChecksumOk());
     }
 
     SECTION("Load a ROM that should pass all checks")
@@ -30,7 +35,7 @@ TEST_CASE("Load ROM and set flags", "[ROM]")
         REQUIRE(loadResult);
         REQUIRE(rom.nintendoLogoOk);
         REQUIRE(rom.headerChecksumOk);
-        REQUIRE(rom.globalchecksumOk);
+        REQUIRE(rom.isGlobalChecksumOk());
     }
 
     SECTION("Load a ROM and check header info")
@@ -52,6 +57,105 @@ TEST_CASE("Load ROM and set flags", "[ROM]")
     }
 }
 
+TEST_CASE("ROM image cache", "[ROM]")
+{
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    REQUIRE(RomImageCache::getNumImages() == 0);
+
+    {
+        ROM rom1, rom2, rom3;
+        REQUIRE(rom1.loadROM(romDirPath / "test_mbc5.gb"));
+        REQUIRE(rom2.loadROM(romDirPath / ".." / TestConstants::testRomsDir / "test_mbc5.gb"));
+        REQUIRE(rom3.loadROM(romDirPath / "test_mbc1.gb"));
+
+        // Instances of the same file share its image
+        REQUIRE(rom1.rom == rom2.rom);
+        REQUIRE(rom1.rom != rom3.rom);
+        REQUIRE(rom1.romFileSize == 0x800000);
+        REQUIRE(RomImageCache::getNumImages() == 2);
+        REQUIRE(rom2.gameTitle == rom1.gameTitle);
+    }
+
+    // The images are released with the last instance
+    REQUIRE(RomImageCache::getNumImages() == 0);
+
+    SECTION("Missing ROM")
+    {
+        ROM rom;
+        REQUIRE_FALSE(rom.loadROM(romDirPath / "missing.gb"));
+        REQUIRE(RomImageCache::getNumImages() == 0);
+    }
+}
+
+TEST_CASE("ROM library", "[ROM]")
+{
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    fs::path libraryPath = fs::temp_directory_path() / "gameboy-emu-test-library";
+    fs::path indexPath = libraryPath / ROM_LIBRARY_INDEX_NAME;
+
+    fs::remove_all(libraryPath);
+    fs::create_directories(libraryPath / "mbc");
+    fs::copy_file(romDirPath / "test_no_mbc_ram.gb", libraryPath / "test_no_mbc_ram.gb");
+    fs::copy_file(romDirPath / "test_mbc1.gb", libraryPath / "mbc" / "test_mbc1.gb");
+    fs::copy_file(romDirPath / "test_mbc5.gb", libraryPath / "mbc" / "test_mbc5.GBC");
+    std::ofstream(libraryPath / "notes.txt") << "not a ROM";
+
+    RomLibrary library;
+    REQUIRE_FALSE(library.loadIndex(indexPath));
+    library.scan(libraryPath, 4);
+
+    REQUIRE(library.entries.size() == 3);
+    REQUIRE(library.headersRead == 3);
+
+    // Same header as a loaded ROM
+    RomLibraryEntry &entry = library.entries[0];
+    ROM rom;
+    REQUIRE(rom.loadROM(libraryPath / "mbc" / "test_mbc1.gb"));
+    REQUIRE(entry.path == (libraryPath / "mbc" / "test_mbc1.gb").string());
+    REQUIRE(entry.gameTitle == rom.gameTitle);
+    REQUIRE(entry.mbc == MBC::MBC1);
+    REQUIRE(entry.romSize == rom.romSize);
+    REQUIRE(entry.ramSize == rom.ramSize);
+    REQUIRE(entry.nintendoLogoOk == rom.nintendoLogoOk);
+    REQUIRE(entry.headerChecksumOk == rom.headerChecksumOk);
+    REQUIRE(entry.globalChecksumState == CHECKSUM_UNKNOWN);
+
+    REQUIRE(library.verifyGlobalChecksum(entry) == rom.isGlobalChecksumOk());
+    REQUIRE(entry.globalChecksumState != CHECKSUM_UNKNOWN);
+
+    REQUIRE(library.saveIndex(indexPath));
+
+    SECTION("Unchanged ROMs come from the index")
+    {
+        RomLibrary indexedLibrary;
+        REQUIRE(indexedLibrary.loadIndex(indexPath));
+        indexedLibrary.scan(libraryPath, 4);
+
+        REQUIRE(indexedLibrary.entries.size() == 3);
+        REQUIRE(indexedLibrary.headersRead == 0);
+        REQUIRE(indexedLibrary.entries[0].gameTitle == entry.gameTitle);
+        REQUIRE(indexedLibrary.entries[0].globalChecksumState == entry.globalChecksumState);
+    }
+
+    SECTION("Changed ROMs are read again")
+    {
+        fs::remove(libraryPath / "test_no_mbc_ram.gb");
+        fs::copy_file(romDirPath / "test_mbc2.gb", libraryPath / "mbc" / "test_mbc1.gb",
+                      fs::copy_options::overwrite_existing);
+
+        RomLibrary indexedLibrary;
+        REQUIRE(indexedLibrary.loadIndex(indexPath));
+        indexedLibrary.scan(libraryPath, 4);
+
+        REQUIRE(indexedLibrary.entries.size() == 2);
+        REQUIRE(indexedLibrary.headersRead == 1);
+        REQUIRE(indexedLibrary.entries[0].mbc == MBC::MBC2);
+        REQUIRE(indexedLibrary.entries[0].globalChecksumState == CHECKSUM_UNKNOWN);
+    }
+
+    fs::remove_all(libraryPath);
+}
+
 TEST_CASE("No MBC and No RAM Read", "[ROM]")
 {
     ROM rom;
@@ -61,9 +165,12 @@ TEST_CASE("No MBC and No RAM Read", "[ROM]")
 
     REQUIRE(loadResult);
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add some data in ROM
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = (uint8_t)i;
+        romBytes[i] = (uint8_t)i;
 
     SECTION("Read nonexisting RAM")
     {
@@ -93,9 +200,12 @@ TEST_CASE("No MBC and RAM Read and Write", "[ROM]")
 
     REQUIRE(loadResult);
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add some data in ROM
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = (uint8_t)i;
+        romBytes[i] = (uint8_t)i;
 
     // Add some data in RAM
     for (uint32_t i = 0; i < rom.ramSize; ++i)
@@ -163,10 +273,13 @@ TEST_CASE("MBC1 Read and Write")
 
     REQUIRE(loadResult);
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add some data
     // Fill each rom bank with its number
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = i / 0x4000;
+        romBytes[i] = i / 0x4000;
 
     // Fill each ram bank with its number
     for (uint32_t i = 0; i < rom.ramSize; ++i)
@@ -177,6 +290,7 @@ TEST_CASE("MBC1 Read and Write")
         SECTION("Bank Mode 0")
         {
             rom.bankMode = 0;
+            rom.mapBanks();
 
             SECTION("ROM Bank 0x00")
             {
@@ -188,11 +302,13 @@ TEST_CASE("MBC1 Read and Write")
             {
                 // Select Bank 0x02
                 rom.currentROMBank = 0x02;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0x4000);
                 REQUIRE(val == 0x02);
 
                 // Select Bank 0x22
                 rom.currentRAMBank = 0x01;
+                rom.mapBanks();
                 val = rom.readmem(0x4000);
                 REQUIRE(val == 0x22);
             }
@@ -213,11 +329,13 @@ TEST_CASE("MBC1 Read and Write")
             {
                 // Select Bank 0x20
                 rom.currentRAMBank = 1;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0x1000);
                 REQUIRE(val == 0x20);
 
                 // Select Bank 0x40
                 rom.currentRAMBank = 2;
+                rom.mapBanks();
                 val = rom.readmem(0x1000);
                 REQUIRE(val == 0x40);
             }
@@ -226,11 +344,13 @@ TEST_CASE("MBC1 Read and Write")
             {
                 // Select ROM Bank 0x01
                 rom.currentROMBank = 1;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0x5000);
                 REQUIRE(val == 0x01);
 
                 // Select ROM Bank 0x10
                 rom.currentROMBank = 0x10;
+                rom.mapBanks();
                 val = rom.readmem(0x4000);
                 REQUIRE(val == 0x10);
             }
@@ -241,11 +361,13 @@ TEST_CASE("MBC1 Read and Write")
 
                 // RAM Bank 1
                 rom.currentRAMBank = 1;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0xA000);
                 REQUIRE(val == 0x01);
 
                 // RAM Bank 2
                 rom.currentRAMBank = 2;
+                rom.mapBanks();
                 val = rom.readmem(0xA000);
                 REQUIRE(val == 0x02);
             }
@@ -296,6 +418,7 @@ TEST_CASE("MBC1 Read and Write")
             SECTION("Bank Mode 0")
             {
                 rom.bankMode = 0;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA066);
                 REQUIRE(rom.ram[0x66] == 0x66);
             }
@@ -304,6 +427,7 @@ TEST_CASE("MBC1 Read and Write")
             {
                 rom.bankMode = 1;
                 rom.currentRAMBank = 1;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA066);
                 REQUIRE(rom.ram[0x2066] == 0x66);
             }
@@ -320,10 +444,13 @@ TEST_CASE("MBC2 Read and Write", "[ROM]")
 
     REQUIRE(loadResult);
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add some data
     // Fill each rom bank with its number
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = i / 0x4000;
+        romBytes[i] = i / 0x4000;
 
     // Fill ram
     for (uint32_t i = 0; i < rom.ramSize; ++i)
@@ -341,11 +468,13 @@ TEST_CASE("MBC2 Read and Write", "[ROM]")
         {
             // Select ROM Bank 0x01
             rom.currentROMBank = 1;
+            rom.mapBanks();
             uint8_t val = rom.readmem(0x4000);
             REQUIRE(val == 0x01);
 
             // Select ROM Bank 0x03
             rom.currentROMBank = 3;
+            rom.mapBanks();
             val = rom.readmem(0x4000);
             REQUIRE(val == 0x03);
         }
@@ -410,10 +539,13 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
 
     REQUIRE(loadResult);
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add some data
     // Fill each rom bank with its number
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = i / 0x4000;
+        romBytes[i] = i / 0x4000;
 
     // Fill each ram bank with its number
     for (uint32_t i = 0; i < rom.ramSize; ++i)
@@ -438,11 +570,13 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
         {
             // Select ROM Bank 1
             rom.currentROMBank = 1;
+            rom.mapBanks();
             uint8_t val = rom.readmem(0x4000);
             REQUIRE(val == 0x01);
 
             // Selct ROM Bank 2
             rom.currentROMBank = 2;
+            rom.mapBanks();
             val = rom.readmem(0x4000);
             REQUIRE(val == 0x02);
         }
@@ -453,11 +587,13 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
 
             // Select RAM Bank 0
             rom.currentRAMBank = 0;
+            rom.mapBanks();
             uint8_t val = rom.readmem(0xA000);
             REQUIRE(val == 0x00);
 
             // Select RAM Bank 1
             rom.currentRAMBank = 1;
+            rom.mapBanks();
             val = rom.readmem(0xA000);
             REQUIRE(val == 0x01);
         }
@@ -469,6 +605,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC S")
             {
                 rom.currentRAMBank = 0x08;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0xA000);
                 REQUIRE(val == 0x08);
             }
@@ -476,6 +613,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC M")
             {
                 rom.currentRAMBank = 0x09;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0xA000);
                 REQUIRE(val == 0x09);
             }
@@ -483,6 +621,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC H")
             {
                 rom.currentRAMBank = 0x0A;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0xA000);
                 REQUIRE(val == 0x0A);
             }
@@ -490,6 +629,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC DL")
             {
                 rom.currentRAMBank = 0x0B;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0xA000);
                 REQUIRE(val == 0x0B);
             }
@@ -497,6 +637,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC DH")
             {
                 rom.currentRAMBank = 0x0C;
+                rom.mapBanks();
                 uint8_t val = rom.readmem(0xA000);
                 REQUIRE(val == 0x0C);
             }
@@ -556,11 +697,13 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
 
             // Select RAM Bank 0
             rom.currentRAMBank = 0;
+            rom.mapBanks();
             rom.writemem(0x66, 0xA066);
             REQUIRE(rom.ram[0x66] == 0x66);
 
             // Select RAM Bank 1
             rom.currentRAMBank = 1;
+            rom.mapBanks();
             rom.writemem(0x66, 0xA066);
             REQUIRE(rom.ram[0x2066] == 0x66);
         }
@@ -572,6 +715,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC S")
             {
                 rom.currentRAMBank = 0x08;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA000);
                 REQUIRE(rom.rtcS == 0x66);
             }
@@ -579,6 +723,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC M")
             {
                 rom.currentRAMBank = 0x09;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA000);
                 REQUIRE(rom.rtcM == 0x66);
             }
@@ -586,6 +731,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC H")
             {
                 rom.currentRAMBank = 0x0A;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA000);
                 REQUIRE(rom.rtcH == 0x66);
             }
@@ -593,6 +739,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC DL")
             {
                 rom.currentRAMBank = 0x0B;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA000);
                 REQUIRE(rom.rtcDL == 0x66);
             }
@@ -600,6 +747,7 @@ TEST_CASE("MBC3 Read and Write", "[ROM]")
             SECTION("RTC DH")
             {
                 rom.currentRAMBank = 0x0C;
+                rom.mapBanks();
                 rom.writemem(0x66, 0xA000);
                 REQUIRE(rom.rtcDH == 0x66);
             }
@@ -616,10 +764,13 @@ TEST_CASE("MBC5 Read and Write", "[ROM]")
 
     REQUIRE(loadResult);
 
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
     // Add some data
     // Fill each rom bank with its number
     for (uint32_t i = 0x0150; i < rom.romSize; ++i)
-        rom.rom[i] = i / 0x4000;
+        romBytes[i] = i / 0x4000;
 
     // Fill each ram bank with its number
     for (uint32_t i = 0; i < rom.ramSize; ++i)
@@ -637,11 +788,13 @@ TEST_CASE("MBC5 Read and Write", "[ROM]")
         {
             // Select ROM Bank 1
             rom.currentROMBank = 1;
+            rom.mapBanks();
             uint8_t val = rom.readmem(0x4000);
             REQUIRE(val == 0x01);
 
             // Select ROM Bank 2
             rom.currentROMBank = 2;
+            rom.mapBanks();
             val = rom.readmem(0x4000);
             REQUIRE(val == 0x02);
         }
@@ -652,14 +805,30 @@ TEST_CASE("MBC5 Read and Write", "[ROM]")
 
             // Select RAM Bank 0
             rom.currentRAMBank = 0;
+            rom.mapBanks();
             uint8_t val = rom.readmem(0xA000);
             REQUIRE(val == 0x00);
 
             // Select RAM Bank 1
             rom.currentRAMBank = 1;
+            rom.mapBanks();
             val = rom.readmem(0xA000);
             REQUIRE(val == 0x01);
         }
+
+        SECTION("Bank switching")
+        {
+            // Banks above 0xFF, switched through the MBC registers
+            rom.writemem(0x05, 0x2000);
+            rom.writemem(0x01, 0x3000);
+            REQUIRE(rom.getMappedBank(0x4000) == 0x105);
+            REQUIRE(rom.readmem(0x4000) == 0x05);
+            REQUIRE(rom.getMappedBank(0x0000) == 0);
+
+            rom.ramEnable = true;
+            rom.writemem(0x03, 0x4000);
+            REQUIRE(rom.readmem(0xA000) == 0x03);
+        }
     }
 
     SECTION("Memory writes")
@@ -705,13 +874,133 @@ TEST_CASE("MBC5 Read and Write", "[ROM]")
 
             // Select RAM Bank 0
             rom.currentRAMBank = 0;
+            rom.mapBanks();
             rom.writemem(0x66, 0xA066);
             REQUIRE(rom.ram[0x66] == 0x66);
 
             // Select RAM Bank 1
             rom.currentRAMBank = 1;
+            rom.mapBanks();
             rom.writemem(0x66, 0xA066);
             REQUIRE(rom.ram[0x2066] == 0x66);
         }
     }
 }
+
+TEST_CASE("Battery saves", "[ROM]")
+{
+    ROM rom;
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+
+    bool loadResult = rom.loadROM(romDirPath / "test_mbc5.gb");
+
+    REQUIRE(loadResult);
+
+    // The test ROM has no battery
+    rom.batterySave = true;
+    rom.saveFilePath = fs::temp_directory_path() / "gameboy-emu-test.sav";
+    fs::path tempPath = rom.saveFilePath;
+    tempPath += ".tmp";
+    fs::remove(rom.saveFilePath);
+
+    rom.ramEnable = true;
+    rom.currentRAMBank = 1;
+    rom.mapBanks();
+
+    auto readSaveFile = [&rom]() {
+        std::ifstream file(rom.saveFilePath, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                    std::istreambuf_iterator<char>());
+    };
+
+    SECTION("RAM writes set the dirty flag")
+    {
+        rom.writemem(0x00, 0xA066);
+        REQUIRE_FALSE(rom.ramDirty);
+
+        // Switching banks doesn't change the save
+        rom.writemem(0x03, 0x4000);
+        REQUIRE_FALSE(rom.ramDirty);
+
+        rom.writemem(0x66, 0xA066);
+        REQUIRE(rom.ramDirty);
+        REQUIRE(rom.ram[0x6066] == 0x66);
+    }
+
+    SECTION("Save after a quiet period")
+    {
+        BatterySaver saver;
+        saver.start(&rom);
+
+        rom.writemem(0x66, 0xA066);
+        for (uint32_t i = 0; i < BATTERY_SAVE_QUIET_FRAMES; ++i) {
+            saver.update();
+            // Keep writing the same value, which doesn't change the save
+            rom.writemem(0x66, 0xA066);
+        }
+        REQUIRE(saver.unsaved);
+
+        saver.update();
+        REQUIRE_FALSE(saver.unsaved);
+
+        saver.stop();
+        REQUIRE(saver.savesWritten == 1);
+
+        std::vector<uint8_t> save = readSaveFile();
+        REQUIRE(save.size() == rom.ramSize);
+        REQUIRE(save[0x2066] == 0x66);
+        REQUIRE_FALSE(fs::exists(tempPath));
+    }
+
+    SECTION("Save a game that keeps writing")
+    {
+        BatterySaver saver;
+        saver.start(&rom);
+
+        for (uint32_t i = 1; i <= BATTERY_SAVE_MAX_DELAY_FRAMES; ++i) {
+            rom.writemem(i, 0xA000);
+            saver.update();
+        }
+        REQUIRE_FALSE(saver.unsaved);
+
+        // Nothing changed since, so there is no final save
+        saver.stop();
+        REQUIRE(saver.savesWritten == 1);
+        REQUIRE(readSaveFile()[0x2000] == (uint8_t)BATTERY_SAVE_MAX_DELAY_FRAMES);
+    }
+
+    SECTION("Save the last changes on stop")
+    {
+        BatterySaver saver;
+        saver.start(&rom);
+
+        saver.update();
+        rom.writemem(0x77, 0xA010);
+        saver.stop();
+
+        REQUIRE(saver.savesWritten == 1);
+        REQUIRE(readSaveFile()[0x2010] == 0x77);
+
+        // The saved RAM is loaded back
+        ROM loadedRom;
+        REQUIRE(loadedRom.loadROM(romDirPath / "test_mbc5.gb"));
+        loadedRom.cartridgeBattery = true;
+        REQUIRE(loadedRom.loadSaveFile(rom.saveFilePath));
+        REQUIRE(loadedRom.ram[0x2010] == 0x77);
+    }
+
+    SECTION("No save without changes")
+    {
+        BatterySaver saver;
+        saver.start(&rom);
+
+        for (uint32_t i = 0; i < BATTERY_SAVE_MAX_DELAY_FRAMES; ++i)
+            saver.update();
+
+        saver.stop();
+        REQUIRE(saver.savesWritten == 0);
+        REQUIRE_FALSE(fs::exists(rom.saveFilePath));
+    }
+
+    fs::remove(rom.saveFilePath);
+}
@@ -1,10 +1,18 @@
 #include "catch.hpp"
 
+#include "Jit.hpp"
 #include "Memory.hpp"
 #include "SM83.hpp"
 #include "PPU.hpp"
+#include "Profiler.hpp"
+#include "TestConstants.hpp"
+#include "TestRom.hpp"
+#include <experimental/filesystem>
+#include <fstream>
 #include <iostream>
 
+namespace fs = std::experimental::filesystem;
+
 TEST_CASE("SM83 Cycle", "[SM83]")
 {
     SM83 cpu;
@@ -866,3 +874,636 @@ TEST_CASE("Set Interrupt Flags", "[SM83]")
         REQUIRE(mem.readmem(0xFF0F) == 0x10);
     }
 }
+
+TEST_CASE("Interrupt Controller", "[SM83]")
+{
+    SM83 cpu;
+    Memory mem;
+    PPU ppu;
+
+    cpu.memory = &mem;
+    mem.ppu = &ppu;
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+
+    cpu.setInterruptEnable(0);
+    cpu.setInterruptFlag(0);
+
+    SECTION("Pending mask follows IE and IF writes")
+    {
+        REQUIRE(!mem.interrupts.anyPending());
+
+        mem.writemem(0x14, 0xFF0F);
+        REQUIRE(!mem.interrupts.anyPending());
+
+        mem.writemem(0x04, 0xFFFF);
+        REQUIRE(mem.interrupts.pending == INTERRUPT_TIMER);
+
+        mem.requestInterrupt(INTERRUPT_VBLANK);
+        mem.writemem(0x05, 0xFFFF);
+        REQUIRE(mem.interrupts.pending == (INTERRUPT_VBLANK | INTERRUPT_TIMER));
+
+        mem.acknowledgeInterrupt(INTERRUPT_VBLANK);
+        REQUIRE(mem.interrupts.pending == INTERRUPT_TIMER);
+        REQUIRE(cpu.getInterruptFlag() == 0x14);
+    }
+
+    SECTION("Highest priority is dispatched first")
+    {
+        int8_t intCycles = -1;
+        uint16_t intAddr = 0;
+        cpu.ime = 1;
+
+        cpu.setInterruptEnable(0x1F);
+        mem.requestInterrupt(INTERRUPT_JOYPAD);
+        mem.requestInterrupt(INTERRUPT_TIMER);
+
+        REQUIRE(cpu.checkInterrupts(&intCycles, &intAddr));
+        REQUIRE(intAddr == SM83_TIMER_INT);
+        REQUIRE(cpu.getTimerInterruptFlag() == 0);
+
+        REQUIRE(cpu.checkInterrupts(&intCycles, &intAddr));
+        REQUIRE(intAddr == SM83_JOYPAD_INT);
+
+        REQUIRE(!cpu.checkInterrupts(&intCycles, &intAddr));
+    }
+}
+
+TEST_CASE("Lazy Flags", "[SM83]")
+{
+    LazyFlags flags;
+
+    SECTION("Assignment keeps all bits")
+    {
+        flags = 0xA5;
+        REQUIRE(flags == 0xA5);
+        REQUIRE(flags.getZero() == 1);
+        REQUIRE(flags.getSubtract() == 0);
+        REQUIRE(flags.getHalfCarry() == 1);
+        REQUIRE(flags.getCarry() == 0);
+    }
+
+    SECTION("Add and subtract match the eager flags")
+    {
+        for (uint16_t a = 0; a < 0x100; ++a) {
+            for (uint16_t b = 0; b < 0x100; ++b) {
+                for (uint8_t carry = 0; carry < 2; ++carry) {
+                    uint16_t sum = a + b + carry;
+                    uint8_t expected = (((sum & 0xFF) == 0) << 7) |
+                                       ((((a & 0xF) + (b & 0xF) + carry) > 0xF) << 5) |
+                                       ((sum > 0xFF) << 4);
+                    flags = 0;
+                    flags.setAdd(a, b, carry);
+                    if (flags != expected)
+                        FAIL("ADD " << a << " " << b << " " << (int)carry);
+
+                    uint8_t diff = a - b - carry;
+                    expected = ((diff == 0) << 7) | (1 << 6) |
+                               (((a & 0xF) < (b & 0xF) + carry) << 5) | ((a < b + carry) << 4);
+                    flags = 0;
+                    flags.setSub(a, b, carry);
+                    if (flags != expected)
+                        FAIL("SUB " << a << " " << b << " " << (int)carry);
+                }
+            }
+        }
+    }
+
+    SECTION("INC and DEC keep the carry flag")
+    {
+        flags = 0x10;
+        flags.setInc(0x10);
+        REQUIRE(flags == 0x30);
+
+        flags.setDec(0x00);
+        REQUIRE(flags == 0xD0);
+
+        flags = 0x0F;
+        flags.setLogic(0x00, 0x20);
+        REQUIRE(flags == 0xAF);
+    }
+}
+
+TEST_CASE("Decode Cache", "[SM83]")
+{
+    SM83 cpu;
+    Memory mem;
+    PPU ppu;
+    ROM rom;
+
+    cpu.memory = &mem;
+    mem.ppu = &ppu;
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    rom.loadROM(romDirPath / "test_mbc1.gb");
+    mem.rom = &rom;
+
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
+    cpu.instructionCycle = 0;
+    cpu.halted = false;
+    cpu.halt_bug = false;
+    cpu.ime = 0;
+
+    // LD A, 0x11 in bank 1 and LD A, 0x22 in bank 2
+    romBytes[0x4000] = 0x3E;
+    romBytes[0x4001] = 0x11;
+    romBytes[0x8000] = 0x3E;
+    romBytes[0x8001] = 0x22;
+
+    SECTION("Instructions are decoded per ROM bank")
+    {
+        cpu.PC = 0x4000;
+        cpu.cycle();
+        cpu.cycle();
+        REQUIRE(cpu.A == 0x11);
+        REQUIRE(cpu.PC == 0x4002);
+
+        DecodedInstruction *instruction = cpu.decodeCache.lookup(&rom, 0x4000);
+        REQUIRE(instruction != nullptr);
+        REQUIRE(instruction->opcode == 0x3E);
+        REQUIRE(instruction->length == 2);
+        REQUIRE(instruction->operands[0] == 0x11);
+
+        // Switch to bank 2
+        mem.writemem(0x02, 0x2000);
+        cpu.PC = 0x4000;
+        cpu.cycle();
+        cpu.cycle();
+        REQUIRE(cpu.A == 0x22);
+
+        // Switch back to bank 1
+        mem.writemem(0x01, 0x2000);
+        cpu.PC = 0x4000;
+        cpu.cycle();
+        cpu.cycle();
+        REQUIRE(cpu.A == 0x11);
+    }
+
+    SECTION("Instructions crossing regions are not cached")
+    {
+        // LD A, n8 with the operand in bank 1
+        romBytes[0x3FFF] = 0x3E;
+        REQUIRE(cpu.decodeCache.lookup(&rom, 0x3FFF) == nullptr);
+
+        cpu.PC = 0x3FFF;
+        cpu.cycle();
+        cpu.cycle();
+        REQUIRE(cpu.A == 0x3E);
+        REQUIRE(cpu.PC == 0x4001);
+    }
+
+    SECTION("Code in RAM bypasses the cache")
+    {
+        mem.wram[0] = 0x3E;
+        mem.wram[1] = 0x33;
+
+        cpu.PC = 0xC000;
+        cpu.cycle();
+        cpu.cycle();
+        REQUIRE(cpu.A == 0x33);
+        REQUIRE(cpu.decodeCache.banks.empty());
+    }
+}
+
+TEST_CASE("JIT", "[SM83]")
+{
+    SM83 cpu;
+    Memory mem;
+    PPU ppu;
+    ROM rom;
+    Jit jit;
+
+    cpu.memory = &mem;
+    mem.ppu = &ppu;
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    rom.loadROM(romDirPath / "test_mbc1.gb");
+    mem.rom = &rom;
+
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
+    cpu.instructionCycle = 0;
+    cpu.halted = false;
+    cpu.halt_bug = false;
+    cpu.ime = 0;
+    cpu.SP = 0xD000;
+    cpu.A = cpu.B = cpu.C = cpu.D = cpu.E = cpu.H = cpu.L = 0;
+    cpu.F = 0;
+    cpu.setInterruptEnable(0);
+
+    // Sums 5 + 4 + ... + 1 in A, stores it at 0xC000 and jumps to 0x0217
+    uint8_t program[] = {
+        0x06, 0x05,       // LD B, 5
+        0x0E, 0x00,       // LD C, 0
+        0x3E, 0x00,       // LD A, 0
+        0x80,             // ADD A, B
+        0x0C,             // INC C
+        0x05,             // DEC B
+        0x20, 0xFB,       // JR NZ, -5
+        0x21, 0x00, 0xC0, // LD HL, 0xC000
+        0x77,             // LD (HL), A
+        0x54,             // LD D, H
+        0x5D,             // LD E, L
+        0x13,             // INC DE
+        0x1B,             // DEC DE
+        0x13,             // INC DE
+        0xC3, 0x17, 0x02, // JP 0x0217
+    };
+    memcpy(romBytes + 0x0200, program, sizeof(program));
+    cpu.PC = 0x0200;
+
+    uint32_t interpreterCycles = 0;
+    while (cpu.PC != 0x0217 || cpu.instructionCycle != 0) {
+        cpu.cycle();
+        ++interpreterCycles;
+    }
+
+    REQUIRE(mem.wram[0] == 15);
+    uint8_t interpreterF = cpu.F;
+
+#if defined(__x86_64__) && defined(__linux__)
+    REQUIRE(jit.init());
+    jit.hotThreshold = 1;
+
+    mem.wram[0] = 0;
+    cpu.A = cpu.B = cpu.C = cpu.D = cpu.E = cpu.H = cpu.L = 0;
+    cpu.F = 0;
+    cpu.PC = 0x0200;
+
+    uint32_t jitCycles = 0;
+    while (cpu.PC != 0x0217) {
+        uint32_t cycles = jit.run(cpu);
+        REQUIRE(cycles > 0);
+        jitCycles += cycles;
+    }
+
+    REQUIRE(jit.blocksCompiled > 0);
+    REQUIRE(jitCycles == interpreterCycles);
+    REQUIRE(mem.wram[0] == 15);
+    REQUIRE(cpu.A == 15);
+    REQUIRE(cpu.B == 0);
+    REQUIRE(cpu.C == 5);
+    REQUIRE(cpu.D == 0xC0);
+    REQUIRE(cpu.E == 0x01);
+    REQUIRE(cpu.H == 0xC0);
+    REQUIRE(cpu.L == 0x00);
+    REQUIRE(cpu.F == interpreterF);
+#else
+    REQUIRE_FALSE(jit.init());
+#endif
+}
+
+TEST_CASE("Idle Loop Detector", "[SM83]")
+{
+    SM83 cpu;
+    Memory mem;
+    PPU ppu;
+    ROM rom;
+
+    cpu.memory = &mem;
+    mem.ppu = &ppu;
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    rom.loadROM(romDirPath / "test_mbc1.gb");
+    mem.rom = &rom;
+
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
+    cpu.instructionCycle = 0;
+    cpu.halted = false;
+    cpu.halt_bug = false;
+    cpu.ime = 0;
+    cpu.SP = 0xD000;
+    cpu.A = cpu.B = cpu.C = cpu.D = cpu.E = cpu.H = cpu.L = 0;
+    cpu.F = 0;
+    cpu.setInterruptEnable(0);
+    cpu.idleLoop.enabled = true;
+
+    SECTION("Polling loop is skipped until the value changes")
+    {
+        // Waits for 0xFF80 to become 1
+        uint8_t program[] = {
+            0xF0, 0x80, // LDH A, (0x80)
+            0xFE, 0x01, // CP 1
+            0x20, 0xFA, // JR NZ, -6
+            0x00,       // NOP
+        };
+        memcpy(romBytes + 0x0300, program, sizeof(program));
+        cpu.PC = 0x0300;
+        mem.hram[0] = 0;
+
+        for (int i = 0; i < 100; ++i)
+            cpu.cycle();
+
+        REQUIRE(cpu.idleLoop.active);
+        REQUIRE(cpu.idleLoop.period == 8);
+        REQUIRE(cpu.idleLoop.skippedCycles > 50);
+        REQUIRE(cpu.PC == 0x0300);
+
+        uint64_t skipped = cpu.idleLoop.skippedCycles;
+        mem.hram[0] = 1;
+
+        int cycles = 0;
+        while (cpu.PC != 0x0306 && cycles < 100) {
+            cpu.cycle();
+            ++cycles;
+        }
+
+        REQUIRE(cpu.PC == 0x0306);
+        REQUIRE_FALSE(cpu.idleLoop.active);
+        REQUIRE(cpu.idleLoop.skippedCycles - skipped < 8);
+
+        IdleLoop &loop = cpu.idleLoop.loops.begin()->second;
+        REQUIRE(loop.idle);
+        REQUIRE(loop.start == 0x0300);
+        REQUIRE(loop.end == 0x0304);
+        REQUIRE(loop.timesSkipped == 1);
+        REQUIRE(loop.skippedCycles == cpu.idleLoop.skippedCycles);
+    }
+
+    SECTION("Pending interrupt stops skipping")
+    {
+        uint8_t program[] = {
+            0xF0, 0x80, // LDH A, (0x80)
+            0xA7,       // AND A
+            0x28, 0xFB, // JR Z, -5
+        };
+        memcpy(romBytes + 0x0300, program, sizeof(program));
+        cpu.PC = 0x0300;
+        mem.hram[0] = 0;
+        cpu.ime = 1;
+
+        for (int i = 0; i < 100; ++i)
+            cpu.cycle();
+
+        REQUIRE(cpu.idleLoop.active);
+
+        cpu.setInterruptEnable(0x01);
+        cpu.setInterruptFlag(0x01);
+        cpu.cycle();
+
+        REQUIRE_FALSE(cpu.idleLoop.active);
+        REQUIRE(cpu.int_cycles >= 0);
+    }
+
+    SECTION("Loops that carry state are not skipped")
+    {
+        // Counts B down from 0xFF
+        uint8_t program[] = {
+            0x06, 0xFF, // LD B, 0xFF
+            0x05,       // DEC B
+            0x20, 0xFD, // JR NZ, -3
+        };
+        memcpy(romBytes + 0x0300, program, sizeof(program));
+        cpu.PC = 0x0300;
+
+        for (int i = 0; i < 200; ++i) {
+            cpu.cycle();
+            REQUIRE_FALSE(cpu.idleLoop.active);
+        }
+
+        REQUIRE(cpu.idleLoop.loops.size() == 1);
+        REQUIRE_FALSE(cpu.idleLoop.loops.begin()->second.idle);
+        REQUIRE(cpu.idleLoop.skippedCycles == 0);
+    }
+
+    SECTION("Loops that write memory are not skipped")
+    {
+        uint8_t program[] = {
+            0xF0, 0x80, // LDH A, (0x80)
+            0xE0, 0x81, // LDH (0x81), A
+            0xA7,       // AND A
+            0x28, 0xF9, // JR Z, -7
+        };
+        memcpy(romBytes + 0x0300, program, sizeof(program));
+        cpu.PC = 0x0300;
+        mem.hram[0] = 0;
+
+        for (int i = 0; i < 100; ++i)
+            cpu.cycle();
+
+        REQUIRE_FALSE(cpu.idleLoop.active);
+        REQUIRE_FALSE(cpu.idleLoop.loops.begin()->second.idle);
+    }
+}
+
+TEST_CASE("Profiler", "[SM83]")
+{
+    SM83 cpu;
+    Memory mem;
+    PPU ppu;
+    ROM rom;
+    Profiler profiler;
+
+    cpu.memory = &mem;
+    mem.ppu = &ppu;
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    rom.loadROM(romDirPath / "test_mbc1.gb");
+    mem.rom = &rom;
+
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
+    uint8_t program[] = {
+        0xCD, 0x10, 0x03, // 0x0300: CALL 0x0310
+        0xCB, 0x37,       // 0x0303: SWAP A
+        0x18, 0xFE,       // 0x0305: JR -2
+    };
+    uint8_t function[] = {
+        0x3E, 0x01, // 0x0310: LD A, 1
+        0xC9,       // 0x0312: RET
+    };
+    memcpy(romBytes + 0x0300, program, sizeof(program));
+    memcpy(romBytes + 0x0310, function, sizeof(function));
+
+    cpu.instructionCycle = 0;
+    cpu.halted = false;
+    cpu.halt_bug = false;
+    cpu.ime = 0;
+    cpu.SP = 0xD000;
+    cpu.PC = 0x0300;
+    cpu.setInterruptEnable(0);
+
+    SECTION("Cycles are counted per address and opcode")
+    {
+        profiler.init(&rom, false);
+
+        for (int i = 0; i < 20; ++i) {
+            profiler.cycle(cpu);
+            cpu.cycle();
+        }
+
+        REQUIRE(profiler.totalCycles == 20);
+        REQUIRE(profiler.romCycles[0x0300] == 6);
+        REQUIRE(profiler.romCycles[0x0303] == 2);
+        REQUIRE(profiler.romCycles[0x0305] == 6);
+        REQUIRE(profiler.romCycles[0x0310] == 2);
+        REQUIRE(profiler.romCycles[0x0312] == 4);
+
+        REQUIRE(profiler.opcodeCounts[0xCD] == 1);
+        REQUIRE(profiler.opcodeCycles[0xCD] == 6);
+        REQUIRE(profiler.opcodeCounts[0x137] == 1);
+        REQUIRE(profiler.opcodeCycles[0x137] == 2);
+        REQUIRE(profiler.opcodeCounts[0x18] == 2);
+    }
+
+    SECTION("Folded stacks follow calls and returns")
+    {
+        profiler.init(&rom, true);
+
+        for (int i = 0; i < 20; ++i) {
+            profiler.cycle(cpu);
+            cpu.cycle();
+        }
+
+        uint32_t main = profiler.getKey(0x0300);
+        uint32_t function = profiler.getKey(0x0310);
+
+        REQUIRE(profiler.callStack.empty());
+        REQUIRE(profiler.stackCycles[{main}] == 6);
+        REQUIRE(profiler.stackCycles[{function, function}] == 2);
+        REQUIRE(profiler.stackCycles[{function, profiler.getKey(0x0312)}] == 4);
+        REQUIRE(profiler.stackCycles[{profiler.getKey(0x0303)}] == 2);
+    }
+
+    SECTION("Addresses are resolved with the RGBDS symbols")
+    {
+        profiler.init(&rom, false);
+
+        fs::path symbolsPath = fs::temp_directory_path() / "gameboy-emu-test.sym";
+        std::ofstream symbols(symbolsPath);
+        symbols << "; File generated by rgblink\n"
+                << "00:0300 Main\n"
+                << "00:0310 Function\n"
+                << "00:0312 Function.return\n"
+                << "01:4000 BankedFunction\n";
+        symbols.close();
+
+        REQUIRE(profiler.loadSymbols(symbolsPath));
+        fs::remove(symbolsPath);
+        REQUIRE(profiler.symbols.size() == 4);
+
+        REQUIRE(profiler.resolve(profiler.getKey(0x0300)) == "Main");
+        REQUIRE(profiler.resolve(profiler.getKey(0x0305)) == "Main+0x5");
+        REQUIRE(profiler.resolve(profiler.getKey(0x0312)) == "Function.return");
+        REQUIRE(profiler.resolve(profiler.getKey(0x0312), false) == "Function");
+        REQUIRE(profiler.resolve(profiler.getKey(0x4010)) == "BankedFunction+0x10");
+        REQUIRE(profiler.resolve(profiler.getKey(0x0200)) == "00:0200");
+        REQUIRE(profiler.resolve(PROFILER_HALT_KEY) == "[halt]");
+    }
+}
+
+TEST_CASE("Tracer", "[SM83]")
+{
+    SM83 cpu;
+    Memory mem;
+    PPU ppu;
+    ROM rom;
+
+    cpu.memory = &mem;
+    mem.ppu = &ppu;
+    ppu.memory = &mem;
+    ppu.cpu = &cpu;
+
+    fs::path romDirPath = fs::current_path() / TestConstants::testRomsDir;
+    rom.loadROM(romDirPath / "test_mbc1.gb");
+    mem.rom = &rom;
+
+    std::vector<uint8_t> romData;
+    uint8_t *romBytes = TestRom::makeWritable(rom, romData);
+
+    uint8_t program[] = {
+        0x3C,       // 0x0300: INC A
+        0x18, 0xFD, // 0x0301: JR -3
+    };
+    memcpy(romBytes + 0x0300, program, sizeof(program));
+
+    cpu.instructionCycle = 0;
+    cpu.halted = false;
+    cpu.halt_bug = false;
+    cpu.ime = 0;
+    cpu.SP = 0xD000;
+    cpu.PC = 0x0300;
+    cpu.A = 0;
+    cpu.B = cpu.C = cpu.D = cpu.E = cpu.H = cpu.L = 0;
+    cpu.F = 0;
+    cpu.setInterruptEnable(0);
+
+    fs::path tracePath = fs::temp_directory_path() / "gameboy-emu-test.trace";
+
+    SECTION("The ring buffer keeps the last instructions")
+    {
+        // 4 records
+        REQUIRE(cpu.tracer.init(TRACE_RING, tracePath, 4 * sizeof(TraceRecord)));
+        REQUIRE(cpu.tracer.records.size() == 4);
+
+        // 10 times INC A, JR
+        for (int i = 0; i < 10 * 4; ++i)
+            cpu.cycle();
+
+        REQUIRE(cpu.tracer.head == 20);
+
+        TraceRecord &last = cpu.tracer.records[19 & cpu.tracer.mask];
+        REQUIRE(last.pc == 0x0301);
+        REQUIRE(last.a == 10);
+        REQUIRE(last.sp == 0xD000);
+        REQUIRE(last.bank == 0);
+        REQUIRE(last.pcmem[0] == 0x18);
+        REQUIRE(last.pcmem[1] == 0xFD);
+
+        REQUIRE(cpu.tracer.dump("test"));
+
+        FILE *log = tmpfile();
+        REQUIRE(Tracer::convertToDoctor(tracePath, log));
+        rewind(log);
+
+        char line[128];
+        std::vector<std::string> lines;
+        while (fgets(line, sizeof(line), log) != nullptr)
+            lines.push_back(line);
+        fclose(log);
+
+        REQUIRE(lines.size() == 4);
+        REQUIRE(lines[0] ==
+                "A:08 F:00 B:00 C:00 D:00 E:00 H:00 L:00 SP:D000 PC:0300 PCMEM:3C,18,FD,00\n");
+        REQUIRE(lines[3] ==
+                "A:0A F:00 B:00 C:00 D:00 E:00 H:00 L:00 SP:D000 PC:0301 PCMEM:18,FD,00,00\n");
+    }
+
+    SECTION("Stream mode writes every instruction")
+    {
+        REQUIRE(cpu.tracer.init(TRACE_STREAM, tracePath, 4 * sizeof(TraceRecord)));
+
+        for (int i = 0; i < 100 * 4; ++i)
+            cpu.cycle();
+        cpu.tracer.stop();
+
+        REQUIRE(fs::file_size(tracePath) == sizeof(TraceFileHeader) + 200 * sizeof(TraceRecord));
+
+        FILE *file = fopen(tracePath.c_str(), "rb");
+        TraceFileHeader header;
+        TraceRecord record;
+        REQUIRE(fread(&header, sizeof(header), 1, file) == 1);
+        for (int i = 0; i < 200; ++i) {
+            REQUIRE(fread(&record, sizeof(record), 1, file) == 1);
+            REQUIRE(record.pc == (i % 2 == 0 ? 0x0300 : 0x0301));
+            REQUIRE(record.a == (i + 1) / 2);
+        }
+        fclose(file);
+    }
+
+    fs::remove(tracePath);
+}
@@ -0,0 +1,267 @@
+#include "HashStream.hpp"
+#include "Memory.hpp"
+#include "Movie.hpp"
+#include "Rewind.hpp"
+#include "SM83.hpp"
+#include "StateSerializer.hpp"
+#include "XXHash.hpp"
+#include "catch.hpp"
+#include <experimental/filesystem>
+
+namespace fs = std::experimental::filesystem;
+
+TEST_CASE("State Serializer", "[STATE]")
+{
+    Memory mem;
+    SM83 cpu;
+    cpu.memory = &mem;
+
+    cpu.A = 0x12;
+    cpu.PC = 0x1234;
+    cpu.SP = 0xFFFE;
+    mem.ieRegister = 0x1F;
+    mem.wram[0x10] = 0x66;
+
+    std::vector<uint8_t> buffer;
+    StateSerializer save(buffer, StateSerializer::SAVE);
+    cpu.serialize(save);
+    mem.serialize(save);
+
+    cpu.A = 0;
+    cpu.PC = 0;
+    cpu.SP = 0;
+    mem.ieRegister = 0;
+    mem.wram[0x10] = 0;
+
+    SECTION("Load restores fields")
+    {
+        StateSerializer load(buffer, StateSerializer::LOAD);
+        cpu.serialize(load);
+        mem.serialize(load);
+
+        REQUIRE(load.isValid());
+        REQUIRE(load.getPosition() == buffer.size());
+        REQUIRE(cpu.A == 0x12);
+        REQUIRE(cpu.PC == 0x1234);
+        REQUIRE(cpu.SP == 0xFFFE);
+        REQUIRE(mem.ieRegister == 0x1F);
+        REQUIRE(mem.wram[0x10] == 0x66);
+    }
+
+    SECTION("Truncated buffer")
+    {
+        buffer.resize(buffer.size() / 2);
+        StateSerializer load(buffer, StateSerializer::LOAD);
+        cpu.serialize(load);
+        mem.serialize(load);
+
+        REQUIRE(!load.isValid());
+    }
+}
+
+TEST_CASE("Rewind", "[STATE]")
+{
+    Rewind rewind;
+    std::vector<uint8_t> state(4096, 0);
+    std::vector<uint8_t> out;
+
+    SECTION("Disabled")
+    {
+        rewind.push(state);
+        REQUIRE(!rewind.isEnabled());
+        REQUIRE(!rewind.rewind(out));
+    }
+
+    SECTION("Push and rewind")
+    {
+        rewind.init(64 * 1024);
+
+        for (uint8_t i = 0; i < 10; ++i) {
+            state[i * 100] = i + 1;
+            rewind.push(state);
+        }
+
+        REQUIRE(rewind.getNumEntries() == 10);
+
+        // each rewind returns the previous snapshot
+        for (int i = 9; i >= 0; --i) {
+            REQUIRE(rewind.rewind(out));
+            REQUIRE(out.size() == state.size());
+            REQUIRE(out[i * 100] == i + 1);
+            if (i < 9)
+                REQUIRE(out[(i + 1) * 100] == 0);
+        }
+
+        // the oldest snapshot is kept
+        REQUIRE(rewind.getNumEntries() == 1);
+        REQUIRE(rewind.rewind(out));
+        REQUIRE(out[0] == 1);
+    }
+
+    SECTION("Deltas are small")
+    {
+        rewind.init(64 * 1024);
+        rewind.push(state);
+        size_t used = rewind.getUsedBytes();
+
+        state[2000] = 0xFF;
+        rewind.push(state);
+        REQUIRE(rewind.getUsedBytes() - used < 16);
+    }
+
+    SECTION("Oldest entries are dropped when full")
+    {
+        rewind.init(2048);
+
+        for (uint32_t i = 0; i < 1000; ++i) {
+            for (uint32_t j = 0; j < 32; ++j)
+                state[(i * 32 + j) % state.size()] ^= 0xA5;
+            rewind.push(state);
+        }
+
+        REQUIRE(rewind.getUsedBytes() <= rewind.getBufferSize());
+        REQUIRE(rewind.getNumEntries() < 1000);
+
+        REQUIRE(rewind.rewind(out));
+        REQUIRE(out == state);
+    }
+}
+
+TEST_CASE("Movie", "[STATE]")
+{
+    Movie movie;
+    bool keyState[2][4] = {{true, false, false, true}, {false, true, true, false}};
+
+    SECTION("Pack keys")
+    {
+        uint8_t keys = Movie::packKeys(keyState);
+        REQUIRE(keys == 0x69);
+
+        bool unpacked[2][4];
+        Movie::unpackKeys(keys, unpacked);
+        for (int i = 0; i < 2; ++i)
+            for (int j = 0; j < 4; ++j)
+                REQUIRE(unpacked[i][j] == keyState[i][j]);
+    }
+
+    SECTION("Serialize")
+    {
+        movie.emulatorMode = CGB;
+        movie.romChecksum = 0x1234;
+        movie.rtcSeed = 1600000000;
+        movie.audioBatchCycles = 4;
+        movie.startState = {1, 2, 3};
+        for (uint8_t i = 0; i < 100; ++i)
+            movie.recordFrame(i);
+
+        std::vector<uint8_t> buffer;
+        StateSerializer save(buffer, StateSerializer::SAVE);
+        movie.serialize(save);
+
+        Movie loaded;
+        StateSerializer load(buffer, StateSerializer::LOAD);
+        loaded.serialize(load);
+
+        REQUIRE(load.isValid());
+        REQUIRE(loaded.emulatorMode == CGB);
+        REQUIRE(loaded.romChecksum == 0x1234);
+        REQUIRE(loaded.rtcSeed == 1600000000);
+        REQUIRE(loaded.audioBatchCycles == 4);
+        REQUIRE(loaded.startState == movie.startState);
+        REQUIRE(loaded.frames == movie.frames);
+
+        uint8_t keys;
+        for (uint8_t i = 0; i < 100; ++i) {
+            REQUIRE(loaded.nextFrame(keys));
+            REQUIRE(keys == i);
+        }
+        REQUIRE(!loaded.nextFrame(keys));
+
+        // Corrupted magic and truncated files are rejected
+        buffer[0] ^= 0xFF;
+        StateSerializer badMagic(buffer, StateSerializer::LOAD);
+        loaded.serialize(badMagic);
+        REQUIRE(!badMagic.isValid());
+
+        buffer[0] ^= 0xFF;
+        buffer.resize(buffer.size() - 1);
+        StateSerializer truncated(buffer, StateSerializer::LOAD);
+        loaded.serialize(truncated);
+        REQUIRE(!truncated.isValid());
+    }
+}
+
+TEST_CASE("Hash Stream", "[STATE]")
+{
+    SECTION("xxHash64 matches the reference")
+    {
+        uint8_t bytes[100];
+        for (int i = 0; i < 100; ++i)
+            bytes[i] = i;
+
+        REQUIRE(xxHash64("", 0) == 0xEF46DB3751D8E999);
+        REQUIRE(xxHash64("a", 1) == 0xD24EC4F1A98C6E5B);
+        REQUIRE(xxHash64("abc", 3) == 0x44BC2CF5AD770999);
+        REQUIRE(xxHash64("abc", 3, 0x9E3779B1) == 0x1318DF30094A85FD);
+        REQUIRE(xxHash64(bytes, sizeof(bytes)) == 0x6AC1E58032166597);
+        REQUIRE(xxHash64(bytes, sizeof(bytes), 0x9E3779B1) == 0x8832442A88284F11);
+    }
+
+    fs::path goldenPath = fs::temp_directory_path() / "gameboy-emu-test.hashes";
+
+    uint8_t frame[160 * 144];
+    float samples[64];
+    memset(frame, 0, sizeof(frame));
+    memset(samples, 0, sizeof(samples));
+
+    // 5 frames with an audio block after frame 2
+    auto run = [&](HashStream &hashes, int changedFrame) {
+        for (uint32_t i = 0; i < 5 && !hashes.diverged; ++i) {
+            hashes.frame = i;
+            frame[0] = i;
+            frame[1] = i == (uint32_t)changedFrame;
+            hashes.addFrame(frame, sizeof(frame));
+            if (i == 2)
+                hashes.addAudio(samples, 64);
+        }
+    };
+
+    HashStream golden;
+    REQUIRE(golden.open(goldenPath));
+    run(golden, -1);
+    REQUIRE(golden.close());
+    REQUIRE(fs::file_size(goldenPath) == 8 + 6 * sizeof(HashRecord));
+
+    HashStream hashes;
+    REQUIRE(hashes.loadGolden(goldenPath));
+    REQUIRE(hashes.golden.size() == 6);
+
+    SECTION("Same run")
+    {
+        run(hashes, -1);
+        REQUIRE_FALSE(hashes.diverged);
+        REQUIRE(hashes.count == 6);
+    }
+
+    SECTION("Stops at the first difference")
+    {
+        run(hashes, 3);
+        REQUIRE(hashes.diverged);
+        REQUIRE(hashes.count == 5);
+        REQUIRE(hashes.actual.frame == 3);
+        REQUIRE(hashes.actual.type == HASH_FRAME);
+        REQUIRE(hashes.expected.frame == 3);
+        REQUIRE(hashes.expected.hash != hashes.actual.hash);
+    }
+
+    SECTION("Longer than the golden stream")
+    {
+        hashes.golden.resize(4);
+        run(hashes, -1);
+        REQUIRE(hashes.diverged);
+        REQUIRE(hashes.actual.frame == 3);
+        REQUIRE(hashes.expected.frame == UINT32_MAX);
+    }
+
+    fs::remove(goldenPath);
+}
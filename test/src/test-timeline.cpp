@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include "FrameMetrics.hpp"
+#include "Histogram.hpp"
+#include "Timeline.hpp"
+#include <experimental/filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::experimental::filesystem;
+
+TEST_CASE("Timeline", "[Timeline]")
+{
+    // The tests that run after this one expect the timeline to be off, even if it fails
+    struct TimelineGuard
+    {
+        ~TimelineGuard() { Timeline::disable(); }
+    } timelineGuard;
+
+    Timeline::enable();
+    Timeline::setThreadName("Test main");
+
+    {
+        TIMELINE_SCOPE("Outer", "Test");
+        TIMELINE_SCOPE("Inner", "Test");
+    }
+
+    std::thread worker([]() {
+        Timeline::setThreadName("Test worker");
+        TIMELINE_SCOPE("Worker", "Test");
+    });
+    worker.join();
+
+    Timeline::disable();
+    {
+        TIMELINE_SCOPE("Disabled", "Test");
+    }
+
+    fs::path timelinePath = fs::temp_directory_path() / "gameboy-emu-test.timeline.json";
+    REQUIRE(Timeline::write(timelinePath));
+
+    std::ifstream file(timelinePath);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string json = contents.str();
+    fs::remove(timelinePath);
+
+    REQUIRE(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+    REQUIRE(json.find("\"args\":{\"name\":\"Test main\"}") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"name\":\"Test worker\"}") != std::string::npos);
+    REQUIRE(json.find("{\"name\":\"Outer\",\"cat\":\"Test\",\"ph\":\"X\"") != std::string::npos);
+    REQUIRE(json.find("{\"name\":\"Inner\",\"cat\":\"Test\",\"ph\":\"X\"") != std::string::npos);
+    REQUIRE(json.find("{\"name\":\"Worker\",\"cat\":\"Test\",\"ph\":\"X\"") != std::string::npos);
+    REQUIRE(json.find("\"Disabled\"") == std::string::npos);
+    // Inner ends first, so it is recorded before Outer
+    REQUIRE(json.find("\"Inner\"") < json.find("\"Outer\""));
+    REQUIRE(json.substr(json.size() - 4) == "\n]}\n");
+}
+
+TEST_CASE("Histogram", "[Timeline]")
+{
+    Histogram histogram;
+
+    SECTION("Values fall in buckets that contain them")
+    {
+        uint64_t values[] = {0, 1, 63, 64, 65, 127, 128, 1000, 16667, 1234567, UINT64_MAX};
+        for (uint64_t value : values) {
+            uint32_t bucket = Histogram::getBucket(value);
+            REQUIRE(bucket < HISTOGRAM_NUM_BUCKETS);
+            REQUIRE(Histogram::getBucketStart(bucket) <= value);
+            REQUIRE(Histogram::getBucketEnd(bucket) >= value);
+            // Relative error of at most 1 / HISTOGRAM_SUB_BUCKETS
+            REQUIRE(Histogram::getBucketEnd(bucket) - Histogram::getBucketStart(bucket) <=
+                    value / HISTOGRAM_SUB_BUCKETS);
+        }
+
+        for (uint32_t bucket = 1; bucket < HISTOGRAM_NUM_BUCKETS; ++bucket)
+            REQUIRE(Histogram::getBucketStart(bucket) == Histogram::getBucketEnd(bucket - 1) + 1);
+    }
+
+    SECTION("Percentiles")
+    {
+        for (uint64_t value = 1; value <= 1000; ++value)
+            histogram.record(value);
+
+        REQUIRE(histogram.count == 1000);
+        REQUIRE(histogram.min == 1);
+        REQUIRE(histogram.max == 1000);
+        REQUIRE(histogram.getMean() == Approx(500.5));
+
+        REQUIRE(histogram.getPercentile(50) >= 500);
+        REQUIRE(histogram.getPercentile(50) <= 500 + 500 / HISTOGRAM_SUB_BUCKETS);
+        REQUIRE(histogram.getPercentile(99) >= 990);
+        REQUIRE(histogram.getPercentile(99) <= 990 + 990 / HISTOGRAM_SUB_BUCKETS);
+        REQUIRE(histogram.getPercentile(100) == 1000);
+
+        histogram.reset();
+        REQUIRE(histogram.count == 0);
+        REQUIRE(histogram.getPercentile(50) == 0);
+    }
+
+    SECTION("Frame metrics keep the interval and the whole run")
+    {
+        FrameMetrics metrics;
+
+        metrics.record(METRIC_EMULATION_TIME, 2000);
+        metrics.endInterval();
+        metrics.record(METRIC_EMULATION_TIME, 8000);
+
+        REQUIRE(metrics.interval[METRIC_EMULATION_TIME].count == 1);
+        REQUIRE(metrics.interval[METRIC_EMULATION_TIME].max == 8000);
+        REQUIRE(metrics.total[METRIC_EMULATION_TIME].count == 1);
+        REQUIRE(metrics.get(METRIC_EMULATION_TIME).count == 2);
+        REQUIRE(metrics.get(METRIC_EMULATION_TIME).min == 2000);
+        REQUIRE(metrics.get(METRIC_PRESENT_TIME).count == 0);
+    }
+}
@@ -280,3 +280,46 @@ TEST_CASE("TAC", "[TIMER]")
         }
     }
 }
+
+TEST_CASE("Timer Advance", "[TIMER]")
+{
+    const uint8_t tacValues[] = {0x00, 0x04, 0x05, 0x06, 0x07};
+    const uint32_t tCycleValues[] = {1, 15, 16, 17, 1000, 70224};
+
+    for (uint8_t tac : tacValues) {
+        for (uint32_t tCycles : tCycleValues) {
+            Memory mem[2];
+            Timer timer[2];
+            PPU ppu[2];
+            SM83 cpu[2];
+
+            for (int i = 0; i < 2; ++i) {
+                timer[i].cpu = &cpu[i];
+                timer[i].memory = &mem[i];
+                ppu[i].cpu = &cpu[i];
+                ppu[i].memory = &mem[i];
+                mem[i].ppu = &ppu[i];
+                mem[i].timer = &timer[i];
+                cpu[i].memory = &mem[i];
+
+                mem[i].ioRegisters[0xFF07 - MEM_IO_START] = tac;
+                mem[i].ioRegisters[0xFF05 - MEM_IO_START] = 0xF0;
+                mem[i].ioRegisters[0xFF06 - MEM_IO_START] = 0x80;
+                timer[i].setDividerCounter(0x1234);
+            }
+
+            // Stepping every T-cycle and advancing at once give the same result
+            for (uint32_t i = 0; i < tCycles; ++i)
+                timer[0].cycle();
+            timer[1].advance(tCycles);
+
+            REQUIRE(timer[1].divCounter == timer[0].divCounter);
+            REQUIRE(timer[1].getDividerRegister() == timer[0].getDividerRegister());
+            REQUIRE(timer[1].getTimerCounter() == timer[0].getTimerCounter());
+            REQUIRE(timer[1].timaSelectedBitPreviousValue == timer[0].timaSelectedBitPreviousValue);
+            REQUIRE(timer[1].timaReloadTCyclesDelay == timer[0].timaReloadTCyclesDelay);
+            REQUIRE(mem[1].ioRegisters[0xFF0F - MEM_IO_START] ==
+                    mem[0].ioRegisters[0xFF0F - MEM_IO_START]);
+        }
+    }
+}
@@ -0,0 +1,324 @@
+#include "catch.hpp"
+
+#include "Recorder.hpp"
+#include "Upscaler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+// 10x9, so the rows end with pixels that don't fill a whole SIMD register
+#define TEST_WIDTH 10
+#define TEST_HEIGHT 9
+
+static uint32_t at(const std::vector<uint32_t> &src, int x, int y)
+{
+    x = std::clamp(x, 0, TEST_WIDTH - 1);
+    y = std::clamp(y, 0, TEST_HEIGHT - 1);
+    return src[y * TEST_WIDTH + x];
+}
+
+static uint32_t channelDistance(uint32_t a, uint32_t b)
+{
+    uint32_t sum = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+        sum += std::abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+    return sum;
+}
+
+static std::vector<uint32_t> scale(ScaleFilter filter, const std::vector<uint32_t> &src,
+                                   uint32_t numThreads, uint32_t outWidth = 0,
+                                   uint32_t outHeight = 0)
+{
+    Upscaler upscaler;
+    upscaler.init(filter, TEST_WIDTH, TEST_HEIGHT, outWidth, outHeight, numThreads);
+
+    std::vector<uint32_t> dest(upscaler.outWidth * upscaler.outHeight);
+    upscaler.scale(src.data(), dest.data(), upscaler.outWidth);
+    return dest;
+}
+
+TEST_CASE("Upscaler", "[Video]")
+{
+    // Few colors, so neighbours are often equal
+    const uint32_t colors[] = {0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF, 0x000000FF};
+    std::vector<uint32_t> src(TEST_WIDTH * TEST_HEIGHT);
+    srand(0x5CA1);
+    for (uint32_t &pixel : src)
+        pixel = colors[rand() % 4];
+
+    SECTION("Scale2x")
+    {
+        std::vector<uint32_t> dest = scale(SCALE_2X, src, 1);
+
+        for (int y = 0; y < TEST_HEIGHT; ++y) {
+            for (int x = 0; x < TEST_WIDTH; ++x) {
+                uint32_t B = at(src, x, y - 1), D = at(src, x - 1, y), E = at(src, x, y);
+                uint32_t F = at(src, x + 1, y), H = at(src, x, y + 1);
+                uint32_t *out = &dest[y * 2 * TEST_WIDTH * 2 + x * 2];
+
+                REQUIRE(out[0] == (D == B && B != F && D != H ? D : E));
+                REQUIRE(out[1] == (B == F && B != D && F != H ? F : E));
+                REQUIRE(out[TEST_WIDTH * 2] == (D == H && D != B && H != F ? D : E));
+                REQUIRE(out[TEST_WIDTH * 2 + 1] == (H == F && D != H && B != F ? F : E));
+            }
+        }
+    }
+
+    SECTION("Scale3x")
+    {
+        std::vector<uint32_t> dest = scale(SCALE_3X, src, 1);
+
+        for (int y = 0; y < TEST_HEIGHT; ++y) {
+            for (int x = 0; x < TEST_WIDTH; ++x) {
+                uint32_t A = at(src, x - 1, y - 1), B = at(src, x, y - 1),
+                         C = at(src, x + 1, y - 1), D = at(src, x - 1, y), E = at(src, x, y),
+                         F = at(src, x + 1, y), G = at(src, x - 1, y + 1), H = at(src, x, y + 1),
+                         I = at(src, x + 1, y + 1);
+                uint32_t expected[9] = {
+                    D == B && D != H && B != F ? D : E,
+                    (D == B && D != H && B != F && E != C) || (B == F && B != D && F != H && E != A)
+                        ? B
+                        : E,
+                    B == F && B != D && F != H ? F : E,
+                    (D == B && D != H && B != F && E != G) || (D == H && D != B && H != F && E != A)
+                        ? D
+                        : E,
+                    E,
+                    (B == F && B != D && F != H && E != I) || (H == F && D != H && B != F && E != C)
+                        ? F
+                        : E,
+                    D == H && D != B && H != F ? D : E,
+                    (D == H && D != B && H != F && E != I) || (H == F && D != H && B != F && E != G)
+                        ? H
+                        : E,
+                    H == F && D != H && B != F ? F : E};
+
+                for (int i = 0; i < 9; ++i)
+                    REQUIRE(dest[(y * 3 + i / 3) * TEST_WIDTH * 3 + x * 3 + i % 3] == expected[i]);
+            }
+        }
+    }
+
+    SECTION("xBR")
+    {
+        std::vector<uint32_t> dest = scale(SCALE_XBR, src, 1);
+
+        for (int y = 0; y < TEST_HEIGHT; ++y) {
+            for (int x = 0; x < TEST_WIDTH; ++x) {
+                for (int corner = 0; corner < 4; ++corner) {
+                    int dx = corner & 1 ? 1 : -1, dy = corner & 2 ? 1 : -1;
+                    uint32_t E = at(src, x, y), F = at(src, x + dx, y), H = at(src, x, y + dy),
+                             I = at(src, x + dx, y + dy);
+
+                    uint32_t weightE = channelDistance(E, at(src, x + dx, y - dy)) +
+                                       channelDistance(E, at(src, x - dx, y + dy)) +
+                                       channelDistance(I, at(src, x + 2 * dx, y)) +
+                                       channelDistance(I, at(src, x, y + 2 * dy)) +
+                                       4 * channelDistance(H, F);
+                    uint32_t weightI = channelDistance(H, at(src, x - dx, y)) +
+                                       channelDistance(H, at(src, x + dx, y + 2 * dy)) +
+                                       channelDistance(F, at(src, x + 2 * dx, y + dy)) +
+                                       channelDistance(F, at(src, x, y - dy)) +
+                                       4 * channelDistance(E, I);
+
+                    uint32_t expected = E;
+                    if (weightE < weightI) {
+                        uint32_t closer = channelDistance(E, F) > channelDistance(E, H) ? H : F;
+                        expected = 0;
+                        for (int shift = 0; shift < 32; shift += 8)
+                            expected |= ((((E >> shift) & 0xFF) + ((closer >> shift) & 0xFF) + 1) >> 1)
+                                        << shift;
+                    }
+
+                    int outX = x * 2 + (corner & 1), outY = y * 2 + (corner >> 1);
+                    REQUIRE(dest[outY * TEST_WIDTH * 2 + outX] == expected);
+                }
+            }
+        }
+    }
+
+    SECTION("Sharp Bilinear")
+    {
+        SECTION("Integer scale")
+        {
+            // Every output pixel is inside a source pixel
+            std::vector<uint32_t> dest =
+                scale(SCALE_SHARP_BILINEAR, src, 1, TEST_WIDTH * 4, TEST_HEIGHT * 4);
+
+            for (int y = 0; y < TEST_HEIGHT * 4; ++y)
+                for (int x = 0; x < TEST_WIDTH * 4; ++x)
+                    REQUIRE(dest[y * TEST_WIDTH * 4 + x] == at(src, x / 4, y / 4));
+        }
+
+        SECTION("Fractional scale")
+        {
+            // 2.5x: the pixels that straddle two source pixels are blended
+            uint32_t outWidth = TEST_WIDTH * 5 / 2, outHeight = TEST_HEIGHT;
+            std::vector<uint32_t> dest = scale(SCALE_SHARP_BILINEAR, src, 1, outWidth, outHeight);
+
+            for (uint32_t x = 0; x < outWidth; ++x) {
+                uint32_t left = at(src, x * 2 / 5, 0), right = at(src, (x * 2 + 1) / 5, 0);
+                uint32_t pixel = dest[x];
+
+                for (int shift = 0; shift < 32; shift += 8) {
+                    uint32_t channel = (pixel >> shift) & 0xFF;
+                    REQUIRE(channel >= std::min((left >> shift) & 0xFF, (right >> shift) & 0xFF));
+                    REQUIRE(channel <= std::max((left >> shift) & 0xFF, (right >> shift) & 0xFF));
+                }
+            }
+        }
+    }
+
+    SECTION("Threads")
+    {
+        ScaleFilter filter =
+            GENERATE(SCALE_NONE, SCALE_2X, SCALE_3X, SCALE_XBR, SCALE_SHARP_BILINEAR);
+
+        std::vector<uint32_t> single = scale(filter, src, 1, 37, 29);
+        std::vector<uint32_t> threaded = scale(filter, src, 3, 37, 29);
+
+        REQUIRE(single == threaded);
+        if (filter == SCALE_NONE)
+            REQUIRE(single == src);
+    }
+
+    SECTION("Started frames")
+    {
+        // The source can be reused as soon as start returns, like the frame of the emulator
+        Upscaler upscaler;
+        upscaler.init(SCALE_XBR, TEST_WIDTH, TEST_HEIGHT, 0, 0, 2);
+        std::vector<uint32_t> frame = src, dest(upscaler.outWidth * upscaler.outHeight);
+
+        upscaler.start(frame.data(), dest.data(), upscaler.outWidth);
+        std::fill(frame.begin(), frame.end(), 0);
+        upscaler.wait();
+        REQUIRE(dest == scale(SCALE_XBR, src, 1));
+
+        Upscaler none;
+        none.init(SCALE_NONE, TEST_WIDTH, TEST_HEIGHT, 0, 0, 2);
+        REQUIRE(none.numThreads == 0);
+    }
+
+    SECTION("Filter names")
+    {
+        ScaleFilter filter;
+        REQUIRE(Upscaler::getFilterByName("xbr", filter));
+        REQUIRE(filter == SCALE_XBR);
+        REQUIRE(std::string(Upscaler::getFilterName(SCALE_SHARP_BILINEAR)) == "sharp-bilinear");
+        REQUIRE_FALSE(Upscaler::getFilterByName("hq4x", filter));
+    }
+}
+
+static std::vector<uint8_t> readFile(const fs::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+TEST_CASE("Recorder", "[Video]")
+{
+    fs::path videoPath = fs::temp_directory_path() / "gameboy-emu-test.y4m";
+    fs::path audioPath = fs::temp_directory_path() / "gameboy-emu-test.wav";
+
+    // White, black and red pixels
+    std::vector<uint32_t> pixels(TEST_WIDTH * TEST_HEIGHT, 0xFFFFFFFF);
+    pixels[1] = 0x000000FF;
+    pixels[2] = 0xFF0000FF;
+
+    // Bigger than a slot, with values out of range
+    std::vector<float> samples(RECORDER_AUDIO_SLOT_SAMPLES + 10, 0.5f);
+    samples[0] = 2.0f;
+    samples[1] = -1.0f;
+
+    Recorder recorder;
+    RecordFormat format = GENERATE(RECORD_Y4M, RECORD_RGBA);
+    bool directIo = GENERATE(false, true);
+    REQUIRE(recorder.start(videoPath, audioPath, format, TEST_WIDTH, TEST_HEIGHT, 60, 1, 44100,
+                           directIo));
+
+    for (int frame = 0; frame < 3; ++frame)
+        recorder.pushFrame(pixels.data());
+    recorder.pushAudio(samples.data(), samples.size());
+    recorder.stop();
+
+    REQUIRE(recorder.frames.dropped == 0);
+    REQUIRE(recorder.audio.head == 2);
+
+    std::vector<uint8_t> video = readFile(videoPath);
+    if (format == RECORD_Y4M) {
+        std::string header = "YUV4MPEG2 W10 H9 F60:1 Ip A1:1 C444\n";
+        REQUIRE(video.size() == header.size() + 3 * (6 + TEST_WIDTH * TEST_HEIGHT * 3));
+        REQUIRE(std::string(video.begin(), video.begin() + header.size()) == header);
+
+        uint8_t *frame = &video[header.size() + 2 * (6 + TEST_WIDTH * TEST_HEIGHT * 3)];
+        REQUIRE(std::string(frame, frame + 6) == "FRAME\n");
+        uint8_t *y = frame + 6, *u = y + TEST_WIDTH * TEST_HEIGHT, *v = u + TEST_WIDTH * TEST_HEIGHT;
+        REQUIRE((int)y[0] == 235);
+        REQUIRE((int)y[1] == 16);
+        REQUIRE((int)u[0] == 128);
+        REQUIRE((int)v[0] == 128);
+        REQUIRE((int)v[2] == 240);
+    } else {
+        REQUIRE(video.size() == 3 * TEST_WIDTH * TEST_HEIGHT * 4);
+        REQUIRE(video[4] == 0x00);
+        REQUIRE(video[7] == 0xFF);
+        REQUIRE(video[8] == 0xFF);
+        REQUIRE(video[9] == 0x00);
+    }
+
+    std::vector<uint8_t> wav = readFile(audioPath);
+    uint32_t dataSize = samples.size() * sizeof(int16_t);
+    REQUIRE(wav.size() == RECORDER_WAV_HEADER_SIZE + dataSize);
+    REQUIRE(std::string(wav.begin(), wav.begin() + 4) == "RIFF");
+    REQUIRE(std::string(wav.begin() + 8, wav.begin() + 16) == "WAVEfmt ");
+
+    auto u32 = [&wav](size_t offset) {
+        return (uint32_t)(wav[offset] | wav[offset + 1] << 8 | wav[offset + 2] << 16 |
+                          wav[offset + 3] << 24);
+    };
+    auto s16 = [&wav](size_t offset) { return (int16_t)(wav[offset] | wav[offset + 1] << 8); };
+    REQUIRE(u32(4) == 36 + dataSize);
+    REQUIRE(u32(24) == 44100);
+    REQUIRE(u32(40) == dataSize);
+    REQUIRE(s16(44) == 32767);
+    REQUIRE(s16(46) == -32767);
+    REQUIRE(s16(48) == 16384);
+    REQUIRE(s16(wav.size() - 2) == 16384);
+
+    fs::remove(videoPath);
+    fs::remove(audioPath);
+}
+
+TEST_CASE("Recorder keeps the timing when it drops", "[Video]")
+{
+    fs::path videoPath = fs::temp_directory_path() / "gameboy-emu-test-drops.rgba";
+    fs::path audioPath = fs::temp_directory_path() / "gameboy-emu-test-drops.wav";
+
+    // Far more than the rings hold, pushed as fast as possible; whatever the writer has no room
+    // for is replaced, so the files have the same length either way
+    std::vector<uint32_t> pixels(TEST_WIDTH * TEST_HEIGHT, 0xFFFFFFFF);
+    std::vector<float> samples(RECORDER_AUDIO_SLOT_SAMPLES * 3 / 2, 0.5f);
+    const int numChunks = 20 * RECORDER_AUDIO_SLOTS;
+
+    Recorder recorder;
+    REQUIRE(recorder.start(videoPath, audioPath, RECORD_RGBA, TEST_WIDTH, TEST_HEIGHT, 60, 1,
+                           44100, false));
+
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        recorder.pushFrame(pixels.data());
+        recorder.pushAudio(samples.data(), samples.size());
+    }
+    recorder.stop();
+
+    REQUIRE(fs::file_size(videoPath) == (uintmax_t)numChunks * TEST_WIDTH * TEST_HEIGHT * 4);
+    REQUIRE(fs::file_size(audioPath) ==
+            RECORDER_WAV_HEADER_SIZE + (uintmax_t)numChunks * samples.size() * sizeof(int16_t));
+
+    fs::remove(videoPath);
+    fs::remove(audioPath);
+}